@@ -0,0 +1,216 @@
+/* ************************************************************************ */
+/* Archive.h                                                                */
+/* ************************************************************************ */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ************************************************************************ */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ************************************************************************ */
+#ifndef _BRIGHT_ARCHIVE_H_
+#define _BRIGHT_ARCHIVE_H_
+
+#include <Bright/IOUtils.h>
+#include <Bright/Hash.h>
+#include <Bright/LZ4.h>
+#include <algorithm>
+#include <string>
+
+// Packed asset archive, the layout is:
+//
+//     archive_header
+//     entry data, every entry start at a multiple of header.alignment
+//     archive_entry[entry_count], sorted by path hash
+//     path strings, not null terminated
+//
+// Uncompressed entries can be used in place from the mapping, so aligning
+// them to the page size allow zero-copy mmap and staging buffer upload.
+#define ARCHIVE_MAGIC 0x4b415042 /* BPAK */
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_DEFAULT_ALIGNMENT 4096
+
+enum archive_compression {
+    ARCHIVE_COMPRESSION_NONE = 0,
+    ARCHIVE_COMPRESSION_LZ4 = 1,
+};
+
+struct archive_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t alignment;
+    uint64_t toc_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+struct archive_entry {
+    uint64_t path_hash;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t uncompressed_size;
+    uint32_t path_offset;
+    uint32_t path_length;
+    uint32_t compression;
+    uint32_t reserved;
+};
+
+struct archive {
+    io_mapped_file mapped;
+    const archive_header *header;
+    const archive_entry *entries;
+    const char *strings;
+};
+
+// fold '\' to '/', paths are stored, hashed and compared in this form.
+inline static std::string archive_normalize_path(const char *path, size_t length)
+{
+    std::string normalized(path, length);
+    std::replace(normalized.begin(), normalized.end(), '\\', '/');
+
+    return normalized;
+}
+
+// hash of the path with '\' folded to '/', both builder and reader use it.
+inline static uint64_t archive_hash_path(const char *path, size_t length)
+{
+    uint64_t hash = HASH_FNV1A64_OFFSET_BASIS;
+
+    for (size_t i = 0; i < length; i++) {
+        char c = path[i] == '\\' ? '/' : path[i];
+        hash = hash_fnv1a64(&c, 1, hash);
+    }
+
+    return hash;
+}
+
+inline static Error archive_open(const char *path, archive *pak)
+{
+    *pak = {};
+
+    if (io_map_file(path, &pak->mapped) != OK)
+        return FAIL;
+
+    /* ranges are checked as offset <= size && length <= size - offset so
+       a corrupted archive can't wrap around */
+    uint64_t size = pak->mapped.size;
+    const archive_header *header = (const archive_header *) pak->mapped.data;
+    if (size < sizeof(archive_header) || header->magic != ARCHIVE_MAGIC || header->version != ARCHIVE_VERSION ||
+        header->toc_offset > size || header->entry_count > (size - header->toc_offset) / sizeof(archive_entry) ||
+        header->strings_offset > size || header->strings_size > size - header->strings_offset) {
+        io_unmap_file(&pak->mapped);
+        return FAIL;
+    }
+
+    const archive_entry *entries = (const archive_entry *) (pak->mapped.data + header->toc_offset);
+
+    for (uint32_t i = 0; i < header->entry_count; i++) {
+        const archive_entry *entry = &entries[i];
+        if (entry->offset > size || entry->size > size - entry->offset ||
+            entry->path_offset > header->strings_size || entry->path_length > header->strings_size - entry->path_offset ||
+            (entry->compression == ARCHIVE_COMPRESSION_NONE && entry->size != entry->uncompressed_size)) {
+            io_unmap_file(&pak->mapped);
+            return FAIL;
+        }
+    }
+
+    pak->header = header;
+    pak->entries = entries;
+    pak->strings = pak->mapped.data + header->strings_offset;
+
+    return OK;
+}
+
+inline static void archive_close(archive *pak)
+{
+    io_unmap_file(&pak->mapped);
+    *pak = {};
+}
+
+// binary search the hashed table of contents, NULL when not found.
+inline static const archive_entry *archive_find(const archive *pak, const char *path)
+{
+    std::string normalized = archive_normalize_path(path, strlen(path));
+    size_t length = std::size(normalized);
+    uint64_t hash = archive_hash_path(std::data(normalized), length);
+
+    size_t lo = 0;
+    size_t hi = pak->header->entry_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (pak->entries[mid].path_hash < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* walk the colliding hashes and compare the real path */
+    for (size_t i = lo; i < pak->header->entry_count && pak->entries[i].path_hash == hash; i++) {
+        const archive_entry *entry = &pak->entries[i];
+        if (entry->path_length == length && memcmp(pak->strings + entry->path_offset, std::data(normalized), length) == 0)
+            return entry;
+    }
+
+    return NULL;
+}
+
+// pointer into the mapping for uncompressed entries, NULL otherwise.
+inline static const char *archive_entry_data(const archive *pak, const archive_entry *entry)
+{
+    if (entry->compression != ARCHIVE_COMPRESSION_NONE)
+        return NULL;
+
+    return pak->mapped.data + entry->offset;
+}
+
+// copy or decompress the entry into dst, dst must hold uncompressed_size.
+inline static Error archive_read(const archive *pak, const archive_entry *entry, void *dst)
+{
+    const char *src = pak->mapped.data + entry->offset;
+
+    switch (entry->compression) {
+        case ARCHIVE_COMPRESSION_NONE:
+            memcpy(dst, src, entry->size);
+            return OK;
+        case ARCHIVE_COMPRESSION_LZ4:
+            if (lz4_decompress(src, entry->size, dst, entry->uncompressed_size) != (int64_t) entry->uncompressed_size)
+                return FAIL;
+            return OK;
+        default:
+            return FAIL;
+    }
+}
+
+// read the entry into a new buffer released with io_free_buf.
+inline static char *archive_read_bytecode(const archive *pak, const char *path, size_t *size)
+{
+    const archive_entry *entry = archive_find(pak, path);
+    if (!entry)
+        return NULL;
+
+    char *buf = (char *) malloc(entry->uncompressed_size);
+    if (archive_read(pak, entry, buf) != OK) {
+        free(buf);
+        return NULL;
+    }
+
+    *size = entry->uncompressed_size;
+
+    return buf;
+}
+
+#endif /* _BRIGHT_ARCHIVE_H_ */
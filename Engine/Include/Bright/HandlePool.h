@@ -0,0 +1,201 @@
+/* ************************************************************************ */
+/* HandlePool.h                                                             */
+/* ************************************************************************ */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ************************************************************************ */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ************************************************************************ */
+#ifndef _BRIGHT_HANDLE_POOL_H_
+#define _BRIGHT_HANDLE_POOL_H_
+
+#include <Bright/Memalloc.h>
+#include <assert.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <new>
+
+// 32 bit handle, the low bits index a slot and the high bits carry the slot
+// generation, releasing a slot bump its generation so handles that still
+// point at it are detected as stale. The null handle is 0. Freed slots are
+// reused oldest first and a slot whose generation is exhausted is retired,
+// so a stale handle never validate again.
+#define HANDLE_INDEX_BITS 20
+#define HANDLE_GENERATION_BITS 12
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1u << HANDLE_GENERATION_BITS) - 1)
+#define HANDLE_POOL_PAGE_SIZE 256
+#define HANDLE_POOL_MAX_PAGES ((1u << HANDLE_INDEX_BITS) / HANDLE_POOL_PAGE_SIZE)
+
+template<typename T>
+struct handle {
+    uint32_t value = 0;
+
+    uint32_t index() const { return value & HANDLE_INDEX_MASK; }
+    uint32_t generation() const { return value >> HANDLE_INDEX_BITS; }
+    bool is_null() const { return value == 0; }
+    explicit operator bool() const { return value != 0; }
+    bool operator==(const handle &other) const { return value == other.value; }
+    bool operator!=(const handle &other) const { return value != other.value; }
+};
+
+// Slots live in fixed pages that never move, objects of a page sit next to
+// each other so a full scan walk contiguous memory. get() is lock free and
+// may run concurrently with allocate() and release() of other slots.
+// allocate(), release(), for_each() and size() serialize on the pool mutex
+// and may be called from any thread, the destructor may not run with any
+// other call.
+template<typename T>
+class handle_pool {
+public:
+    handle_pool() = default;
+    handle_pool(const handle_pool &) = delete;
+
+    ~handle_pool()
+    {
+        for (uint32_t i = 0; i < page_count; i++) {
+            page *p = pages[i].load(std::memory_order_relaxed);
+            for (uint32_t j = 0; j < HANDLE_POOL_PAGE_SIZE; j++) {
+                if (p->alive[j])
+                    _item(p, j)->~T();
+            }
+            memdel(p);
+        }
+    }
+
+    // construct a value initialized T and return its handle.
+    handle<T> allocate(T **ptr = NULL)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        uint32_t index;
+        if (!free_indices.empty()) {
+            index = free_indices.front();
+            free_indices.pop_front();
+        } else {
+            if (next_index % HANDLE_POOL_PAGE_SIZE == 0) {
+                assert(page_count < HANDLE_POOL_MAX_PAGES && "handle pool exhausted");
+                page *p = memnew(page);
+                for (uint32_t j = 0; j < HANDLE_POOL_PAGE_SIZE; j++)
+                    p->generations[j].store(1, std::memory_order_relaxed);
+                pages[page_count++].store(p, std::memory_order_release);
+            }
+            index = next_index++;
+        }
+
+        page *p = pages[index / HANDLE_POOL_PAGE_SIZE].load(std::memory_order_relaxed);
+        uint32_t slot = index % HANDLE_POOL_PAGE_SIZE;
+
+        T *item = new (_item(p, slot)) T();
+        p->alive[slot] = true;
+        ++count;
+
+        if (ptr)
+            *ptr = item;
+
+        return { (p->generations[slot].load(std::memory_order_relaxed) << HANDLE_INDEX_BITS) | index };
+    }
+
+    // NULL when the handle is null, stale or was never allocated.
+    T *get(handle<T> h) const
+    {
+        if (h.is_null() || h.index() >= HANDLE_POOL_MAX_PAGES * HANDLE_POOL_PAGE_SIZE)
+            return NULL;
+
+        page *p = pages[h.index() / HANDLE_POOL_PAGE_SIZE].load(std::memory_order_acquire);
+        if (!p)
+            return NULL;
+
+        uint32_t slot = h.index() % HANDLE_POOL_PAGE_SIZE;
+        if (p->generations[slot].load(std::memory_order_acquire) != h.generation())
+            return NULL;
+
+        return _item(p, slot);
+    }
+
+    bool release(handle<T> h)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        T *item = get(h);
+        if (!item)
+            return false;
+
+        page *p = pages[h.index() / HANDLE_POOL_PAGE_SIZE].load(std::memory_order_relaxed);
+        uint32_t slot = h.index() % HANDLE_POOL_PAGE_SIZE;
+
+        /* generation 0 match no handle, it mark a retired slot instead of
+           wrapping back to the generation of handles still around */
+        uint32_t generation = (h.generation() + 1) & HANDLE_GENERATION_MASK;
+        p->generations[slot].store(generation, std::memory_order_release);
+        p->alive[slot] = false;
+
+        item->~T();
+        if (generation)
+            free_indices.push_back(h.index());
+        --count;
+
+        return true;
+    }
+
+    // visit every live object in index order, fn(handle<T>, T *). The pool
+    // is locked for the walk, fn must not allocate or release from it.
+    template<typename F>
+    void for_each(F fn)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (uint32_t i = 0; i < page_count; i++) {
+            page *p = pages[i].load(std::memory_order_acquire);
+            for (uint32_t j = 0; j < HANDLE_POOL_PAGE_SIZE; j++) {
+                if (!p->alive[j])
+                    continue;
+
+                uint32_t index = i * HANDLE_POOL_PAGE_SIZE + j;
+                fn(handle<T> { (p->generations[j].load(std::memory_order_relaxed) << HANDLE_INDEX_BITS) | index }, _item(p, j));
+            }
+        }
+    }
+
+    uint32_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+private:
+    struct page {
+        alignas(T) unsigned char items[sizeof(T) * HANDLE_POOL_PAGE_SIZE];
+        std::atomic<uint32_t> generations[HANDLE_POOL_PAGE_SIZE];
+        bool alive[HANDLE_POOL_PAGE_SIZE] = {};
+    };
+
+    static T *_item(page *p, uint32_t slot)
+    {
+        return (T *) (p->items + sizeof(T) * slot);
+    }
+
+    mutable std::mutex mutex;
+    std::atomic<page *> pages[HANDLE_POOL_MAX_PAGES] = {};
+    uint32_t page_count = 0;
+    uint32_t next_index = 0;
+    uint32_t count = 0;
+    std::deque<uint32_t> free_indices;
+};
+
+#endif /* _BRIGHT_HANDLE_POOL_H_ */
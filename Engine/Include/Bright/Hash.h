@@ -0,0 +1,58 @@
+/* ************************************************************************ */
+/* Hash.h                                                                   */
+/* ************************************************************************ */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ************************************************************************ */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ************************************************************************ */
+#ifndef _BRIGHT_HASH_H_
+#define _BRIGHT_HASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HASH_FNV1A64_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define HASH_FNV1A64_PRIME        0x100000001b3ULL
+
+// FNV-1a 64 bit, pass the previous result as seed to continue
+// hashing over several discontinuous blocks of memory.
+inline static uint64_t hash_fnv1a64(const void *data, size_t size, uint64_t seed = HASH_FNV1A64_OFFSET_BASIS)
+{
+    const uint8_t *bytes = (const uint8_t *) data;
+    uint64_t hash = seed;
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= HASH_FNV1A64_PRIME;
+    }
+
+    return hash;
+}
+
+template<typename T>
+inline static uint64_t hash_fnv1a64_value(const T &value, uint64_t seed = HASH_FNV1A64_OFFSET_BASIS)
+{
+    return hash_fnv1a64(&value, sizeof(T), seed);
+}
+
+inline static uint64_t hash_combine64(uint64_t a, uint64_t b)
+{
+    return a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+}
+
+#endif /* _BRIGHT_HASH_H_ */
@@ -24,21 +24,69 @@
 #define _IOUTILS_H_
 
 #include <fstream>
-#include <bright/memalloc.h>
+#include <Bright/Memalloc.h>
+#include <Bright/Error.h>
 
-static char *io_read_bytecode(const char *path, size_t *size)
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#define IO_WHOLE_FILE ((size_t) -1)
+
+// read size bytes from offset, into *buf when it is not NULL otherwise into
+// a new buffer released with io_free_buf. buffer is not zero filled since
+// every byte is overwritten by the read. A caller buffer hold capacity bytes,
+// the read fail when it doesn't fit.
+static Error io_read_file(const char *path, size_t offset, size_t size, char **buf, size_t capacity, size_t *read_size)
 {
     std::ifstream file(path, std::ios::ate | std::ios::binary);
     if (!file.is_open())
-        throw std::runtime_error("error open file failed!");
+        return FAIL;
+
+    size_t file_size = file.tellg();
+    if (offset > file_size)
+        return FAIL;
+
+    if (size == IO_WHOLE_FILE || offset + size > file_size)
+        size = file_size - offset;
 
-    *size = file.tellg();
-    file.seekg(0);
+    if (*buf && size > capacity)
+        return FAIL;
 
-    /* malloc buffer */
-    char *buf = (char *) imalloc(*size);
-    file.read(buf, *size);
-    file.close();
+    file.seekg(offset);
+
+    char *dst = *buf ? *buf : (char *) malloc(size);
+    file.read(dst, size);
+
+    if ((size_t) file.gcount() != size) {
+        if (!*buf)
+            free(dst);
+        return FAIL;
+    }
+
+    *buf = dst;
+    *read_size = size;
+
+    return OK;
+}
+
+static char *io_read_bytecode(const char *path, size_t *size)
+{
+    char *buf = NULL;
+
+    if (io_read_file(path, 0, IO_WHOLE_FILE, &buf, 0, size) != OK)
+        throw std::runtime_error("error open file failed!");
 
     return buf;
 }
@@ -48,4 +96,115 @@ static void io_free_buf(char *buf)
     free(buf);
 }
 
+// create or truncate path on the host filesystem.
+static Error io_write_file(const char *path, const void *data, size_t size)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return FAIL;
+
+    file.write((const char *) data, size);
+
+    return file.good() ? OK : FAIL;
+}
+
+// read-only view of a whole file, pages are loaded by the OS on demand so
+// large assets are never copied into an intermediate buffer.
+struct io_mapped_file {
+    const char *data = NULL;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
+
+static Error io_map_file(const char *path, io_mapped_file *mapped)
+{
+    *mapped = {};
+
+#ifdef _WIN32
+    mapped->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mapped->file == INVALID_HANDLE_VALUE)
+        return FAIL;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mapped->file, &size)) {
+        CloseHandle(mapped->file);
+        *mapped = {};
+        return FAIL;
+    }
+
+    mapped->size = (size_t) size.QuadPart;
+
+    /* empty file can't be mapped, leave data NULL */
+    if (mapped->size == 0)
+        return OK;
+
+    mapped->mapping = CreateFileMappingA(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapped->mapping) {
+        CloseHandle(mapped->file);
+        *mapped = {};
+        return FAIL;
+    }
+
+    mapped->data = (const char *) MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mapped->data) {
+        CloseHandle(mapped->mapping);
+        CloseHandle(mapped->file);
+        *mapped = {};
+        return FAIL;
+    }
+#else
+    mapped->fd = open(path, O_RDONLY);
+    if (mapped->fd < 0)
+        return FAIL;
+
+    struct stat st;
+    if (fstat(mapped->fd, &st) != 0) {
+        close(mapped->fd);
+        *mapped = {};
+        return FAIL;
+    }
+
+    mapped->size = (size_t) st.st_size;
+
+    /* empty file can't be mapped, leave data NULL */
+    if (mapped->size == 0)
+        return OK;
+
+    void *data = mmap(NULL, mapped->size, PROT_READ, MAP_PRIVATE, mapped->fd, 0);
+    if (data == MAP_FAILED) {
+        close(mapped->fd);
+        *mapped = {};
+        return FAIL;
+    }
+
+    mapped->data = (const char *) data;
+#endif
+
+    return OK;
+}
+
+static void io_unmap_file(io_mapped_file *mapped)
+{
+#ifdef _WIN32
+    if (mapped->data)
+        UnmapViewOfFile(mapped->data);
+    if (mapped->mapping)
+        CloseHandle(mapped->mapping);
+    if (mapped->file != INVALID_HANDLE_VALUE)
+        CloseHandle(mapped->file);
+#else
+    if (mapped->data)
+        munmap((void *) mapped->data, mapped->size);
+    if (mapped->fd >= 0)
+        close(mapped->fd);
+#endif
+
+    *mapped = {};
+}
+
 #endif /* _IOUTILS_H_ */
@@ -0,0 +1,208 @@
+/* ************************************************************************ */
+/* LZ4.h                                                                    */
+/* ************************************************************************ */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ************************************************************************ */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ************************************************************************ */
+#ifndef _BRIGHT_LZ4_H_
+#define _BRIGHT_LZ4_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// LZ4 block format (no frame header), output is readable by the reference
+// implementation and the other way around. Compression is a greedy single
+// probe hash chain, good enough for offline packing.
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT 12
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_LOG 12
+
+inline static size_t lz4_compress_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+inline static uint32_t _lz4_read32(const uint8_t *p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline static uint32_t _lz4_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+inline static uint8_t *_lz4_write_length(uint8_t *op, size_t length)
+{
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+
+    *op++ = (uint8_t) length;
+    return op;
+}
+
+// return the compressed size, 0 when dst_capacity is too small.
+inline static size_t lz4_compress(const void *src, size_t src_size, void *dst, size_t dst_capacity)
+{
+    const uint8_t *ip = (const uint8_t *) src;
+    const uint8_t *anchor = ip;
+    const uint8_t *end = ip + src_size;
+    uint8_t *op = (uint8_t *) dst;
+    uint8_t *op_end = op + dst_capacity;
+
+    int64_t table[1 << LZ4_HASH_LOG];
+    for (size_t i = 0; i < (1 << LZ4_HASH_LOG); i++)
+        table[i] = -1;
+
+    /* a match can't start within the last LZ4_MF_LIMIT bytes */
+    const uint8_t *match_limit = src_size > LZ4_MF_LIMIT ? end - LZ4_MF_LIMIT : ip;
+
+    while (ip < match_limit) {
+        uint32_t sequence = _lz4_read32(ip);
+        uint32_t h = _lz4_hash(sequence);
+        int64_t ref = table[h];
+        table[h] = ip - (const uint8_t *) src;
+
+        const uint8_t *match = (const uint8_t *) src + ref;
+        if (ref < 0 || ip - match > LZ4_MAX_OFFSET || _lz4_read32(match) != sequence) {
+            ++ip;
+            continue;
+        }
+
+        size_t match_length = LZ4_MIN_MATCH;
+        while (ip + match_length < end - LZ4_LAST_LITERALS && match[match_length] == ip[match_length])
+            ++match_length;
+
+        size_t literal_length = ip - anchor;
+        if (op + 1 + literal_length + literal_length / 255 + 2 + match_length / 255 + 1 > op_end)
+            return 0;
+
+        uint8_t *token = op++;
+        *token = (uint8_t) ((literal_length >= 15 ? 15 : literal_length) << 4);
+        if (literal_length >= 15)
+            op = _lz4_write_length(op, literal_length - 15);
+
+        memcpy(op, anchor, literal_length);
+        op += literal_length;
+
+        uint16_t offset = (uint16_t) (ip - match);
+        *op++ = (uint8_t) (offset & 0xff);
+        *op++ = (uint8_t) (offset >> 8);
+
+        size_t length = match_length - LZ4_MIN_MATCH;
+        *token |= (uint8_t) (length >= 15 ? 15 : length);
+        if (length >= 15)
+            op = _lz4_write_length(op, length - 15);
+
+        ip += match_length;
+        anchor = ip;
+    }
+
+    /* last sequence only carry literals */
+    size_t literal_length = end - anchor;
+    if (op + 1 + literal_length + literal_length / 255 + 1 > op_end)
+        return 0;
+
+    uint8_t *token = op++;
+    *token = (uint8_t) ((literal_length >= 15 ? 15 : literal_length) << 4);
+    if (literal_length >= 15)
+        op = _lz4_write_length(op, literal_length - 15);
+
+    memcpy(op, anchor, literal_length);
+    op += literal_length;
+
+    return op - (uint8_t *) dst;
+}
+
+// return the decompressed size or -1 on malformed input, never write past
+// dst_size bytes of dst.
+inline static int64_t lz4_decompress(const void *src, size_t src_size, void *dst, size_t dst_size)
+{
+    const uint8_t *ip = (const uint8_t *) src;
+    const uint8_t *ip_end = ip + src_size;
+    uint8_t *op = (uint8_t *) dst;
+    uint8_t *op_end = op + dst_size;
+
+    while (ip < ip_end) {
+        uint8_t token = *ip++;
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15) {
+            uint8_t s;
+            do {
+                if (ip >= ip_end)
+                    return -1;
+                s = *ip++;
+                literal_length += s;
+            } while (s == 255);
+        }
+
+        if ((size_t) (ip_end - ip) < literal_length || (size_t) (op_end - op) < literal_length)
+            return -1;
+
+        memcpy(op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        /* block end right after the literals of the last sequence */
+        if (ip == ip_end)
+            break;
+
+        if (ip_end - ip < 2)
+            return -1;
+
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > (size_t) (op - (uint8_t *) dst))
+            return -1;
+
+        size_t match_length = token & 0xf;
+        if (match_length == 15) {
+            uint8_t s;
+            do {
+                if (ip >= ip_end)
+                    return -1;
+                s = *ip++;
+                match_length += s;
+            } while (s == 255);
+        }
+
+        match_length += LZ4_MIN_MATCH;
+        if ((size_t) (op_end - op) < match_length)
+            return -1;
+
+        /* overlapping copy is how LZ4 encode runs, go byte by byte */
+        const uint8_t *match = op - offset;
+        for (size_t i = 0; i < match_length; i++)
+            op[i] = match[i];
+        op += match_length;
+    }
+
+    return op - (uint8_t *) dst;
+}
+
+#endif /* _BRIGHT_LZ4_H_ */
@@ -24,12 +24,101 @@
 #define _MEMALLOC_H_
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
 
 /* use follow the memory allocate */
 #define _post_initialize(ptr) (ptr)
 
+// Tracking record bytes and live allocation count per tag, build with
+// BRIGHT_MEMORY_TRACKING to enable it, otherwise the hooks compile out.
+#define MEMORY_TRACKER_MAX_TAGS 64
+
+struct memory_tag_stats {
+    const char *tag;
+    std::atomic<int64_t> bytes;
+    std::atomic<int64_t> count;
+    std::atomic<int64_t> peak_bytes;
+    std::atomic<uint64_t> total_allocations;
+};
+
+inline memory_tag_stats _memory_tags[MEMORY_TRACKER_MAX_TAGS];
+inline std::atomic<uint32_t> _memory_tag_count = 0;
+inline std::mutex _memory_tag_mutex;
+
+inline static memory_tag_stats *_memory_tracker_find(const char *tag)
+{
+    uint32_t count = _memory_tag_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++) {
+        if (_memory_tags[i].tag == tag || strcmp(_memory_tags[i].tag, tag) == 0)
+            return &_memory_tags[i];
+    }
+
+    std::lock_guard<std::mutex> lock(_memory_tag_mutex);
+
+    /* another thread may have added it meanwhile */
+    count = _memory_tag_count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(_memory_tags[i].tag, tag) == 0)
+            return &_memory_tags[i];
+    }
+
+    if (count == MEMORY_TRACKER_MAX_TAGS)
+        return NULL;
+
+    _memory_tags[count].tag = tag;
+    _memory_tag_count.store(count + 1, std::memory_order_release);
+
+    return &_memory_tags[count];
+}
+
+inline static void memory_tracker_record(const char *tag, int64_t bytes, int64_t count)
+{
+    memory_tag_stats *stats = _memory_tracker_find(tag);
+    if (!stats)
+        return;
+
+    int64_t current = stats->bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    stats->count.fetch_add(count, std::memory_order_relaxed);
+
+    if (count > 0)
+        stats->total_allocations.fetch_add(count, std::memory_order_relaxed);
+
+    int64_t peak = stats->peak_bytes.load(std::memory_order_relaxed);
+    while (current > peak && !stats->peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+        ;
+}
+
+inline static void memory_tracker_report(FILE *stream)
+{
+    uint32_t count = _memory_tag_count.load(std::memory_order_acquire);
+
+    fprintf(stream, "%-24s %14s %10s %14s %12s\n", "tag", "bytes", "live", "peak", "allocations");
+    for (uint32_t i = 0; i < count; i++) {
+        memory_tag_stats *stats = &_memory_tags[i];
+        fprintf(stream, "%-24s %14lld %10lld %14lld %12llu\n", stats->tag,
+                (long long) stats->bytes.load(), (long long) stats->count.load(),
+                (long long) stats->peak_bytes.load(), (unsigned long long) stats->total_allocations.load());
+    }
+}
+
+#ifdef BRIGHT_MEMORY_TRACKING
+#  define memtrack_alloc(tag, size) memory_tracker_record(tag, (int64_t) (size), 1)
+#  define memtrack_free(tag, size) memory_tracker_record(tag, -(int64_t) (size), -1)
+#else
+#  define memtrack_alloc(tag, size) ((void) 0)
+#  define memtrack_free(tag, size) ((void) 0)
+#endif
+
 // allocate memory and initialize members to zero,
 // the default malloc does not initialize members
 inline static void *imalloc(size_t size)
@@ -42,7 +131,269 @@ inline static void *imalloc(size_t size)
     return _post_initialize(ptr);
 }
 
-#define memnew(obj, ...) _post_initialize(new obj(__VA_ARGS__))
-#define memdel(ptr) delete (ptr)
+// parse T out of the memory_type_name signature.
+inline static std::string _memory_parse_type_name(const char *signature)
+{
+    std::string type = signature;
+#if defined(_MSC_VER) && !defined(__clang__)
+    size_t begin = type.find("memory_type_name<") + strlen("memory_type_name<");
+    type = type.substr(begin, type.rfind(">(") - begin);
+    for (const char *prefix : { "struct ", "class ", "union ", "enum " }) {
+        if (type.starts_with(prefix))
+            type.erase(0, strlen(prefix));
+    }
+#else
+    size_t begin = type.find("T = ") + strlen("T = ");
+    type = type.substr(begin, type.find_first_of(";]", begin) - begin);
+#endif
+
+    return type;
+}
+
+// default tag of memnew and pool_new, the report break usage down per type.
+template<typename T>
+inline static const char *memory_type_name()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    static const std::string name = _memory_parse_type_name(__FUNCSIG__);
+#else
+    static const std::string name = _memory_parse_type_name(__PRETTY_FUNCTION__);
+#endif
+    return name.c_str();
+}
+
+template<typename T>
+inline static T *_memnew_track(T *ptr)
+{
+    memtrack_alloc(memory_type_name<T>(), sizeof(T));
+    return ptr;
+}
+
+template<typename T>
+inline static void _memdel_track(T *ptr)
+{
+    if (ptr)
+        memtrack_free(memory_type_name<T>(), sizeof(T));
+    delete ptr;
+}
+
+#define memnew(obj, ...) _post_initialize(_memnew_track(new obj(__VA_ARGS__)))
+#define memdel(ptr) _memdel_track(ptr)
+
+// Linear arena, allocations are bumped from one block and released all at
+// once by arena_reset, nothing is zero filled.
+struct memory_arena {
+    char *base;
+    size_t capacity;
+    size_t offset;
+    size_t peak;
+    const char *tag;
+};
+
+inline static void arena_create(memory_arena *arena, size_t capacity, const char *tag = "arena")
+{
+    arena->base = (char *) malloc(capacity);
+    arena->capacity = capacity;
+    arena->offset = 0;
+    arena->peak = 0;
+    arena->tag = tag;
+    memtrack_alloc(tag, capacity);
+}
+
+inline static void arena_destroy(memory_arena *arena)
+{
+    memtrack_free(arena->tag, arena->capacity);
+    free(arena->base);
+    memset(arena, 0, sizeof(memory_arena));
+}
+
+// return NULL when the arena is full, alignment must be a power of two.
+inline static void *arena_alloc(memory_arena *arena, size_t size, size_t alignment = alignof(max_align_t))
+{
+    size_t offset = (arena->offset + alignment - 1) & ~(alignment - 1);
+    if (offset + size > arena->capacity)
+        return NULL;
+
+    arena->offset = offset + size;
+    if (arena->offset > arena->peak)
+        arena->peak = arena->offset;
+
+    return arena->base + offset;
+}
+
+template<typename T>
+inline static T *arena_alloc_array(memory_arena *arena, size_t count)
+{
+    return (T *) arena_alloc(arena, sizeof(T) * count, alignof(T));
+}
+
+inline static void arena_reset(memory_arena *arena)
+{
+    arena->offset = 0;
+}
+
+// One arena per frame in flight, frame_arena_begin reset the arena of the
+// frame being started, so data stays valid until that frame slot come back.
+#define FRAME_ARENA_COUNT 3
+
+struct frame_arena {
+    memory_arena arenas[FRAME_ARENA_COUNT];
+    uint32_t index;
+};
+
+inline static void frame_arena_create(frame_arena *arena, size_t capacity, const char *tag = "frame_arena")
+{
+    for (uint32_t i = 0; i < FRAME_ARENA_COUNT; i++)
+        arena_create(&arena->arenas[i], capacity, tag);
+    arena->index = 0;
+}
+
+inline static void frame_arena_destroy(frame_arena *arena)
+{
+    for (uint32_t i = 0; i < FRAME_ARENA_COUNT; i++)
+        arena_destroy(&arena->arenas[i]);
+}
+
+inline static void frame_arena_begin(frame_arena *arena, uint64_t frame)
+{
+    arena->index = (uint32_t) (frame % FRAME_ARENA_COUNT);
+    arena_reset(&arena->arenas[arena->index]);
+}
+
+inline static void *frame_arena_alloc(frame_arena *arena, size_t size, size_t alignment = alignof(max_align_t))
+{
+    return arena_alloc(&arena->arenas[arena->index], size, alignment);
+}
+
+// Fixed-size pool of one type, slots are carved from chunks and recycled
+// through a free list. Every thread keep a small cache of free slots and
+// exchange them with the shared list in batches, so the lock is only taken
+// once every OBJECT_POOL_THREAD_CACHE_SIZE allocations.
+#define OBJECT_POOL_CHUNK_SIZE 64
+#define OBJECT_POOL_THREAD_CACHE_SIZE 32
+
+template<typename T>
+class object_pool {
+public:
+    union slot {
+        slot *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    static object_pool &instance()
+    {
+        static object_pool pool;
+        return pool;
+    }
+
+    void *allocate()
+    {
+        thread_cache &cache = _cache();
+        if (!cache.head)
+            _refill(&cache);
+
+        slot *s = cache.head;
+        cache.head = s->next;
+        --cache.count;
+
+        return s;
+    }
+
+    void release(void *ptr)
+    {
+        thread_cache &cache = _cache();
+
+        slot *s = (slot *) ptr;
+        s->next = cache.head;
+        cache.head = s;
+
+        if (++cache.count > OBJECT_POOL_THREAD_CACHE_SIZE * 2)
+            _flush(&cache, OBJECT_POOL_THREAD_CACHE_SIZE);
+    }
+
+    ~object_pool()
+    {
+        for (slot *chunk : chunks)
+            free(chunk);
+    }
+
+private:
+    struct thread_cache {
+        slot *head = NULL;
+        uint32_t count = 0;
+
+        ~thread_cache()
+        {
+            if (count)
+                instance()._flush(this, count);
+        }
+    };
+
+    static thread_cache &_cache()
+    {
+        static thread_local thread_cache cache;
+        return cache;
+    }
+
+    void _refill(thread_cache *cache)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!free_list) {
+            slot *chunk = (slot *) malloc(sizeof(slot) * OBJECT_POOL_CHUNK_SIZE);
+            for (uint32_t i = 0; i < OBJECT_POOL_CHUNK_SIZE; i++)
+                chunk[i].next = i + 1 < OBJECT_POOL_CHUNK_SIZE ? &chunk[i + 1] : NULL;
+            free_list = chunk;
+            chunks.push_back(chunk);
+            memtrack_alloc("object_pool", sizeof(slot) * OBJECT_POOL_CHUNK_SIZE);
+        }
+
+        for (uint32_t i = 0; i < OBJECT_POOL_THREAD_CACHE_SIZE && free_list; i++) {
+            slot *s = free_list;
+            free_list = s->next;
+            s->next = cache->head;
+            cache->head = s;
+            ++cache->count;
+        }
+    }
+
+    void _flush(thread_cache *cache, uint32_t count)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (uint32_t i = 0; i < count && cache->head; i++) {
+            slot *s = cache->head;
+            cache->head = s->next;
+            --cache->count;
+            s->next = free_list;
+            free_list = s;
+        }
+    }
+
+    std::mutex mutex;
+    slot *free_list = NULL;
+    std::vector<slot *> chunks;
+};
+
+// value initialize like imalloc did for plain structs, T() zero the members
+// that have no default initializer.
+template<typename T, typename... Args>
+inline static T *pool_new(Args&&... args)
+{
+    void *ptr = object_pool<T>::instance().allocate();
+    memtrack_alloc(memory_type_name<T>(), sizeof(T));
+    return new (ptr) T(std::forward<Args>(args)...);
+}
+
+template<typename T>
+inline static void pool_delete(T *ptr)
+{
+    if (!ptr)
+        return;
+
+    ptr->~T();
+    object_pool<T>::instance().release(ptr);
+    memtrack_free(memory_type_name<T>(), sizeof(T));
+}
 
 #endif /* _MEMALLOC_H_ */
\ No newline at end of file
@@ -0,0 +1,763 @@
+/* ======================================================================== */
+/* SIMDMath.h                                                               */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _BRIGHT_SIMD_MATH_H_
+#define _BRIGHT_SIMD_MATH_H_
+
+#include <Bright/Math.h>
+#include <atomic>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#  define SIMD_MATH_X86
+#  include <immintrin.h>
+#  if defined(_MSC_VER) && !defined(__clang__)
+#    include <intrin.h>
+#    define SIMD_MATH_TARGET_SSE2
+#    define SIMD_MATH_TARGET_AVX2
+#  else
+#    include <cpuid.h>
+#    define SIMD_MATH_TARGET_SSE2 __attribute__((target("sse2")))
+#    define SIMD_MATH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#  endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#  define SIMD_MATH_NEON
+#  include <arm_neon.h>
+#endif
+
+// Batched math kernels over arrays of aligned types, for the transform and
+// cull loops that run over every object of a frame. The glm types of
+// Math.h are left as they are (they mirror shader layouts), convert with
+// simd_load and simd_store.
+//
+// Every kernel exist in scalar, SSE2, AVX2 + FMA and NEON, the best level
+// the CPU (and OS) supports is picked on first use. The BRIGHT_SIMD_LEVEL
+// variable (scalar, sse2, avx2, neon) or simd_set_level lower it, to
+// compare the paths. Results between levels only differ by rounding.
+enum simd_level {
+    SIMD_LEVEL_SCALAR,
+    SIMD_LEVEL_SSE2,
+    SIMD_LEVEL_AVX2,
+    SIMD_LEVEL_NEON,
+    SIMD_LEVEL_COUNT,
+};
+
+struct alignas(16) simd_vec4 {
+    float x, y, z, w;
+};
+
+/* column major, same as glm */
+struct alignas(16) simd_mat4 {
+    simd_vec4 columns[4];
+};
+
+struct alignas(16) simd_quat {
+    float x, y, z, w;
+};
+
+/* w of min and max are ignored */
+struct alignas(16) simd_aabb {
+    simd_vec4 min;
+    simd_vec4 max;
+};
+
+// normalized planes (xyz normal pointing inside, w distance), kept as
+// structure of arrays padded to 8 lanes for the kernels. Padding planes
+// always pass.
+#define SIMD_FRUSTUM_PLANE_COUNT 6
+#define SIMD_FRUSTUM_LANE_COUNT 8
+
+struct alignas(32) simd_frustum {
+    float nx[SIMD_FRUSTUM_LANE_COUNT];
+    float ny[SIMD_FRUSTUM_LANE_COUNT];
+    float nz[SIMD_FRUSTUM_LANE_COUNT];
+    float d[SIMD_FRUSTUM_LANE_COUNT];
+    /* absolute normal, project the box extent */
+    float ax[SIMD_FRUSTUM_LANE_COUNT];
+    float ay[SIMD_FRUSTUM_LANE_COUNT];
+    float az[SIMD_FRUSTUM_LANE_COUNT];
+};
+
+inline static simd_mat4 simd_load(const mat4 &m)
+{
+    simd_mat4 result;
+    memcpy(&result, glm::value_ptr(m), sizeof(simd_mat4));
+    return result;
+}
+
+inline static mat4 simd_store(const simd_mat4 &m)
+{
+    mat4 result;
+    memcpy(glm::value_ptr(result), &m, sizeof(simd_mat4));
+    return result;
+}
+
+inline static simd_quat simd_load(const quat &q)
+{
+    return { q.x, q.y, q.z, q.w };
+}
+
+inline static quat simd_store(const simd_quat &q)
+{
+    return quat(q.w, q.x, q.y, q.z);
+}
+
+// planes of a Vulkan clip space (0 <= z <= w) view projection.
+inline static simd_frustum simd_frustum_from_matrix(const mat4 &viewProjection)
+{
+    vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    vec4 planes[SIMD_FRUSTUM_PLANE_COUNT] = {
+        rows[3] + rows[0],
+        rows[3] - rows[0],
+        rows[3] + rows[1],
+        rows[3] - rows[1],
+        rows[2],
+        rows[3] - rows[2],
+    };
+
+    simd_frustum frustum;
+    for (int i = 0; i < SIMD_FRUSTUM_LANE_COUNT; i++) {
+        vec4 plane = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        if (i < SIMD_FRUSTUM_PLANE_COUNT)
+            plane = planes[i] / glm::length(vec3(planes[i]));
+
+        frustum.nx[i] = plane.x;
+        frustum.ny[i] = plane.y;
+        frustum.nz[i] = plane.z;
+        frustum.d[i] = plane.w;
+        frustum.ax[i] = fabsf(plane.x);
+        frustum.ay[i] = fabsf(plane.y);
+        frustum.az[i] = fabsf(plane.z);
+    }
+
+    return frustum;
+}
+
+/* ======================================================================== */
+/* scalar kernels, also the reference of the others                         */
+/* ======================================================================== */
+
+// a is advanced by aStep (0 or 1) per matrix, out may alias b.
+inline static void _simd_mat4_mul_scalar(const simd_mat4 *a, size_t aStep, const simd_mat4 *b, simd_mat4 *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++, a += aStep) {
+        const float *pa = &a->columns[0].x;
+        const float *pb = &b[i].columns[0].x;
+
+        float result[16];
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                result[column * 4 + row] = pa[0 * 4 + row] * pb[column * 4 + 0] + pa[1 * 4 + row] * pb[column * 4 + 1] +
+                                           pa[2 * 4 + row] * pb[column * 4 + 2] + pa[3 * 4 + row] * pb[column * 4 + 3];
+            }
+        }
+
+        memcpy(&out[i], result, sizeof(result));
+    }
+}
+
+// visible when the box is on the inner side of every plane, conservative
+// near the frustum corners.
+inline static size_t _simd_frustum_cull_aabb_scalar(const simd_frustum *frustum, const simd_aabb *boxes, size_t count, uint32_t *visible)
+{
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        const simd_aabb *box = &boxes[i];
+        float cx = (box->max.x + box->min.x) * 0.5f, ex = (box->max.x - box->min.x) * 0.5f;
+        float cy = (box->max.y + box->min.y) * 0.5f, ey = (box->max.y - box->min.y) * 0.5f;
+        float cz = (box->max.z + box->min.z) * 0.5f, ez = (box->max.z - box->min.z) * 0.5f;
+
+        bool inside = true;
+        for (int j = 0; j < SIMD_FRUSTUM_PLANE_COUNT; j++) {
+            float distance = frustum->nx[j] * cx + frustum->ny[j] * cy + frustum->nz[j] * cz + frustum->d[j];
+            float radius = frustum->ax[j] * ex + frustum->ay[j] * ey + frustum->az[j] * ez;
+            inside = inside && distance + radius >= 0.0f;
+        }
+
+        visible[visibleCount] = (uint32_t) i;
+        visibleCount += inside;
+    }
+
+    return visibleCount;
+}
+
+// slerp without trigonometry (Eberly, "A Fast and Accurate Algorithm for
+// Computing SLERP"), a polynomial in cos(theta) with the last term scaled
+// to absorb the truncation, about 2e-5 off the exact coefficients. Only
+// mul/add, so every lane of the SIMD paths compute it the same way.
+#define SIMD_SLERP_TERM_COUNT 8
+#define SIMD_SLERP_MU 1.85298109240830f
+
+struct simd_slerp_terms {
+    /* u[i] * t^2 - v[i] and the same with (1 - t) */
+    float t[SIMD_SLERP_TERM_COUNT];
+    float d[SIMD_SLERP_TERM_COUNT];
+};
+
+inline static simd_slerp_terms _simd_slerp_terms(float t)
+{
+    simd_slerp_terms terms;
+    float d = 1.0f - t;
+    for (int i = 0; i < SIMD_SLERP_TERM_COUNT; i++) {
+        float n = (float) (i + 1);
+        float u = 1.0f / (n * (2.0f * n + 1.0f));
+        float v = n / (2.0f * n + 1.0f);
+        if (i == SIMD_SLERP_TERM_COUNT - 1) {
+            u *= SIMD_SLERP_MU;
+            v *= SIMD_SLERP_MU;
+        }
+
+        terms.t[i] = u * t * t - v;
+        terms.d[i] = u * d * d - v;
+    }
+
+    return terms;
+}
+
+inline static void _simd_quat_slerp_scalar(const simd_quat *a, const simd_quat *b, float t, simd_quat *out, size_t count)
+{
+    simd_slerp_terms terms = _simd_slerp_terms(t);
+    float d = 1.0f - t;
+
+    for (size_t i = 0; i < count; i++) {
+        float dot = a[i].x * b[i].x + a[i].y * b[i].y + a[i].z * b[i].z + a[i].w * b[i].w;
+
+        /* shortest path */
+        float sign = dot < 0.0f ? -1.0f : 1.0f;
+        float xm1 = dot * sign - 1.0f;
+
+        float ct = 1.0f, cd = 1.0f;
+        for (int j = SIMD_SLERP_TERM_COUNT - 1; j >= 0; j--) {
+            ct = 1.0f + terms.t[j] * xm1 * ct;
+            cd = 1.0f + terms.d[j] * xm1 * cd;
+        }
+
+        ct *= t * sign;
+        cd *= d;
+
+        out[i] = { a[i].x * cd + b[i].x * ct, a[i].y * cd + b[i].y * ct, a[i].z * cd + b[i].z * ct, a[i].w * cd + b[i].w * ct };
+    }
+}
+
+#if defined(SIMD_MATH_X86)
+/* ======================================================================== */
+/* SSE2                                                                     */
+/* ======================================================================== */
+
+SIMD_MATH_TARGET_SSE2
+inline static void _simd_mat4_mul_sse2(const simd_mat4 *a, size_t aStep, const simd_mat4 *b, simd_mat4 *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++, a += aStep) {
+        __m128 a0 = _mm_load_ps(&a->columns[0].x);
+        __m128 a1 = _mm_load_ps(&a->columns[1].x);
+        __m128 a2 = _mm_load_ps(&a->columns[2].x);
+        __m128 a3 = _mm_load_ps(&a->columns[3].x);
+
+        __m128 result[4];
+        for (int column = 0; column < 4; column++) {
+            __m128 bc = _mm_load_ps(&b[i].columns[column].x);
+            __m128 r = _mm_mul_ps(a0, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(0, 0, 0, 0)));
+            r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(1, 1, 1, 1))));
+            r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(2, 2, 2, 2))));
+            r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_shuffle_ps(bc, bc, _MM_SHUFFLE(3, 3, 3, 3))));
+            result[column] = r;
+        }
+
+        for (int column = 0; column < 4; column++)
+            _mm_store_ps(&out[i].columns[column].x, result[column]);
+    }
+}
+
+// one box at a time against the 8 plane lanes, in two halves.
+SIMD_MATH_TARGET_SSE2
+inline static size_t _simd_frustum_cull_aabb_sse2(const simd_frustum *frustum, const simd_aabb *boxes, size_t count, uint32_t *visible)
+{
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 zero = _mm_setzero_ps();
+
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        __m128 mn = _mm_load_ps(&boxes[i].min.x);
+        __m128 mx = _mm_load_ps(&boxes[i].max.x);
+        __m128 c = _mm_mul_ps(_mm_add_ps(mx, mn), half);
+        __m128 e = _mm_mul_ps(_mm_sub_ps(mx, mn), half);
+
+        __m128 cx = _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 cy = _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 cz = _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 ex = _mm_shuffle_ps(e, e, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 ey = _mm_shuffle_ps(e, e, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 ez = _mm_shuffle_ps(e, e, _MM_SHUFFLE(2, 2, 2, 2));
+
+        int outside = 0;
+        for (int lane = 0; lane < SIMD_FRUSTUM_LANE_COUNT; lane += 4) {
+            __m128 distance = _mm_add_ps(_mm_mul_ps(_mm_load_ps(&frustum->nx[lane]), cx), _mm_load_ps(&frustum->d[lane]));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(&frustum->ny[lane]), cy));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(&frustum->nz[lane]), cz));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(&frustum->ax[lane]), ex));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(&frustum->ay[lane]), ey));
+            distance = _mm_add_ps(distance, _mm_mul_ps(_mm_load_ps(&frustum->az[lane]), ez));
+            outside |= _mm_movemask_ps(_mm_cmplt_ps(distance, zero));
+        }
+
+        visible[visibleCount] = (uint32_t) i;
+        visibleCount += outside == 0;
+    }
+
+    return visibleCount;
+}
+
+// four quaternions per iteration as structure of arrays.
+SIMD_MATH_TARGET_SSE2
+inline static void _simd_quat_slerp_sse2(const simd_quat *a, const simd_quat *b, float t, simd_quat *out, size_t count)
+{
+    simd_slerp_terms terms = _simd_slerp_terms(t);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 vt = _mm_set1_ps(t);
+    __m128 vd = _mm_set1_ps(1.0f - t);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 ax = _mm_load_ps(&a[i + 0].x), ay = _mm_load_ps(&a[i + 1].x), az = _mm_load_ps(&a[i + 2].x), aw = _mm_load_ps(&a[i + 3].x);
+        __m128 bx = _mm_load_ps(&b[i + 0].x), by = _mm_load_ps(&b[i + 1].x), bz = _mm_load_ps(&b[i + 2].x), bw = _mm_load_ps(&b[i + 3].x);
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+        __m128 sign = _mm_and_ps(dot, signMask);
+        __m128 xm1 = _mm_sub_ps(_mm_xor_ps(dot, sign), one);
+
+        __m128 ct = one, cd = one;
+        for (int j = SIMD_SLERP_TERM_COUNT - 1; j >= 0; j--) {
+            ct = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(terms.t[j]), xm1), ct));
+            cd = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(terms.d[j]), xm1), cd));
+        }
+
+        /* shortest path, flip b through its coefficient */
+        ct = _mm_xor_ps(_mm_mul_ps(ct, vt), sign);
+        cd = _mm_mul_ps(cd, vd);
+
+        __m128 rx = _mm_add_ps(_mm_mul_ps(ax, cd), _mm_mul_ps(bx, ct));
+        __m128 ry = _mm_add_ps(_mm_mul_ps(ay, cd), _mm_mul_ps(by, ct));
+        __m128 rz = _mm_add_ps(_mm_mul_ps(az, cd), _mm_mul_ps(bz, ct));
+        __m128 rw = _mm_add_ps(_mm_mul_ps(aw, cd), _mm_mul_ps(bw, ct));
+        _MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+
+        _mm_store_ps(&out[i + 0].x, rx);
+        _mm_store_ps(&out[i + 1].x, ry);
+        _mm_store_ps(&out[i + 2].x, rz);
+        _mm_store_ps(&out[i + 3].x, rw);
+    }
+
+    _simd_quat_slerp_scalar(a + i, b + i, t, out + i, count - i);
+}
+
+/* ======================================================================== */
+/* AVX2 + FMA                                                               */
+/* ======================================================================== */
+
+// two columns of the result per register.
+SIMD_MATH_TARGET_AVX2
+inline static void _simd_mat4_mul_avx2(const simd_mat4 *a, size_t aStep, const simd_mat4 *b, simd_mat4 *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++, a += aStep) {
+        __m256 a0 = _mm256_broadcast_ps((const __m128 *) &a->columns[0]);
+        __m256 a1 = _mm256_broadcast_ps((const __m128 *) &a->columns[1]);
+        __m256 a2 = _mm256_broadcast_ps((const __m128 *) &a->columns[2]);
+        __m256 a3 = _mm256_broadcast_ps((const __m128 *) &a->columns[3]);
+
+        __m256 b01 = _mm256_loadu_ps(&b[i].columns[0].x);
+        __m256 b23 = _mm256_loadu_ps(&b[i].columns[2].x);
+
+        __m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, _MM_SHUFFLE(0, 0, 0, 0)));
+        r01 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b01, _MM_SHUFFLE(1, 1, 1, 1)), r01);
+        r01 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b01, _MM_SHUFFLE(2, 2, 2, 2)), r01);
+        r01 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b01, _MM_SHUFFLE(3, 3, 3, 3)), r01);
+
+        __m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, _MM_SHUFFLE(0, 0, 0, 0)));
+        r23 = _mm256_fmadd_ps(a1, _mm256_permute_ps(b23, _MM_SHUFFLE(1, 1, 1, 1)), r23);
+        r23 = _mm256_fmadd_ps(a2, _mm256_permute_ps(b23, _MM_SHUFFLE(2, 2, 2, 2)), r23);
+        r23 = _mm256_fmadd_ps(a3, _mm256_permute_ps(b23, _MM_SHUFFLE(3, 3, 3, 3)), r23);
+
+        _mm256_storeu_ps(&out[i].columns[0].x, r01);
+        _mm256_storeu_ps(&out[i].columns[2].x, r23);
+    }
+}
+
+// one box at a time against all 8 plane lanes.
+SIMD_MATH_TARGET_AVX2
+inline static size_t _simd_frustum_cull_aabb_avx2(const simd_frustum *frustum, const simd_aabb *boxes, size_t count, uint32_t *visible)
+{
+    __m256 nx = _mm256_load_ps(frustum->nx), ny = _mm256_load_ps(frustum->ny), nz = _mm256_load_ps(frustum->nz);
+    __m256 ax = _mm256_load_ps(frustum->ax), ay = _mm256_load_ps(frustum->ay), az = _mm256_load_ps(frustum->az);
+    __m256 d = _mm256_load_ps(frustum->d);
+    __m128 half = _mm_set1_ps(0.5f);
+
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        __m128 mn = _mm_load_ps(&boxes[i].min.x);
+        __m128 mx = _mm_load_ps(&boxes[i].max.x);
+        __m128 c = _mm_mul_ps(_mm_add_ps(mx, mn), half);
+        __m128 e = _mm_mul_ps(_mm_sub_ps(mx, mn), half);
+
+        __m256 distance = _mm256_fmadd_ps(nx, _mm256_broadcastss_ps(c), d);
+        distance = _mm256_fmadd_ps(ny, _mm256_broadcastss_ps(_mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1))), distance);
+        distance = _mm256_fmadd_ps(nz, _mm256_broadcastss_ps(_mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2))), distance);
+        distance = _mm256_fmadd_ps(ax, _mm256_broadcastss_ps(e), distance);
+        distance = _mm256_fmadd_ps(ay, _mm256_broadcastss_ps(_mm_shuffle_ps(e, e, _MM_SHUFFLE(1, 1, 1, 1))), distance);
+        distance = _mm256_fmadd_ps(az, _mm256_broadcastss_ps(_mm_shuffle_ps(e, e, _MM_SHUFFLE(2, 2, 2, 2))), distance);
+        int outside = _mm256_movemask_ps(_mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_LT_OQ));
+
+        visible[visibleCount] = (uint32_t) i;
+        visibleCount += outside == 0;
+    }
+
+    return visibleCount;
+}
+
+// 8 quaternions q0..q7 loaded as q0|q4, q1|q5, q2|q6, q3|q7 so the in-lane
+// 4x4 transpose give x, y, z, w of all 8, and back.
+SIMD_MATH_TARGET_AVX2
+inline static void _simd_transpose8x4(__m256 *r0, __m256 *r1, __m256 *r2, __m256 *r3)
+{
+    __m256 t0 = _mm256_unpacklo_ps(*r0, *r1);
+    __m256 t1 = _mm256_unpackhi_ps(*r0, *r1);
+    __m256 t2 = _mm256_unpacklo_ps(*r2, *r3);
+    __m256 t3 = _mm256_unpackhi_ps(*r2, *r3);
+    *r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    *r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    *r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    *r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+SIMD_MATH_TARGET_AVX2
+inline static __m256 _simd_load_quat_pair(const simd_quat *q)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(&q[0].x)), _mm_load_ps(&q[4].x), 1);
+}
+
+SIMD_MATH_TARGET_AVX2
+inline static void _simd_store_quat_pair(simd_quat *q, __m256 value)
+{
+    _mm_store_ps(&q[0].x, _mm256_castps256_ps128(value));
+    _mm_store_ps(&q[4].x, _mm256_extractf128_ps(value, 1));
+}
+
+SIMD_MATH_TARGET_AVX2
+inline static void _simd_quat_slerp_avx2(const simd_quat *a, const simd_quat *b, float t, simd_quat *out, size_t count)
+{
+    simd_slerp_terms terms = _simd_slerp_terms(t);
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 signMask = _mm256_set1_ps(-0.0f);
+    __m256 vt = _mm256_set1_ps(t);
+    __m256 vd = _mm256_set1_ps(1.0f - t);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 ax = _simd_load_quat_pair(&a[i + 0]), ay = _simd_load_quat_pair(&a[i + 1]);
+        __m256 az = _simd_load_quat_pair(&a[i + 2]), aw = _simd_load_quat_pair(&a[i + 3]);
+        __m256 bx = _simd_load_quat_pair(&b[i + 0]), by = _simd_load_quat_pair(&b[i + 1]);
+        __m256 bz = _simd_load_quat_pair(&b[i + 2]), bw = _simd_load_quat_pair(&b[i + 3]);
+        _simd_transpose8x4(&ax, &ay, &az, &aw);
+        _simd_transpose8x4(&bx, &by, &bz, &bw);
+
+        __m256 dot = _mm256_fmadd_ps(ax, bx, _mm256_fmadd_ps(ay, by, _mm256_fmadd_ps(az, bz, _mm256_mul_ps(aw, bw))));
+        __m256 sign = _mm256_and_ps(dot, signMask);
+        __m256 xm1 = _mm256_sub_ps(_mm256_xor_ps(dot, sign), one);
+
+        __m256 ct = one, cd = one;
+        for (int j = SIMD_SLERP_TERM_COUNT - 1; j >= 0; j--) {
+            ct = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_set1_ps(terms.t[j]), xm1), ct, one);
+            cd = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_set1_ps(terms.d[j]), xm1), cd, one);
+        }
+
+        ct = _mm256_xor_ps(_mm256_mul_ps(ct, vt), sign);
+        cd = _mm256_mul_ps(cd, vd);
+
+        __m256 rx = _mm256_fmadd_ps(bx, ct, _mm256_mul_ps(ax, cd));
+        __m256 ry = _mm256_fmadd_ps(by, ct, _mm256_mul_ps(ay, cd));
+        __m256 rz = _mm256_fmadd_ps(bz, ct, _mm256_mul_ps(az, cd));
+        __m256 rw = _mm256_fmadd_ps(bw, ct, _mm256_mul_ps(aw, cd));
+        _simd_transpose8x4(&rx, &ry, &rz, &rw);
+
+        _simd_store_quat_pair(&out[i + 0], rx);
+        _simd_store_quat_pair(&out[i + 1], ry);
+        _simd_store_quat_pair(&out[i + 2], rz);
+        _simd_store_quat_pair(&out[i + 3], rw);
+    }
+
+    _simd_quat_slerp_sse2(a + i, b + i, t, out + i, count - i);
+}
+#endif /* SIMD_MATH_X86 */
+
+#if defined(SIMD_MATH_NEON)
+/* ======================================================================== */
+/* NEON (AArch64)                                                           */
+/* ======================================================================== */
+
+inline static void _simd_mat4_mul_neon(const simd_mat4 *a, size_t aStep, const simd_mat4 *b, simd_mat4 *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++, a += aStep) {
+        float32x4_t a0 = vld1q_f32(&a->columns[0].x);
+        float32x4_t a1 = vld1q_f32(&a->columns[1].x);
+        float32x4_t a2 = vld1q_f32(&a->columns[2].x);
+        float32x4_t a3 = vld1q_f32(&a->columns[3].x);
+
+        float32x4_t result[4];
+        for (int column = 0; column < 4; column++) {
+            float32x4_t bc = vld1q_f32(&b[i].columns[column].x);
+            float32x4_t r = vmulq_laneq_f32(a0, bc, 0);
+            r = vfmaq_laneq_f32(r, a1, bc, 1);
+            r = vfmaq_laneq_f32(r, a2, bc, 2);
+            r = vfmaq_laneq_f32(r, a3, bc, 3);
+            result[column] = r;
+        }
+
+        for (int column = 0; column < 4; column++)
+            vst1q_f32(&out[i].columns[column].x, result[column]);
+    }
+}
+
+inline static size_t _simd_frustum_cull_aabb_neon(const simd_frustum *frustum, const simd_aabb *boxes, size_t count, uint32_t *visible)
+{
+    size_t visibleCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        float32x4_t mn = vld1q_f32(&boxes[i].min.x);
+        float32x4_t mx = vld1q_f32(&boxes[i].max.x);
+        float32x4_t c = vmulq_n_f32(vaddq_f32(mx, mn), 0.5f);
+        float32x4_t e = vmulq_n_f32(vsubq_f32(mx, mn), 0.5f);
+
+        uint32_t outside = 0;
+        for (int lane = 0; lane < SIMD_FRUSTUM_LANE_COUNT; lane += 4) {
+            float32x4_t distance = vfmaq_laneq_f32(vld1q_f32(&frustum->d[lane]), vld1q_f32(&frustum->nx[lane]), c, 0);
+            distance = vfmaq_laneq_f32(distance, vld1q_f32(&frustum->ny[lane]), c, 1);
+            distance = vfmaq_laneq_f32(distance, vld1q_f32(&frustum->nz[lane]), c, 2);
+            distance = vfmaq_laneq_f32(distance, vld1q_f32(&frustum->ax[lane]), e, 0);
+            distance = vfmaq_laneq_f32(distance, vld1q_f32(&frustum->ay[lane]), e, 1);
+            distance = vfmaq_laneq_f32(distance, vld1q_f32(&frustum->az[lane]), e, 2);
+            outside |= vmaxvq_u32(vcltzq_f32(distance));
+        }
+
+        visible[visibleCount] = (uint32_t) i;
+        visibleCount += outside == 0;
+    }
+
+    return visibleCount;
+}
+
+// vld4q/vst4q (de)interleave four quaternions into x, y, z, w.
+inline static void _simd_quat_slerp_neon(const simd_quat *a, const simd_quat *b, float t, simd_quat *out, size_t count)
+{
+    simd_slerp_terms terms = _simd_slerp_terms(t);
+    float32x4_t one = vdupq_n_f32(1.0f);
+    uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4x4_t qa = vld4q_f32(&a[i].x);
+        float32x4x4_t qb = vld4q_f32(&b[i].x);
+
+        float32x4_t dot = vmulq_f32(qa.val[0], qb.val[0]);
+        dot = vfmaq_f32(dot, qa.val[1], qb.val[1]);
+        dot = vfmaq_f32(dot, qa.val[2], qb.val[2]);
+        dot = vfmaq_f32(dot, qa.val[3], qb.val[3]);
+        uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(dot), signMask);
+        float32x4_t xm1 = vsubq_f32(vabsq_f32(dot), one);
+
+        float32x4_t ct = one, cd = one;
+        for (int j = SIMD_SLERP_TERM_COUNT - 1; j >= 0; j--) {
+            ct = vfmaq_f32(one, vmulq_n_f32(xm1, terms.t[j]), ct);
+            cd = vfmaq_f32(one, vmulq_n_f32(xm1, terms.d[j]), cd);
+        }
+
+        ct = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(vmulq_n_f32(ct, t)), sign));
+        cd = vmulq_n_f32(cd, 1.0f - t);
+
+        float32x4x4_t result;
+        for (int k = 0; k < 4; k++)
+            result.val[k] = vfmaq_f32(vmulq_f32(qa.val[k], cd), qb.val[k], ct);
+
+        vst4q_f32(&out[i].x, result);
+    }
+
+    _simd_quat_slerp_scalar(a + i, b + i, t, out + i, count - i);
+}
+#endif /* SIMD_MATH_NEON */
+
+/* ======================================================================== */
+/* dispatch                                                                 */
+/* ======================================================================== */
+
+struct simd_kernels {
+    void (*mat4_mul)(const simd_mat4 *a, size_t aStep, const simd_mat4 *b, simd_mat4 *out, size_t count);
+    size_t (*frustum_cull_aabb)(const simd_frustum *frustum, const simd_aabb *boxes, size_t count, uint32_t *visible);
+    void (*quat_slerp)(const simd_quat *a, const simd_quat *b, float t, simd_quat *out, size_t count);
+};
+
+/* levels not compiled for this architecture are left empty */
+inline const simd_kernels _simd_kernels[SIMD_LEVEL_COUNT] = {
+    { _simd_mat4_mul_scalar, _simd_frustum_cull_aabb_scalar, _simd_quat_slerp_scalar },
+#if defined(SIMD_MATH_X86)
+    { _simd_mat4_mul_sse2, _simd_frustum_cull_aabb_sse2, _simd_quat_slerp_sse2 },
+    { _simd_mat4_mul_avx2, _simd_frustum_cull_aabb_avx2, _simd_quat_slerp_avx2 },
+#else
+    { NULL, NULL, NULL },
+    { NULL, NULL, NULL },
+#endif
+#if defined(SIMD_MATH_NEON)
+    { _simd_mat4_mul_neon, _simd_frustum_cull_aabb_neon, _simd_quat_slerp_neon },
+#else
+    { NULL, NULL, NULL },
+#endif
+};
+
+inline const char *_simd_level_names[SIMD_LEVEL_COUNT] = { "scalar", "sse2", "avx2", "neon" };
+
+inline std::atomic<int> _simd_supported_level = -1;
+inline std::atomic<int> _simd_level = -1;
+
+inline static const char *simd_level_name(simd_level level)
+{
+    return _simd_level_names[level];
+}
+
+// best level of the CPU, AVX2 also need FMA and the OS saving the ymm
+// registers.
+inline static simd_level simd_detect_level()
+{
+#if defined(SIMD_MATH_X86)
+    uint32_t ecx1, ebx7;
+    bool osxsave;
+#  if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    ecx1 = (uint32_t) info[2];
+    __cpuidex(info, 7, 0);
+    ebx7 = maxLeaf >= 7 ? (uint32_t) info[1] : 0;
+    osxsave = (ecx1 & (1u << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+#  else
+    uint32_t eax, ebx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx1, &edx))
+        return SIMD_LEVEL_SCALAR;
+
+    uint32_t ecx7, edx7, eax7;
+    if (!__get_cpuid_count(7, 0, &eax7, &ebx7, &ecx7, &edx7))
+        ebx7 = 0;
+
+    osxsave = false;
+    if (ecx1 & (1u << 27)) {
+        uint32_t xcr0, xcr0High;
+        __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+        osxsave = (xcr0 & 0x6) == 0x6;
+    }
+#  endif
+    bool avx = (ecx1 & (1u << 28)) && osxsave;
+    bool fma = ecx1 & (1u << 12);
+    bool avx2 = ebx7 & (1u << 5);
+    if (avx && fma && avx2)
+        return SIMD_LEVEL_AVX2;
+
+    return SIMD_LEVEL_SSE2;
+#elif defined(SIMD_MATH_NEON)
+    return SIMD_LEVEL_NEON;
+#else
+    return SIMD_LEVEL_SCALAR;
+#endif
+}
+
+inline static simd_level _simd_supported()
+{
+    int level = _simd_supported_level.load(std::memory_order_relaxed);
+    if (level < 0) {
+        level = simd_detect_level();
+        _simd_supported_level.store(level, std::memory_order_relaxed);
+    }
+
+    return (simd_level) level;
+}
+
+// lower the level used by the kernels, clamped to what the CPU support. A
+// level of another architecture fall back to scalar.
+inline static void simd_set_level(simd_level level)
+{
+    simd_level supported = _simd_supported();
+    if (level > supported || !_simd_kernels[level].mat4_mul)
+        level = level > supported && _simd_kernels[supported].mat4_mul ? supported : SIMD_LEVEL_SCALAR;
+
+    _simd_level.store(level, std::memory_order_relaxed);
+}
+
+inline static simd_level simd_get_level()
+{
+    int level = _simd_level.load(std::memory_order_relaxed);
+    if (level >= 0)
+        return (simd_level) level;
+
+    simd_level selected = _simd_supported();
+
+    const char *name = getenv("BRIGHT_SIMD_LEVEL");
+    for (int i = 0; name && i < SIMD_LEVEL_COUNT; i++) {
+        if (strcmp(name, _simd_level_names[i]) == 0)
+            selected = (simd_level) i;
+    }
+
+    simd_set_level(selected);
+
+    return (simd_level) _simd_level.load(std::memory_order_relaxed);
+}
+
+// out[i] = a[i] * b[i], out may alias b.
+inline static void simd_mat4_mul_batch(const simd_mat4 *a, const simd_mat4 *b, simd_mat4 *out, size_t count)
+{
+    _simd_kernels[simd_get_level()].mat4_mul(a, 1, b, out, count);
+}
+
+// out[i] = a * b[i], parent or view projection applied to every local.
+inline static void simd_mat4_mul_batch(const simd_mat4 &a, const simd_mat4 *b, simd_mat4 *out, size_t count)
+{
+    _simd_kernels[simd_get_level()].mat4_mul(&a, 0, b, out, count);
+}
+
+// write the indices of the boxes touching the frustum to visible (room
+// for count indices) and return how many there are.
+inline static size_t simd_frustum_cull_aabb_batch(const simd_frustum &frustum, const simd_aabb *boxes, size_t count, uint32_t *visible)
+{
+    return _simd_kernels[simd_get_level()].frustum_cull_aabb(&frustum, boxes, count, visible);
+}
+
+// out[i] = slerp(a[i], b[i], t) along the shortest path, inputs are unit
+// quaternions.
+inline static void simd_quat_slerp_batch(const simd_quat *a, const simd_quat *b, float t, simd_quat *out, size_t count)
+{
+    _simd_kernels[simd_get_level()].quat_slerp(a, b, t, out, count);
+}
+
+#endif /* _BRIGHT_SIMD_MATH_H_ */
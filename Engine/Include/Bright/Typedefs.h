@@ -42,9 +42,11 @@
 #define ARRAY_SIZE(a) ( sizeof(a) / sizeof(a[0]) )
 
 #if defined(__MINGW32__)
-#  define RESOURCE(path) "../../../../Engine/Resources" path
+#  define RESOURCE_DIRECTORY "../../../../Engine/Resources"
 #elif defined(_MSC_VER)
-#  define RESOURCE(path) "../../../Engine/Resources" path
+#  define RESOURCE_DIRECTORY "../../../Engine/Resources"
+#else
+#  define RESOURCE_DIRECTORY "Engine/Resources"
 #endif
 
 // std::string to const char *
@@ -0,0 +1,527 @@
+/* ************************************************************************ */
+/* VFS.h                                                                    */
+/* ************************************************************************ */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ************************************************************************ */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ************************************************************************ */
+#ifndef _BRIGHT_VFS_H_
+#define _BRIGHT_VFS_H_
+
+#include <Bright/Archive.h>
+#include <Bright/Typedefs.h>
+#include <algorithm>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Virtual filesystem, paths are relative and use '/'. Mounts overlay each
+// other, the last mounted source that contain a path win, so a RAM-disk or
+// patch directory can be mounted over the packed archive. A path is resolved
+// once and the result cached until the mount table change.
+//
+// Without any mount the resource directory is mounted at the root, its
+// location can be overridden with the BRIGHT_RESOURCE_DIRECTORY variable.
+//
+// Mounts are reference counted, resolved nodes and views keep theirs alive
+// so a file being read or mapped survive a concurrent vfs_unmount.
+enum vfs_mount_type {
+    VFS_MOUNT_DIRECTORY,
+    VFS_MOUNT_ARCHIVE,
+    VFS_MOUNT_MEMORY,
+};
+
+struct vfs_mount {
+    vfs_mount_type type;
+    /* prefix inside the vfs, empty or ending with '/' */
+    std::string point;
+    std::string directory;
+    archive pak;
+    /* memory mount, point is the full path of the single file */
+    const char *data;
+    size_t size;
+};
+
+struct vfs_node {
+    std::shared_ptr<vfs_mount> mount;
+    const archive_entry *entry;
+    std::string native_path;
+};
+
+// read-only view, data point into the archive, a file mapping or memory.
+struct vfs_view {
+    const char *data;
+    size_t size;
+    /* set when data had to be decompressed or mapped */
+    char *owned;
+    io_mapped_file mapped;
+    /* keep the archive or memory mount data pointed by data alive */
+    std::shared_ptr<vfs_mount> mount;
+};
+
+/* default byte budget of the in-memory derived asset cache */
+#define VFS_MEMORY_CACHE_BUDGET (64 * 1024 * 1024)
+
+struct vfs_cache_entry {
+    uint64_t key;
+    std::vector<char> data;
+};
+
+struct vfs_context {
+    std::recursive_mutex mutex;
+    std::vector<std::shared_ptr<vfs_mount>> mounts;
+    std::unordered_map<std::string, vfs_node> nodes;
+    std::string cache_directory;
+    /* most recently used first, evicted from the back over the budget */
+    std::list<vfs_cache_entry> memory_cache;
+    std::unordered_map<uint64_t, std::list<vfs_cache_entry>::iterator> memory_cache_index;
+    size_t memory_cache_bytes = 0;
+    size_t memory_cache_budget = VFS_MEMORY_CACHE_BUDGET;
+};
+
+inline vfs_context _vfs_context;
+
+// fail on '..' components, a path must not escape its mount.
+inline static bool _vfs_normalize(const char *path, std::string *normalized)
+{
+    *normalized = path;
+    std::replace(normalized->begin(), normalized->end(), '\\', '/');
+
+    while (normalized->starts_with("./") || normalized->starts_with("/"))
+        normalized->erase(0, (*normalized)[0] == '.' ? 2 : 1);
+
+    size_t begin = 0;
+    while (begin <= normalized->size()) {
+        size_t end = normalized->find('/', begin);
+        if (end == std::string::npos)
+            end = normalized->size();
+
+        if (normalized->compare(begin, end - begin, "..") == 0)
+            return false;
+
+        begin = end + 1;
+    }
+
+    return true;
+}
+
+inline static bool _vfs_mount_point(const char *point, std::string *normalized)
+{
+    if (!_vfs_normalize(point, normalized))
+        return false;
+
+    if (!normalized->empty() && !normalized->ends_with("/"))
+        *normalized += "/";
+
+    return true;
+}
+
+inline static void _vfs_destroy_mount(vfs_mount *mount)
+{
+    if (mount->type == VFS_MOUNT_ARCHIVE)
+        archive_close(&mount->pak);
+
+    memdel(mount);
+}
+
+inline static void _vfs_add_mount(vfs_mount *mount)
+{
+    std::lock_guard<std::recursive_mutex> lock(_vfs_context.mutex);
+    _vfs_context.mounts.emplace_back(mount, _vfs_destroy_mount);
+    _vfs_context.nodes.clear();
+}
+
+inline static Error vfs_mount_directory(const char *point, const char *directory)
+{
+    std::string normalized;
+    if (!_vfs_mount_point(point, &normalized))
+        return FAIL;
+
+    vfs_mount *mount = memnew(vfs_mount);
+    mount->type = VFS_MOUNT_DIRECTORY;
+    mount->point = normalized;
+    mount->directory = directory;
+    _vfs_add_mount(mount);
+
+    return OK;
+}
+
+inline static Error vfs_mount_archive(const char *point, const char *path)
+{
+    std::string normalized;
+    if (!_vfs_mount_point(point, &normalized))
+        return FAIL;
+
+    vfs_mount *mount = memnew(vfs_mount);
+    mount->type = VFS_MOUNT_ARCHIVE;
+    mount->point = normalized;
+
+    if (archive_open(path, &mount->pak) != OK) {
+        memdel(mount);
+        return FAIL;
+    }
+
+    _vfs_add_mount(mount);
+
+    return OK;
+}
+
+// data is not copied, it must outlive the mount and the views mapping it.
+inline static Error vfs_mount_memory(const char *path, const void *data, size_t size)
+{
+    std::string normalized;
+    if (!_vfs_normalize(path, &normalized))
+        return FAIL;
+
+    vfs_mount *mount = memnew(vfs_mount);
+    mount->type = VFS_MOUNT_MEMORY;
+    mount->point = normalized;
+    mount->data = (const char *) data;
+    mount->size = size;
+    _vfs_add_mount(mount);
+
+    return OK;
+}
+
+// remove every mount at point, for memory mounts point is the file path.
+inline static void vfs_unmount(const char *point)
+{
+    std::lock_guard<std::recursive_mutex> lock(_vfs_context.mutex);
+
+    std::string directory_point, file_point;
+    if (!_vfs_mount_point(point, &directory_point) || !_vfs_normalize(point, &file_point))
+        return;
+
+    /* destroyed once the last node or view using it is released */
+    std::erase_if(_vfs_context.mounts, [&](const std::shared_ptr<vfs_mount> &mount) {
+        return mount->type == VFS_MOUNT_MEMORY ? mount->point == file_point : mount->point == directory_point;
+    });
+
+    _vfs_context.nodes.clear();
+}
+
+inline static void vfs_unmount_all()
+{
+    std::lock_guard<std::recursive_mutex> lock(_vfs_context.mutex);
+
+    _vfs_context.mounts.clear();
+    _vfs_context.nodes.clear();
+    _vfs_context.memory_cache.clear();
+    _vfs_context.memory_cache_index.clear();
+    _vfs_context.memory_cache_bytes = 0;
+}
+
+inline static void _vfs_mount_default()
+{
+    const char *directory = getenv("BRIGHT_RESOURCE_DIRECTORY");
+    vfs_mount_directory("", directory ? directory : RESOURCE_DIRECTORY);
+}
+
+inline static bool _vfs_resolve(const char *path, vfs_node *node)
+{
+    std::string normalized;
+    if (!_vfs_normalize(path, &normalized))
+        return false;
+
+    std::lock_guard<std::recursive_mutex> lock(_vfs_context.mutex);
+
+    if (_vfs_context.mounts.empty())
+        _vfs_mount_default();
+
+    auto cached = _vfs_context.nodes.find(normalized);
+    if (cached != _vfs_context.nodes.end()) {
+        *node = cached->second;
+        return true;
+    }
+
+    /* misses are not cached, a file may be written later */
+    for (auto it = _vfs_context.mounts.rbegin(); it != _vfs_context.mounts.rend(); ++it) {
+        const std::shared_ptr<vfs_mount> &mount = *it;
+        vfs_node resolved = { mount, NULL, {} };
+
+        if (mount->type == VFS_MOUNT_MEMORY) {
+            if (mount->point != normalized)
+                continue;
+        } else {
+            if (!normalized.starts_with(mount->point))
+                continue;
+
+            std::string relative = normalized.substr(mount->point.size());
+
+            if (mount->type == VFS_MOUNT_ARCHIVE) {
+                resolved.entry = archive_find(&mount->pak, getpchar(relative));
+                if (!resolved.entry)
+                    continue;
+            } else {
+                resolved.native_path = mount->directory + "/" + relative;
+                std::error_code error;
+                if (!std::filesystem::is_regular_file(resolved.native_path, error))
+                    continue;
+            }
+        }
+
+        _vfs_context.nodes[normalized] = resolved;
+        *node = resolved;
+        return true;
+    }
+
+    return false;
+}
+
+inline static bool vfs_exists(const char *path)
+{
+    vfs_node node;
+    return _vfs_resolve(path, &node);
+}
+
+// host path of a file served by a directory mount, empty otherwise.
+inline static std::string vfs_native_path(const char *path)
+{
+    vfs_node node;
+    if (!_vfs_resolve(path, &node))
+        return {};
+
+    return node.native_path;
+}
+
+// read a whole file into a new buffer released with io_free_buf.
+inline static char *vfs_read(const char *path, size_t *size)
+{
+    vfs_node node;
+    if (!_vfs_resolve(path, &node))
+        return NULL;
+
+    switch (node.mount->type) {
+        case VFS_MOUNT_DIRECTORY: {
+            char *buf = NULL;
+            if (io_read_file(getpchar(node.native_path), 0, IO_WHOLE_FILE, &buf, 0, size) != OK)
+                return NULL;
+            return buf;
+        }
+        case VFS_MOUNT_ARCHIVE: {
+            char *buf = (char *) malloc(node.entry->uncompressed_size);
+            if (archive_read(&node.mount->pak, node.entry, buf) != OK) {
+                free(buf);
+                return NULL;
+            }
+            *size = node.entry->uncompressed_size;
+            return buf;
+        }
+        case VFS_MOUNT_MEMORY: {
+            char *buf = (char *) malloc(node.mount->size);
+            memcpy(buf, node.mount->data, node.mount->size);
+            *size = node.mount->size;
+            return buf;
+        }
+    }
+
+    return NULL;
+}
+
+inline static void vfs_unmap(vfs_view *view)
+{
+    io_unmap_file(&view->mapped);
+
+    free(view->owned);
+    *view = {};
+}
+
+// zero-copy whenever the source allow it, release with vfs_unmap.
+inline static Error vfs_map(const char *path, vfs_view *view)
+{
+    *view = {};
+
+    vfs_node node;
+    if (!_vfs_resolve(path, &node))
+        return FAIL;
+
+    switch (node.mount->type) {
+        case VFS_MOUNT_DIRECTORY:
+            if (io_map_file(getpchar(node.native_path), &view->mapped) != OK)
+                return FAIL;
+            view->data = view->mapped.data;
+            view->size = view->mapped.size;
+            return OK;
+        case VFS_MOUNT_ARCHIVE:
+            view->mount = node.mount;
+            view->size = node.entry->uncompressed_size;
+            view->data = archive_entry_data(&node.mount->pak, node.entry);
+            if (!view->data) {
+                view->owned = (char *) malloc(view->size);
+                if (archive_read(&node.mount->pak, node.entry, view->owned) != OK) {
+                    vfs_unmap(view);
+                    return FAIL;
+                }
+                view->data = view->owned;
+            }
+            return OK;
+        case VFS_MOUNT_MEMORY:
+            view->mount = node.mount;
+            view->data = node.mount->data;
+            view->size = node.mount->size;
+            return OK;
+    }
+
+    return FAIL;
+}
+
+// write into the last mounted directory whose mount point cover path.
+inline static Error vfs_write(const char *path, const void *data, size_t size)
+{
+    std::lock_guard<std::recursive_mutex> lock(_vfs_context.mutex);
+
+    if (_vfs_context.mounts.empty())
+        _vfs_mount_default();
+
+    std::string normalized;
+    if (!_vfs_normalize(path, &normalized))
+        return FAIL;
+
+    for (auto it = _vfs_context.mounts.rbegin(); it != _vfs_context.mounts.rend(); ++it) {
+        const std::shared_ptr<vfs_mount> &mount = *it;
+        if (mount->type != VFS_MOUNT_DIRECTORY || !normalized.starts_with(mount->point))
+            continue;
+
+        std::filesystem::path native_path = mount->directory + "/" + normalized.substr(mount->point.size());
+
+        std::error_code error;
+        std::filesystem::create_directories(native_path.parent_path(), error);
+
+        std::ofstream file(native_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return FAIL;
+
+        file.write((const char *) data, size);
+        _vfs_context.nodes.erase(normalized);
+
+        return file.good() ? OK : FAIL;
+    }
+
+    return FAIL;
+}
+
+// Content-addressed cache for derived assets (decoded textures, compiled
+// shaders...), the key is the hash of the source bytes and of a tag naming
+// the transform. Entries go into the cache directory when one is set,
+// otherwise they only live in memory for the session, least recently used
+// first out once they exceed the memory budget.
+inline static void vfs_set_cache_directory(const char *directory)
+{
+    std::lock_guard<std::recursive_mutex> lock(_vfs_context.mutex);
+    _vfs_context.cache_directory = directory ? directory : "";
+}
+
+inline static void _vfs_cache_trim(size_t budget)
+{
+    while (_vfs_context.memory_cache_bytes > budget) {
+        vfs_cache_entry &entry = _vfs_context.memory_cache.back();
+        _vfs_context.memory_cache_bytes -= std::size(entry.data);
+        _vfs_context.memory_cache_index.erase(entry.key);
+        _vfs_context.memory_cache.pop_back();
+    }
+}
+
+inline static void vfs_set_memory_cache_budget(size_t budget)
+{
+    std::lock_guard<std::recursive_mutex> lock(_vfs_context.mutex);
+    _vfs_context.memory_cache_budget = budget;
+    _vfs_cache_trim(budget);
+}
+
+inline static uint64_t vfs_cache_key(const char *tag, const void *data, size_t size)
+{
+    // the terminator is hashed too, so the tag/data boundary can't shift
+    // between two keys.
+    return hash_fnv1a64(data, size, hash_fnv1a64(tag, strlen(tag) + 1));
+}
+
+inline static std::string _vfs_cache_path(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long) key);
+
+    return _vfs_context.cache_directory + name;
+}
+
+// return a buffer released with io_free_buf, NULL on miss.
+inline static char *vfs_cache_read(uint64_t key, size_t *size)
+{
+    std::lock_guard<std::recursive_mutex> lock(_vfs_context.mutex);
+
+    auto cached = _vfs_context.memory_cache_index.find(key);
+    if (cached != _vfs_context.memory_cache_index.end()) {
+        _vfs_context.memory_cache.splice(_vfs_context.memory_cache.begin(), _vfs_context.memory_cache, cached->second);
+
+        const std::vector<char> &data = cached->second->data;
+        *size = std::size(data);
+        char *buf = (char *) malloc(*size);
+        memcpy(buf, std::data(data), *size);
+        return buf;
+    }
+
+    if (_vfs_context.cache_directory.empty())
+        return NULL;
+
+    char *buf = NULL;
+    if (io_read_file(getpchar(_vfs_cache_path(key)), 0, IO_WHOLE_FILE, &buf, 0, size) != OK)
+        return NULL;
+
+    return buf;
+}
+
+inline static Error vfs_cache_write(uint64_t key, const void *data, size_t size)
+{
+    std::lock_guard<std::recursive_mutex> lock(_vfs_context.mutex);
+
+    if (_vfs_context.cache_directory.empty()) {
+        /* never cached, it would evict everything else and itself */
+        if (size > _vfs_context.memory_cache_budget)
+            return FAIL;
+
+        auto cached = _vfs_context.memory_cache_index.find(key);
+        if (cached != _vfs_context.memory_cache_index.end()) {
+            _vfs_context.memory_cache_bytes -= std::size(cached->second->data);
+            _vfs_context.memory_cache.erase(cached->second);
+            _vfs_context.memory_cache_index.erase(cached);
+        }
+
+        _vfs_context.memory_cache.push_front({ key, std::vector<char>((const char *) data, (const char *) data + size) });
+        _vfs_context.memory_cache_index[key] = _vfs_context.memory_cache.begin();
+        _vfs_context.memory_cache_bytes += size;
+        _vfs_cache_trim(_vfs_context.memory_cache_budget);
+
+        return OK;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(_vfs_context.cache_directory, error);
+
+    std::ofstream file(_vfs_cache_path(key), std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return FAIL;
+
+    file.write((const char *) data, size);
+
+    return file.good() ? OK : FAIL;
+}
+
+#endif /* _BRIGHT_VFS_H_ */
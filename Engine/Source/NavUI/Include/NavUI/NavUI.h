@@ -26,6 +26,7 @@
 #include <imgui.h>
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
+#include <mutex>
 
 namespace NavUI {
     struct InitializeInfo {
@@ -40,8 +41,20 @@ namespace NavUI {
         uint32_t                        MinImageCount;
         uint32_t                        ImageCount;
         VkSampleCountFlagBits           MSAASamples;
+        // set when another thread submit to Queue, see RenderThread.
+        std::mutex*                     QueueMutex = NULL;
     };
 
+    // one line of a StatsTable, nested rows are indented by depth.
+    struct StatRow {
+        const char*                     name;
+        uint32_t                        depth;
+        double                          value;
+    };
+
+    // snapshot of the main viewport draw lists, owned by the caller.
+    struct FrameDrawData;
+
     // create and destroy
     void Initialize(InitializeInfo *p_initialize_info);
     void Destroy();
@@ -49,6 +62,15 @@ namespace NavUI {
     // api
     void BeginNewFrame(VkCommandBuffer cmd_buffer);
     void EndNewFrame(VkCommandBuffer cmd_buffer);
+
+    // threaded rendering, build the UI between BeginFrame and EndFrame on
+    // the main thread, EndFrame copy the main viewport into p_draw_data
+    // and RenderFrame record it later on the render thread.
+    FrameDrawData *CreateFrameDrawData();
+    void DestroyFrameDrawData(FrameDrawData *p_draw_data);
+    void BeginFrame();
+    void EndFrame(FrameDrawData *p_draw_data);
+    void RenderFrame(FrameDrawData *p_draw_data, VkCommandBuffer cmd_buffer);
     bool Begin(const char *title, bool* p_open = NULL, ImGuiWindowFlags flags = 0);
     void End();
     void BeginViewport(const char *title);
@@ -62,6 +84,8 @@ namespace NavUI {
     void DragFloat4(const char *label, float v[4], float v_speed = 1.0f, float v_min = 0.0f, float v_max = 0.0f, const char* format = "%.3f");
     void ColorEdit3(const char* label, float col[3], ImGuiColorEditFlags flags = 0);
     void SliderFloat(const char* label, float* v, float v_min, float v_max, const char* format = "%.2f", ImGuiSliderFlags flags = 0);
+    void StatsTable(const char *id, const char *unit, uint32_t row_count, const StatRow *p_rows);
+    void PlotHistory(const char *label, const float *p_values, uint32_t count, const char *overlay = NULL);
 
     // vulkan
     ImTextureID AddTexture(VkSampler v_sampler, VkImageView v_image, VkImageLayout v_layout);
@@ -24,8 +24,65 @@
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_vulkan.h"
 #include <Bright/Typedefs.h>
+#include <Bright/VFS.h>
+
+#define NAVUI_INI_PATH "naveditor.ini"
+#define NAVUI_FONT_PATH "Fonts/Microsoft Yahei UI/Microsoft Yahei UI.ttf"
 
 static GLFWwindow *_window = NULL;
+static char *_fontData = NULL;
+static std::mutex *_queueMutex = NULL;
+
+namespace NavUI {
+    struct FrameDrawData {
+        ImDrawData drawData;
+        ImVector<ImDrawList *> lists;
+    };
+}
+
+void _CaptureDrawData(ImDrawData *p_src, NavUI::FrameDrawData *p_dst)
+  {
+    // reuse the lists of the previous capture, only the buffers are copied.
+    while (p_dst->lists.Size < p_src->CmdListsCount)
+        p_dst->lists.push_back(IM_NEW(ImDrawList)(p_src->CmdLists[p_dst->lists.Size]->_Data));
+
+    p_dst->drawData = *p_src;
+    p_dst->drawData.CmdLists.resize(0);
+
+    for (int i = 0; i < p_src->CmdListsCount; i++) {
+        ImDrawList *src = p_src->CmdLists[i];
+        ImDrawList *dst = p_dst->lists[i];
+        dst->CmdBuffer = src->CmdBuffer;
+        dst->IdxBuffer = src->IdxBuffer;
+        dst->VtxBuffer = src->VtxBuffer;
+        dst->Flags = src->Flags;
+        p_dst->drawData.CmdLists.push_back(dst);
+    }
+  }
+
+void _RenderPlatformWindows()
+  {
+    ImGuiIO& io = ImGui::GetIO();
+    if (!(io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable))
+        return;
+
+    ImGui::UpdatePlatformWindows();
+
+    if (_queueMutex) {
+        std::lock_guard<std::mutex> lock(*_queueMutex);
+        ImGui::RenderPlatformWindowsDefault();
+    } else {
+        ImGui::RenderPlatformWindowsDefault();
+    }
+  }
+
+void _SaveIniSettings()
+  {
+    size_t size;
+    const char *settings = ImGui::SaveIniSettingsToMemory(&size);
+    vfs_write(NAVUI_INI_PATH, settings, size);
+    ImGui::GetIO().WantSaveIniSettings = false;
+  }
 
 void _DarkNavUITheme()
   {
@@ -153,11 +210,27 @@ namespace NavUI {
         io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;       // Enable Multi-Viewport / Platform Windows
         io.ConfigViewportsNoAutoMerge = true;
         io.ConfigViewportsNoTaskBarIcon = true;
-        io.IniFilename = RESOURCE("/naveditor.ini");
+
+        // ini and font go through the vfs, imgui never touch the disk.
+        io.IniFilename = nullptr;
+
+        size_t size;
+        char *settings = vfs_read(NAVUI_INI_PATH, &size);
+        if (settings) {
+            ImGui::LoadIniSettingsFromMemory(settings, size);
+            io_free_buf(settings);
+        }
 
         // set default font.
-        io.Fonts->AddFontFromFileTTF(RESOURCE("/Fonts/Microsoft Yahei UI/Microsoft Yahei UI.ttf"), 18.0f,
-                                     nullptr, io.Fonts->GetGlyphRangesChineseSimplifiedCommon());
+        _fontData = vfs_read(NAVUI_FONT_PATH, &size);
+        if (_fontData) {
+            ImFontConfig fontConfig;
+            fontConfig.FontDataOwnedByAtlas = false;
+            io.Fonts->AddFontFromMemoryTTF(_fontData, (int) size, 18.0f,
+                                           &fontConfig, io.Fonts->GetGlyphRangesChineseSimplifiedCommon());
+        } else {
+            io.Fonts->AddFontDefault();
+        }
         io.FontDefault = io.Fonts->Fonts.back();
 
         // When viewports are enabled we tweak WindowRounding/WindowBg so platform windows can look identical to regular ones.
@@ -190,22 +263,23 @@ namespace NavUI {
         ImGui_ImplVulkan_Init(&init_info);
 
         _window = p_initialize_info->window;
+        _queueMutex = p_initialize_info->QueueMutex;
       }
 
     void Destroy()
       {
+        _SaveIniSettings();
+
         ImGui_ImplGlfw_Shutdown();
         ImGui_ImplVulkan_Shutdown();
+
+        io_free_buf(_fontData);
+        _fontData = NULL;
       }
 
     void BeginNewFrame(VkCommandBuffer cmdBuffer)
       {
-        ImGui_ImplVulkan_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-
-        // docking
-        ImGui::DockSpaceOverViewport();
+        BeginFrame();
       }
 
     void EndNewFrame(VkCommandBuffer cmdBuffer)
@@ -217,11 +291,58 @@ namespace NavUI {
         ImDrawData* main_draw_data = ImGui::GetDrawData();
         ImGui_ImplVulkan_RenderDrawData(main_draw_data, cmdBuffer);
 
+        if (io.WantSaveIniSettings)
+            _SaveIniSettings();
+
         // Update and Render additional Platform Windows
-        if (io.ConfigFlags & ImGuiConfigFlags_ViewportsEnable) {
-            ImGui::UpdatePlatformWindows();
-            ImGui::RenderPlatformWindowsDefault();
+        _RenderPlatformWindows();
+      }
+
+    FrameDrawData *CreateFrameDrawData()
+      {
+        return IM_NEW(FrameDrawData)();
+      }
+
+    void DestroyFrameDrawData(FrameDrawData *p_draw_data)
+      {
+        for (ImDrawList *list : p_draw_data->lists)
+            IM_DELETE(list);
+        IM_DELETE(p_draw_data);
+      }
+
+    void BeginFrame()
+      {
+        // the font atlas upload on the first frame submit to the queue.
+        if (_queueMutex) {
+            std::lock_guard<std::mutex> lock(*_queueMutex);
+            ImGui_ImplVulkan_NewFrame();
+        } else {
+            ImGui_ImplVulkan_NewFrame();
         }
+
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+
+        // docking
+        ImGui::DockSpaceOverViewport();
+      }
+
+    void EndFrame(FrameDrawData *p_draw_data)
+      {
+        ImGuiIO& io = ImGui::GetIO();
+
+        ImGui::Render();
+        _CaptureDrawData(ImGui::GetDrawData(), p_draw_data);
+
+        if (io.WantSaveIniSettings)
+            _SaveIniSettings();
+
+        _RenderPlatformWindows();
+      }
+
+    void RenderFrame(FrameDrawData *p_draw_data, VkCommandBuffer cmd_buffer)
+      {
+        ImGui_ImplVulkan_RenderDrawData(&p_draw_data->drawData, cmd_buffer);
       }
 
     bool Begin(const char *title, bool* p_open, ImGuiWindowFlags flags)
@@ -300,6 +421,40 @@ namespace NavUI {
         ImGui::PopID();
       }
 
+    void StatsTable(const char *id, const char *unit, uint32_t row_count, const StatRow *p_rows)
+      {
+        if (!ImGui::BeginTable(id, 2, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingStretchProp))
+            return;
+
+        ImGui::TableSetupColumn("Name");
+        ImGui::TableSetupColumn(unit);
+        ImGui::TableHeadersRow();
+
+        for (uint32_t i = 0; i < row_count; i++) {
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            /* Indent(0) would use the default spacing */
+            float indent = 16.0f * p_rows[i].depth;
+            if (indent > 0.0f)
+                ImGui::Indent(indent);
+            ImGui::TextUnformatted(p_rows[i].name);
+            if (indent > 0.0f)
+                ImGui::Unindent(indent);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%.3f", p_rows[i].value);
+        }
+
+        ImGui::EndTable();
+      }
+
+    void PlotHistory(const char *label, const float *p_values, uint32_t count, const char *overlay)
+      {
+        ImGui::PushID(label);
+        ImGui::TextUnformatted(label);
+        ImGui::PlotLines("", p_values, (int) count, 0, overlay, 0.0f, FLT_MAX, ImVec2(-1.0f, 64.0f));
+        ImGui::PopID();
+      }
+
     ImTextureID AddTexture(VkSampler v_sampler, VkImageView v_image, VkImageLayout v_layout)
       {
         return ImGui_ImplVulkan_AddTexture(v_sampler, v_image, v_layout);
@@ -0,0 +1,292 @@
+/* ======================================================================== */
+/* MemoryDefragmenter.cpp                                                   */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "MemoryDefragmenter.h"
+#include "Profiler/CPUProfiler.h"
+#include <unordered_map>
+
+MemoryDefragmenter::MemoryDefragmenter(RenderDevice *vRD)
+    : rd(vRD)
+{
+    device = rd->GetDeviceContext()->GetDevice();
+    allocator = rd->GetDeviceContext()->GetAllocator();
+}
+
+MemoryDefragmenter::~MemoryDefragmenter()
+{
+    Cancel();
+}
+
+void MemoryDefragmenter::Begin(VkDeviceSize bytesPerStep, uint32_t movesPerStep)
+{
+    if (context)
+        return;
+
+    VkResult U_ASSERT_ONLY err;
+
+    VmaDefragmentationInfo defragmentationInfo = {};
+    defragmentationInfo.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+    defragmentationInfo.maxBytesPerPass = bytesPerStep;
+    defragmentationInfo.maxAllocationsPerPass = movesPerStep;
+
+    err = vmaBeginDefragmentation(allocator, &defragmentationInfo, &context);
+    assert(!err);
+
+    stats = {};
+}
+
+bool MemoryDefragmenter::Step()
+{
+    if (!context)
+        return false;
+
+    PROFILE_FUNCTION();
+
+    VmaDefragmentationPassMoveInfo pass;
+    if (vmaBeginDefragmentationPass(allocator, context, &pass) == VK_SUCCESS) {
+        _End();
+        return false;
+    }
+
+    // vma only knows allocations, find the resource owning each of them.
+    std::unordered_map<VmaAllocation, RenderDevice::BufferHandle> bufferAllocations;
+    std::unordered_map<VmaAllocation, RenderDevice::TextureHandle> textureAllocations;
+    rd->ForEachBuffer([&] (RenderDevice::BufferHandle hBuffer, RenderDevice::Buffer *buffer) { bufferAllocations[buffer->allocation] = hBuffer; });
+    rd->ForEachTexture([&] (RenderDevice::TextureHandle hTexture, RenderDevice::Texture2D *texture) { textureAllocations[texture->allocation] = hTexture; });
+
+    std::vector<MovedBuffer> movedBuffers;
+    std::vector<MovedTexture> movedTextures;
+    VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+
+    for (uint32_t i = 0; i < pass.moveCount; i++) {
+        VmaDefragmentationMove *move = &pass.pMoves[i];
+        bool moved = false;
+
+        auto bufferSearch = bufferAllocations.find(move->srcAllocation);
+        auto textureSearch = textureAllocations.find(move->srcAllocation);
+
+        if (bufferSearch != bufferAllocations.end()) {
+            if (!cmdBuffer)
+                rd->CmdBufferOneTimeBegin(&cmdBuffer);
+            moved = _MoveBuffer(cmdBuffer, bufferSearch->second, move->dstTmpAllocation, &movedBuffers);
+        } else if (textureSearch != textureAllocations.end()) {
+            if (!cmdBuffer)
+                rd->CmdBufferOneTimeBegin(&cmdBuffer);
+            moved = _MoveTexture(cmdBuffer, textureSearch->second, move->dstTmpAllocation, &movedTextures);
+        }
+
+        if (!moved) {
+            move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        VmaAllocationInfo allocationInfo;
+        vmaGetAllocationInfo(allocator, move->srcAllocation, &allocationInfo);
+        stats.bytesMoved += allocationInfo.size;
+    }
+
+    /* wait for the buffer and image copies */
+    if (cmdBuffer)
+        rd->CmdBufferOneTimeEnd(cmdBuffer);
+
+    // old objects are still bound to the source memory, drop them before
+    // vma release it.
+    for (const MovedBuffer &moved : movedBuffers) {
+        RenderDevice::Buffer *buffer = rd->GetBuffer(moved.handle);
+        vkDestroyBuffer(device, buffer->vkBuffer, VK_NULL_HANDLE);
+        buffer->vkBuffer = moved.vkBuffer;
+    }
+
+    for (const MovedTexture &moved : movedTextures) {
+        RenderDevice::Texture2D *texture = rd->GetTexture(moved.handle);
+        vkDestroyImageView(device, texture->imageView, VK_NULL_HANDLE);
+        vkDestroyImage(device, texture->image, VK_NULL_HANDLE);
+        texture->image = moved.image;
+    }
+
+    VkResult result = vmaEndDefragmentationPass(allocator, context, &pass);
+
+    /* source allocations now describe the new memory */
+    for (const MovedBuffer &moved : movedBuffers) {
+        RenderDevice::Buffer *buffer = rd->GetBuffer(moved.handle);
+        vmaGetAllocationInfo(allocator, buffer->allocation, &buffer->allocationInfo);
+        rd->RefreshDescriptorReferences(moved.handle);
+        stats.movedBuffers++;
+    }
+
+    for (const MovedTexture &moved : movedTextures) {
+        RenderDevice::Texture2D *texture = rd->GetTexture(moved.handle);
+        vmaGetAllocationInfo(allocator, texture->allocation, &texture->allocationInfo);
+        rd->CreateTextureImageView(moved.handle);
+        rd->RefreshDescriptorReferences(moved.handle);
+        stats.movedTextures++;
+
+        if (fnTextureMovedCallback)
+            fnTextureMovedCallback(moved.handle, textureMovedUserData);
+    }
+
+    stats.passCount++;
+
+    if (result == VK_SUCCESS) {
+        _End();
+        return false;
+    }
+
+    return true;
+}
+
+void MemoryDefragmenter::Cancel()
+{
+    if (context)
+        _End();
+}
+
+bool MemoryDefragmenter::_MoveBuffer(VkCommandBuffer cmdBuffer, RenderDevice::BufferHandle hBuffer, VmaAllocation dstAllocation, std::vector<MovedBuffer> *pMoved)
+{
+    RenderDevice::Buffer *buffer = rd->GetBuffer(hBuffer);
+
+    VkResult U_ASSERT_ONLY err;
+
+    VkBufferCreateInfo buffer_create_info = {};
+    buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_create_info.usage = buffer->usage;
+    buffer_create_info.size = buffer->size;
+
+    VkBuffer vkBuffer;
+    err = vkCreateBuffer(device, &buffer_create_info, VK_NULL_HANDLE, &vkBuffer);
+    assert(!err);
+
+    err = vmaBindBufferMemory(allocator, dstAllocation, vkBuffer);
+    assert(!err);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+    VkBufferCopy copy = {};
+    copy.size = buffer->size;
+    vkCmdCopyBuffer(cmdBuffer, buffer->vkBuffer, vkBuffer, 1, &copy);
+
+    /* host visible buffers may be read back through a mapping */
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE);
+
+    pMoved->push_back({ hBuffer, vkBuffer });
+
+    return true;
+}
+
+bool MemoryDefragmenter::_MoveTexture(VkCommandBuffer cmdBuffer, RenderDevice::TextureHandle hTexture, VmaAllocation dstAllocation, std::vector<MovedTexture> *pMoved)
+{
+    RenderDevice::Texture2D *texture = rd->GetTexture(hTexture);
+
+    // framebuffers hold the views of render targets, leave them in place.
+    if (texture->usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
+        return false;
+
+    if (!(texture->usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) || texture->imageLayout != VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+        return false;
+
+    VkResult U_ASSERT_ONLY err;
+
+    VkImageCreateInfo image_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            /* pNext */ VK_NULL_HANDLE,
+            /* flags */ texture->createFlags,
+            /* imageType */ texture->imageType,
+            /* format */ texture->format,
+            /* extent */ { texture->width, texture->height, 1 },
+            /* mipLevels */ texture->mipLevels,
+            /* arrayLayers */ texture->arrayLayers,
+            /* samples */ texture->samples,
+            /* tiling */ VK_IMAGE_TILING_OPTIMAL,
+            /* usage */ texture->usage,
+            /* sharingMode */ VK_SHARING_MODE_EXCLUSIVE,
+            /* queueFamilyIndexCount */ 0,
+            /* pQueueFamilyIndices */ nullptr,
+            /* initialLayout */ VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    VkImage image;
+    err = vkCreateImage(device, &image_create_info, VK_NULL_HANDLE, &image);
+    assert(!err);
+
+    err = vmaBindImageMemory(allocator, dstAllocation, image);
+    assert(!err);
+
+    VkImageMemoryBarrier barriers[2] = {};
+    for (VkImageMemoryBarrier &barrier : barriers) {
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = { texture->aspectMask, 0, texture->mipLevels, 0, texture->arrayLayers };
+    }
+
+    barriers[0].image = texture->image;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    barriers[1].image = image;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 2, barriers);
+
+    std::vector<VkImageCopy> copies(texture->mipLevels);
+    for (uint32_t i = 0; i < texture->mipLevels; i++) {
+        VkImageCopy *copy = &copies[i];
+        copy->srcSubresource = { texture->aspectMask, i, 0, texture->arrayLayers };
+        copy->srcOffset = { 0, 0, 0 };
+        copy->dstSubresource = copy->srcSubresource;
+        copy->dstOffset = { 0, 0, 0 };
+        copy->extent = { std::max(texture->width >> i, 1u), std::max(texture->height >> i, 1u), 1 };
+    }
+
+    vkCmdCopyImage(cmdBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t) std::size(copies), std::data(copies));
+
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barriers[1]);
+
+    pMoved->push_back({ hTexture, image });
+
+    return true;
+}
+
+void MemoryDefragmenter::_End()
+{
+    VmaDefragmentationStats defragmentationStats;
+    vmaEndDefragmentation(allocator, context, &defragmentationStats);
+    context = VK_NULL_HANDLE;
+
+    stats.bytesFreed = defragmentationStats.bytesFreed;
+    stats.deviceMemoryBlocksFreed = defragmentationStats.deviceMemoryBlocksFreed;
+}
@@ -0,0 +1,91 @@
+/* ======================================================================== */
+/* MemoryDefragmenter.h                                                     */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _MEMORY_DEFRAGMENTER_H_
+#define _MEMORY_DEFRAGMENTER_H_
+
+#include "RenderDevice.h"
+
+#define MEMORY_DEFRAGMENTER_DEFAULT_BYTES_PER_STEP (32 * 1024 * 1024)
+#define MEMORY_DEFRAGMENTER_DEFAULT_MOVES_PER_STEP 64
+
+struct MemoryDefragmenterStats {
+    uint32_t passCount = 0;
+    uint32_t movedBuffers = 0;
+    uint32_t movedTextures = 0;
+    VkDeviceSize bytesMoved = 0;
+    /* filled when the defragmentation is finished */
+    VkDeviceSize bytesFreed = 0;
+    uint32_t deviceMemoryBlocksFreed = 0;
+};
+
+typedef void (*PFN_TextureMovedCallback) (RenderDevice::TextureHandle texture, void *pUserData);
+
+// Incremental defragmentation of the RenderDevice allocations. Every Step
+// run one VMA pass of at most bytesPerStep, moved resources keep their
+// handle: the Vulkan objects behind it are recreated in the new memory and
+// descriptors written through UpdateDescriptorSet* are rewritten. Anything
+// holding a raw VkImageView (UI textures...) is told through the moved
+// callback.
+//
+// A Step replace Vulkan objects, nothing may be recorded or in flight with
+// them: call it while the render thread is idle, and not while other
+// threads create or destroy resources.
+class MemoryDefragmenter {
+public:
+    MemoryDefragmenter(RenderDevice *vRD);
+   ~MemoryDefragmenter();
+
+    void Begin(VkDeviceSize bytesPerStep = MEMORY_DEFRAGMENTER_DEFAULT_BYTES_PER_STEP, uint32_t movesPerStep = MEMORY_DEFRAGMENTER_DEFAULT_MOVES_PER_STEP);
+    // return true while there is still work to do.
+    bool Step();
+    void Cancel();
+    bool IsActive() { return context != VK_NULL_HANDLE; }
+    const MemoryDefragmenterStats &GetStats() { return stats; }
+
+    void SetTextureMovedCallback(PFN_TextureMovedCallback fnCallback, void *pUserData) { fnTextureMovedCallback = fnCallback; textureMovedUserData = pUserData; }
+
+private:
+    struct MovedBuffer {
+        RenderDevice::BufferHandle handle;
+        VkBuffer vkBuffer;
+    };
+
+    struct MovedTexture {
+        RenderDevice::TextureHandle handle;
+        VkImage image;
+    };
+
+    bool _MoveBuffer(VkCommandBuffer cmdBuffer, RenderDevice::BufferHandle hBuffer, VmaAllocation dstAllocation, std::vector<MovedBuffer> *pMoved);
+    bool _MoveTexture(VkCommandBuffer cmdBuffer, RenderDevice::TextureHandle hTexture, VmaAllocation dstAllocation, std::vector<MovedTexture> *pMoved);
+    void _End();
+
+    RenderDevice *rd = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VmaAllocator allocator = VK_NULL_HANDLE;
+    VmaDefragmentationContext context = VK_NULL_HANDLE;
+    MemoryDefragmenterStats stats;
+    PFN_TextureMovedCallback fnTextureMovedCallback = VK_NULL_HANDLE;
+    void *textureMovedUserData = VK_NULL_HANDLE;
+};
+
+#endif /* _MEMORY_DEFRAGMENTER_H_ */
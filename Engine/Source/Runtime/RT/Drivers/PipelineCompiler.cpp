@@ -0,0 +1,210 @@
+/* ======================================================================== */
+/* PipelineCompiler.cpp                                                     */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "PipelineCompiler.h"
+#include <algorithm>
+
+template<typename T>
+static std::vector<T> _CopyArray(const T *pArray, uint32_t count)
+{
+    if (!pArray)
+        return {};
+    return std::vector<T>(pArray, pArray + count);
+}
+
+template<typename T>
+static T *_ArrayOrNull(std::vector<T> &array, const void *pSource)
+{
+    // keep NULL as NULL, render device derive these from reflection.
+    return pSource ? std::data(array) : NULL;
+}
+
+static double _ElapsedMilliseconds(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+PipelineCompiler::PipelineCompiler(RenderDevice *vRD, uint32_t workerCount)
+    : rd(vRD)
+{
+    // leave one core for the render thread.
+    if (workerCount == 0)
+        workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+    for (uint32_t i = 0; i < workerCount; i++)
+        workers.emplace_back(&PipelineCompiler::_WorkerMain, this);
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+    WaitIdle();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopFlag = true;
+    }
+
+    jobCondition.notify_all();
+
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+AsyncPipeline *PipelineCompiler::CompileGraphicsPipelineAsync(RenderDevice::PipelineCreateInfo *pCreateInfo, RenderDevice::ShaderInfo *pShaderInfo)
+{
+    CompileJob *job = memnew(CompileJob);
+    job->bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    job->createInfo = *pCreateInfo;
+    job->shaderInfo = *pShaderInfo;
+
+    job->vertex = pShaderInfo->vertex;
+    job->fragment = pShaderInfo->fragment;
+    job->attributes = _CopyArray(pShaderInfo->attributes, pShaderInfo->attributeCount);
+    job->binds = _CopyArray(pShaderInfo->binds, pShaderInfo->bindCount);
+    job->descriptorSetLayouts = _CopyArray(pShaderInfo->pDescriptorSetLayouts, pShaderInfo->descriptorSetLayoutCount);
+    job->pushConstantRanges = _CopyArray(pShaderInfo->pPushConstantRange, pShaderInfo->pushConstantCount);
+    job->specializationConstants = _CopyArray(pShaderInfo->pSpecializationConstants, pShaderInfo->specializationConstantCount);
+
+    job->shaderInfo.vertex = job->vertex.c_str();
+    job->shaderInfo.fragment = job->fragment.c_str();
+    job->shaderInfo.attributes = _ArrayOrNull(job->attributes, pShaderInfo->attributes);
+    job->shaderInfo.binds = _ArrayOrNull(job->binds, pShaderInfo->binds);
+    job->shaderInfo.pDescriptorSetLayouts = _ArrayOrNull(job->descriptorSetLayouts, pShaderInfo->pDescriptorSetLayouts);
+    job->shaderInfo.pPushConstantRange = _ArrayOrNull(job->pushConstantRanges, pShaderInfo->pPushConstantRange);
+    job->shaderInfo.pSpecializationConstants = _ArrayOrNull(job->specializationConstants, pShaderInfo->pSpecializationConstants);
+
+    job->asyncPipeline = memnew(AsyncPipeline);
+    job->asyncPipeline->name = job->vertex + "+" + job->fragment;
+
+    AsyncPipeline *asyncPipeline = job->asyncPipeline;
+    _Enqueue(job);
+
+    return asyncPipeline;
+}
+
+AsyncPipeline *PipelineCompiler::CompileComputePipelineAsync(RenderDevice::ComputeShaderInfo *pShaderInfo)
+{
+    CompileJob *job = memnew(CompileJob);
+    job->bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+    job->computeShaderInfo = *pShaderInfo;
+
+    job->compute = pShaderInfo->compute;
+    job->descriptorSetLayouts = _CopyArray(pShaderInfo->pDescriptorSetLayouts, pShaderInfo->descriptorSetLayoutCount);
+    job->pushConstantRanges = _CopyArray(pShaderInfo->pPushConstantRange, pShaderInfo->pushConstantCount);
+    job->specializationConstants = _CopyArray(pShaderInfo->pSpecializationConstants, pShaderInfo->specializationConstantCount);
+
+    job->computeShaderInfo.compute = job->compute.c_str();
+    job->computeShaderInfo.pDescriptorSetLayouts = _ArrayOrNull(job->descriptorSetLayouts, pShaderInfo->pDescriptorSetLayouts);
+    job->computeShaderInfo.pPushConstantRange = _ArrayOrNull(job->pushConstantRanges, pShaderInfo->pPushConstantRange);
+    job->computeShaderInfo.pSpecializationConstants = _ArrayOrNull(job->specializationConstants, pShaderInfo->pSpecializationConstants);
+
+    job->asyncPipeline = memnew(AsyncPipeline);
+    job->asyncPipeline->name = job->compute;
+
+    AsyncPipeline *asyncPipeline = job->asyncPipeline;
+    _Enqueue(job);
+
+    return asyncPipeline;
+}
+
+void PipelineCompiler::DestroyAsyncPipeline(AsyncPipeline *pAsyncPipeline)
+{
+    Wait(pAsyncPipeline);
+
+    if (pAsyncPipeline->pipeline)
+        rd->DestroyPipeline(pAsyncPipeline->pipeline);
+
+    memdel(pAsyncPipeline);
+}
+
+void PipelineCompiler::Wait(AsyncPipeline *pAsyncPipeline)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    completeCondition.wait(lock, [pAsyncPipeline] { return pAsyncPipeline->ready.load(std::memory_order_acquire); });
+}
+
+void PipelineCompiler::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    completeCondition.wait(lock, [this] { return pendingCount.load() == 0; });
+}
+
+void PipelineCompiler::_Enqueue(CompileJob *pJob)
+{
+    pJob->enqueueTime = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(pJob);
+        ++pendingCount;
+    }
+
+    jobCondition.notify_one();
+}
+
+void PipelineCompiler::_WorkerMain()
+{
+    while (true) {
+        CompileJob *job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobCondition.wait(lock, [this] { return stopFlag || !jobs.empty(); });
+
+            if (stopFlag && jobs.empty())
+                return;
+
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        _Compile(job);
+
+        AsyncPipeline *asyncPipeline = job->asyncPipeline;
+        asyncPipeline->latencyMilliseconds = _ElapsedMilliseconds(job->enqueueTime);
+        memdel(job);
+
+        // report before ready, the handle may be destroyed right after.
+        if (fnPipelineCompiledCallback)
+            fnPipelineCompiledCallback(asyncPipeline);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            asyncPipeline->ready.store(true, std::memory_order_release);
+            --pendingCount;
+        }
+
+        completeCondition.notify_all();
+    }
+}
+
+void PipelineCompiler::_Compile(CompileJob *pJob)
+{
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+    if (pJob->bindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS)
+        pJob->asyncPipeline->pipeline = rd->CreateGraphicsPipeline(&pJob->createInfo, &pJob->shaderInfo);
+    else
+        pJob->asyncPipeline->pipeline = rd->CreateComputePipeline(&pJob->computeShaderInfo);
+
+    pJob->asyncPipeline->compileMilliseconds = _ElapsedMilliseconds(begin);
+}
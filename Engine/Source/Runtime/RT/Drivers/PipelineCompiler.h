@@ -0,0 +1,109 @@
+/* ======================================================================== */
+/* PipelineCompiler.h                                                       */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _PIPELINE_COMPILER_H_
+#define _PIPELINE_COMPILER_H_
+
+#include "RenderDevice.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <string>
+#include <thread>
+
+struct AsyncPipeline;
+
+typedef void (*PFN_PipelineCompiledCallback) (AsyncPipeline *pAsyncPipeline);
+
+// Compile-state handle returned by the pipeline compiler, the pipeline
+// member is only valid once ready was set by the worker thread.
+struct AsyncPipeline {
+    std::atomic<bool> ready = false;
+    RenderDevice::PipelineHandle pipeline;
+    std::string name;
+    /* enqueue to ready, include the time spent waiting in queue */
+    double latencyMilliseconds = 0.0;
+    /* only the time spent in vkCreate*Pipelines and shader loading */
+    double compileMilliseconds = 0.0;
+};
+
+// Build pipelines on a pool of worker threads through the render device
+// pipeline cache, so new materials never stall the render thread.
+class PipelineCompiler {
+public:
+    PipelineCompiler(RenderDevice *vRD, uint32_t workerCount = 0);
+   ~PipelineCompiler();
+
+    AsyncPipeline *CompileGraphicsPipelineAsync(RenderDevice::PipelineCreateInfo *pCreateInfo, RenderDevice::ShaderInfo *pShaderInfo);
+    AsyncPipeline *CompileComputePipelineAsync(RenderDevice::ComputeShaderInfo *pShaderInfo);
+    void DestroyAsyncPipeline(AsyncPipeline *pAsyncPipeline);
+    void Wait(AsyncPipeline *pAsyncPipeline);
+    void WaitIdle();
+
+    uint32_t GetPendingCount() { return pendingCount; }
+    void SetPipelineCompiledCallback(PFN_PipelineCompiledCallback callback) { fnPipelineCompiledCallback = callback; }
+
+    // return the compiled pipeline or fallback when not ready yet, fallback
+    // must be layout compatible, pass a null handle to let the caller skip the draw.
+    static RenderDevice::PipelineHandle GetPipelineOrFallback(AsyncPipeline *pAsyncPipeline, RenderDevice::PipelineHandle fallback)
+      {
+        if (pAsyncPipeline && pAsyncPipeline->ready.load(std::memory_order_acquire))
+            return pAsyncPipeline->pipeline;
+        return fallback;
+      }
+
+private:
+    struct CompileJob {
+        AsyncPipeline *asyncPipeline;
+        VkPipelineBindPoint bindPoint;
+        std::chrono::steady_clock::time_point enqueueTime;
+        RenderDevice::PipelineCreateInfo createInfo;
+        RenderDevice::ShaderInfo shaderInfo;
+        RenderDevice::ComputeShaderInfo computeShaderInfo;
+        /* deep copy of everything the shader info points to */
+        std::string vertex;
+        std::string fragment;
+        std::string compute;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+        std::vector<VkVertexInputBindingDescription> binds;
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+        std::vector<VkPushConstantRange> pushConstantRanges;
+        std::vector<RenderDevice::SpecializationConstant> specializationConstants;
+    };
+
+    void _Enqueue(CompileJob *pJob);
+    void _WorkerMain();
+    void _Compile(CompileJob *pJob);
+
+    RenderDevice *rd = VK_NULL_HANDLE;
+    std::vector<std::thread> workers;
+    std::deque<CompileJob *> jobs;
+    std::mutex mutex;
+    std::condition_variable jobCondition;
+    std::condition_variable completeCondition;
+    std::atomic<uint32_t> pendingCount = 0;
+    bool stopFlag = false;
+    PFN_PipelineCompiledCallback fnPipelineCompiledCallback = NULL;
+};
+
+#endif /* _PIPELINE_COMPILER_H_ */
@@ -21,6 +21,12 @@
 /*                                                                          */
 /* ======================================================================== */
 #include "Drivers/RenderDevice.h"
+#include "Profiler/CPUProfiler.h"
+#include "Profiler/GPUProfiler.h"
+#include <Bright/Hash.h>
+#include <algorithm>
+#include <map>
+#include <string.h>
 
 RenderDevice::RenderDevice(RenderDeviceContext *vRDC)
     : rdc(vRDC)
@@ -29,47 +35,79 @@ RenderDevice::RenderDevice(RenderDeviceContext *vRDC)
     allocator = rdc->GetAllocator();
 
     _InitializeDescriptorPool();
+    _InitializePipelineCache();
 
     msaaSampleCounts = rdc->GetMaxMSAASampleCounts();
 
+    // extended dynamic state is core since vulkan 1.3.
+    extendedDynamicStateSupported = rdc->GetPhysicalDeviceProperties().apiVersion >= VK_API_VERSION_1_3;
+
     // if sample counts > 4x，that default msaa samples set 4x otherwise 2x
     msaaSampleCounts = msaaSampleCounts >= 4 ? VK_SAMPLE_COUNT_4_BIT : VK_SAMPLE_COUNT_2_BIT;
 }
 
 RenderDevice::~RenderDevice()
 {
+    // the pools free their own memory, only the vulkan objects of
+    // whatever is still alive need to go.
+    pipelines.for_each([this] (PipelineHandle, Pipeline *pPipeline) { _DestroyPipelineObjects(pPipeline); });
+    textures.for_each([this] (TextureHandle, Texture2D *pTexture) {
+        vkDestroyImageView(device, pTexture->imageView, VK_NULL_HANDLE);
+        vmaDestroyImage(allocator, pTexture->image, pTexture->allocation);
+    });
+    buffers.for_each([this] (BufferHandle, Buffer *pBuffer) { vmaDestroyBuffer(allocator, pBuffer->vkBuffer, pBuffer->allocation); });
+
+    for (const auto &[hash, descriptorSetLayouts] : descriptorSetLayoutCache) {
+        for (const CachedDescriptorSetLayout &cached : descriptorSetLayouts)
+            vkDestroyDescriptorSetLayout(device, cached.descriptorSetLayout, VK_NULL_HANDLE);
+    }
+
+    vkDestroyPipelineCache(device, pipelineCache, VK_NULL_HANDLE);
     vkDestroyDescriptorPool(device, descriptorPool, VK_NULL_HANDLE);
 }
 
-RenderDevice::Buffer *RenderDevice::CreateBuffer(VkBufferUsageFlags usage, VkDeviceSize size)
+RenderDevice::BufferHandle RenderDevice::CreateBuffer(VkBufferUsageFlags usage, VkDeviceSize size, VmaMemoryUsage memoryUsage)
 {
     VkResult U_ASSERT_ONLY err;
 
+    /* copied on the GPU when the defragmenter move it */
+    usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
     VkBufferCreateInfo buffer_create_info = {};
     buffer_create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     buffer_create_info.usage = usage;
     buffer_create_info.size = size;
 
     VmaAllocationCreateInfo allocation_create_info = {};
-    allocation_create_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    allocation_create_info.usage = memoryUsage;
 
-    Buffer *buffer = (Buffer *) imalloc(sizeof(Buffer));
-    buffer->size = size;
+    Buffer *pBuffer;
+    BufferHandle buffer = buffers.allocate(&pBuffer);
+    pBuffer->usage = usage;
+    pBuffer->size = size;
 
-    err = vmaCreateBuffer(allocator, &buffer_create_info, &allocation_create_info, &buffer->vkBuffer, &buffer->allocation, &buffer->allocationInfo);
+    err = vmaCreateBuffer(allocator, &buffer_create_info, &allocation_create_info, &pBuffer->vkBuffer, &pBuffer->allocation, &pBuffer->allocationInfo);
     assert(!err);
 
     return buffer;
 }
 
-void RenderDevice::DestroyBuffer(Buffer *buffer)
+void RenderDevice::DestroyBuffer(BufferHandle hBuffer)
 {
+    Buffer *buffer = buffers.get(hBuffer);
+    assert(buffer && "destroy stale buffer handle");
+
     vmaDestroyBuffer(allocator, buffer->vkBuffer, buffer->allocation);
-    free(buffer);
+    buffers.release(hBuffer);
 }
 
-void RenderDevice::WriteBuffer(Buffer *buffer, VkDeviceSize offset, VkDeviceSize size, void *buf)
+void RenderDevice::WriteBuffer(BufferHandle hBuffer, VkDeviceSize offset, VkDeviceSize size, void *buf)
 {
+    PROFILE_FUNCTION();
+
+    Buffer *buffer = buffers.get(hBuffer);
+    assert(buffer);
+
     char *tmp;
     vmaMapMemory(allocator, buffer->allocation, (void **) &tmp);
     memcpy((tmp + offset), buf, size);
@@ -77,8 +115,11 @@ void RenderDevice::WriteBuffer(Buffer *buffer, VkDeviceSize offset, VkDeviceSize
 }
 
 void
-RenderDevice::ReadBuffer(Buffer *buffer, VkDeviceSize offset, VkDeviceSize size, void *buf)
+RenderDevice::ReadBuffer(BufferHandle hBuffer, VkDeviceSize offset, VkDeviceSize size, void *buf)
 {
+    Buffer *buffer = buffers.get(hBuffer);
+    assert(buffer);
+
     char *tmp;
     vmaMapMemory(allocator, buffer->allocation, (void **) &tmp);
     memcpy(buf, (tmp + offset), size);
@@ -108,6 +149,67 @@ void RenderDevice::DestroyRenderPass(VkRenderPass renderPass)
     vkDestroyRenderPass(device, renderPass, VK_NULL_HANDLE);
 }
 
+void RenderDevice::CreateQueryPool(VkQueryType queryType, uint32_t queryCount, VkQueryPipelineStatisticFlags pipelineStatistics, VkQueryPool *pQueryPool)
+{
+    VkResult U_ASSERT_ONLY err;
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {
+        /* sType */ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        /* pNext */ VK_NULL_HANDLE,
+        /* flags */ 0,
+        /* queryType */ queryType,
+        /* queryCount */ queryCount,
+        /* pipelineStatistics */ queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS ? pipelineStatistics : 0,
+    };
+
+    err = vkCreateQueryPool(device, &queryPoolCreateInfo, VK_NULL_HANDLE, pQueryPool);
+    assert(!err);
+}
+
+void RenderDevice::DestroyQueryPool(VkQueryPool queryPool)
+{
+    vkDestroyQueryPool(device, queryPool, VK_NULL_HANDLE);
+}
+
+void RenderDevice::EnumeratePerformanceCounters(std::vector<PerformanceCounter> *pCounters)
+{
+    pCounters->clear();
+
+    VkPhysicalDevice physicalDevice = rdc->GetPhysicalDevice();
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, VK_NULL_HANDLE, &extensionCount, VK_NULL_HANDLE);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, VK_NULL_HANDLE, &extensionCount, std::data(extensions));
+
+    bool supported = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties &extension) {
+        return strcmp(extension.extensionName, VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME) == 0;
+    });
+
+    if (!supported)
+        return;
+
+    PFN_vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR fnEnumerateCounters =
+        (PFN_vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR) vkGetInstanceProcAddr(rdc->GetInstance(), "vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR");
+    if (!fnEnumerateCounters)
+        return;
+
+    uint32_t counterCount = 0;
+    fnEnumerateCounters(physicalDevice, rdc->GetQueueFamily(), &counterCount, VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+    std::vector<VkPerformanceCounterKHR> counters(counterCount, VkPerformanceCounterKHR {});
+    std::vector<VkPerformanceCounterDescriptionKHR> descriptions(counterCount, VkPerformanceCounterDescriptionKHR {});
+
+    for (uint32_t i = 0; i < counterCount; i++) {
+        counters[i].sType = VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_KHR;
+        descriptions[i].sType = VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_DESCRIPTION_KHR;
+    }
+    fnEnumerateCounters(physicalDevice, rdc->GetQueueFamily(), &counterCount, std::data(counters), std::data(descriptions));
+
+    for (uint32_t i = 0; i < counterCount; i++)
+        pCounters->push_back({ descriptions[i].name, descriptions[i].category, descriptions[i].description, counters[i].unit });
+}
+
 void RenderDevice::AllocateCommandBuffer(VkCommandBuffer *pCmdBuffer)
 {
     rdc->AllocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, pCmdBuffer);
@@ -118,29 +220,60 @@ void RenderDevice::FreeCommandBuffer(VkCommandBuffer cmdBuffer)
     rdc->FreeCommandBuffer(cmdBuffer);
 }
 
-RenderDevice::Texture2D *RenderDevice::CreateTexture(TextureCreateInfo *pCreateInfo)
+uint32_t RenderDevice::CalculateMipLevels(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    uint32_t size = std::max(width, height);
+
+    while (size > 1) {
+        size >>= 1;
+        ++levels;
+    }
+
+    return levels;
+}
+
+RenderDevice::TextureHandle RenderDevice::CreateTexture(TextureCreateInfo *pCreateInfo)
 {
     VkResult U_ASSERT_ONLY err;
     Texture2D *texture = VK_NULL_HANDLE;
 
-    texture = (Texture2D *) imalloc(sizeof(Texture2D));
+    TextureHandle hTexture = textures.allocate(&texture);
     texture->format = pCreateInfo->format;
     texture->width = pCreateInfo->width;
     texture->height = pCreateInfo->height;
     texture->aspectMask = pCreateInfo->aspectMask;
+    texture->arrayLayers = pCreateInfo->arrayLayers;
+    texture->imageType = pCreateInfo->imageType;
+    texture->imageViewType = pCreateInfo->imageViewType;
+    texture->samples = pCreateInfo->samples;
+    texture->mipLevels = std::min(pCreateInfo->mipLevels, CalculateMipLevels(pCreateInfo->width, pCreateInfo->height));
+
+    VkImageCreateFlags flags = VK_NONE_FLAGS;
+    if (pCreateInfo->imageViewType == VK_IMAGE_VIEW_TYPE_CUBE || pCreateInfo->imageViewType == VK_IMAGE_VIEW_TYPE_CUBE_ARRAY)
+        flags |= VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+
+    // mip chain is generated by blit from level 0, sampled images are also
+    // copied when the defragmenter move them.
+    VkImageUsageFlags usage = pCreateInfo->usage;
+    if (texture->mipLevels > 1 || !(usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)))
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    texture->createFlags = flags;
+    texture->usage = usage;
 
     VkImageCreateInfo image_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
             /* pNext */ VK_NULL_HANDLE,
-            /* flags */ VK_NONE_FLAGS,
+            /* flags */ flags,
             /* imageType */ pCreateInfo->imageType,
             /* format */ texture->format,
             /* extent */ { pCreateInfo->width, pCreateInfo->height, 1 },
-            /* mipLevels */ 1,
-            /* arrayLayers */ 1,
+            /* mipLevels */ texture->mipLevels,
+            /* arrayLayers */ texture->arrayLayers,
             /* samples */ pCreateInfo->samples,
             /* tiling */ VK_IMAGE_TILING_OPTIMAL,
-            /* usage */ pCreateInfo->usage,
+            /* usage */ usage,
             /* sharingMode */ VK_SHARING_MODE_EXCLUSIVE,
             /* queueFamilyIndexCount */ 0,
             /* pQueueFamilyIndices */ nullptr,
@@ -152,12 +285,24 @@ RenderDevice::Texture2D *RenderDevice::CreateTexture(TextureCreateInfo *pCreateI
     err = vmaCreateImage(allocator, &image_create_info, &allocation_create_info, &texture->image, &texture->allocation, &texture->allocationInfo);
     assert(!err);
 
+    CreateTextureImageView(hTexture);
+
+    return hTexture;
+}
+
+void RenderDevice::CreateTextureImageView(TextureHandle hTexture)
+{
+    VkResult U_ASSERT_ONLY err;
+
+    Texture2D *texture = textures.get(hTexture);
+    assert(texture);
+
     VkImageViewCreateInfo image_view_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             /* pNext */ VK_NULL_HANDLE,
             /* flags */ VK_NONE_FLAGS,
             /* image */ texture->image,
-            /* viewType */ pCreateInfo->imageViewType,
+            /* viewType */ texture->imageViewType,
             /* format */ texture->format,
             /* components */
                 {
@@ -168,40 +313,48 @@ RenderDevice::Texture2D *RenderDevice::CreateTexture(TextureCreateInfo *pCreateI
                 },
             /* subresourceRange */
                 {
-                    .aspectMask = pCreateInfo->aspectMask,
-                    .baseMipLevel = 0,
-                    .levelCount = 1,
+                    .aspectMask = texture->aspectMask,
+                    .baseMipLevel = texture->baseMipLevel,
+                    .levelCount = texture->mipLevels - texture->baseMipLevel,
                     .baseArrayLayer = 0,
-                    .layerCount = 1,
+                    .layerCount = texture->arrayLayers,
                 },
     };
 
     err = vkCreateImageView(device, &image_view_create_info, VK_NULL_HANDLE, &texture->imageView);
     assert(!err);
-
-    return texture;
 }
 
-void RenderDevice::DestroyTexture(Texture2D *p_texture)
+void RenderDevice::DestroyTexture(TextureHandle hTexture)
 {
+    Texture2D *p_texture = textures.get(hTexture);
+    assert(p_texture && "destroy stale texture handle");
+
     vmaDestroyImage(allocator, p_texture->image, p_texture->allocation);
     vkDestroyImageView(device, p_texture->imageView, VK_NULL_HANDLE);
     if (p_texture->descriptorSet)
         FreeDescriptorSet(p_texture->descriptorSet);
+    textures.release(hTexture);
 }
 
-void RenderDevice::WriteTexture(Texture2D *texture, size_t size, void *pixels)
+void RenderDevice::WriteTexture(TextureHandle hTexture, size_t size, void *pixels)
 {
-    Buffer *buffer = CreateBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
+    PROFILE_FUNCTION();
+
+    Texture2D *texture = textures.get(hTexture);
+    assert(texture);
+
+    BufferHandle buffer = CreateBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
     WriteBuffer(buffer, 0, size, pixels);
 
     texture->size = size;
 
     VkCommandBuffer cmdBuffer;
     CmdBufferOneTimeBegin(&cmdBuffer);
+    uint32_t upload = profiler ? profiler->CmdBeginUpload(cmdBuffer) : GPU_PROFILER_INVALID_SCOPE;
 
     PipelineMemoryBarrier barrier;
-    barrier.image.texture = texture;
+    barrier.image.texture = hTexture;
     barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     barrier.image.newImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     barrier.image.srcAccessMask = 0;
@@ -215,27 +368,176 @@ void RenderDevice::WriteTexture(Texture2D *texture, size_t size, void *pixels)
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     region.imageSubresource.mipLevel = 0;
     region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
+    region.imageSubresource.layerCount = texture->arrayLayers;
     region.imageOffset = {0, 0, 0};
     region.imageExtent = { texture->width, texture->height, 1 };
 
     vkCmdCopyBufferToImage(
         cmdBuffer,
-        buffer->vkBuffer,
+        GetBuffer(buffer)->vkBuffer,
         texture->image,
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         1,
         &region
     );
 
+    // a chain that can't be generated is left undefined, sampling stays
+    // on level 0 as long as the sampler maxLod is 0.
+    if (texture->mipLevels == 1 || CmdGenerateMipmaps(cmdBuffer, hTexture) != OK) {
+        barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.image.newImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.image.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.image.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        CmdPipelineBarrier(cmdBuffer, &barrier);
+    }
+
+    if (profiler)
+        profiler->CmdEndUpload(cmdBuffer, upload);
+
+    CmdBufferOneTimeEnd(cmdBuffer);
+    DestroyBuffer(buffer);
+
+    if (profiler)
+        profiler->ResolveUpload(upload);
+}
+
+void RenderDevice::WriteTextureRegions(TextureHandle hTexture, size_t size, void *data, uint32_t regionCount, const TextureRegion *pRegions)
+{
+    PROFILE_FUNCTION();
+
+    Texture2D *texture = textures.get(hTexture);
+    assert(texture);
+
+    BufferHandle buffer = CreateBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
+    WriteBuffer(buffer, 0, size, data);
+
+    texture->size = size;
+
+    std::vector<VkBufferImageCopy> copies(regionCount);
+    for (uint32_t i = 0; i < regionCount; i++) {
+        VkBufferImageCopy *copy = &copies[i];
+        copy->bufferOffset = pRegions[i].offset;
+        copy->bufferRowLength = 0;
+        copy->bufferImageHeight = 0;
+        copy->imageSubresource.aspectMask = texture->aspectMask;
+        copy->imageSubresource.mipLevel = pRegions[i].mipLevel;
+        copy->imageSubresource.baseArrayLayer = pRegions[i].baseArrayLayer;
+        copy->imageSubresource.layerCount = pRegions[i].layerCount;
+        copy->imageOffset = { 0, 0, 0 };
+        copy->imageExtent = { std::max(texture->width >> pRegions[i].mipLevel, 1u), std::max(texture->height >> pRegions[i].mipLevel, 1u), 1 };
+    }
+
+    VkCommandBuffer cmdBuffer;
+    CmdBufferOneTimeBegin(&cmdBuffer);
+    uint32_t upload = profiler ? profiler->CmdBeginUpload(cmdBuffer) : GPU_PROFILER_INVALID_SCOPE;
+
+    PipelineMemoryBarrier barrier;
+    barrier.image.texture = hTexture;
+    barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.image.newImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.image.srcAccessMask = 0;
+    barrier.image.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    vkCmdCopyBufferToImage(cmdBuffer, GetBuffer(buffer)->vkBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, std::data(copies));
+
     barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     barrier.image.newImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     barrier.image.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
     barrier.image.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
     CmdPipelineBarrier(cmdBuffer, &barrier);
 
+    if (profiler)
+        profiler->CmdEndUpload(cmdBuffer, upload);
+
     CmdBufferOneTimeEnd(cmdBuffer);
     DestroyBuffer(buffer);
+
+    if (profiler)
+        profiler->ResolveUpload(upload);
+}
+
+bool RenderDevice::IsMipmapGenerationSupported(VkFormat format)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(rdc->GetPhysicalDevice(), format, &formatProperties);
+
+    VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    return (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+}
+
+Error RenderDevice::CmdGenerateMipmaps(VkCommandBuffer cmdBuffer, TextureHandle hTexture)
+{
+    Texture2D *texture = textures.get(hTexture);
+    assert(texture);
+
+    if (!IsMipmapGenerationSupported(texture->format)) {
+        fprintf(stderr, "generate mipmaps failed, format %d can't be blit\n", texture->format);
+        return FAIL;
+    }
+
+    // expect every level in TRANSFER_DST_OPTIMAL with level 0 written,
+    // leave every level in SHADER_READ_ONLY_OPTIMAL. Linear filtering of
+    // the format is optional, nearest is used without it.
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(rdc->GetPhysicalDevice(), texture->format, &formatProperties);
+    VkFilter filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = texture->image;
+    barrier.subresourceRange.aspectMask = texture->aspectMask;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = texture->arrayLayers;
+
+    int32_t mipWidth = (int32_t) texture->width;
+    int32_t mipHeight = (int32_t) texture->height;
+
+    for (uint32_t i = 1; i < texture->mipLevels; i++) {
+        barrier.subresourceRange.baseMipLevel = i - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+
+        int32_t nextWidth = std::max(mipWidth / 2, 1);
+        int32_t nextHeight = std::max(mipHeight / 2, 1);
+
+        VkImageBlit blit = {};
+        blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+        blit.srcSubresource = { texture->aspectMask, i - 1, 0, texture->arrayLayers };
+        blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+        blit.dstSubresource = { texture->aspectMask, i, 0, texture->arrayLayers };
+
+        vkCmdBlitImage(cmdBuffer,
+                       texture->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &blit, filter);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+
+        mipWidth = nextWidth;
+        mipHeight = nextHeight;
+    }
+
+    barrier.subresourceRange.baseMipLevel = texture->mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 1, &barrier);
+
+    texture->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    return OK;
 }
 
 void
@@ -266,23 +568,26 @@ void RenderDevice::DestroyFramebuffer(VkFramebuffer framebuffer)
 
 void RenderDevice::CreateSampler(SamplerCreateInfo* pCreateInfo, VkSampler* p_sampler)
 {
+    VkBool32 anisotropyEnable = pCreateInfo->anisotropyEnable && rdc->GetPhysicalDeviceFeatures().samplerAnisotropy;
+    float maxAnisotropy = std::min(pCreateInfo->maxAnisotropy, rdc->GetPhysicalDeviceProperties().limits.maxSamplerAnisotropy);
+
     VkSamplerCreateInfo sampler_create_info = {};
     sampler_create_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    sampler_create_info.magFilter = VK_FILTER_LINEAR;
-    sampler_create_info.minFilter = VK_FILTER_LINEAR;
+    sampler_create_info.magFilter = pCreateInfo->filter;
+    sampler_create_info.minFilter = pCreateInfo->filter;
     sampler_create_info.addressModeU = pCreateInfo->u;
     sampler_create_info.addressModeV = pCreateInfo->v;
     sampler_create_info.addressModeW = pCreateInfo->w;
-    sampler_create_info.anisotropyEnable = VK_FALSE;
-    sampler_create_info.maxAnisotropy = 16;
+    sampler_create_info.anisotropyEnable = anisotropyEnable;
+    sampler_create_info.maxAnisotropy = anisotropyEnable ? maxAnisotropy : 1.0f;
     sampler_create_info.borderColor = pCreateInfo->border_color;
     sampler_create_info.unnormalizedCoordinates = VK_FALSE;
     sampler_create_info.compareEnable = VK_FALSE;
     sampler_create_info.compareOp = VK_COMPARE_OP_ALWAYS;
-    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    sampler_create_info.mipLodBias = 0.0f;
-    sampler_create_info.minLod = 0.0f;
-    sampler_create_info.maxLod = 0.0f;
+    sampler_create_info.mipmapMode = pCreateInfo->mipmapMode;
+    sampler_create_info.mipLodBias = pCreateInfo->mipLodBias;
+    sampler_create_info.minLod = pCreateInfo->minLod;
+    sampler_create_info.maxLod = pCreateInfo->maxLod;
 
     vkCreateSampler(device, &sampler_create_info, VK_NULL_HANDLE, p_sampler);
 }
@@ -292,8 +597,11 @@ void RenderDevice::DestroySampler(VkSampler sampler)
     vkDestroySampler(device, sampler, VK_NULL_HANDLE);
 }
 
-void RenderDevice::BindTextureSampler(RenderDevice::Texture2D *texture, VkSampler sampler)
+void RenderDevice::BindTextureSampler(TextureHandle hTexture, VkSampler sampler)
 {
+    Texture2D *texture = textures.get(hTexture);
+    assert(texture);
+
     texture->sampler = sampler;
 }
 
@@ -318,6 +626,58 @@ void RenderDevice::DestroyDescriptorSetLayout(VkDescriptorSetLayout descriptorSe
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, VK_NULL_HANDLE);
 }
 
+VkDescriptorSetLayout RenderDevice::AcquireDescriptorSetLayout(uint32_t bindingCount, const VkDescriptorSetLayoutBinding *pBindings)
+{
+    uint64_t hash = hash_fnv1a64_value(bindingCount);
+    for (uint32_t i = 0; i < bindingCount; i++) {
+        hash = hash_fnv1a64_value(pBindings[i].binding, hash);
+        hash = hash_fnv1a64_value(pBindings[i].descriptorType, hash);
+        hash = hash_fnv1a64_value(pBindings[i].descriptorCount, hash);
+        hash = hash_fnv1a64_value(pBindings[i].stageFlags, hash);
+        if (pBindings[i].pImmutableSamplers)
+            hash = hash_fnv1a64(pBindings[i].pImmutableSamplers, sizeof(VkSampler) * pBindings[i].descriptorCount, hash);
+    }
+
+    // the hash only pick the bucket, bindings are compared as well.
+    CachedDescriptorSetLayout cached;
+    for (uint32_t i = 0; i < bindingCount; i++) {
+        VkDescriptorSetLayoutBinding binding = pBindings[i];
+        if (binding.pImmutableSamplers)
+            cached.immutableSamplers.insert(cached.immutableSamplers.end(), binding.pImmutableSamplers, binding.pImmutableSamplers + binding.descriptorCount);
+        binding.pImmutableSamplers = NULL;
+        cached.bindings.push_back(binding);
+    }
+
+    std::lock_guard<std::mutex> lock(descriptorSetLayoutCacheMutex);
+
+    std::vector<CachedDescriptorSetLayout> &bucket = descriptorSetLayoutCache[hash];
+    for (const CachedDescriptorSetLayout &other : bucket) {
+        if (_IsSameDescriptorSetLayout(cached, other))
+            return other.descriptorSetLayout;
+    }
+
+    CreateDescriptorSetLayout(bindingCount, (VkDescriptorSetLayoutBinding *) pBindings, &cached.descriptorSetLayout);
+    bucket.push_back(cached);
+
+    return cached.descriptorSetLayout;
+}
+
+bool RenderDevice::_IsSameDescriptorSetLayout(const CachedDescriptorSetLayout &a, const CachedDescriptorSetLayout &b)
+{
+    if (std::size(a.bindings) != std::size(b.bindings) || a.immutableSamplers != b.immutableSamplers)
+        return false;
+
+    for (size_t i = 0; i < std::size(a.bindings); i++) {
+        const VkDescriptorSetLayoutBinding &x = a.bindings[i];
+        const VkDescriptorSetLayoutBinding &y = b.bindings[i];
+        if (x.binding != y.binding || x.descriptorType != y.descriptorType || x.descriptorCount != y.descriptorCount ||
+            x.stageFlags != y.stageFlags)
+            return false;
+    }
+
+    return true;
+}
+
 void RenderDevice::AllocateDescriptorSet(VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet *pDescriptorSet)
 {
     VkDescriptorSetAllocateInfo descriptor_allocate_info = {
@@ -333,11 +693,23 @@ void RenderDevice::AllocateDescriptorSet(VkDescriptorSetLayout descriptorSetLayo
 
 void RenderDevice::FreeDescriptorSet(VkDescriptorSet descriptorSet)
 {
+    {
+        std::lock_guard<std::mutex> lock(descriptorReferenceMutex);
+        descriptorReferences.erase(descriptorReferences.lower_bound({ descriptorSet, 0 }), descriptorReferences.upper_bound({ descriptorSet, UINT32_MAX }));
+    }
+
     vkFreeDescriptorSets(device, descriptorPool, 1, &descriptorSet);
 }
 
-void RenderDevice::UpdateDescriptorSetBuffer(Buffer *buffer, uint32_t binding, VkDescriptorSet descriptorSet)
+void RenderDevice::UpdateDescriptorSetBuffer(BufferHandle hBuffer, uint32_t binding, VkDescriptorSet descriptorSet)
 {
+    Buffer *buffer = buffers.get(hBuffer);
+    assert(buffer);
+
+    VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    if ((buffer->usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) && !(buffer->usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT))
+        descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
     VkDescriptorBufferInfo bufferInfo = {
             /* buffer */ buffer->vkBuffer,
             /* offset */ 0,
@@ -351,17 +723,23 @@ void RenderDevice::UpdateDescriptorSetBuffer(Buffer *buffer, uint32_t binding, V
             /* dstBinding */ binding,
             /* dstArrayElement */ 0,
             /* descriptorCount */ 1,
-            /* descriptorType */ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            /* descriptorType */ descriptorType,
             /* pImageInfo */ VK_NULL_HANDLE,
             /* pBufferInfo */ &bufferInfo,
             /* pTexelBufferView */ VK_NULL_HANDLE,
     };
 
     vkUpdateDescriptorSets(device, 1, &writeInfo, 0, nullptr);
+
+    std::lock_guard<std::mutex> lock(descriptorReferenceMutex);
+    descriptorReferences[{ descriptorSet, binding }] = { false, hBuffer.value };
 }
 
-void RenderDevice::UpdateDescriptorSetImage(RenderDevice::Texture2D *texture, uint32_t binding, VkDescriptorSet descriptorSet)
+void RenderDevice::UpdateDescriptorSetImage(TextureHandle hTexture, uint32_t binding, VkDescriptorSet descriptorSet)
 {
+    Texture2D *texture = textures.get(hTexture);
+    assert(texture);
+
     VkDescriptorImageInfo image_info = {
             /* sampler= */ texture->sampler,
             /* imageView= */ texture->imageView,
@@ -382,20 +760,142 @@ void RenderDevice::UpdateDescriptorSetImage(RenderDevice::Texture2D *texture, ui
     };
 
     vkUpdateDescriptorSets(device, 1, &writeInfo, 0, nullptr);
+
+    std::lock_guard<std::mutex> lock(descriptorReferenceMutex);
+    descriptorReferences[{ descriptorSet, binding }] = { true, hTexture.value };
+}
+
+void RenderDevice::RefreshDescriptorReferences(BufferHandle hBuffer)
+{
+    std::vector<std::pair<VkDescriptorSet, uint32_t>> bindings;
+
+    {
+        std::lock_guard<std::mutex> lock(descriptorReferenceMutex);
+        for (const auto &[key, reference] : descriptorReferences) {
+            if (!reference.image && reference.handle == hBuffer.value)
+                bindings.push_back(key);
+        }
+    }
+
+    for (const auto &[descriptorSet, binding] : bindings)
+        UpdateDescriptorSetBuffer(hBuffer, binding, descriptorSet);
 }
 
-RenderDevice::Pipeline *RenderDevice::CreateGraphicsPipeline(RenderDevice::PipelineCreateInfo *pCreateInfo, RenderDevice::ShaderInfo *pShaderInfo)
+void RenderDevice::RefreshDescriptorReferences(TextureHandle hTexture)
 {
+    std::vector<std::pair<VkDescriptorSet, uint32_t>> bindings;
+
+    {
+        std::lock_guard<std::mutex> lock(descriptorReferenceMutex);
+        for (const auto &[key, reference] : descriptorReferences) {
+            if (reference.image && reference.handle == hTexture.value)
+                bindings.push_back(key);
+        }
+    }
+
+    for (const auto &[descriptorSet, binding] : bindings)
+        UpdateDescriptorSetImage(hTexture, binding, descriptorSet);
+}
+
+struct _SpecializationStage {
+    std::vector<VkSpecializationMapEntry> entries;
+    std::vector<uint32_t> data;
+    VkSpecializationInfo info;
+};
+
+// pick constants for the stage, return NULL if the stage has none.
+static VkSpecializationInfo *_BuildSpecializationInfo(VkShaderStageFlagBits stage, uint32_t count, const RenderDevice::SpecializationConstant *pConstants, _SpecializationStage *pSpecialization)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if (!(pConstants[i].stageFlags & stage))
+            continue;
+
+        VkSpecializationMapEntry entry = {
+                /* constantID */ pConstants[i].constantID,
+                /* offset */ (uint32_t) (std::size(pSpecialization->data) * sizeof(uint32_t)),
+                /* size */ sizeof(uint32_t),
+        };
+
+        pSpecialization->entries.push_back(entry);
+        pSpecialization->data.push_back(pConstants[i].value);
+    }
+
+    if (pSpecialization->entries.empty())
+        return VK_NULL_HANDLE;
+
+    pSpecialization->info = {
+            /* mapEntryCount */ (uint32_t) std::size(pSpecialization->entries),
+            /* pMapEntries */ std::data(pSpecialization->entries),
+            /* dataSize */ std::size(pSpecialization->data) * sizeof(uint32_t),
+            /* pData */ std::data(pSpecialization->data),
+    };
+
+    return &pSpecialization->info;
+}
+
+RenderDevice::PipelineHandle RenderDevice::CreateGraphicsPipeline(RenderDevice::PipelineCreateInfo *pCreateInfo, RenderDevice::ShaderInfo *pShaderInfo)
+{
+    PROFILE_FUNCTION();
+
     VkResult U_ASSERT_ONLY err;
 
+    // the key hold the bytecode itself, a rebuilt or newly mounted shader
+    // never match the pipeline of the previous one.
+    size_t vertexBytecodeSize, fragmentBytecodeSize;
+    char *vertexBytecode = load_shader_bytecode(pShaderInfo->vertex, "vert", &vertexBytecodeSize);
+    char *fragmentBytecode = load_shader_bytecode(pShaderInfo->fragment, "frag", &fragmentBytecodeSize);
+
+    std::string key;
+    _BuildGraphicsPipelineKey(pCreateInfo, pShaderInfo, vertexBytecode, vertexBytecodeSize, fragmentBytecode, fragmentBytecodeSize, &key);
+
+    PipelineHandle hPipeline = _AcquireRegisteredPipeline(key);
+    if (hPipeline) {
+        io_free_buf(vertexBytecode);
+        io_free_buf(fragmentBytecode);
+        return hPipeline;
+    }
+
+    // layouts and vertex input come from reflection, a partial one would
+    // build a pipeline that doesn't match the shaders.
+    ShaderReflection reflections[2];
+    if (ReflectShaderBytecode((uint32_t *) vertexBytecode, vertexBytecodeSize, &reflections[0]) != OK ||
+        ReflectShaderBytecode((uint32_t *) fragmentBytecode, fragmentBytecodeSize, &reflections[1]) != OK) {
+        fprintf(stderr, "reflect shader %s/%s failed\n", pShaderInfo->vertex, pShaderInfo->fragment);
+        io_free_buf(vertexBytecode);
+        io_free_buf(fragmentBytecode);
+        return {};
+    }
+
+    Pipeline *pPipeline;
+    hPipeline = pipelines.allocate(&pPipeline);
+    pPipeline->hash = hash_fnv1a64(std::data(key), std::size(key));
+    pPipeline->key = std::move(key);
+
+    if (pShaderInfo->pDescriptorSetLayouts) {
+        assert(pShaderInfo->descriptorSetLayoutCount <= RENDER_DEVICE_MAX_DESCRIPTOR_SETS);
+        pPipeline->descriptorSetLayoutCount = pShaderInfo->descriptorSetLayoutCount;
+        memcpy(pPipeline->descriptorSetLayouts, pShaderInfo->pDescriptorSetLayouts, sizeof(VkDescriptorSetLayout) * pShaderInfo->descriptorSetLayoutCount);
+    } else {
+        _ReflectDescriptorSetLayouts(ARRAY_SIZE(reflections), reflections, &pPipeline->descriptorSetLayoutCount, pPipeline->descriptorSetLayouts);
+    }
+
+    uint32_t pushConstantCount = pShaderInfo->pushConstantCount;
+    VkPushConstantRange *pPushConstantRange = pShaderInfo->pPushConstantRange;
+    if (!pPushConstantRange) {
+        pushConstantCount = _ReflectPushConstantRange(ARRAY_SIZE(reflections), reflections, &pPipeline->pushConstantRange);
+        pPushConstantRange = &pPipeline->pushConstantRange;
+    } else if (pushConstantCount > 0) {
+        pPipeline->pushConstantRange = pPushConstantRange[0];
+    }
+
     VkPipelineLayoutCreateInfo pipelineLayoutCreatInfo = {
             /* sType */ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             /* pNext */ VK_NULL_HANDLE,
             /* flags */ VK_NONE_FLAGS,
-            /* setLayoutCount */ pShaderInfo->descriptorSetLayoutCount,
-            /* pSetLayouts */ pShaderInfo->pDescriptorSetLayouts,
-            /* pushConstantRangeCount */ pShaderInfo->pushConstantCount,
-            /* pPushConstantRanges */ pShaderInfo->pPushConstantRange,
+            /* setLayoutCount */ pPipeline->descriptorSetLayoutCount,
+            /* pSetLayouts */ pPipeline->descriptorSetLayouts,
+            /* pushConstantRangeCount */ pushConstantCount,
+            /* pPushConstantRanges */ pPushConstantRange,
     };
 
     VkPipelineLayout pipelineLayout;
@@ -404,33 +904,75 @@ RenderDevice::Pipeline *RenderDevice::CreateGraphicsPipeline(RenderDevice::Pipel
 
     VkShaderModule vertex_shader_module, fragment_shader_module;
 
-    vertex_shader_module = load_shader_module(device, pShaderInfo->vertex, "vert");
-    fragment_shader_module = load_shader_module(device, pShaderInfo->fragment, "frag");
+    vertex_shader_module = create_shader_module(device, vertexBytecode, vertexBytecodeSize);
+    fragment_shader_module = create_shader_module(device, fragmentBytecode, fragmentBytecodeSize);
+
+    io_free_buf(vertexBytecode);
+    io_free_buf(fragmentBytecode);
+
+    _SpecializationStage vertexSpecialization, fragmentSpecialization;
 
     VkPipelineShaderStageCreateInfo vertex_shader_create_info = {};
     vertex_shader_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertex_shader_create_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
     vertex_shader_create_info.module = vertex_shader_module;
     vertex_shader_create_info.pName = "main";
+    vertex_shader_create_info.pSpecializationInfo = _BuildSpecializationInfo(VK_SHADER_STAGE_VERTEX_BIT, pShaderInfo->specializationConstantCount, pShaderInfo->pSpecializationConstants, &vertexSpecialization);
 
     VkPipelineShaderStageCreateInfo fragmentShaderCreateInfo = {};
     fragmentShaderCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     fragmentShaderCreateInfo.module = fragment_shader_module;
     fragmentShaderCreateInfo.pName = "main";
+    fragmentShaderCreateInfo.pSpecializationInfo = _BuildSpecializationInfo(VK_SHADER_STAGE_FRAGMENT_BIT, pShaderInfo->specializationConstantCount, pShaderInfo->pSpecializationConstants, &fragmentSpecialization);
 
     VkPipelineShaderStageCreateInfo shaderStagesInfo[] = {
             vertex_shader_create_info, fragmentShaderCreateInfo
     };
 
+    uint32_t attributeCount = pShaderInfo->attributeCount;
+    VkVertexInputAttributeDescription *attributes = pShaderInfo->attributes;
+    uint32_t bindCount = pShaderInfo->bindCount;
+    VkVertexInputBindingDescription *binds = pShaderInfo->binds;
+
+    // derive an interleaved layout on binding 0 from the vertex shader inputs,
+    // attributes are tightly packed by location order. Inputs from
+    // instanceInputLocation on go to binding 1 at instance rate.
+    std::vector<VkVertexInputAttributeDescription> reflectAttributes;
+    VkVertexInputBindingDescription reflectBinds[2] = {
+            { 0, 0, VK_VERTEX_INPUT_RATE_VERTEX },
+            { 1, 0, VK_VERTEX_INPUT_RATE_INSTANCE },
+    };
+    if (!attributes && !reflections[0].inputs.empty()) {
+        for (const ShaderReflection::VertexInput &input : reflections[0].inputs) {
+            VkVertexInputBindingDescription *bind = &reflectBinds[input.location >= pShaderInfo->instanceInputLocation ? 1 : 0];
+            VkVertexInputAttributeDescription attribute = {};
+            attribute.location = input.location;
+            attribute.binding = bind->binding;
+            attribute.format = input.format;
+            attribute.offset = bind->stride;
+            reflectAttributes.push_back(attribute);
+            bind->stride += input.size;
+        }
+
+        attributeCount = (uint32_t) std::size(reflectAttributes);
+        attributes = std::data(reflectAttributes);
+
+        if (!binds) {
+            /* skip the per vertex binding when every input is per instance */
+            binds = reflectBinds[0].stride ? &reflectBinds[0] : &reflectBinds[1];
+            bindCount = reflectBinds[0].stride && reflectBinds[1].stride ? 2 : 1;
+        }
+    }
+
     VkPipelineVertexInputStateCreateInfo inputStateCreateInfo = {
             /* sType */ VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
             /* pNext */ VK_NULL_HANDLE,
             /* flags */ VK_NONE_FLAGS,
-            /* vertexBindingDescriptionCount */ pShaderInfo->bindCount,
-            /* pVertexBindingDescriptions */ pShaderInfo->binds,
-            /* vertexAttributeDescriptionCount */ pShaderInfo->attributeCount,
-            /* pVertexAttributeDescriptions */ pShaderInfo->attributes,
+            /* vertexBindingDescriptionCount */ bindCount,
+            /* pVertexBindingDescriptions */ binds,
+            /* vertexAttributeDescriptionCount */ attributeCount,
+            /* pVertexAttributeDescriptions */ attributes,
     };
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
@@ -472,7 +1014,7 @@ RenderDevice::Pipeline *RenderDevice::CreateGraphicsPipeline(RenderDevice::Pipel
     rasterizationStateCreateInfo.polygonMode = pCreateInfo->polygon;
     rasterizationStateCreateInfo.lineWidth = pCreateInfo->lineWidth;
     rasterizationStateCreateInfo.cullMode = pCreateInfo->cullMode;
-    rasterizationStateCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizationStateCreateInfo.frontFace = pCreateInfo->frontFace;
     rasterizationStateCreateInfo.depthBiasEnable = VK_FALSE;
     rasterizationStateCreateInfo.depthBiasConstantFactor = 0.0f;
     rasterizationStateCreateInfo.depthBiasClamp = 0.0f;
@@ -492,23 +1034,16 @@ RenderDevice::Pipeline *RenderDevice::CreateGraphicsPipeline(RenderDevice::Pipel
     colorBlendAttachmentState.blendEnable = pCreateInfo->blendEnable;
     colorBlendAttachmentState.srcColorBlendFactor = pCreateInfo->srcColorBlendFactor;
     colorBlendAttachmentState.dstColorBlendFactor = pCreateInfo->dstColorBlendFactor;
-    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachmentState.blendEnable = VK_TRUE;
-    colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-    colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachmentState.colorBlendOp = pCreateInfo->colorBlendOp;
+    colorBlendAttachmentState.srcAlphaBlendFactor = pCreateInfo->srcAlphaBlendFactor;
+    colorBlendAttachmentState.dstAlphaBlendFactor = pCreateInfo->dstAlphaBlendFactor;
+    colorBlendAttachmentState.alphaBlendOp = pCreateInfo->alphaBlendOp;
 
     VkPipelineDepthStencilStateCreateInfo depthStencilStateCreateInfo = {};
     depthStencilStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
-    depthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
-    depthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilStateCreateInfo.depthTestEnable = pCreateInfo->depthTestEnable;
+    depthStencilStateCreateInfo.depthWriteEnable = pCreateInfo->depthWriteEnable;
+    depthStencilStateCreateInfo.depthCompareOp = pCreateInfo->depthCompareOp;
     depthStencilStateCreateInfo.depthBoundsTestEnable = VK_FALSE;
     depthStencilStateCreateInfo.stencilTestEnable = VK_FALSE;
     depthStencilStateCreateInfo.minDepthBounds = 0.0f;
@@ -518,8 +1053,8 @@ RenderDevice::Pipeline *RenderDevice::CreateGraphicsPipeline(RenderDevice::Pipel
     colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
     colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_COPY;
-    colorBlendStateCreateInfo.attachmentCount = 1;
-    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachmentState;
+    colorBlendStateCreateInfo.attachmentCount = pCreateInfo->colorAttachmentCount;
+    colorBlendStateCreateInfo.pAttachments = pCreateInfo->colorAttachmentCount ? &colorBlendAttachmentState : VK_NULL_HANDLE;
     colorBlendStateCreateInfo.blendConstants[0] = 0.0f;
     colorBlendStateCreateInfo.blendConstants[1] = 0.0f;
     colorBlendStateCreateInfo.blendConstants[2] = 0.0f;
@@ -533,6 +1068,15 @@ RenderDevice::Pipeline *RenderDevice::CreateGraphicsPipeline(RenderDevice::Pipel
     if (pCreateInfo->lineWidth > 1.0f)
         dynamics.push_back(VK_DYNAMIC_STATE_LINE_WIDTH);
 
+    if (pCreateInfo->extendedDynamicState && extendedDynamicStateSupported) {
+        dynamics.push_back(VK_DYNAMIC_STATE_CULL_MODE);
+        dynamics.push_back(VK_DYNAMIC_STATE_FRONT_FACE);
+        dynamics.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY);
+        dynamics.push_back(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE);
+        dynamics.push_back(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE);
+        dynamics.push_back(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP);
+    }
+
     VkPipelineDynamicStateCreateInfo dynamicStateCrateInfo = {
             /* sType= */ VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
             /* pNext= */ VK_NULL_HANDLE,
@@ -558,16 +1102,15 @@ RenderDevice::Pipeline *RenderDevice::CreateGraphicsPipeline(RenderDevice::Pipel
             /* pDynamicState */ &dynamicStateCrateInfo,
             /* layout */ pipelineLayout,
             /* renderPass */ pCreateInfo->renderPass,
-            /* subpass */ 0,
+            /* subpass */ pCreateInfo->subpass,
             /* basePipelineHandle */ VK_NULL_HANDLE,
             /* basePipelineIndex */ -1,
     };
 
     VkPipeline pipeline;
-    err = vkCreateGraphicsPipelines(device, nullptr, 1, &pipelineCreateInfo, VK_NULL_HANDLE, &pipeline);
+    err = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, VK_NULL_HANDLE, &pipeline);
     assert(!err);
 
-    Pipeline *pPipeline = (Pipeline*) imalloc(sizeof(Pipeline));
     pPipeline->pipeline = pipeline;
     pPipeline->layout = pipelineLayout;
     pPipeline->bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
@@ -575,7 +1118,7 @@ RenderDevice::Pipeline *RenderDevice::CreateGraphicsPipeline(RenderDevice::Pipel
     vkDestroyShaderModule(device, vertex_shader_module, VK_NULL_HANDLE);
     vkDestroyShaderModule(device, fragment_shader_module, VK_NULL_HANDLE);
 
-    return pPipeline;
+    return _RegisterPipeline(hPipeline);
 }
 
 void RenderDevice::_InitializeDescriptorPool()
@@ -609,43 +1152,366 @@ void RenderDevice::_InitializeDescriptorPool()
     assert(!err);
 }
 
-RenderDevice::Pipeline *RenderDevice::CreateComputePipeline(RenderDevice::ComputeShaderInfo *pShaderInfo)
+void RenderDevice::_InitializePipelineCache()
 {
-    Pipeline *pipeline = (Pipeline *) imalloc(sizeof(Pipeline));
+    VkResult U_ASSERT_ONLY err;
+
+    // pipeline cache is internally synchronized, pipelines can be
+    // created through it from any thread.
+    VkPipelineCacheCreateInfo pipeline_cache_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            /* pNext */ VK_NULL_HANDLE,
+            /* flags */ VK_NONE_FLAGS,
+            /* initialDataSize */ 0,
+            /* pInitialData */ VK_NULL_HANDLE,
+    };
+
+    err = vkCreatePipelineCache(device, &pipeline_cache_create_info, VK_NULL_HANDLE, &pipelineCache);
+    assert(!err);
+}
+
+void RenderDevice::_ReflectDescriptorSetLayouts(uint32_t reflectionCount, const ShaderReflection *pReflections, uint32_t *pDescriptorSetLayoutCount, VkDescriptorSetLayout *pDescriptorSetLayouts)
+{
+    // set -> binding -> layout binding, the same binding used by several
+    // stages is merged into one with combined stage flags.
+    std::map<uint32_t, std::map<uint32_t, VkDescriptorSetLayoutBinding>> sets;
+
+    for (uint32_t i = 0; i < reflectionCount; i++) {
+        for (const ShaderReflection::DescriptorBinding &reflect : pReflections[i].bindings) {
+            assert(reflect.set < RENDER_DEVICE_MAX_DESCRIPTOR_SETS);
+
+            auto &bindings = sets[reflect.set];
+            auto search = bindings.find(reflect.binding);
+            if (search != bindings.end()) {
+                search->second.stageFlags |= pReflections[i].stage;
+                search->second.descriptorCount = std::max(search->second.descriptorCount, reflect.descriptorCount);
+                continue;
+            }
+
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.binding = reflect.binding;
+            binding.descriptorType = reflect.descriptorType;
+            binding.descriptorCount = reflect.descriptorCount;
+            binding.stageFlags = pReflections[i].stage;
+            bindings.insert({ reflect.binding, binding });
+        }
+    }
+
+    *pDescriptorSetLayoutCount = sets.empty() ? 0 : sets.rbegin()->first + 1;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    for (uint32_t set = 0; set < *pDescriptorSetLayoutCount; set++) {
+        bindings.clear();
+        for (const auto &[index, binding] : sets[set])
+            bindings.push_back(binding);
+        pDescriptorSetLayouts[set] = AcquireDescriptorSetLayout((uint32_t) std::size(bindings), std::data(bindings));
+    }
+}
+
+uint32_t RenderDevice::_ReflectPushConstantRange(uint32_t reflectionCount, const ShaderReflection *pReflections, VkPushConstantRange *pPushConstantRange)
+{
+    uint32_t begin = UINT32_MAX;
+    uint32_t end = 0;
+    VkShaderStageFlags stageFlags = 0;
+
+    for (uint32_t i = 0; i < reflectionCount; i++) {
+        if (pReflections[i].pushConstantSize == 0)
+            continue;
+
+        begin = std::min(begin, pReflections[i].pushConstantOffset);
+        end = std::max(end, pReflections[i].pushConstantOffset + pReflections[i].pushConstantSize);
+        stageFlags |= pReflections[i].stage;
+    }
+
+    if (!stageFlags)
+        return 0;
+
+    pPushConstantRange->stageFlags = stageFlags;
+    pPushConstantRange->offset = begin;
+    pPushConstantRange->size = end - begin;
+
+    return 1;
+}
+
+RenderDevice::PipelineHandle RenderDevice::CreateComputePipeline(RenderDevice::ComputeShaderInfo *pShaderInfo)
+{
+    size_t computeBytecodeSize;
+    char *computeBytecode = load_shader_bytecode(pShaderInfo->compute, "comp", &computeBytecodeSize);
+
+    std::string key;
+    _BuildComputePipelineKey(pShaderInfo, computeBytecode, computeBytecodeSize, &key);
+
+    PipelineHandle hPipeline = _AcquireRegisteredPipeline(key);
+    if (hPipeline) {
+        io_free_buf(computeBytecode);
+        return hPipeline;
+    }
+
+    ShaderReflection reflection;
+    if (ReflectShaderBytecode((uint32_t *) computeBytecode, computeBytecodeSize, &reflection) != OK) {
+        fprintf(stderr, "reflect shader %s failed\n", pShaderInfo->compute);
+        io_free_buf(computeBytecode);
+        return {};
+    }
+
+    Pipeline *pipeline;
+    hPipeline = pipelines.allocate(&pipeline);
     pipeline->bindPoint = VK_PIPELINE_BIND_POINT_COMPUTE;
+    pipeline->hash = hash_fnv1a64(std::data(key), std::size(key));
+    pipeline->key = std::move(key);
+
+    if (pShaderInfo->pDescriptorSetLayouts) {
+        assert(pShaderInfo->descriptorSetLayoutCount <= RENDER_DEVICE_MAX_DESCRIPTOR_SETS);
+        pipeline->descriptorSetLayoutCount = pShaderInfo->descriptorSetLayoutCount;
+        memcpy(pipeline->descriptorSetLayouts, pShaderInfo->pDescriptorSetLayouts, sizeof(VkDescriptorSetLayout) * pShaderInfo->descriptorSetLayoutCount);
+    } else {
+        _ReflectDescriptorSetLayouts(1, &reflection, &pipeline->descriptorSetLayoutCount, pipeline->descriptorSetLayouts);
+    }
+
+    uint32_t pushConstantCount = pShaderInfo->pushConstantCount;
+    VkPushConstantRange *pPushConstantRange = pShaderInfo->pPushConstantRange;
+    if (!pPushConstantRange) {
+        pushConstantCount = _ReflectPushConstantRange(1, &reflection, &pipeline->pushConstantRange);
+        pPushConstantRange = &pipeline->pushConstantRange;
+    } else if (pushConstantCount > 0) {
+        pipeline->pushConstantRange = pPushConstantRange[0];
+    }
 
     VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
             /* sType= */ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             /* pNext= */ VK_NULL_HANDLE,
             /* flags= */ VK_NONE_FLAGS,
-            /* setLayoutCount= */ pShaderInfo->descriptorSetLayoutCount,
-            /* pSetLayouts= */ pShaderInfo->pDescriptorSetLayouts,
-            /* pushConstantRangeCount= */ pShaderInfo->pushConstantCount,
-            /* pPushConstantRanges= */ pShaderInfo->pPushConstantRange,
+            /* setLayoutCount= */ pipeline->descriptorSetLayoutCount,
+            /* pSetLayouts= */ pipeline->descriptorSetLayouts,
+            /* pushConstantRangeCount= */ pushConstantCount,
+            /* pPushConstantRanges= */ pPushConstantRange,
     };
     vkCreatePipelineLayout(device, &pipeline_layout_create_info, VK_NULL_HANDLE, &pipeline->layout);
 
     VkShaderModule compute_shader_module;
-    compute_shader_module = load_shader_module(device, pShaderInfo->compute, "vert");
+    compute_shader_module = create_shader_module(device, computeBytecode, computeBytecodeSize);
+    io_free_buf(computeBytecode);
+
+    _SpecializationStage computeSpecialization;
 
     VkPipelineShaderStageCreateInfo shaderStageCreateInfo = {};
     shaderStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
     shaderStageCreateInfo.module = compute_shader_module;
     shaderStageCreateInfo.pName = "main";
+    shaderStageCreateInfo.pSpecializationInfo = _BuildSpecializationInfo(VK_SHADER_STAGE_COMPUTE_BIT, pShaderInfo->specializationConstantCount, pShaderInfo->pSpecializationConstants, &computeSpecialization);
 
     VkComputePipelineCreateInfo pipelineCreateInfo = {};
     pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
     pipelineCreateInfo.stage = shaderStageCreateInfo;
     pipelineCreateInfo.layout = pipeline->layout;
 
-    vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, VK_NULL_HANDLE, &pipeline->pipeline);
+    vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, VK_NULL_HANDLE, &pipeline->pipeline);
     vkDestroyShaderModule(device, compute_shader_module, VK_NULL_HANDLE);
 
+    return _RegisterPipeline(hPipeline);
+}
+
+void RenderDevice::DestroyPipeline(PipelineHandle pipeline)
+{
+    Pipeline *pPipeline = pipelines.get(pipeline);
+    assert(pPipeline && "destroy stale pipeline handle");
+
+    {
+        std::lock_guard<std::mutex> lock(pipelineRegistryMutex);
+        if (--pPipeline->refcount > 0)
+            return;
+
+        /* a colliding key is never registered */
+        auto search = pipelineRegistry.find(pPipeline->hash);
+        if (search != pipelineRegistry.end() && search->second == pipeline)
+            pipelineRegistry.erase(search);
+    }
+
+    _DestroyPipelineObjects(pPipeline);
+    pipelines.release(pipeline);
+}
+
+uint32_t RenderDevice::GetRegisteredPipelineCount()
+{
+    std::lock_guard<std::mutex> lock(pipelineRegistryMutex);
+    return (uint32_t) std::size(pipelineRegistry);
+}
+
+template<typename T>
+static void _AppendKey(std::string *pKey, const T &value)
+{
+    pKey->append((const char *) &value, sizeof(T));
+}
+
+/* size first, two arrays never read as the same bytes */
+static void _AppendKeyBytes(std::string *pKey, const void *data, size_t size)
+{
+    _AppendKey(pKey, size);
+    pKey->append((const char *) data, size);
+}
+
+void RenderDevice::_AppendSpecializationConstantsKey(uint32_t count, const SpecializationConstant *pConstants, std::string *pKey)
+{
+    _AppendKey(pKey, count);
+    for (uint32_t i = 0; i < count; i++) {
+        _AppendKey(pKey, pConstants[i].constantID);
+        _AppendKey(pKey, pConstants[i].stageFlags);
+        _AppendKey(pKey, pConstants[i].value);
+    }
+}
+
+static VkPrimitiveTopology _TopologyClass(VkPrimitiveTopology topology)
+{
+    switch (topology) {
+        case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+            return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+        case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+            return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+        case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+            return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+        default:
+            return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    }
+}
+
+void RenderDevice::_BuildGraphicsPipelineKey(const PipelineCreateInfo *pCreateInfo, const ShaderInfo *pShaderInfo, const char *vertexBytecode, size_t vertexBytecodeSize,
+                                             const char *fragmentBytecode, size_t fragmentBytecodeSize, std::string *pKey)
+{
+    PipelineCreateInfo state = *pCreateInfo;
+
+    // dynamic states don't produce new permutations.
+    if (state.extendedDynamicState && extendedDynamicStateSupported) {
+        state.cullMode = VK_CULL_MODE_NONE;
+        state.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        state.topology = _TopologyClass(state.topology);
+        state.depthTestEnable = VK_FALSE;
+        state.depthWriteEnable = VK_FALSE;
+        state.depthCompareOp = VK_COMPARE_OP_NEVER;
+    }
+
+    _AppendKey(pKey, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    _AppendKey(pKey, state.renderPass);
+    _AppendKey(pKey, state.subpass);
+    _AppendKey(pKey, state.polygon);
+    _AppendKey(pKey, state.topology);
+    _AppendKey(pKey, state.cullMode);
+    _AppendKey(pKey, state.frontFace);
+    _AppendKey(pKey, state.samples);
+    _AppendKey(pKey, state.colorAttachmentCount);
+    _AppendKey(pKey, state.lineWidth);
+    _AppendKey(pKey, state.depthTestEnable);
+    _AppendKey(pKey, state.depthWriteEnable);
+    _AppendKey(pKey, state.depthCompareOp);
+    _AppendKey(pKey, state.blendEnable);
+    _AppendKey(pKey, state.srcColorBlendFactor);
+    _AppendKey(pKey, state.dstColorBlendFactor);
+    _AppendKey(pKey, state.colorBlendOp);
+    _AppendKey(pKey, state.srcAlphaBlendFactor);
+    _AppendKey(pKey, state.dstAlphaBlendFactor);
+    _AppendKey(pKey, state.alphaBlendOp);
+    _AppendKey(pKey, state.extendedDynamicState && extendedDynamicStateSupported);
+
+    _AppendKeyBytes(pKey, vertexBytecode, vertexBytecodeSize);
+    _AppendKeyBytes(pKey, fragmentBytecode, fragmentBytecodeSize);
+
+    // NULL and empty arrays are keyed differently, NULL means reflection.
+    _AppendKey(pKey, pShaderInfo->attributes != NULL);
+    _AppendKey(pKey, pShaderInfo->attributes ? pShaderInfo->attributeCount : pShaderInfo->instanceInputLocation);
+    for (uint32_t i = 0; pShaderInfo->attributes && i < pShaderInfo->attributeCount; i++) {
+        _AppendKey(pKey, pShaderInfo->attributes[i].location);
+        _AppendKey(pKey, pShaderInfo->attributes[i].binding);
+        _AppendKey(pKey, pShaderInfo->attributes[i].format);
+        _AppendKey(pKey, pShaderInfo->attributes[i].offset);
+    }
+
+    _AppendKey(pKey, pShaderInfo->binds != NULL);
+    _AppendKey(pKey, pShaderInfo->binds ? pShaderInfo->bindCount : 0);
+    for (uint32_t i = 0; pShaderInfo->binds && i < pShaderInfo->bindCount; i++) {
+        _AppendKey(pKey, pShaderInfo->binds[i].binding);
+        _AppendKey(pKey, pShaderInfo->binds[i].stride);
+        _AppendKey(pKey, pShaderInfo->binds[i].inputRate);
+    }
+
+    _AppendKey(pKey, pShaderInfo->pDescriptorSetLayouts != NULL);
+    if (pShaderInfo->pDescriptorSetLayouts)
+        _AppendKeyBytes(pKey, pShaderInfo->pDescriptorSetLayouts, sizeof(VkDescriptorSetLayout) * pShaderInfo->descriptorSetLayoutCount);
+
+    _AppendKey(pKey, pShaderInfo->pPushConstantRange != NULL);
+    if (pShaderInfo->pPushConstantRange)
+        _AppendKeyBytes(pKey, pShaderInfo->pPushConstantRange, sizeof(VkPushConstantRange) * pShaderInfo->pushConstantCount);
+
+    _AppendSpecializationConstantsKey(pShaderInfo->specializationConstantCount, pShaderInfo->pSpecializationConstants, pKey);
+}
+
+void RenderDevice::_BuildComputePipelineKey(const ComputeShaderInfo *pShaderInfo, const char *computeBytecode, size_t computeBytecodeSize, std::string *pKey)
+{
+    _AppendKey(pKey, VK_PIPELINE_BIND_POINT_COMPUTE);
+    _AppendKeyBytes(pKey, computeBytecode, computeBytecodeSize);
+
+    _AppendKey(pKey, pShaderInfo->pDescriptorSetLayouts != NULL);
+    if (pShaderInfo->pDescriptorSetLayouts)
+        _AppendKeyBytes(pKey, pShaderInfo->pDescriptorSetLayouts, sizeof(VkDescriptorSetLayout) * pShaderInfo->descriptorSetLayoutCount);
+
+    _AppendKey(pKey, pShaderInfo->pPushConstantRange != NULL);
+    if (pShaderInfo->pPushConstantRange)
+        _AppendKeyBytes(pKey, pShaderInfo->pPushConstantRange, sizeof(VkPushConstantRange) * pShaderInfo->pushConstantCount);
+
+    _AppendSpecializationConstantsKey(pShaderInfo->specializationConstantCount, pShaderInfo->pSpecializationConstants, pKey);
+}
+
+RenderDevice::PipelineHandle RenderDevice::_AcquireRegisteredPipeline(const std::string &key)
+{
+    uint64_t hash = hash_fnv1a64(std::data(key), std::size(key));
+
+    std::lock_guard<std::mutex> lock(pipelineRegistryMutex);
+
+    auto search = pipelineRegistry.find(hash);
+    if (search == pipelineRegistry.end())
+        return {};
+
+    Pipeline *pPipeline = pipelines.get(search->second);
+    if (pPipeline->key != key)
+        return {};
+
+    ++pPipeline->refcount;
+    return search->second;
+}
+
+RenderDevice::PipelineHandle RenderDevice::_RegisterPipeline(PipelineHandle pipeline)
+{
+    std::unique_lock<std::mutex> lock(pipelineRegistryMutex);
+    Pipeline *pPipeline = pipelines.get(pipeline);
+
+    pPipeline->refcount = 1;
+
+    // another thread may have built the same state meanwhile, keep theirs.
+    // A different key with the same hash stay unregistered.
+    auto search = pipelineRegistry.find(pPipeline->hash);
+    if (search != pipelineRegistry.end()) {
+        PipelineHandle registered = search->second;
+        Pipeline *pRegistered = pipelines.get(registered);
+        if (pRegistered->key != pPipeline->key)
+            return pipeline;
+
+        ++pRegistered->refcount;
+        lock.unlock();
+
+        _DestroyPipelineObjects(pPipeline);
+        pipelines.release(pipeline);
+
+        return registered;
+    }
+
+    pipelineRegistry.insert({ pPipeline->hash, pipeline });
+
     return pipeline;
 }
 
-void RenderDevice::DestroyPipeline(RenderDevice::Pipeline *pPipeline)
+void RenderDevice::_DestroyPipelineObjects(Pipeline *pPipeline)
 {
     vkDestroyPipelineLayout(device, pPipeline->layout, VK_NULL_HANDLE);
     vkDestroyPipeline(device, pPipeline->pipeline, VK_NULL_HANDLE);
@@ -679,14 +1545,27 @@ void RenderDevice::CmdBufferOneTimeEnd(VkCommandBuffer cmdBuffer)
 {
     CmdBufferEnd(cmdBuffer);
 
+    VkResult U_ASSERT_ONLY err;
+
+    VkFenceCreateInfo fence_create_info = {};
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    err = vkCreateFence(device, &fence_create_info, VK_NULL_HANDLE, &fence);
+    assert(!err);
+
     VkQueue graph_queue = rdc->GetQueue();
     CmdBufferSubmit(cmdBuffer,
         0, VK_NULL_HANDLE,
         0, VK_NULL_HANDLE,
         VK_NULL_HANDLE,
         graph_queue,
-        VK_NULL_HANDLE);
-    vkQueueWaitIdle(graph_queue);
+        fence);
+
+    // only this submit, outside the queue lock, a frame in flight on the
+    // render thread is not waited on.
+    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+    vkDestroyFence(device, fence, VK_NULL_HANDLE);
 
     FreeCommandBuffer(cmdBuffer);
 }
@@ -708,20 +1587,47 @@ void RenderDevice::CmdBeginRenderPass(VkCommandBuffer cmdBuffer, VkRenderPass re
 
 void RenderDevice::CmdPipelineBarrier(VkCommandBuffer cmdBuffer, const RenderDevice::PipelineMemoryBarrier *pPipelineMemoryBarrier)
 {
-    VkImageMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.srcAccessMask = pPipelineMemoryBarrier->image.srcAccessMask;
-    barrier.dstAccessMask = pPipelineMemoryBarrier->image.dstAccessMask;
-    barrier.oldLayout = pPipelineMemoryBarrier->image.oldImageLayout;
-    barrier.newLayout = pPipelineMemoryBarrier->image.newImageLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = pPipelineMemoryBarrier->image.texture->image;
-    barrier.subresourceRange.aspectMask = pPipelineMemoryBarrier->image.texture->aspectMask;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    uint32_t imageBarrierCount = 0;
+    VkImageMemoryBarrier imageBarrier = {};
+    Texture2D *texture = VK_NULL_HANDLE;
+
+    if (pPipelineMemoryBarrier->image.texture) {
+        texture = textures.get(pPipelineMemoryBarrier->image.texture);
+        assert(texture);
+
+        imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrier.srcAccessMask = pPipelineMemoryBarrier->image.srcAccessMask;
+        imageBarrier.dstAccessMask = pPipelineMemoryBarrier->image.dstAccessMask;
+        imageBarrier.oldLayout = pPipelineMemoryBarrier->image.oldImageLayout;
+        imageBarrier.newLayout = pPipelineMemoryBarrier->image.newImageLayout;
+        imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrier.image = texture->image;
+        imageBarrier.subresourceRange.aspectMask = texture->aspectMask;
+        imageBarrier.subresourceRange.baseMipLevel = pPipelineMemoryBarrier->image.baseMipLevel;
+        imageBarrier.subresourceRange.levelCount = pPipelineMemoryBarrier->image.levelCount;
+        imageBarrier.subresourceRange.baseArrayLayer = pPipelineMemoryBarrier->image.baseArrayLayer;
+        imageBarrier.subresourceRange.layerCount = pPipelineMemoryBarrier->image.layerCount;
+        imageBarrierCount = 1;
+    }
+
+    uint32_t bufferBarrierCount = 0;
+    VkBufferMemoryBarrier bufferBarrier = {};
+
+    if (pPipelineMemoryBarrier->buffer.buffer) {
+        Buffer *buffer = buffers.get(pPipelineMemoryBarrier->buffer.buffer);
+        assert(buffer);
+
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = pPipelineMemoryBarrier->buffer.srcAccessMask;
+        bufferBarrier.dstAccessMask = pPipelineMemoryBarrier->buffer.dstAccessMask;
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = buffer->vkBuffer;
+        bufferBarrier.offset = pPipelineMemoryBarrier->buffer.offset;
+        bufferBarrier.size = pPipelineMemoryBarrier->buffer.size;
+        bufferBarrierCount = 1;
+    }
 
     vkCmdPipelineBarrier(
             cmdBuffer,
@@ -729,11 +1635,12 @@ void RenderDevice::CmdPipelineBarrier(VkCommandBuffer cmdBuffer, const RenderDev
             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
             0,
             0, VK_NULL_HANDLE,
-            0, VK_NULL_HANDLE,
-            1, &barrier
+            bufferBarrierCount, &bufferBarrier,
+            imageBarrierCount, &imageBarrier
     );
 
-    pPipelineMemoryBarrier->image.texture->imageLayout = barrier.newLayout;
+    if (texture)
+        texture->imageLayout = imageBarrier.newLayout;
 }
 
 void RenderDevice::CmdEndRenderPass(VkCommandBuffer cmdBuffer)
@@ -741,33 +1648,104 @@ void RenderDevice::CmdEndRenderPass(VkCommandBuffer cmdBuffer)
     vkCmdEndRenderPass(cmdBuffer);
 }
 
-void RenderDevice::CmdBindVertexBuffer(VkCommandBuffer cmdBuffer, RenderDevice::Buffer *buffer)
+void RenderDevice::CmdBindVertexBuffer(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset)
 {
-    VkBuffer buffers[] = { buffer->vkBuffer };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(cmdBuffer, 0, ARRAY_SIZE(buffers), buffers, offsets);
+    VkBuffer vertexBuffers[] = { buffers.get(buffer)->vkBuffer };
+    VkDeviceSize offsets[] = { offset };
+    vkCmdBindVertexBuffers(cmdBuffer, 0, ARRAY_SIZE(vertexBuffers), vertexBuffers, offsets);
 }
 
-void RenderDevice::CmdBindIndexBuffer(VkCommandBuffer cmdBuffer, VkIndexType type, RenderDevice::Buffer *buffer)
+void RenderDevice::CmdBindVertexBuffers(VkCommandBuffer cmdBuffer, uint32_t firstBinding, uint32_t bindingCount, const BufferHandle *pBuffers, const VkDeviceSize *pOffsets)
 {
-    vkCmdBindIndexBuffer(cmdBuffer, buffer->vkBuffer, 0, type);
+    VkBuffer vertexBuffers[RENDER_DEVICE_MAX_VERTEX_BINDINGS];
+    VkDeviceSize offsets[RENDER_DEVICE_MAX_VERTEX_BINDINGS];
+    assert(bindingCount <= RENDER_DEVICE_MAX_VERTEX_BINDINGS);
+
+    for (uint32_t i = 0; i < bindingCount; i++) {
+        vertexBuffers[i] = buffers.get(pBuffers[i])->vkBuffer;
+        offsets[i] = pOffsets ? pOffsets[i] : 0;
+    }
+
+    vkCmdBindVertexBuffers(cmdBuffer, firstBinding, bindingCount, vertexBuffers, offsets);
+}
+
+void RenderDevice::CmdBindIndexBuffer(VkCommandBuffer cmdBuffer, VkIndexType type, BufferHandle buffer, VkDeviceSize offset)
+{
+    vkCmdBindIndexBuffer(cmdBuffer, buffers.get(buffer)->vkBuffer, offset, type);
+}
+
+void RenderDevice::CmdDraw(VkCommandBuffer cmdBuffer, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+    vkCmdDraw(cmdBuffer, vertexCount, instanceCount, firstVertex, firstInstance);
 }
 
-void RenderDevice::CmdDraw(VkCommandBuffer cmdBuffer, uint32_t vertexCount)
+void RenderDevice::CmdDrawIndexed(VkCommandBuffer cmdBuffer, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance)
 {
-    vkCmdDraw(cmdBuffer, vertexCount, 1, 0, 0);
+    vkCmdDrawIndexed(cmdBuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
 }
 
-void RenderDevice::CmdDrawIndexed(VkCommandBuffer cmdBuffer, uint32_t indexCount)
+void RenderDevice::CmdDrawIndirect(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
 {
-    vkCmdDrawIndexed(cmdBuffer, indexCount, 1, 0, 0, 0);
+    VkBuffer vkBuffer = buffers.get(buffer)->vkBuffer;
+
+    if (drawCount <= 1 || IsMultiDrawIndirectSupported()) {
+        vkCmdDrawIndirect(cmdBuffer, vkBuffer, offset, drawCount, stride);
+        return;
+    }
+
+    for (uint32_t i = 0; i < drawCount; i++)
+        vkCmdDrawIndirect(cmdBuffer, vkBuffer, offset + (VkDeviceSize) i * stride, 1, stride);
+}
+
+void RenderDevice::CmdDrawIndexedIndirect(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride)
+{
+    VkBuffer vkBuffer = buffers.get(buffer)->vkBuffer;
+
+    if (drawCount <= 1 || IsMultiDrawIndirectSupported()) {
+        vkCmdDrawIndexedIndirect(cmdBuffer, vkBuffer, offset, drawCount, stride);
+        return;
+    }
+
+    for (uint32_t i = 0; i < drawCount; i++)
+        vkCmdDrawIndexedIndirect(cmdBuffer, vkBuffer, offset + (VkDeviceSize) i * stride, 1, stride);
 }
 
-void RenderDevice::CmdBindPipeline(VkCommandBuffer cmdBuffer, RenderDevice::Pipeline *pPipeline)
+void RenderDevice::CmdDrawIndirectCount(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, BufferHandle countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride)
 {
+    if (!IsDrawIndirectCountSupported()) {
+        CmdDrawIndirect(cmdBuffer, buffer, offset, maxDrawCount, stride);
+        return;
+    }
+
+    vkCmdDrawIndirectCount(cmdBuffer, buffers.get(buffer)->vkBuffer, offset, buffers.get(countBuffer)->vkBuffer, countOffset, maxDrawCount, stride);
+}
+
+void RenderDevice::CmdDrawIndexedIndirectCount(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, BufferHandle countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride)
+{
+    if (!IsDrawIndirectCountSupported()) {
+        CmdDrawIndexedIndirect(cmdBuffer, buffer, offset, maxDrawCount, stride);
+        return;
+    }
+
+    vkCmdDrawIndexedIndirectCount(cmdBuffer, buffers.get(buffer)->vkBuffer, offset, buffers.get(countBuffer)->vkBuffer, countOffset, maxDrawCount, stride);
+}
+
+void RenderDevice::CmdBindPipeline(VkCommandBuffer cmdBuffer, PipelineHandle pipeline)
+{
+    Pipeline *pPipeline = pipelines.get(pipeline);
     vkCmdBindPipeline(cmdBuffer, pPipeline->bindPoint, pPipeline->pipeline);
 }
 
+void RenderDevice::CmdFillBuffer(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data)
+{
+    vkCmdFillBuffer(cmdBuffer, buffers.get(buffer)->vkBuffer, offset, size, data);
+}
+
+void RenderDevice::CmdDispatch(VkCommandBuffer cmdBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+    vkCmdDispatch(cmdBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
 void RenderDevice::CmdBufferSubmit(VkCommandBuffer cmdBuffer, uint32_t waitSemaphoreCount, VkSemaphore *pWaitSemaphores, uint32_t signalSemaphoreCount, VkSemaphore *pSignalSemaphores, VkPipelineStageFlags *pMask, VkQueue queue, VkFence fence)
 {
     VkResult U_ASSERT_ONLY err;
@@ -788,12 +1766,14 @@ void RenderDevice::CmdBufferSubmit(VkCommandBuffer cmdBuffer, uint32_t waitSemap
             /* pSignalSemaphores */ pSignalSemaphores,
     };
 
+    std::lock_guard<std::mutex> lock(rdc->GetQueueMutex());
     err = vkQueueSubmit(queue, 1, &submit_info, fence);
     assert(!err);
 }
 
-void RenderDevice::CmdBindDescriptorSet(VkCommandBuffer cmdBuffer, RenderDevice::Pipeline *pPipeline, VkDescriptorSet descriptor)
+void RenderDevice::CmdBindDescriptorSet(VkCommandBuffer cmdBuffer, PipelineHandle pipeline, VkDescriptorSet descriptor)
 {
+    Pipeline *pPipeline = pipelines.get(pipeline);
     vkCmdBindDescriptorSets(cmdBuffer, pPipeline->bindPoint, pPipeline->layout, 0, 1, &descriptor, 0, VK_NULL_HANDLE);
 }
 
@@ -814,9 +1794,39 @@ void RenderDevice::CmdSetViewport(VkCommandBuffer cmdBuffer, uint32_t w, uint32_
     vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 }
 
-void RenderDevice::CmdPushConstant(VkCommandBuffer cmdBuffer, RenderDevice::Pipeline *pipeline, VkShaderStageFlags shaderStageFlags, uint32_t offset, uint32_t size, void *pValues)
+void RenderDevice::CmdSetCullMode(VkCommandBuffer cmdBuffer, VkCullModeFlags cullMode)
+{
+    vkCmdSetCullMode(cmdBuffer, cullMode);
+}
+
+void RenderDevice::CmdSetFrontFace(VkCommandBuffer cmdBuffer, VkFrontFace frontFace)
+{
+    vkCmdSetFrontFace(cmdBuffer, frontFace);
+}
+
+void RenderDevice::CmdSetPrimitiveTopology(VkCommandBuffer cmdBuffer, VkPrimitiveTopology topology)
+{
+    vkCmdSetPrimitiveTopology(cmdBuffer, topology);
+}
+
+void RenderDevice::CmdSetDepthTestEnable(VkCommandBuffer cmdBuffer, VkBool32 depthTestEnable)
+{
+    vkCmdSetDepthTestEnable(cmdBuffer, depthTestEnable);
+}
+
+void RenderDevice::CmdSetDepthWriteEnable(VkCommandBuffer cmdBuffer, VkBool32 depthWriteEnable)
+{
+    vkCmdSetDepthWriteEnable(cmdBuffer, depthWriteEnable);
+}
+
+void RenderDevice::CmdSetDepthCompareOp(VkCommandBuffer cmdBuffer, VkCompareOp depthCompareOp)
+{
+    vkCmdSetDepthCompareOp(cmdBuffer, depthCompareOp);
+}
+
+void RenderDevice::CmdPushConstant(VkCommandBuffer cmdBuffer, PipelineHandle pipeline, VkShaderStageFlags shaderStageFlags, uint32_t offset, uint32_t size, void *pValues)
 {
-    vkCmdPushConstants(cmdBuffer, pipeline->layout, shaderStageFlags, offset, size, pValues);
+    vkCmdPushConstants(cmdBuffer, pipelines.get(pipeline)->layout, shaderStageFlags, offset, size, pValues);
 }
 
 void RenderDevice::Present(VkQueue queue, VkSwapchainKHR swapchain, uint32_t index, VkSemaphore waitSemaphore)
@@ -832,6 +1842,6 @@ void RenderDevice::Present(VkQueue queue, VkSwapchainKHR swapchain, uint32_t ind
             /* pResults */ VK_NULL_HANDLE,
     };
 
+    std::lock_guard<std::mutex> lock(rdc->GetQueueMutex());
     vkQueuePresentKHR(queue, &present_info);
-    vkQueueWaitIdle(queue);
 }
\ No newline at end of file
@@ -24,7 +24,19 @@
 #define _RENDERING_DEVICE_DRIVER_VULKAN_H
 
 #include "RenderDeviceContext.h"
+#include "SpirvReflection.h"
+#include <Bright/HandlePool.h>
 #include <vector>
+#include <unordered_map>
+#include <map>
+#include <mutex>
+#include <string>
+
+#define RENDER_DEVICE_MAX_DESCRIPTOR_SETS 4
+#define RENDER_DEVICE_MAX_VERTEX_BINDINGS 16
+#define RENDER_DEVICE_FULL_MIP_CHAIN (~0U)
+
+class GPUProfiler;
 
 class RenderDevice {
 public:
@@ -33,20 +45,36 @@ public:
 
     RenderDeviceContext *GetDeviceContext() { return rdc; }
     VkDescriptorPool GetDescriptorPool() { return descriptorPool; }
+    VkPipelineCache GetPipelineCache() { return pipelineCache; }
     VkFormat GetSurfaceFormat() { return rdc->GetWindowFormat(); }
     VkSampleCountFlagBits GetMSAASampleCounts() { return msaaSampleCounts; }
+    GPUProfiler *GetGPUProfiler() { return profiler; }
+    // time one time upload submits with the profiler, NULL to disable.
+    void SetGPUProfiler(GPUProfiler *pProfiler) { profiler = pProfiler; }
 
     struct Buffer {
         VkBuffer vkBuffer;
+        VkBufferUsageFlags usage;
         VkDeviceSize size;
         VmaAllocation allocation;
         VmaAllocationInfo allocationInfo;
     };
 
-    Buffer *CreateBuffer(VkBufferUsageFlags usage, VkDeviceSize size);
-    void DestroyBuffer(Buffer *buffer);
-    void WriteBuffer(Buffer *buffer, VkDeviceSize offset, VkDeviceSize size, void *buf);
-    void ReadBuffer(Buffer *buffer, VkDeviceSize offset, VkDeviceSize size, void *buf);
+    // resources are handed out as generational handles into the device
+    // pools, Get* return NULL for a destroyed (stale) handle.
+    typedef handle<Buffer> BufferHandle;
+
+    // buffers only written by the GPU (culling output, indirect commands)
+    // should use VMA_MEMORY_USAGE_GPU_ONLY, they can't be Write/ReadBuffer.
+    BufferHandle CreateBuffer(VkBufferUsageFlags usage, VkDeviceSize size, VmaMemoryUsage memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU);
+    void DestroyBuffer(BufferHandle buffer);
+    void WriteBuffer(BufferHandle buffer, VkDeviceSize offset, VkDeviceSize size, void *buf);
+    void ReadBuffer(BufferHandle buffer, VkDeviceSize offset, VkDeviceSize size, void *buf);
+    Buffer *GetBuffer(BufferHandle buffer) { return buffers.get(buffer); }
+    uint32_t GetBufferCount() { return buffers.size(); }
+    // walk every live buffer in pool order, fn(BufferHandle, Buffer *).
+    template<typename F>
+    void ForEachBuffer(F fn) { buffers.for_each(fn); }
 
     void CreateRenderPass(uint32_t attachmentCount, VkAttachmentDescription *pAttachments, uint32_t subpassCount, VkSubpassDescription *pSubpass, uint32_t dependencyCount, VkSubpassDependency *pDependencies, VkRenderPass *pRenderPass);
     void DestroyRenderPass(VkRenderPass renderPass);
@@ -62,12 +90,26 @@ public:
         VmaAllocationInfo allocationInfo;
         uint32_t width;
         uint32_t height;
+        uint32_t mipLevels;
+        uint32_t arrayLayers;
         VkFormat format;
+        /* image parameters, kept to recreate the image when it is moved */
+        VkImageCreateFlags createFlags;
+        VkImageType imageType;
+        VkImageViewType imageViewType;
+        VkSampleCountFlagBits samples;
+        VkImageUsageFlags usage;
         VkSampler sampler = VK_NULL_HANDLE;
         VkImageAspectFlags aspectMask;
         size_t size = 0;
+        /* first mip of the image view, levels above it are not sampled */
+        uint32_t baseMipLevel = 0;
     };
 
+    typedef handle<Texture2D> TextureHandle;
+
+    // mipLevels accept RENDER_DEVICE_FULL_MIP_CHAIN, cube views need
+    // arrayLayers to be a multiple of 6.
     struct TextureCreateInfo {
         uint32_t width;
         uint32_t height;
@@ -77,32 +119,91 @@ public:
         VkImageType imageType;
         VkImageViewType imageViewType;
         VkImageUsageFlags usage;
+        uint32_t mipLevels = 1;
+        uint32_t arrayLayers = 1;
     };
 
-    Texture2D *CreateTexture(TextureCreateInfo *pCreateInfo);
-    void DestroyTexture(Texture2D *p_texture);
-    void WriteTexture(Texture2D *texture, size_t size, void *pixels);
+    static uint32_t CalculateMipLevels(uint32_t width, uint32_t height);
+
+    TextureHandle CreateTexture(TextureCreateInfo *pCreateInfo);
+    void DestroyTexture(TextureHandle texture);
+    // create the view of the texture image from baseMipLevel, replacing a
+    // destroyed one.
+    void CreateTextureImageView(TextureHandle texture);
+    // write mip 0 of every layer (layers are consecutive in pixels), the
+    // rest of the mip chain is generated on the GPU.
+    void WriteTexture(TextureHandle texture, size_t size, void *pixels);
+    // blit support of the format, without it a chain can't be generated and
+    // the texture should be created with a single level.
+    bool IsMipmapGenerationSupported(VkFormat format);
+    // record nothing and return FAIL when the format can't be blit.
+    Error CmdGenerateMipmaps(VkCommandBuffer cmdBuffer, TextureHandle texture);
+    Texture2D *GetTexture(TextureHandle texture) { return textures.get(texture); }
+    uint32_t GetTextureCount() { return textures.size(); }
+    // walk every live texture in pool order, fn(TextureHandle, Texture2D *).
+    template<typename F>
+    void ForEachTexture(F fn) { textures.for_each(fn); }
+
+    // one copy per mip level and layer range, offset point into data and
+    // must be aligned to the texel block size.
+    struct TextureRegion {
+        uint32_t mipLevel;
+        uint32_t baseArrayLayer;
+        uint32_t layerCount;
+        size_t offset;
+    };
+
+    // upload every region through a single staging buffer and submit.
+    void WriteTextureRegions(TextureHandle texture, size_t size, void *data, uint32_t regionCount, const TextureRegion *pRegions);
     void CreateFramebuffer(uint32_t width, uint32_t height, uint32_t image_view_count, VkImageView *p_image_view, VkRenderPass renderPass, VkFramebuffer *p_framebuffer);
     void DestroyFramebuffer(VkFramebuffer framebuffer);
 
+    // defaults sample level 0 only, mipmapped textures opt in with maxLod
+    // and anisotropy. anisotropy is clamped to the device limit and ignored
+    // when the device doesn't support it.
     struct SamplerCreateInfo {
         VkSamplerAddressMode u = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         VkSamplerAddressMode v = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         VkSamplerAddressMode w = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         VkBorderColor border_color = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        VkFilter filter = VK_FILTER_LINEAR;
+        VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        float mipLodBias = 0.0f;
+        float minLod = 0.0f;
+        float maxLod = 0.0f;
+        VkBool32 anisotropyEnable = VK_FALSE;
+        float maxAnisotropy = 16.0f;
     };
 
     void CreateSampler(SamplerCreateInfo* pCreateInfo, VkSampler *p_sampler);
     void DestroySampler(VkSampler sampler);
-    void BindTextureSampler(Texture2D *texture, VkSampler sampler);
+    void BindTextureSampler(TextureHandle texture, VkSampler sampler);
 
     void CreateDescriptorSetLayout(uint32_t bindingCount, VkDescriptorSetLayoutBinding *pBindings, VkDescriptorSetLayout *pDescriptorSetLayout);
     void DestroyDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout);
+    // layouts returned from cache are owned by render device, don't destroy them.
+    VkDescriptorSetLayout AcquireDescriptorSetLayout(uint32_t bindingCount, const VkDescriptorSetLayoutBinding *pBindings);
     void AllocateDescriptorSet(VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet *pDescriptorSet);
     void FreeDescriptorSet(VkDescriptorSet descriptorSet);
-    void UpdateDescriptorSetBuffer(Buffer *buffer, uint32_t binding, VkDescriptorSet descriptorSet);
-    void UpdateDescriptorSetImage(Texture2D *texture, uint32_t binding, VkDescriptorSet descriptorSet);
+    // written as a storage buffer when the buffer has the storage usage and
+    // not the uniform one.
+    void UpdateDescriptorSetBuffer(BufferHandle buffer, uint32_t binding, VkDescriptorSet descriptorSet);
+    void UpdateDescriptorSetImage(TextureHandle texture, uint32_t binding, VkDescriptorSet descriptorSet);
+    // descriptors written by UpdateDescriptorSet* are remembered per handle,
+    // rewrite them after the resource Vulkan objects were replaced.
+    void RefreshDescriptorReferences(BufferHandle buffer);
+    void RefreshDescriptorReferences(TextureHandle texture);
+
+    // constant_id value for the given stages, value holds the raw 32 bit
+    // of bool (VkBool32), int, uint or float constants.
+    struct SpecializationConstant {
+        uint32_t constantID;
+        VkShaderStageFlags stageFlags;
+        uint32_t value;
+    };
 
+    // any of attributes, pDescriptorSetLayouts or pPushConstantRange left
+    // NULL is derived from the SPIR-V reflection of the loaded shaders.
     struct ShaderInfo {
         const char *vertex = NULL;
         const char *fragment = NULL;
@@ -114,6 +215,11 @@ public:
         VkDescriptorSetLayout *pDescriptorSetLayouts = NULL;
         uint32_t pushConstantCount = 0;
         VkPushConstantRange *pPushConstantRange = NULL;
+        uint32_t specializationConstantCount = 0;
+        SpecializationConstant *pSpecializationConstants = NULL;
+        // reflected layouts only, inputs from this location on are packed
+        // in binding 1 at instance rate instead of binding 0.
+        uint32_t instanceInputLocation = UINT32_MAX;
     };
 
     struct ComputeShaderInfo {
@@ -122,68 +228,188 @@ public:
         VkDescriptorSetLayout *pDescriptorSetLayouts = NULL;
         uint32_t pushConstantCount = 0;
         VkPushConstantRange *pPushConstantRange = NULL;
+        uint32_t specializationConstantCount = 0;
+        SpecializationConstant *pSpecializationConstants = NULL;
     };
 
+    // with extendedDynamicState cull mode, front face, topology (within
+    // the same topology class) and depth test/write/compare are dynamic,
+    // they are left out of the pipeline hash and must be set with the
+    // CmdSet* functions after binding the pipeline.
     struct PipelineCreateInfo {
         VkRenderPass renderPass;
+        uint32_t subpass = 0;
         VkPolygonMode polygon;
         VkPrimitiveTopology topology;
         VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+        VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
         VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+        // 0 for depth only passes.
+        uint32_t colorAttachmentCount = 1;
         float lineWidth = 1.0f;
+        VkBool32 depthTestEnable = VK_TRUE;
+        VkBool32 depthWriteEnable = VK_TRUE;
+        VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
         VkBool32 blendEnable = VK_FALSE;
         VkBlendFactor srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
         VkBlendFactor dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+        VkBlendOp colorBlendOp = VK_BLEND_OP_ADD;
+        VkBlendFactor srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        VkBlendFactor dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        VkBlendOp alphaBlendOp = VK_BLEND_OP_ADD;
+        VkBool32 extendedDynamicState = VK_FALSE;
     };
 
+    // pipelines are shared through the registry, every Create* must be
+    // paired with a DestroyPipeline, the last one destroy it for real.
     struct Pipeline {
         VkPipeline pipeline;
         VkPipelineLayout layout;
         VkPipelineBindPoint bindPoint;
+        uint32_t descriptorSetLayoutCount;
+        VkDescriptorSetLayout descriptorSetLayouts[RENDER_DEVICE_MAX_DESCRIPTOR_SETS];
+        VkPushConstantRange pushConstantRange;
+        uint64_t hash;
+        /* everything hashed, compared on a registry hit */
+        std::string key;
+        uint32_t refcount;
     };
 
-    Pipeline *CreateGraphicsPipeline(PipelineCreateInfo *pCreateInfo, ShaderInfo *pShaderInfo);
-    Pipeline *CreateComputePipeline(ComputeShaderInfo *pShaderInfo);
-    void DestroyPipeline(Pipeline *pPipeline);
+    typedef handle<Pipeline> PipelineHandle;
+
+    // null handle when the SPIR-V can't be reflected.
+    PipelineHandle CreateGraphicsPipeline(PipelineCreateInfo *pCreateInfo, ShaderInfo *pShaderInfo);
+    PipelineHandle CreateComputePipeline(ComputeShaderInfo *pShaderInfo);
+    void DestroyPipeline(PipelineHandle pipeline);
+    Pipeline *GetPipeline(PipelineHandle pipeline) { return pipelines.get(pipeline); }
+    uint32_t GetRegisteredPipelineCount();
+    bool IsExtendedDynamicStateSupported() { return extendedDynamicStateSupported; }
+
+    // pipelineStatistics is only read for VK_QUERY_TYPE_PIPELINE_STATISTICS.
+    void CreateQueryPool(VkQueryType queryType, uint32_t queryCount, VkQueryPipelineStatisticFlags pipelineStatistics, VkQueryPool *pQueryPool);
+    void DestroyQueryPool(VkQueryPool queryPool);
+    bool IsPipelineStatisticsSupported() { return rdc->GetPhysicalDeviceFeatures().pipelineStatisticsQuery; }
+    bool IsMultiDrawIndirectSupported() { return rdc->GetPhysicalDeviceFeatures().multiDrawIndirect; }
+    bool IsDrawIndirectCountSupported() { return rdc->IsDrawIndirectCountSupported(); }
+
+    struct PerformanceCounter {
+        std::string name;
+        std::string category;
+        std::string description;
+        VkPerformanceCounterUnitKHR unit;
+    };
+
+    // hardware counters of the graphics queue family, empty when the
+    // device doesn't expose VK_KHR_performance_query.
+    void EnumeratePerformanceCounters(std::vector<PerformanceCounter> *pCounters);
 
     void CmdBufferBegin(VkCommandBuffer cmdBuffer, VkCommandBufferUsageFlags usage);
     void CmdBufferEnd(VkCommandBuffer cmdBuffer);
     void CmdBufferOneTimeBegin(VkCommandBuffer *pCmdBuffer);
     void CmdBufferOneTimeEnd(VkCommandBuffer cmdBuffer);
 
+    // image and/or buffer barrier, the part whose handle is left empty is
+    // skipped.
     struct PipelineMemoryBarrier {
         struct {
-            Texture2D *texture = VK_NULL_HANDLE;
+            TextureHandle texture;
+            uint32_t baseMipLevel = 0;
+            uint32_t levelCount = VK_REMAINING_MIP_LEVELS;
+            uint32_t baseArrayLayer = 0;
+            uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS;
             VkImageLayout oldImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             VkImageLayout newImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             VkAccessFlags srcAccessMask = 0;
             VkAccessFlags dstAccessMask = 0;
         } image;
+        struct {
+            BufferHandle buffer;
+            VkDeviceSize offset = 0;
+            VkDeviceSize size = VK_WHOLE_SIZE;
+            VkAccessFlags srcAccessMask = 0;
+            VkAccessFlags dstAccessMask = 0;
+        } buffer;
     };
 
     void CmdPipelineBarrier(VkCommandBuffer cmdBuffer, const PipelineMemoryBarrier *pPipelineMemoryBarrier);
 
     void CmdBeginRenderPass(VkCommandBuffer cmdBuffer, VkRenderPass renderPass, uint32_t clearValueCount, VkClearValue *pClearValues, VkFramebuffer framebuffer, VkRect2D *pRect2D);
     void CmdEndRenderPass(VkCommandBuffer cmdBuffer);
-    void CmdBindVertexBuffer(VkCommandBuffer cmdBuffer, Buffer *buffer);
-    void CmdBindIndexBuffer(VkCommandBuffer cmdBuffer, VkIndexType type, Buffer *buffer);
-    void CmdDraw(VkCommandBuffer cmdBuffer, uint32_t vertexCount);
-    void CmdDrawIndexed(VkCommandBuffer cmdBuffer, uint32_t indexCount);
-    void CmdBindPipeline(VkCommandBuffer cmdBuffer, Pipeline *pPipeline);
+    void CmdBindVertexBuffer(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset = 0);
+    // pOffsets may be NULL to bind every buffer from its start.
+    void CmdBindVertexBuffers(VkCommandBuffer cmdBuffer, uint32_t firstBinding, uint32_t bindingCount, const BufferHandle *pBuffers, const VkDeviceSize *pOffsets);
+    void CmdBindIndexBuffer(VkCommandBuffer cmdBuffer, VkIndexType type, BufferHandle buffer, VkDeviceSize offset = 0);
+    void CmdDraw(VkCommandBuffer cmdBuffer, uint32_t vertexCount, uint32_t instanceCount = 1, uint32_t firstVertex = 0, uint32_t firstInstance = 0);
+    void CmdDrawIndexed(VkCommandBuffer cmdBuffer, uint32_t indexCount, uint32_t instanceCount = 1, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t firstInstance = 0);
+    // buffer holds VkDraw(Indexed)IndirectCommand, created with the indirect
+    // usage. Without multiDrawIndirect the draws are issued one by one.
+    void CmdDrawIndirect(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride = sizeof(VkDrawIndirectCommand));
+    void CmdDrawIndexedIndirect(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride = sizeof(VkDrawIndexedIndirectCommand));
+    // draw count is read from countBuffer (a uint32_t) on the GPU. When
+    // drawIndirectCount is missing maxDrawCount draws are issued, whoever
+    // write the commands must zero the instanceCount of the unused ones.
+    void CmdDrawIndirectCount(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, BufferHandle countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride = sizeof(VkDrawIndirectCommand));
+    void CmdDrawIndexedIndirectCount(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, BufferHandle countBuffer, VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride = sizeof(VkDrawIndexedIndirectCommand));
+    void CmdBindPipeline(VkCommandBuffer cmdBuffer, PipelineHandle pipeline);
+    // outside of a render pass only, size and offset are multiples of 4.
+    void CmdFillBuffer(VkCommandBuffer cmdBuffer, BufferHandle buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t data);
+    void CmdDispatch(VkCommandBuffer cmdBuffer, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
     void CmdBufferSubmit(VkCommandBuffer cmdBuffer, uint32_t waitSemaphoreCount, VkSemaphore *pWaitSemaphores, uint32_t signalSemaphoreCount, VkSemaphore *pSignalSemaphores, VkPipelineStageFlags *pMask, VkQueue queue, VkFence fence);
-    void CmdBindDescriptorSet(VkCommandBuffer cmdBuffer, Pipeline *pPipeline, VkDescriptorSet descriptor);
+    void CmdBindDescriptorSet(VkCommandBuffer cmdBuffer, PipelineHandle pipeline, VkDescriptorSet descriptor);
     void CmdSetViewport(VkCommandBuffer cmdBuffer , uint32_t w, uint32_t h);
-    void CmdPushConstant(VkCommandBuffer cmdBuffer, RenderDevice::Pipeline *pipeline, VkShaderStageFlags shaderStageFlags, uint32_t offset, uint32_t size, void *pValues);
+    void CmdSetCullMode(VkCommandBuffer cmdBuffer, VkCullModeFlags cullMode);
+    void CmdSetFrontFace(VkCommandBuffer cmdBuffer, VkFrontFace frontFace);
+    void CmdSetPrimitiveTopology(VkCommandBuffer cmdBuffer, VkPrimitiveTopology topology);
+    void CmdSetDepthTestEnable(VkCommandBuffer cmdBuffer, VkBool32 depthTestEnable);
+    void CmdSetDepthWriteEnable(VkCommandBuffer cmdBuffer, VkBool32 depthWriteEnable);
+    void CmdSetDepthCompareOp(VkCommandBuffer cmdBuffer, VkCompareOp depthCompareOp);
+    void CmdPushConstant(VkCommandBuffer cmdBuffer, PipelineHandle pipeline, VkShaderStageFlags shaderStageFlags, uint32_t offset, uint32_t size, void *pValues);
     void Present(VkQueue queue, VkSwapchainKHR swapchain, uint32_t index, VkSemaphore waitSemaphore);
 
 private:
+    struct CachedDescriptorSetLayout {
+        /* pImmutableSamplers are cleared, the samplers are flattened in order */
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        std::vector<VkSampler> immutableSamplers;
+        VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    };
+
     void _InitializeDescriptorPool();
+    void _InitializePipelineCache();
+    void _ReflectDescriptorSetLayouts(uint32_t reflectionCount, const ShaderReflection *pReflections, uint32_t *pDescriptorSetLayoutCount, VkDescriptorSetLayout *pDescriptorSetLayouts);
+    uint32_t _ReflectPushConstantRange(uint32_t reflectionCount, const ShaderReflection *pReflections, VkPushConstantRange *pPushConstantRange);
+    void _AppendSpecializationConstantsKey(uint32_t count, const SpecializationConstant *pConstants, std::string *pKey);
+    void _BuildGraphicsPipelineKey(const PipelineCreateInfo *pCreateInfo, const ShaderInfo *pShaderInfo, const char *vertexBytecode, size_t vertexBytecodeSize,
+                                   const char *fragmentBytecode, size_t fragmentBytecodeSize, std::string *pKey);
+    void _BuildComputePipelineKey(const ComputeShaderInfo *pShaderInfo, const char *computeBytecode, size_t computeBytecodeSize, std::string *pKey);
+    PipelineHandle _AcquireRegisteredPipeline(const std::string &key);
+    static bool _IsSameDescriptorSetLayout(const CachedDescriptorSetLayout &a, const CachedDescriptorSetLayout &b);
+    PipelineHandle _RegisterPipeline(PipelineHandle pipeline);
+    void _DestroyPipelineObjects(Pipeline *pPipeline);
 
     RenderDeviceContext *rdc;
     VkDevice device;
     VmaAllocator allocator;
     VkDescriptorPool descriptorPool;
+    VkPipelineCache pipelineCache;
     VkSampleCountFlagBits msaaSampleCounts;
+    handle_pool<Buffer> buffers;
+    handle_pool<Texture2D> textures;
+    handle_pool<Pipeline> pipelines;
+    std::mutex descriptorSetLayoutCacheMutex;
+    std::unordered_map<uint64_t, std::vector<CachedDescriptorSetLayout>> descriptorSetLayoutCache;
+
+    struct DescriptorReference {
+        bool image;
+        uint32_t handle;
+    };
+
+    std::mutex descriptorReferenceMutex;
+    std::map<std::pair<VkDescriptorSet, uint32_t>, DescriptorReference> descriptorReferences;
+    std::mutex pipelineRegistryMutex;
+    std::unordered_map<uint64_t, PipelineHandle> pipelineRegistry;
+    bool extendedDynamicStateSupported = false;
+    GPUProfiler *profiler = NULL;
 };
 
 #endif /* _RENDERING_DEVICE_DRIVER_VULKAN_H */
\ No newline at end of file
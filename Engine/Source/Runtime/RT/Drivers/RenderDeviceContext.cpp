@@ -22,6 +22,7 @@
 /* ======================================================================== */
 #include "RenderDeviceContext.h"
 #include <algorithm>
+#include <string.h>
 
 const char *ignoreValidationError[] = {
         "NONE",
@@ -68,29 +69,64 @@ RenderDeviceContext::RenderDeviceContext()
             /* apiVersion */ VK_API_VERSION_1_3
     };
 
-    const char * extensions[] = {
+    // every surface extension glfw may ask for, anything the loader doesn't
+    // have is dropped so a headless context still start without them.
+    const char *desired_extensions[] = {
             "VK_KHR_surface",
             "VK_KHR_win32_surface",
+            "VK_KHR_xlib_surface",
+            "VK_KHR_xcb_surface",
+            "VK_KHR_wayland_surface",
 #if defined(ENGINE_ENABLE_VULKAN_DEBUG_UTILS_EXT)
             "VK_EXT_debug_utils",
 #endif
     };
 
-    const char * layers[] = {
+    const char *desired_layers[] = {
 #if defined(ENGINE_ENABLE_VULKAN_DEBUG_UTILS_EXT)
             "VK_LAYER_KHRONOS_validation",
 #endif
     };
 
+    uint32_t available_extension_count = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &available_extension_count, nullptr);
+    std::vector<VkExtensionProperties> available_extensions(available_extension_count);
+    vkEnumerateInstanceExtensionProperties(nullptr, &available_extension_count, std::data(available_extensions));
+
+    std::vector<const char *> extensions;
+    for (const char *extension : desired_extensions) {
+        for (const VkExtensionProperties &properties : available_extensions) {
+            if (strcmp(properties.extensionName, extension) == 0) {
+                extensions.push_back(extension);
+                break;
+            }
+        }
+    }
+
+    uint32_t available_layer_count = 0;
+    vkEnumerateInstanceLayerProperties(&available_layer_count, nullptr);
+    std::vector<VkLayerProperties> available_layers(available_layer_count);
+    vkEnumerateInstanceLayerProperties(&available_layer_count, std::data(available_layers));
+
+    std::vector<const char *> layers;
+    for (const char *layer : desired_layers) {
+        for (const VkLayerProperties &properties : available_layers) {
+            if (strcmp(properties.layerName, layer) == 0) {
+                layers.push_back(layer);
+                break;
+            }
+        }
+    }
+
     VkInstanceCreateInfo instance_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
             /* pNext */ VK_NULL_HANDLE,
             /* flags */ VK_NONE_FLAGS,
             /* pApplicationInfo */ &application_info,
-            /* enabledLayerCount */ ARRAY_SIZE(layers),
-            /* ppEnabledLayerNames */ layers,
-            /* enabledExtensionCount */ ARRAY_SIZE(extensions),
-            /* ppEnabledExtensionNames */ extensions
+            /* enabledLayerCount */ (uint32_t) std::size(layers),
+            /* ppEnabledLayerNames */ std::data(layers),
+            /* enabledExtensionCount */ (uint32_t) std::size(extensions),
+            /* ppEnabledExtensionNames */ std::data(extensions)
     };
 
     err = vkCreateInstance(&instance_create_info, VK_NULL_HANDLE, &instance);
@@ -112,8 +148,11 @@ RenderDeviceContext::RenderDeviceContext()
                                         VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
     messenger_create_info.pfnUserCallback = debugCallback;
 
-    err = fnCreateDebugUtilsMessengerEXT(instance, &messenger_create_info, VK_NULL_HANDLE, &messenger);
-    assert(!err);
+    /* VK_EXT_debug_utils may be missing, e.g. without the SDK installed */
+    if (fnCreateDebugUtilsMessengerEXT) {
+        err = fnCreateDebugUtilsMessengerEXT(instance, &messenger_create_info, VK_NULL_HANDLE, &messenger);
+        assert(!err);
+    }
 #endif
 
     // ******************************************************** //
@@ -154,7 +193,8 @@ RenderDeviceContext::~RenderDeviceContext()
     vkDestroyCommandPool(device, cmd_pool, VK_NULL_HANDLE);
     vkDestroyDevice(device, VK_NULL_HANDLE);
 #ifdef ENGINE_ENABLE_VULKAN_DEBUG_UTILS_EXT
-    fnDestroyDebugUtilsMessengerExt(instance, messenger, VK_NULL_HANDLE);
+    if (messenger)
+        fnDestroyDebugUtilsMessengerExt(instance, messenger, VK_NULL_HANDLE);
 #endif
     vkDestroyInstance(instance, VK_NULL_HANDLE);
 }
@@ -200,20 +240,26 @@ void RenderDeviceContext::_Initialize(VkSurfaceKHR surface)
 {
     VkResult U_ASSERT_ONLY err;
 
-    err = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
-    assert(!err);
+    /* headless, render targets only, keep the usual window format */
+    format = VK_FORMAT_B8G8R8A8_UNORM;
 
-    /* pick surface format */
-    uint32_t foramt_count = 0;
-    err = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &foramt_count, nullptr);
-    assert(!err);
+    if (surface) {
+        err = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+        assert(!err);
 
-    VkSurfaceFormatKHR *surface_formats_khr = (VkSurfaceFormatKHR *) imalloc(sizeof(VkSurfaceFormatKHR) * foramt_count);
-    err = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &foramt_count, surface_formats_khr);
-    assert(!err);
+        /* pick surface format */
+        uint32_t foramt_count = 0;
+        err = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &foramt_count, nullptr);
+        assert(!err);
+
+        VkSurfaceFormatKHR *surface_formats_khr = (VkSurfaceFormatKHR *) imalloc(sizeof(VkSurfaceFormatKHR) * foramt_count);
+        err = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &foramt_count, surface_formats_khr);
+        assert(!err);
 
-    VkSurfaceFormatKHR surface_format = pick_surface_format(surface_formats_khr, foramt_count);
-    format = surface_format.format;
+        VkSurfaceFormatKHR surface_format = pick_surface_format(surface_formats_khr, foramt_count);
+        format = surface_format.format;
+        free(surface_formats_khr);
+    }
 
     /* add queue create info */
     uint32_t queue_family_count = 0;
@@ -223,8 +269,9 @@ void RenderDeviceContext::_Initialize(VkSurfaceKHR surface)
 
     for (uint32_t i = 0; i < queue_family_count; i++) {
         VkQueueFamilyProperties properties = queue_family_properties[i];
-        VkBool32 is_support_present = VK_FALSE;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &is_support_present);
+        VkBool32 is_support_present = VK_TRUE;
+        if (surface)
+            vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &is_support_present);
         if ((properties.queueFlags & VK_QUEUE_GRAPHICS_BIT) && is_support_present) {
             graph_queue_family = i;
             break;
@@ -262,24 +309,62 @@ void RenderDeviceContext::_CreateDevice()
     };
 
     /* create logic device */
-    const char *extensions[] = {
-            "VK_KHR_swapchain",
+    std::vector<const char *> extensions = {
             "VK_KHR_synchronization2"
     };
 
+    uint32_t available_extension_count = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &available_extension_count, nullptr);
+    std::vector<VkExtensionProperties> available_extensions(available_extension_count);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &available_extension_count, std::data(available_extensions));
+
+    for (const VkExtensionProperties &extension : available_extensions) {
+        if (strcmp(extension.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0)
+            swapchain_supported = true;
+        if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+            memory_budget_supported = true;
+    }
+
+    if (swapchain_supported)
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+    if (memory_budget_supported)
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
     VkPhysicalDeviceFeatures features = {};
     features.wideLines = VK_TRUE;
+    features.samplerAnisotropy = physical_device_features.samplerAnisotropy;
+    features.textureCompressionBC = physical_device_features.textureCompressionBC;
+    features.pipelineStatisticsQuery = physical_device_features.pipelineStatisticsQuery;
+    features.multiDrawIndirect = physical_device_features.multiDrawIndirect;
+    features.drawIndirectFirstInstance = physical_device_features.drawIndirectFirstInstance;
+
+    VkPhysicalDeviceVulkan12Features vulkan12_features = {};
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+    if (physical_device_properties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &vulkan12_features;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        /* only enable what is used */
+        draw_indirect_count_supported = vulkan12_features.drawIndirectCount;
+        vulkan12_features = {};
+        vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12_features.drawIndirectCount = draw_indirect_count_supported;
+    }
 
     VkDeviceCreateInfo device_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            /* pNext */ VK_NULL_HANDLE,
+            /* pNext */ physical_device_properties.apiVersion >= VK_API_VERSION_1_2 ? &vulkan12_features : VK_NULL_HANDLE,
             /* flags */ VK_NONE_FLAGS,
             /* queueCreateInfoCount */ 1,
             /* pQueueCreateInfos */ &queue_create_info,
             /* enabledLayerCount */ 0,
             /* ppEnabledLayerNames */ nullptr,
-            /* enabledExtensionCount */ ARRAY_SIZE(extensions),
-            /* ppEnabledExtensionNames */ extensions,
+            /* enabledExtensionCount */ (uint32_t) std::size(extensions),
+            /* ppEnabledExtensionNames */ std::data(extensions),
             /* pEnabledFeatures */ &features,
     };
 
@@ -312,6 +397,10 @@ void RenderDeviceContext::_CreateVmaAllocator()
     vma_allocator_create_info.instance = instance;
     vma_allocator_create_info.physicalDevice = physicalDevice;
     vma_allocator_create_info.device = device;
+    /* memory budget query through vkGetPhysicalDeviceMemoryProperties2 */
+    vma_allocator_create_info.vulkanApiVersion = std::min(VK_API_VERSION_1_3, VK_MAKE_API_VERSION(0, VK_API_VERSION_MAJOR(physical_device_properties.apiVersion), VK_API_VERSION_MINOR(physical_device_properties.apiVersion), 0));
+    if (memory_budget_supported)
+        vma_allocator_create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 
     err = vmaCreateAllocator(&vma_allocator_create_info, &allocator);
     assert(!err);
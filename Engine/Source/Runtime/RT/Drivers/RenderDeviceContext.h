@@ -34,6 +34,7 @@
 #include <Bright/Error.h>
 #include <Bright/Typedefs.h>
 #include <time.h>
+#include <mutex>
 #include <vector>
 
 #define VK_NONE_FLAGS 0
@@ -51,19 +52,32 @@ public:
     VkInstance GetInstance() { return instance; }
     VkPhysicalDevice GetPhysicalDevice() { return physicalDevice; }
     const char *GetDeviceName() { return physical_device_properties.deviceName; }
+    const VkPhysicalDeviceProperties &GetPhysicalDeviceProperties() { return physical_device_properties; }
+    const VkPhysicalDeviceFeatures &GetPhysicalDeviceFeatures() { return physical_device_features; }
     VkDevice GetDevice() { return device; }
     VmaAllocator GetAllocator() { return allocator; }
     uint32_t GetQueueFamily() { return graph_queue_family; }
     VkQueue GetQueue() { return graph_queue; };
+    // the queue is shared by the render thread and the main thread, hold
+    // this around every vkQueue* and vkDeviceWaitIdle call.
+    std::mutex &GetQueueMutex() { return queue_mutex; }
     VkCommandPool GetCommandPool() { return cmd_pool; }
     VkFormat GetWindowFormat() { return format; }
     VkFormat FindSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     VkSampleCountFlagBits GetMaxMSAASampleCounts() { return max_msaa_sample_counts; }
+    // VK_EXT_memory_budget is enabled, vmaGetHeapBudgets report the driver
+    // numbers instead of an estimate.
+    bool IsMemoryBudgetSupported() { return memory_budget_supported; }
+    // false on headless devices without presentation support.
+    bool IsSwapchainSupported() { return swapchain_supported; }
+    // vkCmdDraw*IndirectCount, core since vulkan 1.2 behind a feature bit.
+    bool IsDrawIndirectCountSupported() { return draw_indirect_count_supported; }
 
     void AllocateCommandBuffer(VkCommandBufferLevel level, VkCommandBuffer *pCmdBuffer);
     void FreeCommandBuffer(VkCommandBuffer cmdBuffer);
 
 protected:
+    // surface may be VK_NULL_HANDLE for a headless context.
     void _Initialize(VkSurfaceKHR surface);
 
 private:
@@ -87,11 +101,15 @@ private:
     VkDevice device = VK_NULL_HANDLE;
     uint32_t graph_queue_family;
     VkQueue graph_queue = VK_NULL_HANDLE;
+    std::mutex queue_mutex;
     VkCommandPool cmd_pool = VK_NULL_HANDLE;
     VmaAllocator allocator = VK_NULL_HANDLE;
     VkSurfaceCapabilitiesKHR capabilities;
     VkFormat format;
     VkSampleCountFlagBits max_msaa_sample_counts = VK_SAMPLE_COUNT_1_BIT;
+    bool memory_budget_supported = false;
+    bool swapchain_supported = false;
+    bool draw_indirect_count_supported = false;
 };
 
 #endif /* _RENDERING_CONTEXT_DRIVER_VULKAN_H */
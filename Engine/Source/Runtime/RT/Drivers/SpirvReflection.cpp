@@ -0,0 +1,392 @@
+/* ======================================================================== */
+/* SpirvReflection.cpp                                                      */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "SpirvReflection.h"
+#include <unordered_map>
+#include <algorithm>
+#include <stdio.h>
+
+#define SPV_MAGIC_NUMBER 0x07230203
+#define SPV_HEADER_WORD_COUNT 5
+
+/* opcodes */
+#define SPV_OP_ENTRY_POINT       15
+#define SPV_OP_EXECUTION_MODE    16
+#define SPV_OP_TYPE_INT          21
+#define SPV_OP_TYPE_FLOAT        22
+#define SPV_OP_TYPE_VECTOR       23
+#define SPV_OP_TYPE_MATRIX       24
+#define SPV_OP_TYPE_IMAGE        25
+#define SPV_OP_TYPE_SAMPLER      26
+#define SPV_OP_TYPE_SAMPLED_IMAGE 27
+#define SPV_OP_TYPE_ARRAY        28
+#define SPV_OP_TYPE_RUNTIME_ARRAY 29
+#define SPV_OP_TYPE_STRUCT       30
+#define SPV_OP_TYPE_POINTER      32
+#define SPV_OP_CONSTANT          43
+#define SPV_OP_SPEC_CONSTANT     50
+#define SPV_OP_VARIABLE          59
+#define SPV_OP_DECORATE          71
+#define SPV_OP_MEMBER_DECORATE   72
+
+/* decorations */
+#define SPV_DECORATION_BLOCK          2
+#define SPV_DECORATION_BUFFER_BLOCK   3
+#define SPV_DECORATION_ARRAY_STRIDE   6
+#define SPV_DECORATION_MATRIX_STRIDE  7
+#define SPV_DECORATION_BUILT_IN       11
+#define SPV_DECORATION_LOCATION       30
+#define SPV_DECORATION_BINDING        33
+#define SPV_DECORATION_DESCRIPTOR_SET 34
+#define SPV_DECORATION_OFFSET         35
+
+/* storage classes */
+#define SPV_STORAGE_UNIFORM_CONSTANT 0
+#define SPV_STORAGE_INPUT            1
+#define SPV_STORAGE_UNIFORM          2
+#define SPV_STORAGE_PUSH_CONSTANT    9
+#define SPV_STORAGE_STORAGE_BUFFER   12
+
+/* misc */
+#define SPV_EXECUTION_MODEL_VERTEX    0
+#define SPV_EXECUTION_MODEL_FRAGMENT  4
+#define SPV_EXECUTION_MODEL_GLCOMPUTE 5
+#define SPV_EXECUTION_MODE_LOCAL_SIZE 17
+#define SPV_DIM_BUFFER                5
+#define SPV_DIM_SUBPASS_DATA          6
+
+struct _SpvId {
+    uint32_t opcode = 0;
+    /* type info */
+    uint32_t width = 0;
+    uint32_t signedness = 0;
+    uint32_t elementType = 0;
+    uint32_t elementCount = 0;
+    uint32_t dim = 0;
+    uint32_t sampled = 0;
+    uint32_t storageClass = 0;
+    std::vector<uint32_t> members;
+    /* constant value */
+    uint32_t value = 0;
+    /* decorations */
+    uint32_t set = 0;
+    uint32_t binding = 0;
+    uint32_t location = UINT32_MAX;
+    uint32_t arrayStride = 0;
+    bool block = false;
+    bool bufferBlock = false;
+    bool builtIn = false;
+    std::vector<uint32_t> memberOffsets;
+    std::vector<uint32_t> memberMatrixStrides;
+};
+
+static uint32_t _SpvTypeSize(std::unordered_map<uint32_t, _SpvId> &ids, uint32_t typeId, uint32_t matrixStride)
+{
+    _SpvId &type = ids[typeId];
+
+    switch (type.opcode) {
+        case SPV_OP_TYPE_INT:
+        case SPV_OP_TYPE_FLOAT:
+            return type.width / 8;
+        case SPV_OP_TYPE_VECTOR:
+            return _SpvTypeSize(ids, type.elementType, 0) * type.elementCount;
+        case SPV_OP_TYPE_MATRIX:
+            if (matrixStride != 0)
+                return matrixStride * type.elementCount;
+            return _SpvTypeSize(ids, type.elementType, 0) * type.elementCount;
+        case SPV_OP_TYPE_ARRAY: {
+            uint32_t length = ids[type.elementCount].value;
+            uint32_t stride = type.arrayStride;
+            if (stride == 0)
+                stride = _SpvTypeSize(ids, type.elementType, matrixStride);
+            return stride * length;
+        }
+        case SPV_OP_TYPE_STRUCT: {
+            uint32_t size = 0;
+            for (uint32_t i = 0; i < type.members.size(); i++) {
+                uint32_t offset = i < type.memberOffsets.size() ? type.memberOffsets[i] : 0;
+                uint32_t stride = i < type.memberMatrixStrides.size() ? type.memberMatrixStrides[i] : 0;
+                size = std::max(size, offset + _SpvTypeSize(ids, type.members[i], stride));
+            }
+            return size;
+        }
+        default:
+            return 0;
+    }
+}
+
+static VkFormat _SpvVertexInputFormat(std::unordered_map<uint32_t, _SpvId> &ids, uint32_t typeId, uint32_t *pSize)
+{
+    static const VkFormat sfloat[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+    static const VkFormat sint[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+    static const VkFormat uint[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+    _SpvId &type = ids[typeId];
+    uint32_t count = 1;
+    uint32_t scalarId = typeId;
+
+    if (type.opcode == SPV_OP_TYPE_VECTOR) {
+        count = type.elementCount;
+        scalarId = type.elementType;
+    }
+
+    _SpvId &scalar = ids[scalarId];
+    if (scalar.width != 32 || count < 1 || count > 4)
+        return VK_FORMAT_UNDEFINED;
+
+    *pSize = count * 4;
+
+    if (scalar.opcode == SPV_OP_TYPE_FLOAT)
+        return sfloat[count - 1];
+
+    if (scalar.opcode == SPV_OP_TYPE_INT)
+        return scalar.signedness ? sint[count - 1] : uint[count - 1];
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+static VkDescriptorType _SpvDescriptorType(std::unordered_map<uint32_t, _SpvId> &ids, uint32_t storageClass, uint32_t typeId)
+{
+    _SpvId &type = ids[typeId];
+
+    if (storageClass == SPV_STORAGE_STORAGE_BUFFER)
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+    if (storageClass == SPV_STORAGE_UNIFORM)
+        return type.bufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+    switch (type.opcode) {
+        case SPV_OP_TYPE_SAMPLER:
+            return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case SPV_OP_TYPE_SAMPLED_IMAGE:
+            return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        case SPV_OP_TYPE_IMAGE:
+            if (type.dim == SPV_DIM_SUBPASS_DATA)
+                return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            if (type.dim == SPV_DIM_BUFFER)
+                return type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            return type.sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        default:
+            return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+    }
+}
+
+Error ReflectShaderBytecode(const uint32_t *pCode, size_t size, ShaderReflection *pReflection)
+{
+    size_t wordCount = size / sizeof(uint32_t);
+
+    if (wordCount < SPV_HEADER_WORD_COUNT || pCode[0] != SPV_MAGIC_NUMBER)
+        return FAIL;
+
+    std::unordered_map<uint32_t, _SpvId> ids;
+    std::vector<uint32_t> variables;
+
+    /* first pass: collect every id we are interested in */
+    size_t pos = SPV_HEADER_WORD_COUNT;
+    while (pos < wordCount) {
+        uint32_t opcode = pCode[pos] & 0xFFFF;
+        uint32_t count = pCode[pos] >> 16;
+        const uint32_t *op = pCode + pos;
+
+        if (count == 0 || pos + count > wordCount)
+            return FAIL;
+
+        switch (opcode) {
+            case SPV_OP_ENTRY_POINT: {
+                if (op[1] == SPV_EXECUTION_MODEL_VERTEX)
+                    pReflection->stage = VK_SHADER_STAGE_VERTEX_BIT;
+                else if (op[1] == SPV_EXECUTION_MODEL_FRAGMENT)
+                    pReflection->stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+                else if (op[1] == SPV_EXECUTION_MODEL_GLCOMPUTE)
+                    pReflection->stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            } break;
+            case SPV_OP_EXECUTION_MODE: {
+                if (op[2] == SPV_EXECUTION_MODE_LOCAL_SIZE && count >= 6) {
+                    pReflection->localSize[0] = op[3];
+                    pReflection->localSize[1] = op[4];
+                    pReflection->localSize[2] = op[5];
+                }
+            } break;
+            case SPV_OP_TYPE_INT:
+            case SPV_OP_TYPE_FLOAT: {
+                _SpvId &id = ids[op[1]];
+                id.opcode = opcode;
+                id.width = op[2];
+                id.signedness = opcode == SPV_OP_TYPE_INT ? op[3] : 1;
+            } break;
+            case SPV_OP_TYPE_VECTOR:
+            case SPV_OP_TYPE_MATRIX:
+            case SPV_OP_TYPE_ARRAY: {
+                _SpvId &id = ids[op[1]];
+                id.opcode = opcode;
+                id.elementType = op[2];
+                id.elementCount = op[3];
+            } break;
+            case SPV_OP_TYPE_RUNTIME_ARRAY:
+            case SPV_OP_TYPE_SAMPLED_IMAGE: {
+                _SpvId &id = ids[op[1]];
+                id.opcode = opcode;
+                id.elementType = op[2];
+            } break;
+            case SPV_OP_TYPE_IMAGE: {
+                _SpvId &id = ids[op[1]];
+                id.opcode = opcode;
+                id.dim = op[3];
+                id.sampled = op[7];
+            } break;
+            case SPV_OP_TYPE_SAMPLER: {
+                ids[op[1]].opcode = opcode;
+            } break;
+            case SPV_OP_TYPE_STRUCT: {
+                _SpvId &id = ids[op[1]];
+                id.opcode = opcode;
+                id.members.assign(op + 2, op + count);
+            } break;
+            case SPV_OP_TYPE_POINTER: {
+                _SpvId &id = ids[op[1]];
+                id.opcode = opcode;
+                id.storageClass = op[2];
+                id.elementType = op[3];
+            } break;
+            // array sizes may come from a specialization constant, the
+            // layout then use its default value.
+            case SPV_OP_CONSTANT:
+            case SPV_OP_SPEC_CONSTANT: {
+                _SpvId &id = ids[op[2]];
+                id.opcode = opcode;
+                id.value = op[3];
+            } break;
+            case SPV_OP_VARIABLE: {
+                _SpvId &id = ids[op[2]];
+                id.opcode = opcode;
+                id.elementType = op[1];
+                id.storageClass = op[3];
+                variables.push_back(op[2]);
+            } break;
+            case SPV_OP_DECORATE: {
+                _SpvId &id = ids[op[1]];
+                switch (op[2]) {
+                    case SPV_DECORATION_BLOCK: id.block = true; break;
+                    case SPV_DECORATION_BUFFER_BLOCK: id.bufferBlock = true; break;
+                    case SPV_DECORATION_BUILT_IN: id.builtIn = true; break;
+                    case SPV_DECORATION_ARRAY_STRIDE: id.arrayStride = op[3]; break;
+                    case SPV_DECORATION_LOCATION: id.location = op[3]; break;
+                    case SPV_DECORATION_BINDING: id.binding = op[3]; break;
+                    case SPV_DECORATION_DESCRIPTOR_SET: id.set = op[3]; break;
+                    default: break;
+                }
+            } break;
+            case SPV_OP_MEMBER_DECORATE: {
+                _SpvId &id = ids[op[1]];
+                uint32_t member = op[2];
+                if (op[3] == SPV_DECORATION_OFFSET) {
+                    if (id.memberOffsets.size() <= member)
+                        id.memberOffsets.resize(member + 1, 0);
+                    id.memberOffsets[member] = op[4];
+                } else if (op[3] == SPV_DECORATION_MATRIX_STRIDE) {
+                    if (id.memberMatrixStrides.size() <= member)
+                        id.memberMatrixStrides.resize(member + 1, 0);
+                    id.memberMatrixStrides[member] = op[4];
+                } else if (op[3] == SPV_DECORATION_BUILT_IN) {
+                    id.builtIn = true;
+                }
+            } break;
+            default:
+                break;
+        }
+
+        pos += count;
+    }
+
+    /* second pass: resolve global variables */
+    for (uint32_t variableId : variables) {
+        _SpvId &variable = ids[variableId];
+        _SpvId &pointer = ids[variable.elementType];
+        uint32_t typeId = pointer.elementType;
+
+        switch (variable.storageClass) {
+            case SPV_STORAGE_UNIFORM_CONSTANT:
+            case SPV_STORAGE_UNIFORM:
+            case SPV_STORAGE_STORAGE_BUFFER: {
+                uint32_t descriptorCount = 1;
+
+                if (ids[typeId].opcode == SPV_OP_TYPE_ARRAY) {
+                    descriptorCount = ids[ids[typeId].elementCount].value;
+                    typeId = ids[typeId].elementType;
+                } else if (ids[typeId].opcode == SPV_OP_TYPE_RUNTIME_ARRAY) {
+                    typeId = ids[typeId].elementType;
+                }
+
+                VkDescriptorType descriptorType = _SpvDescriptorType(ids, variable.storageClass, typeId);
+                if (descriptorType == VK_DESCRIPTOR_TYPE_MAX_ENUM)
+                    break;
+
+                ShaderReflection::DescriptorBinding binding = {};
+                binding.set = variable.set;
+                binding.binding = variable.binding;
+                binding.descriptorType = descriptorType;
+                binding.descriptorCount = descriptorCount;
+                pReflection->bindings.push_back(binding);
+            } break;
+            case SPV_STORAGE_PUSH_CONSTANT: {
+                _SpvId &block = ids[typeId];
+                uint32_t offset = UINT32_MAX;
+                for (uint32_t memberOffset : block.memberOffsets)
+                    offset = std::min(offset, memberOffset);
+                if (offset == UINT32_MAX)
+                    offset = 0;
+                pReflection->pushConstantOffset = offset;
+                pReflection->pushConstantSize = _SpvTypeSize(ids, typeId, 0) - offset;
+            } break;
+            case SPV_STORAGE_INPUT: {
+                if (pReflection->stage != VK_SHADER_STAGE_VERTEX_BIT)
+                    break;
+
+                if (variable.builtIn || ids[typeId].builtIn || variable.location == UINT32_MAX)
+                    break;
+
+                // a skipped input would leave its location unbound in the
+                // pipeline, fail instead.
+                ShaderReflection::VertexInput input = {};
+                input.location = variable.location;
+                input.format = _SpvVertexInputFormat(ids, typeId, &input.size);
+                if (input.format == VK_FORMAT_UNDEFINED) {
+                    _SpvId &type = ids[typeId];
+                    _SpvId &scalar = type.opcode == SPV_OP_TYPE_VECTOR ? ids[type.elementType] : type;
+                    fprintf(stderr, "SPIR-V reflection: vertex input at location %u has no 32-bit format (opcode %u, %u bit)\n",
+                            variable.location, type.opcode, scalar.width);
+                    return FAIL;
+                }
+
+                pReflection->inputs.push_back(input);
+            } break;
+            default:
+                break;
+        }
+    }
+
+    std::sort(pReflection->inputs.begin(), pReflection->inputs.end(), [](const ShaderReflection::VertexInput &a, const ShaderReflection::VertexInput &b) {
+        return a.location < b.location;
+    });
+
+    return OK;
+}
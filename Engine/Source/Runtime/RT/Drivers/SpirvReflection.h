@@ -0,0 +1,62 @@
+/* ======================================================================== */
+/* SpirvReflection.h                                                        */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _SPIRV_REFLECTION_H_
+#define _SPIRV_REFLECTION_H_
+
+#ifdef VOLK_LOADER
+#  include <volk/volk.h>
+#else
+#  include <vulkan/vulkan.h>
+#endif
+
+#include <Bright/Error.h>
+#include <vector>
+
+// Minimal SPIR-V reflection, only parse the module header, decorations,
+// types and global variables, that is enough to build the pipeline layout
+// and vertex input state without any help from the caller.
+struct ShaderReflection {
+    struct DescriptorBinding {
+        uint32_t set;
+        uint32_t binding;
+        VkDescriptorType descriptorType;
+        uint32_t descriptorCount;
+    };
+
+    struct VertexInput {
+        uint32_t location;
+        VkFormat format;
+        uint32_t size;
+    };
+
+    VkShaderStageFlagBits stage = (VkShaderStageFlagBits) 0;
+    std::vector<DescriptorBinding> bindings;
+    std::vector<VertexInput> inputs;
+    uint32_t pushConstantOffset = 0;
+    uint32_t pushConstantSize = 0;
+    uint32_t localSize[3] = { 1, 1, 1 };
+};
+
+Error ReflectShaderBytecode(const uint32_t *pCode, size_t size, ShaderReflection *pReflection);
+
+#endif /* _SPIRV_REFLECTION_H_ */
@@ -26,6 +26,7 @@
 #include <fstream>
 #include <stdexcept>
 #include <Bright/IOUtils.h>
+#include <Bright/VFS.h>
 
 // pick surface format
 static VkSurfaceFormatKHR pick_surface_format(const VkSurfaceFormatKHR *surface_formats, uint32_t count)
@@ -77,30 +78,46 @@ static VkSampleCountFlagBits find_max_msaa_sample_counts(VkPhysicalDevicePropert
     return VK_SAMPLE_COUNT_1_BIT;
 }
 
-// load shader module form .spv file content.
-static VkShaderModule load_shader_module(VkDevice device, const char *name, const char *stage)
+// load .spv file content, free the buffer with io_free_buf.
+static char *load_shader_bytecode(const char *name, const char *stage, size_t *size)
 {
-    char *buf;
-    size_t size;
-    VkResult U_ASSERT_ONLY err;
-
     char path[255];
-    snprintf(path, sizeof(path), RESOURCE("shader/%s.%s.spv"), name, stage);
+    snprintf(path, sizeof(path), "shader/%s.%s.spv", name, stage);
+
+    char *buf = vfs_read(path, size);
+    if (!buf)
+        throw std::runtime_error("error open file failed!");
 
-    buf = io_read_bytecode(path, &size);
+    return buf;
+}
+
+static VkShaderModule create_shader_module(VkDevice device, const char *buf, size_t size)
+{
+    VkResult U_ASSERT_ONLY err;
 
     VkShaderModuleCreateInfo shader_module_create_info = {
             /* sType */ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             /* pNext */ VK_NULL_HANDLE,
             /* flags */ 0,
             /* codeSize */ size,
-            /* pCode */ reinterpret_cast<uint32_t *>(buf),
+            /* pCode */ reinterpret_cast<const uint32_t *>(buf),
     };
 
     VkShaderModule shader_module;
     err = vkCreateShaderModule(device, &shader_module_create_info, VK_NULL_HANDLE, &shader_module);
     assert(!err);
 
+    return shader_module;
+}
+
+// load shader module form .spv file content.
+static VkShaderModule load_shader_module(VkDevice device, const char *name, const char *stage)
+{
+    char *buf;
+    size_t size;
+
+    buf = load_shader_bytecode(name, stage, &size);
+    VkShaderModule shader_module = create_shader_module(device, buf, size);
     io_free_buf(buf);
 
     return shader_module;
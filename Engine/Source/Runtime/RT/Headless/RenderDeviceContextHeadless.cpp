@@ -0,0 +1,43 @@
+/* ======================================================================== */
+/* RenderDeviceContextHeadless.cpp                                          */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "RenderDeviceContextHeadless.h"
+
+RenderDeviceContextHeadless::RenderDeviceContextHeadless()
+{
+    _Initialize(VK_NULL_HANDLE);
+}
+
+RenderDeviceContextHeadless::~RenderDeviceContextHeadless()
+{
+    /* do nothing in here... */
+}
+
+RenderDevice *RenderDeviceContextHeadless::CreateRenderDevice()
+{
+    return memnew(RenderDevice, this);
+}
+
+void RenderDeviceContextHeadless::DestroyRenderDevice(RenderDevice *pRenderDevice)
+{
+    memdel(pRenderDevice);
+}
@@ -0,0 +1,39 @@
+/* ======================================================================== */
+/* RenderDeviceContextHeadless.h                                            */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _RENDER_DEVICE_CONTEXT_HEADLESS_H_
+#define _RENDER_DEVICE_CONTEXT_HEADLESS_H_
+
+#include "RT/Drivers/RenderDevice.h"
+
+// Render driver context without any window or surface, only offscreen
+// render targets can be used, e.g. for benchmarks on lavapipe or CI.
+class RenderDeviceContextHeadless : public RenderDeviceContext {
+public:
+    RenderDeviceContextHeadless();
+    ~RenderDeviceContextHeadless();
+
+    RenderDevice *CreateRenderDevice();
+    void DestroyRenderDevice(RenderDevice *pRenderDevice);
+};
+
+#endif /* _RENDER_DEVICE_CONTEXT_HEADLESS_H_ */
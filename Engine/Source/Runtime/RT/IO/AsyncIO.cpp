@@ -0,0 +1,131 @@
+/* ======================================================================== */
+/* AsyncIO.cpp                                                              */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "AsyncIO.h"
+#include <algorithm>
+
+AsyncIO::AsyncIO(uint32_t workerCount)
+{
+    for (uint32_t i = 0; i < std::max(workerCount, 1u); i++)
+        workers.emplace_back(&AsyncIO::_WorkerMain, this);
+}
+
+AsyncIO::~AsyncIO()
+{
+    WaitIdle();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopFlag = true;
+    }
+
+    requestCondition.notify_all();
+
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+std::future<AsyncReadResult> AsyncIO::ReadAsync(const char *path, size_t offset, size_t size, char *dst, size_t capacity)
+{
+    ReadRequest *request = memnew(ReadRequest);
+    request->path = path;
+    request->offset = offset;
+    request->size = size;
+    request->dst = dst;
+    request->capacity = capacity;
+    request->callback = NULL;
+    request->userdata = NULL;
+
+    std::future<AsyncReadResult> future = request->promise.get_future();
+    _Enqueue(request);
+
+    return future;
+}
+
+void AsyncIO::ReadAsync(const char *path, PFN_AsyncReadCallback callback, void *userdata, size_t offset, size_t size, char *dst, size_t capacity)
+{
+    ReadRequest *request = memnew(ReadRequest);
+    request->path = path;
+    request->offset = offset;
+    request->size = size;
+    request->dst = dst;
+    request->capacity = capacity;
+    request->callback = callback;
+    request->userdata = userdata;
+
+    _Enqueue(request);
+}
+
+void AsyncIO::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    completeCondition.wait(lock, [this] { return pendingCount.load() == 0; });
+}
+
+void AsyncIO::_Enqueue(ReadRequest *pRequest)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back(pRequest);
+        ++pendingCount;
+    }
+
+    requestCondition.notify_one();
+}
+
+void AsyncIO::_WorkerMain()
+{
+    while (true) {
+        ReadRequest *request;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            requestCondition.wait(lock, [this] { return stopFlag || !requests.empty(); });
+
+            if (stopFlag && requests.empty())
+                return;
+
+            request = requests.front();
+            requests.pop_front();
+        }
+
+        AsyncReadResult result;
+        result.path = std::move(request->path);
+        result.buf = request->dst;
+        result.userdata = request->userdata;
+        result.err = io_read_file(getpchar(result.path), request->offset, request->size, &result.buf, request->capacity, &result.size);
+
+        if (request->callback)
+            request->callback(&result);
+        else
+            request->promise.set_value(std::move(result));
+
+        memdel(request);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --pendingCount;
+        }
+
+        completeCondition.notify_all();
+    }
+}
@@ -0,0 +1,87 @@
+/* ======================================================================== */
+/* AsyncIO.h                                                                */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _ASYNC_IO_H_
+#define _ASYNC_IO_H_
+
+#include <Bright/IOUtils.h>
+#include <Bright/Typedefs.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AsyncReadResult {
+    Error err = FAIL;
+    std::string path;
+    /* caller buffer when one was given, otherwise free with io_free_buf */
+    char *buf = NULL;
+    size_t size = 0;
+    void *userdata = NULL;
+};
+
+typedef void (*PFN_AsyncReadCallback) (AsyncReadResult *pResult);
+
+// File read queue served by worker threads, requests complete through a
+// future or a callback invoked on the worker thread. Reads go straight into
+// the destination buffer, nothing is zero filled or copied twice.
+class AsyncIO {
+public:
+    AsyncIO(uint32_t workerCount = 1);
+   ~AsyncIO();
+
+    // dst hold capacity bytes, a read that doesn't fit fail.
+    std::future<AsyncReadResult> ReadAsync(const char *path, size_t offset = 0, size_t size = IO_WHOLE_FILE, char *dst = NULL, size_t capacity = 0);
+    void ReadAsync(const char *path, PFN_AsyncReadCallback callback, void *userdata, size_t offset = 0, size_t size = IO_WHOLE_FILE, char *dst = NULL, size_t capacity = 0);
+    void WaitIdle();
+
+    uint32_t GetPendingCount() { return pendingCount; }
+
+private:
+    struct ReadRequest {
+        std::string path;
+        size_t offset;
+        size_t size;
+        char *dst;
+        size_t capacity;
+        PFN_AsyncReadCallback callback;
+        void *userdata;
+        std::promise<AsyncReadResult> promise;
+    };
+
+    void _Enqueue(ReadRequest *pRequest);
+    void _WorkerMain();
+
+    std::vector<std::thread> workers;
+    std::deque<ReadRequest *> requests;
+    std::mutex mutex;
+    std::condition_variable requestCondition;
+    std::condition_variable completeCondition;
+    std::atomic<uint32_t> pendingCount = 0;
+    bool stopFlag = false;
+};
+
+#endif /* _ASYNC_IO_H_ */
@@ -0,0 +1,308 @@
+/* ======================================================================== */
+/* JobSystem.cpp                                                            */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "JobSystem.h"
+#include "Profiler/CPUProfiler.h"
+#include <stdio.h>
+
+static thread_local JobSystem *currentJobSystem = NULL;
+static thread_local uint32_t currentWorkerIndex = JOB_INVALID_WORKER_INDEX;
+
+// Chase-Lev deque with the C11 memory orders from Lê et al, "Correct and
+// Efficient Work-Stealing for Weak Memory Models". Only the owner call Push
+// and Pop, any thread may Steal.
+bool JobSystem::JobDeque::Push(Job *job)
+{
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+
+    if (b - t >= JOB_DEQUE_CAPACITY)
+        return false;
+
+    jobs[b & (JOB_DEQUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);
+
+    return true;
+}
+
+JobSystem::Job *JobSystem::JobDeque::Pop()
+{
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    Job *job = jobs[b & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+
+    // last job, race the thieves for it.
+    if (t == b) {
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            job = NULL;
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    return job;
+}
+
+JobSystem::Job *JobSystem::JobDeque::Steal()
+{
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b)
+        return NULL;
+
+    Job *job = jobs[t & (JOB_DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return NULL;
+
+    return job;
+}
+
+JobSystem::JobSystem(uint32_t workerCount)
+{
+    if (workerCount == 0)
+        workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+    for (uint32_t i = 0; i <= workerCount; i++)
+        deques.push_back(memnew(JobDeque));
+
+    currentJobSystem = this;
+    currentWorkerIndex = 0;
+
+    for (uint32_t i = 1; i <= workerCount; i++)
+        workers.emplace_back(&JobSystem::_WorkerMain, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopFlag.store(true);
+    }
+
+    sleepCondition.notify_all();
+
+    for (std::thread &worker : workers)
+        worker.join();
+
+    // whatever is still queued was never waited on, drop it.
+    for (JobDeque *deque : deques) {
+        while (Job *job = deque->Steal())
+            pool_delete(job);
+        memdel(deque);
+    }
+
+    for (Job *job : sharedJobs)
+        pool_delete(job);
+
+    if (currentJobSystem == this) {
+        currentJobSystem = NULL;
+        currentWorkerIndex = JOB_INVALID_WORKER_INDEX;
+    }
+}
+
+void JobSystem::Run(PFN_JobEntry entry, void *data, JobCounter *counter, JobCounter *dependency)
+{
+    JobDecl decl = { entry, data };
+    Run(&decl, 1, counter, dependency);
+}
+
+void JobSystem::Run(const JobDecl *pJobs, uint32_t count, JobCounter *counter, JobCounter *dependency)
+{
+    if (counter)
+        counter->value.fetch_add(count, std::memory_order_relaxed);
+
+    for (uint32_t i = 0; i < count; i++) {
+        Job *job = pool_new<Job>();
+        job->entry = pJobs[i].entry;
+        job->data = pJobs[i].data;
+        job->counter = counter;
+        job->dependency = dependency;
+        job->next = NULL;
+        _PushOrPark(job);
+    }
+}
+
+void JobSystem::Wait(JobCounter *counter)
+{
+    uint32_t workerIndex = currentJobSystem == this ? currentWorkerIndex : JOB_INVALID_WORKER_INDEX;
+
+    while (!counter->IsDone()) {
+        Job *job = _FetchJob(workerIndex);
+        if (!job) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        _Execute(job);
+    }
+
+    /* the last job may still be releasing the waiters */
+    std::lock_guard<std::mutex> lock(counter->waiterMutex);
+}
+
+uint32_t JobSystem::GetCurrentWorkerIndex()
+{
+    return currentWorkerIndex;
+}
+
+void JobSystem::_Push(Job *job)
+{
+    bool pushed = false;
+
+    queuedCount.fetch_add(1, std::memory_order_seq_cst);
+
+    if (currentJobSystem == this)
+        pushed = deques[currentWorkerIndex]->Push(job);
+
+    // foreign thread or full deque.
+    if (!pushed) {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        sharedJobs.push_back(job);
+        sharedCount.fetch_add(1, std::memory_order_release);
+    }
+
+    if (sleepingCount.load(std::memory_order_seq_cst) > 0) {
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        sleepCondition.notify_one();
+    }
+}
+
+// a blocked job never sit in a deque, the owner would pop it back over
+// and over while the job it waits on is stuck under it.
+void JobSystem::_PushOrPark(Job *job)
+{
+    if (job->dependency) {
+        std::lock_guard<std::mutex> lock(job->dependency->waiterMutex);
+        if (!job->dependency->IsDone()) {
+            job->next = (Job *) job->dependency->waiters;
+            job->dependency->waiters = job;
+            return;
+        }
+    }
+
+    _Push(job);
+}
+
+// decrement counter, the last job take the waiters under the lock so the
+// counter outlive it until Wait return.
+void JobSystem::_Complete(JobCounter *counter)
+{
+    uint32_t value = counter->value.load(std::memory_order_relaxed);
+    while (value > 1) {
+        if (counter->value.compare_exchange_weak(value, value - 1, std::memory_order_release, std::memory_order_relaxed))
+            return;
+    }
+
+    Job *waiters;
+
+    {
+        std::lock_guard<std::mutex> lock(counter->waiterMutex);
+        counter->value.fetch_sub(1, std::memory_order_acq_rel);
+        waiters = (Job *) counter->waiters;
+        counter->waiters = NULL;
+    }
+
+    while (waiters) {
+        Job *job = waiters;
+        waiters = job->next;
+        job->next = NULL;
+        _Push(job);
+    }
+}
+
+JobSystem::Job *JobSystem::_FetchJob(uint32_t workerIndex)
+{
+    Job *job = NULL;
+
+    if (workerIndex != JOB_INVALID_WORKER_INDEX)
+        job = deques[workerIndex]->Pop();
+
+    if (!job && sharedCount.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        if (!sharedJobs.empty()) {
+            job = sharedJobs.front();
+            sharedJobs.pop_front();
+            sharedCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // steal starting after ourselves so thieves spread over the victims.
+    uint32_t dequeCount = GetWorkerCount();
+    uint32_t start = workerIndex != JOB_INVALID_WORKER_INDEX ? workerIndex + 1 : 0;
+    for (uint32_t i = 0; !job && i < dequeCount; i++) {
+        uint32_t victim = (start + i) % dequeCount;
+        if (victim != workerIndex)
+            job = deques[victim]->Steal();
+    }
+
+    if (job)
+        queuedCount.fetch_sub(1, std::memory_order_relaxed);
+
+    return job;
+}
+
+void JobSystem::_Execute(Job *job)
+{
+    {
+        PROFILE_SCOPE("Job");
+        job->entry(job->data);
+    }
+
+    JobCounter *counter = job->counter;
+    pool_delete(job);
+
+    if (counter)
+        _Complete(counter);
+}
+
+void JobSystem::_WorkerMain(uint32_t workerIndex)
+{
+    currentJobSystem = this;
+    currentWorkerIndex = workerIndex;
+
+#ifdef BRIGHT_PROFILER_ENABLED
+    char name[32];
+    snprintf(name, sizeof(name), "Worker %u", workerIndex);
+    PROFILE_THREAD(name);
+#endif
+
+    while (!stopFlag.load(std::memory_order_acquire)) {
+        Job *job = _FetchJob(workerIndex);
+        if (job) {
+            _Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingCount.fetch_add(1, std::memory_order_seq_cst);
+        sleepCondition.wait(lock, [this] { return stopFlag.load() || queuedCount.load(std::memory_order_seq_cst) > 0; });
+        sleepingCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
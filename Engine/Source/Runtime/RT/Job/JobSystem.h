@@ -0,0 +1,156 @@
+/* ======================================================================== */
+/* JobSystem.h                                                              */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _JOB_SYSTEM_H_
+#define _JOB_SYSTEM_H_
+
+#include <Bright/Memalloc.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOB_DEQUE_CAPACITY 4096
+#define JOB_INVALID_WORKER_INDEX UINT32_MAX
+
+typedef void (*PFN_JobEntry) (void *pData);
+
+struct JobDecl {
+    PFN_JobEntry entry;
+    void *data;
+};
+
+// Count of jobs still running, a job decrement it when finished. Jobs can
+// wait on a counter before starting, that is how dependencies are chained.
+// Those jobs are parked on the counter, not queued, and pushed by the job
+// bringing it to zero. Don't destroy a counter before Wait on it returned.
+struct JobCounter {
+    std::atomic<uint32_t> value = 0;
+    std::mutex waiterMutex;
+    /* JobSystem::Job list, owned by the job system */
+    void *waiters = NULL;
+
+    bool IsDone() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+// Work stealing scheduler, every worker own a Chase-Lev deque, it push and
+// pop jobs at the bottom while idle workers steal from the top of the
+// others. The thread that created the job system is worker 0 and help run
+// jobs while it waits, threads outside the system submit through a shared
+// queue.
+class JobSystem {
+public:
+    // 0 spawn one worker per core besides the calling thread.
+    JobSystem(uint32_t workerCount = 0);
+   ~JobSystem();
+
+    void Run(PFN_JobEntry entry, void *data, JobCounter *counter = NULL, JobCounter *dependency = NULL);
+    // counter is raised by count at once, dependency must reach zero before
+    // any of the jobs start.
+    void Run(const JobDecl *pJobs, uint32_t count, JobCounter *counter, JobCounter *dependency = NULL);
+    // run other jobs until counter reach zero, never block a worker.
+    void Wait(JobCounter *counter);
+
+    // fn(uint32_t begin, uint32_t end) over [0, count) in chunks of
+    // grainSize, 0 pick a grain giving every worker a few chunks.
+    template<typename F>
+    void ParallelFor(uint32_t count, uint32_t grainSize, F &&fn)
+      {
+        if (count == 0)
+            return;
+
+        if (grainSize == 0)
+            grainSize = std::max(1u, count / (GetWorkerCount() * 4));
+
+        if (count <= grainSize) {
+            fn(0u, count);
+            return;
+        }
+
+        struct Range {
+            F *fn;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        uint32_t chunkCount = (count + grainSize - 1) / grainSize;
+        std::vector<Range> ranges(chunkCount);
+        std::vector<JobDecl> jobs(chunkCount);
+
+        for (uint32_t i = 0; i < chunkCount; i++) {
+            ranges[i] = { &fn, i * grainSize, std::min(count, (i + 1) * grainSize) };
+            jobs[i] = { [] (void *pData) { Range *range = (Range *) pData; (*range->fn)(range->begin, range->end); }, &ranges[i] };
+        }
+
+        JobCounter counter;
+        Run(std::data(jobs), chunkCount, &counter);
+        Wait(&counter);
+      }
+
+    uint32_t GetWorkerCount() { return (uint32_t) std::size(deques); }
+    // index of the calling thread, JOB_INVALID_WORKER_INDEX outside the system.
+    static uint32_t GetCurrentWorkerIndex();
+
+private:
+    struct Job {
+        PFN_JobEntry entry;
+        void *data;
+        JobCounter *counter;
+        JobCounter *dependency;
+        Job *next;
+    };
+
+    class JobDeque {
+    public:
+        bool Push(Job *job);
+        Job *Pop();
+        Job *Steal();
+
+    private:
+        std::atomic<int64_t> top = 0;
+        std::atomic<int64_t> bottom = 0;
+        std::atomic<Job *> jobs[JOB_DEQUE_CAPACITY] = {};
+    };
+
+    void _Push(Job *job);
+    void _PushOrPark(Job *job);
+    void _Complete(JobCounter *counter);
+    Job *_FetchJob(uint32_t workerIndex);
+    void _Execute(Job *job);
+    void _WorkerMain(uint32_t workerIndex);
+
+    std::vector<JobDeque *> deques;
+    std::vector<std::thread> workers;
+    std::deque<Job *> sharedJobs;
+    std::mutex sharedMutex;
+    std::atomic<uint32_t> sharedCount = 0;
+    std::atomic<uint32_t> queuedCount = 0;
+    std::atomic<uint32_t> sleepingCount = 0;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<bool> stopFlag = false;
+};
+
+#endif /* _JOB_SYSTEM_H_ */
@@ -0,0 +1,658 @@
+/* ======================================================================== */
+/* TextureLoader.cpp                                                        */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "TextureLoader.h"
+#include <Bright/VFS.h>
+#include <algorithm>
+
+/* satisfy the copy offset rule of every block size we accept */
+#define TEXTURE_REGION_ALIGNMENT 16
+
+#define FOURCC(a, b, c, d) ((uint32_t) (a) | ((uint32_t) (b) << 8) | ((uint32_t) (c) << 16) | ((uint32_t) (d) << 24))
+
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+#define KTX2_HEADER_SIZE 80
+#define KTX2_LEVEL_INDEX_SIZE 24
+#define KTX2_SUPERCOMPRESSION_NONE 0
+
+#define DDS_MAGIC FOURCC('D', 'D', 'S', ' ')
+#define DDS_HEADER_SIZE 128
+#define DDS_HEADER_DX10_SIZE 20
+#define DDS_PIXELFORMAT_FOURCC 0x4
+#define DDS_PIXELFORMAT_RGB 0x40
+#define DDS_CAPS2_CUBEMAP 0x200
+#define DDS_CAPS2_VOLUME 0x200000
+#define DDS_RESOURCE_MISC_TEXTURECUBE 0x4
+#define DDS_DIMENSION_TEXTURE3D 4
+
+template<typename T>
+static T _Read(const uint8_t *pData, size_t offset)
+{
+    T value;
+    memcpy(&value, pData + offset, sizeof(T));
+    return value;
+}
+
+// block dimension is 4 for BCn and 1 for the plain formats.
+static bool _GetFormatBlockInfo(VkFormat format, uint32_t *pBlockBytes, uint32_t *pBlockDim)
+{
+    *pBlockDim = 4;
+
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            *pBlockBytes = 8;
+            return true;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            *pBlockBytes = 16;
+            return true;
+        default:
+            break;
+    }
+
+    *pBlockDim = 1;
+
+    switch (format) {
+        case VK_FORMAT_R8_UNORM:
+            *pBlockBytes = 1;
+            return true;
+        case VK_FORMAT_R8G8_UNORM:
+            *pBlockBytes = 2;
+            return true;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            *pBlockBytes = 4;
+            return true;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            *pBlockBytes = 8;
+            return true;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            *pBlockBytes = 16;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool _IsBlockCompressed(VkFormat format)
+{
+    return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+static size_t _GetImageSize(VkFormat format, uint32_t width, uint32_t height)
+{
+    uint32_t blockBytes, blockDim;
+    _GetFormatBlockInfo(format, &blockBytes, &blockDim);
+
+    size_t blocksX = (width + blockDim - 1) / blockDim;
+    size_t blocksY = (height + blockDim - 1) / blockDim;
+
+    return blocksX * blocksY * blockBytes;
+}
+
+// append a copy region and return where the bytes must go in data.
+static uint8_t *_AppendRegion(TextureImage *pImage, uint32_t mipLevel, uint32_t baseArrayLayer, uint32_t layerCount, size_t size)
+{
+    size_t offset = (std::size(pImage->data) + TEXTURE_REGION_ALIGNMENT - 1) & ~((size_t) TEXTURE_REGION_ALIGNMENT - 1);
+    pImage->data.resize(offset + size);
+    pImage->regions.push_back({ mipLevel, baseArrayLayer, layerCount, offset });
+
+    return std::data(pImage->data) + offset;
+}
+
+struct TextureImageLoadRequest {
+    TextureImage *image;
+    PFN_TextureImageLoadedCallback callback;
+    void *userdata;
+};
+
+static Error _ParseTextureImage(const char *path, const uint8_t *data, size_t size, TextureImage *pImage)
+{
+    if (size >= sizeof(KTX2_IDENTIFIER) && memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+        return ParseKTX2TextureImage(data, size, pImage);
+
+    if (size >= sizeof(uint32_t) && _Read<uint32_t>(data, 0) == DDS_MAGIC)
+        return ParseDDSTextureImage(data, size, pImage);
+
+    printf("Texture loader: unknown container %s\n", path);
+    return FAIL;
+}
+
+Error LoadTextureImage(const char *path, TextureImage *pImage)
+{
+    vfs_view view;
+
+    // parse straight from the view, each level is copied exactly once.
+    if (vfs_map(path, &view) != OK) {
+        printf("Texture loader: open %s failed\n", path);
+        return FAIL;
+    }
+
+    Error err = _ParseTextureImage(path, (const uint8_t *) view.data, view.size, pImage);
+    vfs_unmap(&view);
+
+    return err;
+}
+
+void LoadTextureImageAsync(AsyncIO *io, const char *path, TextureImage *pImage, PFN_TextureImageLoadedCallback callback, void *userdata)
+{
+    std::string nativePath = vfs_native_path(path);
+
+    if (nativePath.empty()) {
+        Error err = LoadTextureImage(path, pImage);
+        callback(err, pImage, userdata);
+        return;
+    }
+
+    TextureImageLoadRequest *request = memnew(TextureImageLoadRequest);
+    request->image = pImage;
+    request->callback = callback;
+    request->userdata = userdata;
+
+    io->ReadAsync(getpchar(nativePath), [] (AsyncReadResult *pResult) {
+        TextureImageLoadRequest *request = (TextureImageLoadRequest *) pResult->userdata;
+        Error err = FAIL;
+
+        if (pResult->err == OK) {
+            err = _ParseTextureImage(getpchar(pResult->path), (const uint8_t *) pResult->buf, pResult->size, request->image);
+            io_free_buf(pResult->buf);
+        } else {
+            printf("Texture loader: read %s failed\n", getpchar(pResult->path));
+        }
+
+        request->callback(err, request->image, request->userdata);
+        memdel(request);
+    }, request);
+}
+
+Error ParseKTX2TextureImage(const uint8_t *pData, size_t size, TextureImage *pImage)
+{
+    if (size < KTX2_HEADER_SIZE || memcmp(pData, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        return FAIL;
+
+    VkFormat format = (VkFormat) _Read<uint32_t>(pData, 12);
+    uint32_t width = _Read<uint32_t>(pData, 20);
+    uint32_t height = std::max(_Read<uint32_t>(pData, 24), 1u);
+    uint32_t depth = _Read<uint32_t>(pData, 28);
+    uint32_t layerCount = std::max(_Read<uint32_t>(pData, 32), 1u);
+    uint32_t faceCount = _Read<uint32_t>(pData, 36);
+    uint32_t levelCount = _Read<uint32_t>(pData, 40);
+    uint32_t supercompressionScheme = _Read<uint32_t>(pData, 44);
+
+    // vkFormat is undefined for Basis Universal (ETC1S and UASTC) payloads.
+    if (format == VK_FORMAT_UNDEFINED || supercompressionScheme != KTX2_SUPERCOMPRESSION_NONE) {
+        printf("Texture loader: KTX2 Basis/UASTC or supercompressed payloads are not supported\n");
+        return FAIL;
+    }
+
+    uint32_t blockBytes, blockDim;
+    if (!_GetFormatBlockInfo(format, &blockBytes, &blockDim)) {
+        printf("Texture loader: unsupported KTX2 format %d\n", format);
+        return FAIL;
+    }
+
+    if (width == 0 || depth > 1 || (faceCount != 1 && faceCount != 6))
+        return FAIL;
+
+    /* level count 0 ask the loader to generate the mip chain */
+    bool generateMipmaps = levelCount == 0;
+    levelCount = std::max(levelCount, 1u);
+
+    if (size < KTX2_HEADER_SIZE + (size_t) levelCount * KTX2_LEVEL_INDEX_SIZE)
+        return FAIL;
+
+    pImage->format = format;
+    pImage->width = width;
+    pImage->height = height;
+    pImage->mipLevels = levelCount;
+    pImage->arrayLayers = layerCount * faceCount;
+    pImage->generateMipmaps = generateMipmaps && !_IsBlockCompressed(format);
+    pImage->data.clear();
+    pImage->regions.clear();
+
+    if (faceCount == 6)
+        pImage->viewType = _Read<uint32_t>(pData, 32) > 0 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+    else
+        pImage->viewType = _Read<uint32_t>(pData, 32) > 0 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        size_t indexOffset = KTX2_HEADER_SIZE + (size_t) level * KTX2_LEVEL_INDEX_SIZE;
+        uint64_t byteOffset = _Read<uint64_t>(pData, indexOffset);
+        uint64_t byteLength = _Read<uint64_t>(pData, indexOffset + 8);
+
+        // every face of every layer is stored back to back inside a level,
+        // which is the order vkCmdCopyBufferToImage expects for layers.
+        size_t levelSize = _GetImageSize(format, std::max(width >> level, 1u), std::max(height >> level, 1u)) * pImage->arrayLayers;
+        if (byteLength < levelSize || byteOffset + levelSize > size)
+            return FAIL;
+
+        uint8_t *dst = _AppendRegion(pImage, level, 0, pImage->arrayLayers, levelSize);
+        memcpy(dst, pData + byteOffset, levelSize);
+    }
+
+    return OK;
+}
+
+static VkFormat _DXGIFormatToVkFormat(uint32_t dxgiFormat)
+{
+    switch (dxgiFormat) {
+        case 2:  return VK_FORMAT_R32G32B32A32_SFLOAT;
+        case 10: return VK_FORMAT_R16G16B16A16_SFLOAT;
+        case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+        case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+        case 49: return VK_FORMAT_R8G8_UNORM;
+        case 61: return VK_FORMAT_R8_UNORM;
+        case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+        case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+        case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+        case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+        case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+        case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+        case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+        case 87: return VK_FORMAT_B8G8R8A8_UNORM;
+        case 91: return VK_FORMAT_B8G8R8A8_SRGB;
+        case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+        case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+        case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+        case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+        default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+static VkFormat _DDSPixelFormatToVkFormat(const uint8_t *pData)
+{
+    uint32_t flags = _Read<uint32_t>(pData, 80);
+    uint32_t fourCC = _Read<uint32_t>(pData, 84);
+
+    if (flags & DDS_PIXELFORMAT_FOURCC) {
+        switch (fourCC) {
+            case FOURCC('D', 'X', 'T', '1'): return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            case FOURCC('D', 'X', 'T', '2'):
+            case FOURCC('D', 'X', 'T', '3'): return VK_FORMAT_BC2_UNORM_BLOCK;
+            case FOURCC('D', 'X', 'T', '4'):
+            case FOURCC('D', 'X', 'T', '5'): return VK_FORMAT_BC3_UNORM_BLOCK;
+            case FOURCC('A', 'T', 'I', '1'):
+            case FOURCC('B', 'C', '4', 'U'): return VK_FORMAT_BC4_UNORM_BLOCK;
+            case FOURCC('B', 'C', '4', 'S'): return VK_FORMAT_BC4_SNORM_BLOCK;
+            case FOURCC('A', 'T', 'I', '2'):
+            case FOURCC('B', 'C', '5', 'U'): return VK_FORMAT_BC5_UNORM_BLOCK;
+            case FOURCC('B', 'C', '5', 'S'): return VK_FORMAT_BC5_SNORM_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    if ((flags & DDS_PIXELFORMAT_RGB) && _Read<uint32_t>(pData, 88) == 32) {
+        uint32_t rMask = _Read<uint32_t>(pData, 92);
+        uint32_t bMask = _Read<uint32_t>(pData, 100);
+
+        if (rMask == 0x000000ff && bMask == 0x00ff0000)
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        if (rMask == 0x00ff0000 && bMask == 0x000000ff)
+            return VK_FORMAT_B8G8R8A8_UNORM;
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+Error ParseDDSTextureImage(const uint8_t *pData, size_t size, TextureImage *pImage)
+{
+    if (size < DDS_HEADER_SIZE || _Read<uint32_t>(pData, 0) != DDS_MAGIC)
+        return FAIL;
+
+    uint32_t height = _Read<uint32_t>(pData, 12);
+    uint32_t width = _Read<uint32_t>(pData, 16);
+    uint32_t mipMapCount = std::max(_Read<uint32_t>(pData, 28), 1u);
+    uint32_t caps2 = _Read<uint32_t>(pData, 112);
+    uint32_t fourCC = _Read<uint32_t>(pData, 84);
+
+    VkFormat format;
+    uint32_t layerCount = 1;
+    bool cube = (caps2 & DDS_CAPS2_CUBEMAP) != 0;
+    bool array = false;
+    size_t offset = DDS_HEADER_SIZE;
+
+    if ((_Read<uint32_t>(pData, 80) & DDS_PIXELFORMAT_FOURCC) && fourCC == FOURCC('D', 'X', '1', '0')) {
+        if (size < DDS_HEADER_SIZE + DDS_HEADER_DX10_SIZE)
+            return FAIL;
+
+        format = _DXGIFormatToVkFormat(_Read<uint32_t>(pData, 128));
+        if (_Read<uint32_t>(pData, 132) == DDS_DIMENSION_TEXTURE3D)
+            return FAIL;
+
+        cube = (_Read<uint32_t>(pData, 136) & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+        layerCount = std::max(_Read<uint32_t>(pData, 140), 1u);
+        array = layerCount > 1;
+        offset += DDS_HEADER_DX10_SIZE;
+    } else {
+        format = _DDSPixelFormatToVkFormat(pData);
+    }
+
+    if (format == VK_FORMAT_UNDEFINED || (caps2 & DDS_CAPS2_VOLUME) || width == 0 || height == 0) {
+        printf("Texture loader: unsupported DDS format\n");
+        return FAIL;
+    }
+
+    if (cube)
+        layerCount *= 6;
+
+    pImage->format = format;
+    pImage->width = width;
+    pImage->height = height;
+    pImage->mipLevels = mipMapCount;
+    pImage->arrayLayers = layerCount;
+    pImage->generateMipmaps = false;
+    pImage->data.clear();
+    pImage->regions.clear();
+
+    if (cube)
+        pImage->viewType = array ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+    else
+        pImage->viewType = array ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+
+    // DDS store the full mip chain of a layer before the next layer.
+    for (uint32_t layer = 0; layer < layerCount; layer++) {
+        for (uint32_t level = 0; level < mipMapCount; level++) {
+            size_t imageSize = _GetImageSize(format, std::max(width >> level, 1u), std::max(height >> level, 1u));
+            if (offset + imageSize > size)
+                return FAIL;
+
+            uint8_t *dst = _AppendRegion(pImage, level, layer, 1, imageSize);
+            memcpy(dst, pData + offset, imageSize);
+            offset += imageSize;
+        }
+    }
+
+    return OK;
+}
+
+static void _DecodeColor565(uint16_t color, uint8_t *pRGB)
+{
+    pRGB[0] = (uint8_t) (((color >> 11) & 0x1f) * 255 / 31);
+    pRGB[1] = (uint8_t) (((color >> 5) & 0x3f) * 255 / 63);
+    pRGB[2] = (uint8_t) ((color & 0x1f) * 255 / 31);
+}
+
+// decode the BC1 color part, opaque blocks always use four colors.
+static void _DecodeBC1ColorBlock(const uint8_t *pBlock, uint8_t pTexels[16][4], bool forceFourColors)
+{
+    uint16_t c0 = _Read<uint16_t>(pBlock, 0);
+    uint16_t c1 = _Read<uint16_t>(pBlock, 2);
+    uint32_t indices = _Read<uint32_t>(pBlock, 4);
+
+    uint8_t palette[4][4];
+    _DecodeColor565(c0, palette[0]);
+    _DecodeColor565(c1, palette[1]);
+    palette[0][3] = palette[1][3] = 255;
+
+    for (int i = 0; i < 3; i++) {
+        if (c0 > c1 || forceFourColors) {
+            palette[2][i] = (uint8_t) ((2 * palette[0][i] + palette[1][i]) / 3);
+            palette[3][i] = (uint8_t) ((palette[0][i] + 2 * palette[1][i]) / 3);
+        } else {
+            palette[2][i] = (uint8_t) ((palette[0][i] + palette[1][i]) / 2);
+            palette[3][i] = 0;
+        }
+    }
+
+    palette[2][3] = 255;
+    palette[3][3] = (c0 > c1 || forceFourColors) ? 255 : 0;
+
+    for (int i = 0; i < 16; i++)
+        memcpy(pTexels[i], palette[(indices >> (i * 2)) & 0x3], 4);
+}
+
+// BC3 alpha, BC4 and BC5 share this eight values interpolated block. snorm
+// endpoints are signed (-128 read as -127), the texels keep their two's
+// complement bits for an R8G8B8A8_SNORM image.
+static void _DecodeBC4Block(const uint8_t *pBlock, uint8_t pTexels[16][4], int channel, bool snorm = false)
+{
+    int minValue = snorm ? -127 : 0;
+    int maxValue = snorm ? 127 : 255;
+
+    int values[8];
+    values[0] = snorm ? std::max((int) (int8_t) pBlock[0], minValue) : pBlock[0];
+    values[1] = snorm ? std::max((int) (int8_t) pBlock[1], minValue) : pBlock[1];
+
+    if (values[0] > values[1]) {
+        for (int i = 1; i < 7; i++)
+            values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7;
+    } else {
+        for (int i = 1; i < 5; i++)
+            values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5;
+        values[6] = minValue;
+        values[7] = maxValue;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; i++)
+        indices |= (uint64_t) pBlock[2 + i] << (i * 8);
+
+    for (int i = 0; i < 16; i++)
+        pTexels[i][channel] = (uint8_t) values[(indices >> (i * 3)) & 0x7];
+}
+
+static Error _DecodeBlock(VkFormat format, const uint8_t *pBlock, uint8_t pTexels[16][4])
+{
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            _DecodeBC1ColorBlock(pBlock, pTexels, false);
+            return OK;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK: {
+            _DecodeBC1ColorBlock(pBlock + 8, pTexels, true);
+            uint64_t alpha = _Read<uint64_t>(pBlock, 0);
+            for (int i = 0; i < 16; i++)
+                pTexels[i][3] = (uint8_t) (((alpha >> (i * 4)) & 0xf) * 17);
+            return OK;
+        }
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            _DecodeBC1ColorBlock(pBlock + 8, pTexels, true);
+            _DecodeBC4Block(pBlock, pTexels, 3);
+            return OK;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            memset(pTexels, 0, 16 * 4);
+            _DecodeBC4Block(pBlock, pTexels, 0);
+            for (int i = 0; i < 16; i++)
+                pTexels[i][3] = 255;
+            return OK;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            memset(pTexels, 0, 16 * 4);
+            _DecodeBC4Block(pBlock, pTexels, 0);
+            _DecodeBC4Block(pBlock + 8, pTexels, 1);
+            for (int i = 0; i < 16; i++)
+                pTexels[i][3] = 255;
+            return OK;
+        /* alpha is 1.0, 127 in snorm */
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            memset(pTexels, 0, 16 * 4);
+            _DecodeBC4Block(pBlock, pTexels, 0, true);
+            for (int i = 0; i < 16; i++)
+                pTexels[i][3] = 127;
+            return OK;
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+            memset(pTexels, 0, 16 * 4);
+            _DecodeBC4Block(pBlock, pTexels, 0, true);
+            _DecodeBC4Block(pBlock + 8, pTexels, 1, true);
+            for (int i = 0; i < 16; i++)
+                pTexels[i][3] = 127;
+            return OK;
+        default:
+            return FAIL;
+    }
+}
+
+static bool _IsSRGBFormat(VkFormat format)
+{
+    return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+           format == VK_FORMAT_BC2_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK;
+}
+
+static bool _IsSNORMFormat(VkFormat format)
+{
+    return format == VK_FORMAT_BC4_SNORM_BLOCK || format == VK_FORMAT_BC5_SNORM_BLOCK;
+}
+
+Error DecompressTextureImage(TextureImage *pImage)
+{
+    if (!_IsBlockCompressed(pImage->format))
+        return OK;
+
+    VkFormat format = pImage->format;
+    size_t blockBytes = _GetImageSize(format, 4, 4);
+
+    TextureImage decoded;
+    decoded.format = _IsSRGBFormat(format) ? VK_FORMAT_R8G8B8A8_SRGB : _IsSNORMFormat(format) ? VK_FORMAT_R8G8B8A8_SNORM : VK_FORMAT_R8G8B8A8_UNORM;
+    decoded.viewType = pImage->viewType;
+    decoded.width = pImage->width;
+    decoded.height = pImage->height;
+    decoded.mipLevels = pImage->mipLevels;
+    decoded.arrayLayers = pImage->arrayLayers;
+
+    for (const RenderDevice::TextureRegion &region : pImage->regions) {
+        uint32_t width = std::max(pImage->width >> region.mipLevel, 1u);
+        uint32_t height = std::max(pImage->height >> region.mipLevel, 1u);
+        uint32_t blocksX = (width + 3) / 4;
+        uint32_t blocksY = (height + 3) / 4;
+        size_t imageSize = _GetImageSize(format, width, height);
+
+        uint8_t *dst = _AppendRegion(&decoded, region.mipLevel, region.baseArrayLayer, region.layerCount, (size_t) width * height * 4 * region.layerCount);
+        const uint8_t *src = std::data(pImage->data) + region.offset;
+
+        for (uint32_t layer = 0; layer < region.layerCount; layer++) {
+            const uint8_t *layerSrc = src + layer * imageSize;
+            uint8_t *layerDst = dst + (size_t) layer * width * height * 4;
+
+            for (uint32_t by = 0; by < blocksY; by++) {
+                for (uint32_t bx = 0; bx < blocksX; bx++) {
+                    uint8_t texels[16][4];
+                    if (_DecodeBlock(format, layerSrc + (by * blocksX + bx) * blockBytes, texels) != OK) {
+                        printf("Texture loader: no CPU decoder for format %d\n", format);
+                        return FAIL;
+                    }
+
+                    /* clip the block at the right and bottom edge */
+                    for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+                        for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+                            memcpy(layerDst + ((size_t) (by * 4 + y) * width + bx * 4 + x) * 4, texels[y * 4 + x], 4);
+                }
+            }
+        }
+    }
+
+    *pImage = std::move(decoded);
+
+    return OK;
+}
+
+size_t GetTextureImageLevelSize(const TextureImage *pImage, uint32_t mipLevel)
+{
+    return _GetImageSize(pImage->format, std::max(pImage->width >> mipLevel, 1u), std::max(pImage->height >> mipLevel, 1u)) * pImage->arrayLayers;
+}
+
+bool IsTextureFormatSupported(RenderDevice *vRD, VkFormat format)
+{
+    RenderDeviceContext *rdc = vRD->GetDeviceContext();
+
+    if (_IsBlockCompressed(format) && !rdc->GetPhysicalDeviceFeatures().textureCompressionBC)
+        return false;
+
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(rdc->GetPhysicalDevice(), format, &properties);
+
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+RenderDevice::TextureHandle CreateTextureFromImage(RenderDevice *vRD, TextureImage *pImage, uint32_t baseMipLevel)
+{
+    if (!IsTextureFormatSupported(vRD, pImage->format)) {
+        if (DecompressTextureImage(pImage) != OK || !IsTextureFormatSupported(vRD, pImage->format))
+            return {};
+    }
+
+    // without blit support the texture keep the single level of the image.
+    bool generateMipmaps = pImage->generateMipmaps && vRD->IsMipmapGenerationSupported(pImage->format);
+    baseMipLevel = generateMipmaps ? 0 : std::min(baseMipLevel, pImage->mipLevels - 1);
+
+    RenderDevice::TextureCreateInfo texture_create_info = {
+            /* width */ std::max(pImage->width >> baseMipLevel, 1u),
+            /* height */ std::max(pImage->height >> baseMipLevel, 1u),
+            /* samples */ VK_SAMPLE_COUNT_1_BIT,
+            /* format */ pImage->format,
+            /* aspectMask */ VK_IMAGE_ASPECT_COLOR_BIT,
+            /* imageType */ VK_IMAGE_TYPE_2D,
+            /* imageViewType */ pImage->viewType,
+            /* usage */ VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            /* mipLevels */ generateMipmaps ? RENDER_DEVICE_FULL_MIP_CHAIN : pImage->mipLevels - baseMipLevel,
+            /* arrayLayers */ pImage->arrayLayers,
+    };
+
+    RenderDevice::TextureHandle texture = vRD->CreateTexture(&texture_create_info);
+
+    // the generated chain only need level 0, which is the first region.
+    if (generateMipmaps) {
+        vRD->WriteTexture(texture, std::size(pImage->data), std::data(pImage->data));
+        return texture;
+    }
+
+    if (baseMipLevel == 0) {
+        vRD->WriteTextureRegions(texture, std::size(pImage->data), std::data(pImage->data), (uint32_t) std::size(pImage->regions), std::data(pImage->regions));
+        return texture;
+    }
+
+    /* repack the remaining levels so only their bytes are staged */
+    TextureImage subset;
+    for (const RenderDevice::TextureRegion &region : pImage->regions) {
+        if (region.mipLevel < baseMipLevel)
+            continue;
+
+        size_t size = _GetImageSize(pImage->format, std::max(pImage->width >> region.mipLevel, 1u), std::max(pImage->height >> region.mipLevel, 1u)) * region.layerCount;
+        uint8_t *dst = _AppendRegion(&subset, region.mipLevel - baseMipLevel, region.baseArrayLayer, region.layerCount, size);
+        memcpy(dst, std::data(pImage->data) + region.offset, size);
+    }
+
+    vRD->WriteTextureRegions(texture, std::size(subset.data), std::data(subset.data), (uint32_t) std::size(subset.regions), std::data(subset.regions));
+
+    return texture;
+}
@@ -0,0 +1,74 @@
+/* ======================================================================== */
+/* TextureLoader.h                                                          */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _TEXTURE_LOADER_H_
+#define _TEXTURE_LOADER_H_
+
+#include "RT/Drivers/RenderDevice.h"
+#include "RT/IO/AsyncIO.h"
+#include <vector>
+
+// CPU side copy of a texture container, every subresource is packed into
+// data and described by one region, ready for a single staging upload.
+struct TextureImage {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 1;
+    uint32_t arrayLayers = 1;
+    /* container ask the mip chain to be generated at load */
+    bool generateMipmaps = false;
+    std::vector<uint8_t> data;
+    std::vector<RenderDevice::TextureRegion> regions;
+};
+
+// path is a VFS path. Only KTX2 without supercompression and DDS (legacy and DX10 header) are
+// supported, BasisLZ/UASTC payloads are rejected because no transcoder is
+// built into the engine.
+Error LoadTextureImage(const char *path, TextureImage *pImage);
+
+typedef void (*PFN_TextureImageLoadedCallback) (Error err, TextureImage *pImage, void *userdata);
+
+// read and parse the file on an AsyncIO worker, callback run on that worker
+// and pImage must stay alive until then. Only directory mounts have a file
+// to read, archive and memory mounts are loaded synchronously and callback
+// run before the function return.
+void LoadTextureImageAsync(AsyncIO *io, const char *path, TextureImage *pImage, PFN_TextureImageLoadedCallback callback, void *userdata);
+Error ParseKTX2TextureImage(const uint8_t *pData, size_t size, TextureImage *pImage);
+Error ParseDDSTextureImage(const uint8_t *pData, size_t size, TextureImage *pImage);
+
+// decode BC1-BC5 into RGBA8 in place (SNORM for BC4/BC5 SNORM), for devices
+// without the BC feature.
+Error DecompressTextureImage(TextureImage *pImage);
+
+// bytes of one mip level across every layer of the image.
+size_t GetTextureImageLevelSize(const TextureImage *pImage, uint32_t mipLevel);
+bool IsTextureFormatSupported(RenderDevice *vRD, VkFormat format);
+
+// create the texture and upload all mips at once, fall back to the CPU
+// decoder when the device cannot sample the compressed format. baseMipLevel
+// drop the larger mips, the texture extent become the one of that level.
+// Sample it with a sampler whose maxLod cover the chain.
+RenderDevice::TextureHandle CreateTextureFromImage(RenderDevice *vRD, TextureImage *pImage, uint32_t baseMipLevel = 0);
+
+#endif /* _TEXTURE_LOADER_H_ */
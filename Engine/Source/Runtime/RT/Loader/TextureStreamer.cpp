@@ -0,0 +1,466 @@
+/* ======================================================================== */
+/* TextureStreamer.cpp                                                      */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <math.h>
+
+TextureStreamer::TextureStreamer(RenderDevice *vRD, const TextureStreamerSettings &vSettings)
+    : rd(vRD), settings(vSettings)
+{
+    VkResult U_ASSERT_ONLY err;
+    RenderDeviceContext *rdc = rd->GetDeviceContext();
+
+    VkCommandPoolCreateInfo cmd_pool_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            /* pNext */ VK_NULL_HANDLE,
+            /* flags */ VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            /* queueFamilyIndex */ rdc->GetQueueFamily()
+    };
+
+    err = vkCreateCommandPool(rdc->GetDevice(), &cmd_pool_create_info, VK_NULL_HANDLE, &cmdPool);
+    assert(!err);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(rd->GetDeviceContext()->GetQueueMutex());
+        vkDeviceWaitIdle(rd->GetDeviceContext()->GetDevice());
+    }
+
+    _ReleasePendingUploads(true);
+
+    for (StreamedTexture *streamedTexture : textures) {
+        if (streamedTexture->texture)
+            rd->DestroyTexture(streamedTexture->texture);
+        memdel(streamedTexture);
+    }
+
+    _DestroyRetiredTextures(true);
+
+    vkDestroyCommandPool(rd->GetDeviceContext()->GetDevice(), cmdPool, VK_NULL_HANDLE);
+}
+
+StreamedTexture *TextureStreamer::RegisterTexture(TextureImage *pImage, VkSampler sampler)
+{
+    StreamedTexture *streamedTexture = memnew(StreamedTexture);
+    streamedTexture->image = std::move(*pImage);
+    streamedTexture->sampler = sampler;
+    streamedTexture->lastUsedFrame = frame;
+
+    // decode once here instead of every time a mip range is uploaded.
+    if (!IsTextureFormatSupported(rd, streamedTexture->image.format)) {
+        if (DecompressTextureImage(&streamedTexture->image) != OK || !IsTextureFormatSupported(rd, streamedTexture->image.format)) {
+            printf("Texture streamer: format %d is not supported by the device\n", streamedTexture->image.format);
+            memdel(streamedTexture);
+            return NULL;
+        }
+    }
+
+    uint32_t tailMip = _GetTailMip(streamedTexture);
+    streamedTexture->requestedMip = tailMip;
+
+    _CreateTexture(streamedTexture, tailMip);
+    _Upload(streamedTexture, tailMip, streamedTexture->image.mipLevels, true);
+    _SetResidentMip(streamedTexture, tailMip);
+
+    textures.push_back(streamedTexture);
+
+    return streamedTexture;
+}
+
+void TextureStreamer::UnregisterTexture(StreamedTexture *pStreamedTexture)
+{
+    if (pStreamedTexture->texture) {
+        _RetireTexture(pStreamedTexture->texture);
+        residentBytes -= pStreamedTexture->residentBytes;
+    }
+
+    textures.erase(std::remove(textures.begin(), textures.end(), pStreamedTexture), textures.end());
+    memdel(pStreamedTexture);
+}
+
+void TextureStreamer::RequestMipLevel(StreamedTexture *pStreamedTexture, uint32_t mipLevel)
+{
+    mipLevel = std::min(mipLevel, pStreamedTexture->image.mipLevels - 1);
+
+    if (pStreamedTexture->lastUsedFrame != frame)
+        pStreamedTexture->requestedMip = mipLevel;
+    else
+        pStreamedTexture->requestedMip = std::min(pStreamedTexture->requestedMip, mipLevel);
+
+    pStreamedTexture->lastUsedFrame = frame;
+}
+
+void TextureStreamer::RequestScreenSize(StreamedTexture *pStreamedTexture, float screenWidth, float screenHeight)
+{
+    // one texel per pixel, every halving of the coverage drop a level.
+    float ratio = std::max(pStreamedTexture->image.width / std::max(screenWidth, 1.0f),
+                           pStreamedTexture->image.height / std::max(screenHeight, 1.0f));
+
+    uint32_t mipLevel = ratio > 1.0f ? (uint32_t) floorf(log2f(ratio)) : 0;
+    RequestMipLevel(pStreamedTexture, mipLevel);
+}
+
+void TextureStreamer::Update()
+{
+    _ReleasePendingUploads(false);
+    _DestroyRetiredTextures(false);
+
+    /* budget may have been lowered since the last frame */
+    _EvictFor(0, NULL);
+
+    std::vector<StreamedTexture *> promotions;
+    for (StreamedTexture *streamedTexture : textures) {
+        if (streamedTexture->lastUsedFrame == frame && streamedTexture->requestedMip < streamedTexture->residentMip)
+            promotions.push_back(streamedTexture);
+    }
+
+    // most starved textures first, they are the most visibly blurry.
+    std::sort(promotions.begin(), promotions.end(), [](StreamedTexture *a, StreamedTexture *b) {
+        return a->residentMip - a->requestedMip > b->residentMip - b->requestedMip;
+    });
+
+    VkDeviceSize uploadBytes = 0;
+    for (StreamedTexture *streamedTexture : promotions) {
+        uint32_t mipLevel = streamedTexture->requestedMip;
+        uint32_t residentMip = streamedTexture->residentMip;
+
+        /* step toward the request when it doesn't fit this frame upload */
+        while (mipLevel < residentMip && uploadBytes + _GetLevelsBytes(streamedTexture, mipLevel, residentMip) > settings.uploadBytesPerFrame)
+            ++mipLevel;
+
+        // a level larger than the whole per frame budget would never fit,
+        // the first upload of a frame always go one level up.
+        if (mipLevel >= residentMip && uploadBytes == 0)
+            mipLevel = residentMip - 1;
+
+        if (mipLevel >= residentMip)
+            continue;
+
+        if (streamedTexture->textureBaseMip > mipLevel) {
+            // only the tail is allocated, move to the full chain once so
+            // later promotions don't recreate it. The tail is re-uploaded
+            // from the CPU copy, it's a few KB.
+            VkDeviceSize chainBytes = _GetLevelsBytes(streamedTexture, 0, streamedTexture->image.mipLevels);
+            VkDeviceSize extraBytes = chainBytes > streamedTexture->residentBytes ? chainBytes - streamedTexture->residentBytes : 0;
+            if (!_EvictFor(extraBytes, streamedTexture))
+                continue;
+
+            _CreateTexture(streamedTexture, 0);
+            _Upload(streamedTexture, mipLevel, streamedTexture->image.mipLevels, true);
+            uploadBytes += _GetLevelsBytes(streamedTexture, mipLevel, streamedTexture->image.mipLevels);
+        } else {
+            _Upload(streamedTexture, mipLevel, residentMip, false);
+            uploadBytes += _GetLevelsBytes(streamedTexture, mipLevel, residentMip);
+        }
+
+        _SetResidentMip(streamedTexture, mipLevel);
+    }
+
+    ++frame;
+}
+
+uint32_t TextureStreamer::_GetTailMip(StreamedTexture *pStreamedTexture)
+{
+    TextureImage *image = &pStreamedTexture->image;
+
+    // generated chains only exist on the GPU, they can't be streamed.
+    if (image->generateMipmaps)
+        return 0;
+
+    uint32_t mipLevel = 0;
+    while (mipLevel + 1 < image->mipLevels && ((image->width >> mipLevel) > settings.tailSize || (image->height >> mipLevel) > settings.tailSize))
+        ++mipLevel;
+
+    return mipLevel;
+}
+
+VkDeviceSize TextureStreamer::_GetLevelsBytes(StreamedTexture *pStreamedTexture, uint32_t firstMip, uint32_t lastMip)
+{
+    VkDeviceSize bytes = 0;
+    for (uint32_t i = firstMip; i < lastMip; i++)
+        bytes += GetTextureImageLevelSize(&pStreamedTexture->image, i);
+
+    return bytes;
+}
+
+bool TextureStreamer::_IsHeapOverBudget(VkDeviceSize extraBytes)
+{
+    VmaAllocator allocator = rd->GetDeviceContext()->GetAllocator();
+
+    const VkPhysicalDeviceMemoryProperties *properties;
+    vmaGetMemoryProperties(allocator, &properties);
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(allocator, budgets);
+
+    for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+        if (!(properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+            continue;
+
+        /* retired textures are about to be released, don't count them */
+        VkDeviceSize usage = budgets[i].usage > retiredBytes ? budgets[i].usage - retiredBytes : 0;
+        if ((double) (usage + extraBytes) > (double) budgets[i].budget * settings.heapBudgetFraction)
+            return true;
+    }
+
+    return false;
+}
+
+bool TextureStreamer::_EvictFor(VkDeviceSize bytes, StreamedTexture *pExclude)
+{
+    while (residentBytes + bytes > settings.budget || _IsHeapOverBudget(bytes)) {
+        StreamedTexture *victim = NULL;
+
+        // least recently used first, never touch what this frame needs.
+        for (StreamedTexture *streamedTexture : textures) {
+            if (streamedTexture == pExclude || streamedTexture->lastUsedFrame == frame)
+                continue;
+
+            if (streamedTexture->textureBaseMip >= _GetTailMip(streamedTexture))
+                continue;
+
+            if (!victim || streamedTexture->lastUsedFrame < victim->lastUsedFrame ||
+                (streamedTexture->lastUsedFrame == victim->lastUsedFrame && streamedTexture->residentBytes > victim->residentBytes))
+                victim = streamedTexture;
+        }
+
+        if (!victim)
+            return false;
+
+        // clamping the view frees nothing, drop the whole chain back to a
+        // tail only texture.
+        uint32_t tailMip = _GetTailMip(victim);
+        _CreateTexture(victim, tailMip);
+        _Upload(victim, tailMip, victim->image.mipLevels, true);
+        _SetResidentMip(victim, tailMip);
+    }
+
+    return true;
+}
+
+void TextureStreamer::_CreateTexture(StreamedTexture *pStreamedTexture, uint32_t baseMip)
+{
+    TextureImage *image = &pStreamedTexture->image;
+
+    RenderDevice::TextureCreateInfo texture_create_info = {
+            /* width */ std::max(image->width >> baseMip, 1u),
+            /* height */ std::max(image->height >> baseMip, 1u),
+            /* samples */ VK_SAMPLE_COUNT_1_BIT,
+            /* format */ image->format,
+            /* aspectMask */ VK_IMAGE_ASPECT_COLOR_BIT,
+            /* imageType */ VK_IMAGE_TYPE_2D,
+            /* imageViewType */ image->viewType,
+            /* usage */ VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            /* mipLevels */ image->generateMipmaps && rd->IsMipmapGenerationSupported(image->format) ? RENDER_DEVICE_FULL_MIP_CHAIN : image->mipLevels - baseMip,
+            /* arrayLayers */ image->arrayLayers,
+    };
+
+    RenderDevice::TextureHandle texture = rd->CreateTexture(&texture_create_info);
+    rd->BindTextureSampler(texture, pStreamedTexture->sampler);
+
+    if (pStreamedTexture->texture)
+        _RetireTexture(pStreamedTexture->texture);
+
+    residentBytes -= pStreamedTexture->residentBytes;
+    pStreamedTexture->texture = texture;
+    pStreamedTexture->textureBaseMip = baseMip;
+    pStreamedTexture->residentBytes = rd->GetTexture(texture)->allocationInfo.size;
+    residentBytes += pStreamedTexture->residentBytes;
+}
+
+void TextureStreamer::_Upload(StreamedTexture *pStreamedTexture, uint32_t firstMip, uint32_t lastMip, bool initialize)
+{
+    VkResult U_ASSERT_ONLY err;
+    VkDevice device = rd->GetDeviceContext()->GetDevice();
+    TextureImage *image = &pStreamedTexture->image;
+    RenderDevice::Texture2D *texture = rd->GetTexture(pStreamedTexture->texture);
+    uint32_t baseMip = pStreamedTexture->textureBaseMip;
+
+    // a generated chain only need level 0, the rest is blit on the GPU.
+    if (image->generateMipmaps)
+        lastMip = 1;
+
+    /* pack the regions of the range, offsets stay aligned like the loader ones */
+    std::vector<VkBufferImageCopy> copies;
+    std::vector<const uint8_t *> sources;
+    VkDeviceSize stagingSize = 0;
+
+    for (const RenderDevice::TextureRegion &region : image->regions) {
+        if (region.mipLevel < firstMip || region.mipLevel >= lastMip)
+            continue;
+
+        VkBufferImageCopy copy = {};
+        copy.bufferOffset = (stagingSize + 15) & ~(VkDeviceSize) 15;
+        copy.imageSubresource.aspectMask = texture->aspectMask;
+        copy.imageSubresource.mipLevel = region.mipLevel - baseMip;
+        copy.imageSubresource.baseArrayLayer = region.baseArrayLayer;
+        copy.imageSubresource.layerCount = region.layerCount;
+        copy.imageOffset = { 0, 0, 0 };
+        copy.imageExtent = { std::max(image->width >> region.mipLevel, 1u), std::max(image->height >> region.mipLevel, 1u), 1 };
+
+        stagingSize = copy.bufferOffset + GetTextureImageLevelSize(image, region.mipLevel) / image->arrayLayers * region.layerCount;
+        copies.push_back(copy);
+        sources.push_back(std::data(image->data) + region.offset);
+    }
+
+    RenderDevice::BufferHandle buffer = rd->CreateBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, stagingSize);
+    for (size_t i = 0; i < std::size(copies); i++) {
+        uint32_t mipLevel = copies[i].imageSubresource.mipLevel + baseMip;
+        VkDeviceSize size = GetTextureImageLevelSize(image, mipLevel) / image->arrayLayers * copies[i].imageSubresource.layerCount;
+        rd->WriteBuffer(buffer, copies[i].bufferOffset, size, (void *) sources[i]);
+    }
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+            /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            /* pNext */ VK_NULL_HANDLE,
+            /* commandPool */ cmdPool,
+            /* level */ VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            /* commandBufferCount */ 1,
+    };
+
+    VkCommandBuffer cmdBuffer;
+    err = vkAllocateCommandBuffers(device, &command_buffer_allocate_info, &cmdBuffer);
+    assert(!err);
+
+    rd->CmdBufferBegin(cmdBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    // the levels not uploaded yet are moved to the sampled layout too, the
+    // view never expose them but the whole image then share one layout.
+    RenderDevice::PipelineMemoryBarrier barrier;
+    barrier.image.texture = pStreamedTexture->texture;
+    if (initialize && firstMip > baseMip && !image->generateMipmaps) {
+        barrier.image.levelCount = firstMip - baseMip;
+        barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.image.newImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.image.srcAccessMask = 0;
+        barrier.image.dstAccessMask = 0;
+        rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+    }
+
+    /* previous content of the range is discarded, frames in flight don't sample it */
+    barrier.image.baseMipLevel = firstMip - baseMip;
+    barrier.image.levelCount = image->generateMipmaps ? VK_REMAINING_MIP_LEVELS : lastMip - firstMip;
+    barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.image.newImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.image.srcAccessMask = 0;
+    barrier.image.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    vkCmdCopyBufferToImage(cmdBuffer, rd->GetBuffer(buffer)->vkBuffer, texture->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t) std::size(copies), std::data(copies));
+
+    // the barrier cover every later submission on the queue, frames built
+    // after this Update sample the copied levels.
+    bool generateMipmaps = image->generateMipmaps && texture->mipLevels > 1;
+    if (!generateMipmaps || rd->CmdGenerateMipmaps(cmdBuffer, pStreamedTexture->texture) != OK) {
+        barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.image.newImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.image.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.image.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+    }
+
+    rd->CmdBufferEnd(cmdBuffer);
+
+    VkFenceCreateInfo fence_create_info = {};
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    VkFence fence;
+    err = vkCreateFence(device, &fence_create_info, VK_NULL_HANDLE, &fence);
+    assert(!err);
+
+    rd->CmdBufferSubmit(cmdBuffer,
+        0, VK_NULL_HANDLE,
+        0, VK_NULL_HANDLE,
+        VK_NULL_HANDLE,
+        rd->GetDeviceContext()->GetQueue(),
+        fence);
+
+    pendingUploads.push_back({ cmdBuffer, fence, buffer });
+}
+
+void TextureStreamer::_SetResidentMip(StreamedTexture *pStreamedTexture, uint32_t mipLevel)
+{
+    RenderDevice::Texture2D *texture = rd->GetTexture(pStreamedTexture->texture);
+    uint32_t baseMipLevel = mipLevel - pStreamedTexture->textureBaseMip;
+
+    if (texture->baseMipLevel != baseMipLevel) {
+        _RetireImageView(texture->imageView);
+        texture->baseMipLevel = baseMipLevel;
+        rd->CreateTextureImageView(pStreamedTexture->texture);
+    }
+
+    texture->size = _GetLevelsBytes(pStreamedTexture, mipLevel, pStreamedTexture->image.mipLevels);
+    pStreamedTexture->residentMip = mipLevel;
+
+    if (fnTextureResidencyChangedCallback)
+        fnTextureResidencyChangedCallback(pStreamedTexture, pStreamedTexture->texture);
+}
+
+void TextureStreamer::_RetireTexture(RenderDevice::TextureHandle texture)
+{
+    retiredTextures.push_back({ texture, VK_NULL_HANDLE, frame });
+    retiredBytes += rd->GetTexture(texture)->allocationInfo.size;
+}
+
+void TextureStreamer::_RetireImageView(VkImageView imageView)
+{
+    retiredTextures.push_back({ {}, imageView, frame });
+}
+
+void TextureStreamer::_DestroyRetiredTextures(bool all)
+{
+    while (!retiredTextures.empty()) {
+        RetiredTexture retired = retiredTextures.front();
+        if (!all && frame - retired.frame < settings.retireFrames)
+            break;
+
+        if (retired.texture) {
+            retiredBytes -= rd->GetTexture(retired.texture)->allocationInfo.size;
+            rd->DestroyTexture(retired.texture);
+        }
+
+        if (retired.imageView)
+            vkDestroyImageView(rd->GetDeviceContext()->GetDevice(), retired.imageView, VK_NULL_HANDLE);
+
+        retiredTextures.pop_front();
+    }
+}
+
+void TextureStreamer::_ReleasePendingUploads(bool all)
+{
+    VkDevice device = rd->GetDeviceContext()->GetDevice();
+
+    // a single queue signal the fences in submission order.
+    while (!pendingUploads.empty()) {
+        PendingUpload pending = pendingUploads.front();
+        if (!all && vkGetFenceStatus(device, pending.fence) != VK_SUCCESS)
+            break;
+
+        vkDestroyFence(device, pending.fence, VK_NULL_HANDLE);
+        vkFreeCommandBuffers(device, cmdPool, 1, &pending.cmdBuffer);
+        rd->DestroyBuffer(pending.buffer);
+        pendingUploads.pop_front();
+    }
+}
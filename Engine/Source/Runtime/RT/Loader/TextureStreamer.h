@@ -0,0 +1,141 @@
+/* ======================================================================== */
+/* TextureStreamer.h                                                        */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _TEXTURE_STREAMER_H_
+#define _TEXTURE_STREAMER_H_
+
+#include "TextureLoader.h"
+#include <deque>
+
+struct StreamedTexture;
+
+// called when the view of a streamed texture changed, either the clamp moved
+// or the texture was recreated. Frames in flight may still use the previous
+// view for retireFrames updates, so descriptor sets referencing it must be
+// replaced by new ones instead of being rewritten in place.
+typedef void (*PFN_TextureResidencyChangedCallback) (StreamedTexture *pStreamedTexture, RenderDevice::TextureHandle texture);
+
+struct StreamedTexture {
+    TextureImage image;
+    // the full chain once promoted past the tail, only the tail before that.
+    RenderDevice::TextureHandle texture;
+    VkSampler sampler = VK_NULL_HANDLE;
+    /* mip of the image stored in level 0 of texture */
+    uint32_t textureBaseMip = 0;
+    /* most detailed mip the view expose, mipLevels - 1 is the smallest */
+    uint32_t residentMip = 0;
+    /* most detailed mip asked by the renderer since the last update */
+    uint32_t requestedMip = 0;
+    uint64_t lastUsedFrame = 0;
+    /* bytes of the texture allocation */
+    VkDeviceSize residentBytes = 0;
+    void *userdata = NULL;
+};
+
+struct TextureStreamerSettings {
+    /* bytes of streamed textures allowed on the GPU */
+    VkDeviceSize budget = 256ull << 20;
+    /* keep heap usage under this fraction of the VMA budget */
+    float heapBudgetFraction = 0.9f;
+    /* bytes uploaded per Update, bounds the staging memory of a frame. The
+       first promotion of an Update always go one level up, even past it */
+    VkDeviceSize uploadBytesPerFrame = 32ull << 20;
+    /* mips with both sides at or below this are always resident */
+    uint32_t tailSize = 64;
+    /* frames before a replaced texture or view can be destroyed */
+    uint32_t retireFrames = 3;
+};
+
+// Keep a subset of every registered texture mip chain resident on the GPU.
+// Textures start with only their small tail mips, the first promotion past
+// the tail allocate the full chain once and every later promotion only copy
+// the new mips into it and move the view clamp. Uploads are submitted on the
+// graphics queue without waiting, their staging memory is released by a later
+// Update once the fence signaled. The streamer stay under its own budget and
+// the VMA heap budget by dropping the least recently used textures back to
+// their tail.
+//
+// Not thread safe, every call must come from the thread building the frame
+// packets, and Update must run before the packet of the frame reference the
+// streamed textures, uploads are then ordered before that frame on the queue.
+class TextureStreamer {
+public:
+    TextureStreamer(RenderDevice *vRD, const TextureStreamerSettings &vSettings = TextureStreamerSettings());
+   ~TextureStreamer();
+
+    // take ownership of the CPU image, only its tail mips get uploaded.
+    StreamedTexture *RegisterTexture(TextureImage *pImage, VkSampler sampler);
+    void UnregisterTexture(StreamedTexture *pStreamedTexture);
+
+    // request a mip level for this frame, the smallest index wins.
+    void RequestMipLevel(StreamedTexture *pStreamedTexture, uint32_t mipLevel);
+    // derive the mip level from the size the texture cover on screen.
+    void RequestScreenSize(StreamedTexture *pStreamedTexture, float screenWidth, float screenHeight);
+
+    // call once per frame, promote and evict mips within the budgets.
+    void Update();
+
+    void SetBudget(VkDeviceSize budget) { settings.budget = budget; }
+    VkDeviceSize GetResidentBytes() { return residentBytes; }
+    uint64_t GetFrame() { return frame; }
+    void SetTextureResidencyChangedCallback(PFN_TextureResidencyChangedCallback callback) { fnTextureResidencyChangedCallback = callback; }
+
+private:
+    struct RetiredTexture {
+        RenderDevice::TextureHandle texture;
+        VkImageView imageView;
+        uint64_t frame;
+    };
+
+    struct PendingUpload {
+        VkCommandBuffer cmdBuffer;
+        VkFence fence;
+        RenderDevice::BufferHandle buffer;
+    };
+
+    uint32_t _GetTailMip(StreamedTexture *pStreamedTexture);
+    VkDeviceSize _GetLevelsBytes(StreamedTexture *pStreamedTexture, uint32_t firstMip, uint32_t lastMip);
+    bool _IsHeapOverBudget(VkDeviceSize extraBytes);
+    bool _EvictFor(VkDeviceSize bytes, StreamedTexture *pExclude);
+    void _CreateTexture(StreamedTexture *pStreamedTexture, uint32_t baseMip);
+    void _Upload(StreamedTexture *pStreamedTexture, uint32_t firstMip, uint32_t lastMip, bool initialize);
+    void _SetResidentMip(StreamedTexture *pStreamedTexture, uint32_t mipLevel);
+    void _RetireTexture(RenderDevice::TextureHandle texture);
+    void _RetireImageView(VkImageView imageView);
+    void _DestroyRetiredTextures(bool all);
+    void _ReleasePendingUploads(bool all);
+
+    RenderDevice *rd = NULL;
+    TextureStreamerSettings settings;
+    /* owned by the streamer, the device pool is used by other threads */
+    VkCommandPool cmdPool = VK_NULL_HANDLE;
+    std::vector<StreamedTexture *> textures;
+    std::deque<RetiredTexture> retiredTextures;
+    std::deque<PendingUpload> pendingUploads;
+    VkDeviceSize residentBytes = 0;
+    /* replaced textures still alive on the heap */
+    VkDeviceSize retiredBytes = 0;
+    uint64_t frame = 0;
+    PFN_TextureResidencyChangedCallback fnTextureResidencyChangedCallback = NULL;
+};
+
+#endif /* _TEXTURE_STREAMER_H_ */
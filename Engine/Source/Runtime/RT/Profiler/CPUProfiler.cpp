@@ -0,0 +1,284 @@
+/* ======================================================================== */
+/* CPUProfiler.cpp                                                          */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "CPUProfiler.h"
+#include <Bright/IOUtils.h>
+#include <Bright/Memalloc.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <inttypes.h>
+#include <mutex>
+#include <stdio.h>
+
+#define CPU_PROFILER_RING_MASK (CPU_PROFILER_RING_SIZE - 1)
+#define CPU_PROFILER_THREAD_NAME_SIZE 32
+
+static_assert((CPU_PROFILER_RING_SIZE & CPU_PROFILER_RING_MASK) == 0, "ring size must be a power of two");
+
+struct ThreadRing {
+    std::atomic<uint64_t> head = 0;
+    std::atomic<uint64_t> tail = 0;
+    std::atomic<uint64_t> dropped = 0;
+    uint32_t thread = 0;
+    /* only touched by the owning thread */
+    uint16_t depth = 0;
+    char name[CPU_PROFILER_THREAD_NAME_SIZE] = {};
+    CPUProfileEvent events[CPU_PROFILER_RING_SIZE];
+};
+
+// rings outlive their thread so the last events can still be drained, they
+// are never released.
+static std::atomic<ThreadRing *> rings[CPU_PROFILER_MAX_THREADS] = {};
+static std::atomic<uint32_t> ringCount = 0;
+static std::mutex registryMutex;
+static thread_local ThreadRing *currentRing = NULL;
+
+/* frame state, written by the thread calling EndFrame */
+static std::mutex frameMutex;
+static uint64_t frameCounter = 0;
+static uint64_t frameBegin = 0;
+static CPUFrameResult latestFrame;
+static std::deque<float> frameTimeHistory;
+static bool capturing = false;
+static std::vector<CPUProfileEvent> captureEvents;
+
+static ThreadRing *_GetThreadRing()
+{
+    if (currentRing)
+        return currentRing;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    uint32_t thread = ringCount.load(std::memory_order_relaxed);
+    if (thread >= CPU_PROFILER_MAX_THREADS)
+        return NULL;
+
+    ThreadRing *ring = memnew(ThreadRing);
+    ring->thread = thread;
+    snprintf(ring->name, sizeof(ring->name), "Thread %u", thread);
+
+    rings[thread].store(ring, std::memory_order_release);
+    ringCount.store(thread + 1, std::memory_order_release);
+    currentRing = ring;
+
+    return ring;
+}
+
+static void _PushEvent(ThreadRing *ring, const CPUProfileEvent &event)
+{
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= CPU_PROFILER_RING_SIZE) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ring->events[head & CPU_PROFILER_RING_MASK] = event;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t CPUProfiler::GetTimestamp()
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CPUProfiler::SetThreadName(const char *name)
+{
+    ThreadRing *ring = _GetThreadRing();
+    if (!ring)
+        return;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    snprintf(ring->name, sizeof(ring->name), "%s", name);
+}
+
+std::string CPUProfiler::GetThreadName(uint32_t thread)
+{
+    if (thread >= ringCount.load(std::memory_order_acquire))
+        return "";
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return rings[thread].load(std::memory_order_relaxed)->name;
+}
+
+uint64_t CPUProfiler::BeginScope()
+{
+    ThreadRing *ring = _GetThreadRing();
+    if (ring)
+        ++ring->depth;
+
+    return GetTimestamp();
+}
+
+void CPUProfiler::EndScope(const char *name, uint64_t begin)
+{
+    uint64_t end = GetTimestamp();
+
+    ThreadRing *ring = _GetThreadRing();
+    if (!ring)
+        return;
+
+    --ring->depth;
+    _PushEvent(ring, { name, begin, end, 0.0, ring->thread, ring->depth, CPU_PROFILE_EVENT_TYPE_SCOPE });
+}
+
+void CPUProfiler::Counter(const char *name, double value)
+{
+    ThreadRing *ring = _GetThreadRing();
+    if (!ring)
+        return;
+
+    uint64_t timestamp = GetTimestamp();
+    _PushEvent(ring, { name, timestamp, timestamp, value, ring->thread, ring->depth, CPU_PROFILE_EVENT_TYPE_COUNTER });
+}
+
+void CPUProfiler::EndFrame()
+{
+    uint64_t frameEnd = GetTimestamp();
+
+    CPUFrameResult frameResult;
+    frameResult.frame = frameCounter++;
+    frameResult.begin = frameBegin ? frameBegin : frameEnd;
+    frameResult.end = frameEnd;
+    frameBegin = frameEnd;
+
+    uint32_t count = ringCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++) {
+        ThreadRing *ring = rings[i].load(std::memory_order_acquire);
+
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (; tail != head; ++tail)
+            frameResult.events.push_back(ring->events[tail & CPU_PROFILER_RING_MASK]);
+
+        ring->tail.store(tail, std::memory_order_release);
+    }
+
+    // events are pushed when a scope end, children before their parent.
+    std::sort(frameResult.events.begin(), frameResult.events.end(), [](const CPUProfileEvent &a, const CPUProfileEvent &b) {
+        if (a.thread != b.thread)
+            return a.thread < b.thread;
+        if (a.begin != b.begin)
+            return a.begin < b.begin;
+        return a.depth < b.depth;
+    });
+
+    std::lock_guard<std::mutex> lock(frameMutex);
+
+    if (capturing) {
+        size_t room = CPU_PROFILER_MAX_CAPTURE_EVENTS - std::min(captureEvents.size(), (size_t) CPU_PROFILER_MAX_CAPTURE_EVENTS);
+        size_t copyCount = std::min(room, frameResult.events.size());
+        captureEvents.insert(captureEvents.end(), frameResult.events.begin(), frameResult.events.begin() + copyCount);
+    }
+
+    frameTimeHistory.push_back((float) ToMilliseconds(frameResult.end - frameResult.begin));
+    if (frameTimeHistory.size() > CPU_PROFILER_HISTORY_SIZE)
+        frameTimeHistory.pop_front();
+
+    latestFrame = std::move(frameResult);
+}
+
+void CPUProfiler::GetLatestFrame(CPUFrameResult *pResult)
+{
+    std::lock_guard<std::mutex> lock(frameMutex);
+    *pResult = latestFrame;
+}
+
+void CPUProfiler::GetFrameTimeHistory(std::vector<float> *pHistory)
+{
+    std::lock_guard<std::mutex> lock(frameMutex);
+    pHistory->assign(frameTimeHistory.begin(), frameTimeHistory.end());
+}
+
+uint64_t CPUProfiler::GetDroppedEventCount()
+{
+    uint64_t dropped = 0;
+
+    uint32_t count = ringCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++)
+        dropped += rings[i].load(std::memory_order_acquire)->dropped.load(std::memory_order_relaxed);
+
+    return dropped;
+}
+
+void CPUProfiler::BeginCapture()
+{
+    std::lock_guard<std::mutex> lock(frameMutex);
+    captureEvents.clear();
+    capturing = true;
+}
+
+void CPUProfiler::EndCapture()
+{
+    std::lock_guard<std::mutex> lock(frameMutex);
+    capturing = false;
+}
+
+bool CPUProfiler::IsCapturing()
+{
+    std::lock_guard<std::mutex> lock(frameMutex);
+    return capturing;
+}
+
+Error CPUProfiler::ExportChromeTrace(const char *path)
+{
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char line[512];
+    bool first = true;
+
+    uint32_t count = ringCount.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; i++) {
+        snprintf(line, sizeof(line), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                 first ? "" : ",", i, GetThreadName(i).c_str());
+        json += line;
+        first = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(frameMutex);
+
+        /* trace timestamps are microseconds, relative to the first event */
+        uint64_t base = captureEvents.empty() ? 0 : captureEvents.front().begin;
+        for (const CPUProfileEvent &event : captureEvents)
+            base = std::min(base, event.begin);
+
+        for (const CPUProfileEvent &event : captureEvents) {
+            double ts = (double) (event.begin - base) / 1000.0;
+
+            if (event.type == CPU_PROFILE_EVENT_TYPE_COUNTER) {
+                snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"value\":%g}}",
+                         first ? "" : ",", event.name, ts, event.thread, event.value);
+            } else {
+                snprintf(line, sizeof(line), "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                         first ? "" : ",", event.name, ts, (double) (event.end - event.begin) / 1000.0, event.thread);
+            }
+
+            json += line;
+            first = false;
+        }
+    }
+
+    json += "\n]}\n";
+
+    return io_write_file(path, json.data(), json.size());
+}
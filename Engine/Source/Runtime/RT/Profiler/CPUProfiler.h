@@ -0,0 +1,117 @@
+/* ======================================================================== */
+/* CPUProfiler.h                                                            */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _CPU_PROFILER_H_
+#define _CPU_PROFILER_H_
+
+#include <Bright/Error.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#define CPU_PROFILER_RING_SIZE 16384
+#define CPU_PROFILER_MAX_THREADS 64
+#define CPU_PROFILER_HISTORY_SIZE 240
+#define CPU_PROFILER_MAX_CAPTURE_EVENTS (1 << 20)
+
+#define _PROFILE_CONCAT_IMPL(a, b) a##b
+#define _PROFILE_CONCAT(a, b) _PROFILE_CONCAT_IMPL(a, b)
+
+// Instrumentation only exists when BRIGHT_PROFILER_ENABLED is defined, see
+// the BRIGHT_PROFILER cmake option, otherwise the macros expand to nothing
+// and their arguments are never evaluated.
+#ifdef BRIGHT_PROFILER_ENABLED
+#  define PROFILE_SCOPE(name) CPUProfileScope _PROFILE_CONCAT(__profile_scope_, __LINE__)(name)
+#  define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#  define PROFILE_COUNTER(name, value) CPUProfiler::Counter(name, (double) (value))
+#  define PROFILE_THREAD(name) CPUProfiler::SetThreadName(name)
+#  define PROFILE_FRAME() CPUProfiler::EndFrame()
+#else
+#  define PROFILE_SCOPE(name) ((void) 0)
+#  define PROFILE_FUNCTION() ((void) 0)
+#  define PROFILE_COUNTER(name, value) ((void) 0)
+#  define PROFILE_THREAD(name) ((void) 0)
+#  define PROFILE_FRAME() ((void) 0)
+#endif
+
+enum CPUProfileEventType {
+    CPU_PROFILE_EVENT_TYPE_SCOPE,
+    CPU_PROFILE_EVENT_TYPE_COUNTER,
+};
+
+struct CPUProfileEvent {
+    // string literal or function name, never copied.
+    const char *name;
+    uint64_t begin;
+    uint64_t end;
+    double value;
+    uint32_t thread;
+    uint16_t depth;
+    uint16_t type;
+};
+
+struct CPUFrameResult {
+    uint64_t frame = 0;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    // sorted by thread then begin time, a parent always precede its children.
+    std::vector<CPUProfileEvent> events;
+};
+
+// Every thread records into its own single producer ring, EndFrame drain
+// all the rings on the calling thread. Nothing is locked on the recording
+// side, a full ring drop events until the next drain.
+class CPUProfiler {
+public:
+    static uint64_t GetTimestamp();
+    static double ToMilliseconds(uint64_t ticks) { return (double) ticks / 1000000.0; }
+
+    static void SetThreadName(const char *name);
+    static std::string GetThreadName(uint32_t thread);
+    static uint64_t BeginScope();
+    static void EndScope(const char *name, uint64_t begin);
+    static void Counter(const char *name, double value);
+    static void EndFrame();
+
+    static void GetLatestFrame(CPUFrameResult *pResult);
+    static void GetFrameTimeHistory(std::vector<float> *pHistory);
+    static uint64_t GetDroppedEventCount();
+
+    // every event drained between the two calls is kept for ExportChromeTrace.
+    static void BeginCapture();
+    static void EndCapture();
+    static bool IsCapturing();
+    // chrome://tracing and Perfetto trace event format.
+    static Error ExportChromeTrace(const char *path);
+};
+
+class CPUProfileScope {
+public:
+    CPUProfileScope(const char *vName) : name(vName) { begin = CPUProfiler::BeginScope(); }
+   ~CPUProfileScope() { CPUProfiler::EndScope(name, begin); }
+
+private:
+    const char *name;
+    uint64_t begin;
+};
+
+#endif /* _CPU_PROFILER_H_ */
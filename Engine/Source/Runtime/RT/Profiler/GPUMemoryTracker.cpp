@@ -0,0 +1,150 @@
+/* ======================================================================== */
+/* GPUMemoryTracker.cpp                                                     */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "GPUMemoryTracker.h"
+#include <algorithm>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string>
+
+GPUMemoryTracker::GPUMemoryTracker(RenderDevice *vRD)
+    : rd(vRD)
+{
+    allocator = rd->GetDeviceContext()->GetAllocator();
+    snapshot.budgetSupported = rd->GetDeviceContext()->IsMemoryBudgetSupported();
+
+    const VkPhysicalDeviceMemoryProperties *properties;
+    vmaGetMemoryProperties(allocator, &properties);
+
+    snapshot.heaps.resize(properties->memoryHeapCount);
+    for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+        snapshot.heaps[i] = {};
+        snapshot.heaps[i].size = properties->memoryHeaps[i].size;
+        snapshot.heaps[i].deviceLocal = properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    }
+
+    _UpdateStatistics();
+}
+
+void GPUMemoryTracker::Update()
+{
+    // vma only fetch new budgets from the driver when the frame index move.
+    vmaSetCurrentFrameIndex(allocator, (uint32_t) ++frame);
+    snapshot.frame = frame;
+
+    _UpdateBudgets();
+
+    if (frame % GPU_MEMORY_TRACKER_STATISTICS_INTERVAL == 0)
+        _UpdateStatistics();
+}
+
+float GPUMemoryTracker::GetDeviceLocalPressure()
+{
+    float pressure = 0.0f;
+    for (const GPUMemoryHeap &heap : snapshot.heaps) {
+        if (heap.deviceLocal && heap.budget > 0)
+            pressure = std::max(pressure, (float) ((double) heap.usage / (double) heap.budget));
+    }
+
+    return pressure;
+}
+
+void GPUMemoryTracker::_UpdateBudgets()
+{
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(allocator, budgets);
+
+    for (uint32_t i = 0; i < snapshot.heaps.size(); i++) {
+        snapshot.heaps[i].budget = budgets[i].budget;
+        snapshot.heaps[i].usage = budgets[i].usage;
+    }
+}
+
+void GPUMemoryTracker::_UpdateStatistics()
+{
+    _UpdateBudgets();
+
+    VmaTotalStatistics statistics;
+    vmaCalculateStatistics(allocator, &statistics);
+
+    for (uint32_t i = 0; i < snapshot.heaps.size(); i++) {
+        const VmaDetailedStatistics &detailed = statistics.memoryHeap[i];
+        GPUMemoryHeap *heap = &snapshot.heaps[i];
+
+        heap->blockCount = detailed.statistics.blockCount;
+        heap->allocationCount = detailed.statistics.allocationCount;
+        heap->blockBytes = detailed.statistics.blockBytes;
+        heap->allocationBytes = detailed.statistics.allocationBytes;
+        heap->unusedRangeCount = detailed.unusedRangeCount;
+
+        VkDeviceSize unusedBytes = heap->blockBytes - heap->allocationBytes;
+        heap->fragmentation = unusedBytes > 0 && detailed.unusedRangeCount > 0 ? 1.0f - (float) ((double) detailed.unusedRangeSizeMax / (double) unusedBytes) : 0.0f;
+    }
+
+    snapshot.textures = {};
+    snapshot.renderTargets = {};
+    snapshot.buffers = {};
+
+    rd->ForEachTexture([this] (RenderDevice::TextureHandle, RenderDevice::Texture2D *texture) {
+        bool renderTarget = texture->usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        GPUMemoryCategory *category = renderTarget ? &snapshot.renderTargets : &snapshot.textures;
+        category->count++;
+        category->bytes += texture->allocationInfo.size;
+    });
+
+    rd->ForEachBuffer([this] (RenderDevice::BufferHandle, RenderDevice::Buffer *buffer) {
+        snapshot.buffers.count++;
+        snapshot.buffers.bytes += buffer->allocationInfo.size;
+    });
+}
+
+Error GPUMemoryTracker::ExportJSON(const char *path)
+{
+    /* dump the current state, not the last periodic one */
+    _UpdateStatistics();
+
+    std::string json;
+    char line[512];
+
+    snprintf(line, sizeof(line), "{\n  \"frame\": %" PRIu64 ",\n  \"budget_supported\": %s,\n  \"heaps\": [", snapshot.frame, snapshot.budgetSupported ? "true" : "false");
+    json += line;
+
+    for (size_t i = 0; i < snapshot.heaps.size(); i++) {
+        const GPUMemoryHeap &heap = snapshot.heaps[i];
+        snprintf(line, sizeof(line), "%s\n    { \"size\": %" PRIu64 ", \"budget\": %" PRIu64 ", \"usage\": %" PRIu64 ", \"device_local\": %s, \"block_count\": %u, "
+                                     "\"allocation_count\": %u, \"block_bytes\": %" PRIu64 ", \"allocation_bytes\": %" PRIu64 ", \"unused_range_count\": %u, \"fragmentation\": %.4f }",
+                 i ? "," : "", (uint64_t) heap.size, (uint64_t) heap.budget, (uint64_t) heap.usage, heap.deviceLocal ? "true" : "false", heap.blockCount,
+                 heap.allocationCount, (uint64_t) heap.blockBytes, (uint64_t) heap.allocationBytes, heap.unusedRangeCount, heap.fragmentation);
+        json += line;
+    }
+
+    snprintf(line, sizeof(line), "\n  ],\n  \"categories\": {\n"
+                                 "    \"textures\": { \"count\": %u, \"bytes\": %" PRIu64 " },\n"
+                                 "    \"render_targets\": { \"count\": %u, \"bytes\": %" PRIu64 " },\n"
+                                 "    \"buffers\": { \"count\": %u, \"bytes\": %" PRIu64 " }\n  }\n}\n",
+             snapshot.textures.count, (uint64_t) snapshot.textures.bytes,
+             snapshot.renderTargets.count, (uint64_t) snapshot.renderTargets.bytes,
+             snapshot.buffers.count, (uint64_t) snapshot.buffers.bytes);
+    json += line;
+
+    return io_write_file(path, json.data(), json.size());
+}
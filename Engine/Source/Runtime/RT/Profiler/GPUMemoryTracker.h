@@ -0,0 +1,86 @@
+/* ======================================================================== */
+/* GPUMemoryTracker.h                                                       */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _GPU_MEMORY_TRACKER_H_
+#define _GPU_MEMORY_TRACKER_H_
+
+#include "Drivers/RenderDevice.h"
+#include <Bright/IOUtils.h>
+#include <vector>
+
+/* vmaCalculateStatistics walk every block, don't run it every frame */
+#define GPU_MEMORY_TRACKER_STATISTICS_INTERVAL 30
+
+struct GPUMemoryHeap {
+    VkDeviceSize size;
+    VkDeviceSize budget;
+    VkDeviceSize usage;
+    bool deviceLocal;
+    uint32_t blockCount;
+    uint32_t allocationCount;
+    VkDeviceSize blockBytes;
+    VkDeviceSize allocationBytes;
+    uint32_t unusedRangeCount;
+    // 0 when the free space of the heap blocks is one range, toward 1 as
+    // it is split in many small ranges.
+    float fragmentation;
+};
+
+struct GPUMemoryCategory {
+    uint32_t count = 0;
+    VkDeviceSize bytes = 0;
+};
+
+struct GPUMemorySnapshot {
+    uint64_t frame = 0;
+    bool budgetSupported = false;
+    std::vector<GPUMemoryHeap> heaps;
+    GPUMemoryCategory textures;
+    // images that can be attached to a framebuffer.
+    GPUMemoryCategory renderTargets;
+    GPUMemoryCategory buffers;
+};
+
+// Heap budgets are refreshed every Update, allocator statistics and the
+// per category totals every GPU_MEMORY_TRACKER_STATISTICS_INTERVAL calls.
+// Update and the getters belong to one thread, usually the main one.
+class GPUMemoryTracker {
+public:
+    GPUMemoryTracker(RenderDevice *vRD);
+
+    void Update();
+    const GPUMemorySnapshot &GetSnapshot() { return snapshot; }
+    // highest usage / budget ratio across device local heaps.
+    float GetDeviceLocalPressure();
+    Error ExportJSON(const char *path);
+
+private:
+    void _UpdateBudgets();
+    void _UpdateStatistics();
+
+    RenderDevice *rd = VK_NULL_HANDLE;
+    VmaAllocator allocator = VK_NULL_HANDLE;
+    uint64_t frame = 0;
+    GPUMemorySnapshot snapshot;
+};
+
+#endif /* _GPU_MEMORY_TRACKER_H_ */
@@ -0,0 +1,377 @@
+/* ======================================================================== */
+/* GPUProfiler.cpp                                                          */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "GPUProfiler.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string>
+
+/* frame begin/end, then a begin/end pair per scope */
+#define GPU_PROFILER_FRAME_QUERY_COUNT (2 + GPU_PROFILER_MAX_SCOPES * 2)
+
+#define GPU_PROFILER_PIPELINE_STATISTICS (VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | \
+                                          VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | \
+                                          VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | \
+                                          VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT | \
+                                          VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | \
+                                          VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | \
+                                          VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT)
+
+GPUProfiler::GPUProfiler(RenderDevice *vRD)
+    : rd(vRD)
+{
+    RenderDeviceContext *rdc = rd->GetDeviceContext();
+    device = rdc->GetDevice();
+
+    const VkPhysicalDeviceProperties &properties = rdc->GetPhysicalDeviceProperties();
+    timestampPeriod = properties.limits.timestampPeriod;
+    supported = properties.limits.timestampComputeAndGraphics && timestampPeriod > 0.0f;
+    statisticsSupported = rd->IsPipelineStatisticsSupported();
+
+    for (uint32_t i = 0; i < GPU_PROFILER_FRAME_COUNT; i++) {
+        if (supported)
+            rd->CreateQueryPool(VK_QUERY_TYPE_TIMESTAMP, GPU_PROFILER_FRAME_QUERY_COUNT, 0, &frames[i].queryPool);
+        if (statisticsSupported)
+            rd->CreateQueryPool(VK_QUERY_TYPE_PIPELINE_STATISTICS, GPU_PROFILER_MAX_STATISTICS_SCOPES, GPU_PROFILER_PIPELINE_STATISTICS, &frames[i].statisticsQueryPool);
+    }
+
+    if (supported)
+        rd->CreateQueryPool(VK_QUERY_TYPE_TIMESTAMP, GPU_PROFILER_UPLOAD_SLOTS * 2, 0, &uploadQueryPool);
+}
+
+GPUProfiler::~GPUProfiler()
+{
+    for (uint32_t i = 0; i < GPU_PROFILER_FRAME_COUNT; i++) {
+        if (frames[i].queryPool)
+            rd->DestroyQueryPool(frames[i].queryPool);
+        if (frames[i].statisticsQueryPool)
+            rd->DestroyQueryPool(frames[i].statisticsQueryPool);
+    }
+
+    if (uploadQueryPool)
+        rd->DestroyQueryPool(uploadQueryPool);
+}
+
+const char *GPUProfiler::GetPipelineStatisticName(uint32_t statistic)
+{
+    static const char *names[GPU_PIPELINE_STATISTIC_COUNT] = {
+        "Input vertices",
+        "Input primitives",
+        "Vertex invocations",
+        "Clipping invocations",
+        "Clipping primitives",
+        "Fragment invocations",
+        "Compute invocations",
+    };
+
+    return statistic < GPU_PIPELINE_STATISTIC_COUNT ? names[statistic] : "";
+}
+
+void GPUProfiler::CmdBeginFrame(VkCommandBuffer cmdBuffer)
+{
+    if (!supported && !statisticsSupported)
+        return;
+
+    currentFrame = &frames[frameCounter % GPU_PROFILER_FRAME_COUNT];
+
+    // the slot was last used GPU_PROFILER_FRAME_COUNT frames ago, read it
+    // back before its queries are reset.
+    if (currentFrame->pending)
+        _ResolveFrame(currentFrame);
+
+    currentFrame->frame = frameCounter++;
+    currentFrame->pending = true;
+    currentFrame->scopes.clear();
+    currentFrame->statistics.clear();
+    depth = 0;
+    statisticsActive = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentFrame->uploadMilliseconds = uploadMilliseconds;
+        currentFrame->uploadCount = uploadCount;
+        uploadMilliseconds = 0.0;
+        uploadCount = 0;
+    }
+
+    if (statisticsSupported)
+        vkCmdResetQueryPool(cmdBuffer, currentFrame->statisticsQueryPool, 0, GPU_PROFILER_MAX_STATISTICS_SCOPES);
+
+    if (supported) {
+        vkCmdResetQueryPool(cmdBuffer, currentFrame->queryPool, 0, GPU_PROFILER_FRAME_QUERY_COUNT);
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, currentFrame->queryPool, 0);
+    }
+}
+
+void GPUProfiler::CmdEndFrame(VkCommandBuffer cmdBuffer)
+{
+    if (!currentFrame)
+        return;
+
+    if (supported)
+        vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, currentFrame->queryPool, 1);
+
+    currentFrame = VK_NULL_HANDLE;
+}
+
+uint32_t GPUProfiler::CmdBeginScope(VkCommandBuffer cmdBuffer, const char *name)
+{
+    if (!supported || !currentFrame || currentFrame->scopes.size() >= GPU_PROFILER_MAX_SCOPES)
+        return GPU_PROFILER_INVALID_SCOPE;
+
+    uint32_t scope = (uint32_t) currentFrame->scopes.size();
+    currentFrame->scopes.push_back({ name, depth++, 0.0 });
+
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, currentFrame->queryPool, 2 + scope * 2);
+
+    return scope;
+}
+
+void GPUProfiler::CmdEndScope(VkCommandBuffer cmdBuffer, uint32_t scope)
+{
+    if (!currentFrame || scope == GPU_PROFILER_INVALID_SCOPE)
+        return;
+
+    --depth;
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, currentFrame->queryPool, 3 + scope * 2);
+}
+
+uint32_t GPUProfiler::CmdBeginStatistics(VkCommandBuffer cmdBuffer, const char *name)
+{
+    if (!statisticsSupported || !currentFrame || statisticsActive || currentFrame->statistics.size() >= GPU_PROFILER_MAX_STATISTICS_SCOPES)
+        return GPU_PROFILER_INVALID_SCOPE;
+
+    uint32_t scope = (uint32_t) currentFrame->statistics.size();
+    currentFrame->statistics.push_back({ name, {} });
+    statisticsActive = true;
+
+    vkCmdBeginQuery(cmdBuffer, currentFrame->statisticsQueryPool, scope, 0);
+
+    return scope;
+}
+
+void GPUProfiler::CmdEndStatistics(VkCommandBuffer cmdBuffer, uint32_t scope)
+{
+    if (!currentFrame || scope == GPU_PROFILER_INVALID_SCOPE)
+        return;
+
+    statisticsActive = false;
+    vkCmdEndQuery(cmdBuffer, currentFrame->statisticsQueryPool, scope);
+}
+
+uint32_t GPUProfiler::CmdBeginUpload(VkCommandBuffer cmdBuffer)
+{
+    if (!supported)
+        return GPU_PROFILER_INVALID_SCOPE;
+
+    /* uploads may be recorded from any thread */
+    uint32_t slot = uploadSlot.fetch_add(1, std::memory_order_relaxed) % GPU_PROFILER_UPLOAD_SLOTS;
+
+    vkCmdResetQueryPool(cmdBuffer, uploadQueryPool, slot * 2, 2);
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, uploadQueryPool, slot * 2);
+
+    return slot;
+}
+
+void GPUProfiler::CmdEndUpload(VkCommandBuffer cmdBuffer, uint32_t slot)
+{
+    if (slot == GPU_PROFILER_INVALID_SCOPE)
+        return;
+
+    vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, uploadQueryPool, slot * 2 + 1);
+}
+
+void GPUProfiler::ResolveUpload(uint32_t slot)
+{
+    if (slot == GPU_PROFILER_INVALID_SCOPE)
+        return;
+
+    // one time submits already waited for the queue, the results are ready.
+    uint64_t timestamps[2];
+    VkResult result = vkGetQueryPoolResults(device, uploadQueryPool, slot * 2, 2, sizeof(timestamps), timestamps,
+                                            sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    uploadMilliseconds += _TicksToMilliseconds(timestamps[0], timestamps[1]);
+    ++uploadCount;
+}
+
+void GPUProfiler::_ResolveFrame(FrameQueries *pFrame)
+{
+    pFrame->pending = false;
+
+    GPUFrameResult frameResult;
+    frameResult.frame = pFrame->frame;
+    frameResult.uploadMilliseconds = pFrame->uploadMilliseconds;
+    frameResult.uploadCount = pFrame->uploadCount;
+    frameResult.scopes = pFrame->scopes;
+
+    if (supported) {
+        uint32_t queryCount = 2 + (uint32_t) pFrame->scopes.size() * 2;
+
+        /* value and availability pairs */
+        uint64_t results[GPU_PROFILER_FRAME_QUERY_COUNT * 2];
+        VkResult result = vkGetQueryPoolResults(device, pFrame->queryPool, 0, queryCount, sizeof(uint64_t) * 2 * queryCount, results,
+                                                sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS && result != VK_NOT_READY)
+            return;
+
+        // never wait on the GPU, a frame that isn't finished is dropped.
+        for (uint32_t i = 0; i < queryCount; i++) {
+            if (!results[i * 2 + 1])
+                return;
+        }
+
+        frameResult.milliseconds = _TicksToMilliseconds(results[0], results[2]);
+        for (uint32_t i = 0; i < frameResult.scopes.size(); i++)
+            frameResult.scopes[i].milliseconds = _TicksToMilliseconds(results[(2 + i * 2) * 2], results[(3 + i * 2) * 2]);
+    }
+
+    if (statisticsSupported && !_ResolveStatistics(pFrame, &frameResult))
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    history.push_back(std::move(frameResult));
+    if (history.size() > GPU_PROFILER_HISTORY_SIZE)
+        history.pop_front();
+}
+
+bool GPUProfiler::_ResolveStatistics(FrameQueries *pFrame, GPUFrameResult *pResult)
+{
+    uint32_t queryCount = (uint32_t) pFrame->statistics.size();
+    if (queryCount == 0)
+        return true;
+
+    /* every statistic followed by the availability */
+    const uint32_t stride = GPU_PIPELINE_STATISTIC_COUNT + 1;
+    uint64_t results[GPU_PROFILER_MAX_STATISTICS_SCOPES * stride];
+    VkResult result = vkGetQueryPoolResults(device, pFrame->statisticsQueryPool, 0, queryCount, sizeof(uint64_t) * stride * queryCount, results,
+                                            sizeof(uint64_t) * stride, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY)
+        return false;
+
+    pResult->statistics = pFrame->statistics;
+    for (uint32_t i = 0; i < queryCount; i++) {
+        const uint64_t *values = &results[i * stride];
+        if (!values[GPU_PIPELINE_STATISTIC_COUNT])
+            return false;
+
+        for (uint32_t j = 0; j < GPU_PIPELINE_STATISTIC_COUNT; j++) {
+            pResult->statistics[i].values[j] = values[j];
+            pResult->statisticsTotals[j] += values[j];
+        }
+    }
+
+    return true;
+}
+
+void GPUProfiler::GetLatestFrame(GPUFrameResult *pResult)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!history.empty())
+        *pResult = history.back();
+}
+
+void GPUProfiler::GetFrameTimeHistory(std::vector<float> *pHistory)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    pHistory->clear();
+    for (const GPUFrameResult &frameResult : history)
+        pHistory->push_back((float) frameResult.milliseconds);
+}
+
+Error GPUProfiler::ExportCSV(const char *path)
+{
+    std::string csv = "frame,scope,depth,milliseconds\n";
+    char line[256];
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const GPUFrameResult &frameResult : history) {
+            snprintf(line, sizeof(line), "%" PRIu64 ",Frame,0,%.4f\n", frameResult.frame, frameResult.milliseconds);
+            csv += line;
+            snprintf(line, sizeof(line), "%" PRIu64 ",Upload,0,%.4f\n", frameResult.frame, frameResult.uploadMilliseconds);
+            csv += line;
+
+            for (const GPUScopeResult &scope : frameResult.scopes) {
+                snprintf(line, sizeof(line), "%" PRIu64 ",%s,%u,%.4f\n", frameResult.frame, scope.name, scope.depth + 1, scope.milliseconds);
+                csv += line;
+            }
+        }
+    }
+
+    return io_write_file(path, csv.data(), csv.size());
+}
+
+Error GPUProfiler::ExportJSON(const char *path)
+{
+    std::string json = "{\n  \"statistic_names\": [";
+    char line[256];
+
+    for (uint32_t i = 0; i < GPU_PIPELINE_STATISTIC_COUNT; i++) {
+        snprintf(line, sizeof(line), "%s\"%s\"", i ? ", " : "", GetPipelineStatisticName(i));
+        json += line;
+    }
+
+    json += "],\n  \"frames\": [";
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < history.size(); i++) {
+            const GPUFrameResult &frameResult = history[i];
+            snprintf(line, sizeof(line), "%s\n    { \"frame\": %" PRIu64 ", \"milliseconds\": %.4f, \"upload_milliseconds\": %.4f, \"upload_count\": %u, \"scopes\": [",
+                     i ? "," : "", frameResult.frame, frameResult.milliseconds, frameResult.uploadMilliseconds, frameResult.uploadCount);
+            json += line;
+
+            for (size_t j = 0; j < frameResult.scopes.size(); j++) {
+                const GPUScopeResult &scope = frameResult.scopes[j];
+                snprintf(line, sizeof(line), "%s{ \"name\": \"%s\", \"depth\": %u, \"milliseconds\": %.4f }",
+                         j ? ", " : "", scope.name, scope.depth, scope.milliseconds);
+                json += line;
+            }
+
+            json += "], \"statistics\": [";
+
+            for (size_t j = 0; j < frameResult.statistics.size(); j++) {
+                const GPUStatisticsResult &statistics = frameResult.statistics[j];
+                snprintf(line, sizeof(line), "%s{ \"name\": \"%s\", \"values\": [", j ? ", " : "", statistics.name);
+                json += line;
+
+                for (uint32_t k = 0; k < GPU_PIPELINE_STATISTIC_COUNT; k++) {
+                    snprintf(line, sizeof(line), "%s%" PRIu64, k ? ", " : "", statistics.values[k]);
+                    json += line;
+                }
+
+                json += "] }";
+            }
+
+            json += "] }";
+        }
+    }
+
+    json += "\n  ]\n}\n";
+
+    return io_write_file(path, json.data(), json.size());
+}
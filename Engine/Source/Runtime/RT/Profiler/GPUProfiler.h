@@ -0,0 +1,144 @@
+/* ======================================================================== */
+/* GPUProfiler.h                                                            */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _GPU_PROFILER_H_
+#define _GPU_PROFILER_H_
+
+#include "Drivers/RenderDevice.h"
+#include <Bright/IOUtils.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#define GPU_PROFILER_FRAME_COUNT 3
+#define GPU_PROFILER_MAX_SCOPES 128
+#define GPU_PROFILER_MAX_STATISTICS_SCOPES 32
+#define GPU_PROFILER_UPLOAD_SLOTS 16
+#define GPU_PROFILER_HISTORY_SIZE 240
+#define GPU_PROFILER_INVALID_SCOPE UINT32_MAX
+
+// in VkQueryPipelineStatisticFlagBits order, the order results are written.
+enum GPUPipelineStatistic {
+    GPU_PIPELINE_STATISTIC_INPUT_VERTICES,
+    GPU_PIPELINE_STATISTIC_INPUT_PRIMITIVES,
+    GPU_PIPELINE_STATISTIC_VERTEX_INVOCATIONS,
+    GPU_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS,
+    GPU_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES,
+    GPU_PIPELINE_STATISTIC_FRAGMENT_INVOCATIONS,
+    GPU_PIPELINE_STATISTIC_COMPUTE_INVOCATIONS,
+    GPU_PIPELINE_STATISTIC_COUNT,
+};
+
+struct GPUStatisticsResult {
+    const char *name;
+    uint64_t values[GPU_PIPELINE_STATISTIC_COUNT];
+};
+
+struct GPUScopeResult {
+    const char *name;
+    uint32_t depth;
+    double milliseconds;
+};
+
+struct GPUFrameResult {
+    uint64_t frame = 0;
+    double milliseconds = 0.0;
+    /* one time upload submits that completed while the frame was recorded */
+    double uploadMilliseconds = 0.0;
+    uint32_t uploadCount = 0;
+    std::vector<GPUScopeResult> scopes;
+    std::vector<GPUStatisticsResult> statistics;
+    /* sum of every statistics scope of the frame */
+    uint64_t statisticsTotals[GPU_PIPELINE_STATISTIC_COUNT] = {};
+};
+
+// Timestamp and pipeline statistics profiler with one set of query pools
+// per frame in flight. A frame is read back when its pools come around
+// again, without waiting: frames whose queries are not available yet are
+// dropped instead of stalling the CPU.
+class GPUProfiler {
+public:
+    GPUProfiler(RenderDevice *vRD);
+   ~GPUProfiler();
+
+    bool IsSupported() { return supported; }
+    bool IsStatisticsSupported() { return statisticsSupported; }
+    static const char *GetPipelineStatisticName(uint32_t statistic);
+
+    // outside of any render pass, first and last commands of the frame.
+    void CmdBeginFrame(VkCommandBuffer cmdBuffer);
+    void CmdEndFrame(VkCommandBuffer cmdBuffer);
+    // name is stored as is and must outlive the profiler, scopes nest.
+    uint32_t CmdBeginScope(VkCommandBuffer cmdBuffer, const char *name);
+    void CmdEndScope(VkCommandBuffer cmdBuffer, uint32_t scope);
+    // pipeline statistics of the commands in between, unlike timestamp
+    // scopes these can't nest, a scope opened inside a render pass must be
+    // closed in the same subpass.
+    uint32_t CmdBeginStatistics(VkCommandBuffer cmdBuffer, const char *name);
+    void CmdEndStatistics(VkCommandBuffer cmdBuffer, uint32_t scope);
+
+    // one time command buffers, resolve once the submit has completed.
+    uint32_t CmdBeginUpload(VkCommandBuffer cmdBuffer);
+    void CmdEndUpload(VkCommandBuffer cmdBuffer, uint32_t slot);
+    void ResolveUpload(uint32_t slot);
+
+    void GetLatestFrame(GPUFrameResult *pResult);
+    void GetFrameTimeHistory(std::vector<float> *pHistory);
+    Error ExportCSV(const char *path);
+    Error ExportJSON(const char *path);
+
+private:
+    struct FrameQueries {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+        uint64_t frame = 0;
+        bool pending = false;
+        double uploadMilliseconds = 0.0;
+        uint32_t uploadCount = 0;
+        std::vector<GPUScopeResult> scopes;
+        std::vector<GPUStatisticsResult> statistics;
+    };
+
+    void _ResolveFrame(FrameQueries *pFrame);
+    bool _ResolveStatistics(FrameQueries *pFrame, GPUFrameResult *pResult);
+    double _TicksToMilliseconds(uint64_t begin, uint64_t end) { return (double) (end - begin) * timestampPeriod / 1000000.0; }
+
+    RenderDevice *rd = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    float timestampPeriod = 0.0f;
+    bool supported = false;
+    bool statisticsSupported = false;
+    bool statisticsActive = false;
+    FrameQueries frames[GPU_PROFILER_FRAME_COUNT];
+    FrameQueries *currentFrame = VK_NULL_HANDLE;
+    uint64_t frameCounter = 0;
+    uint32_t depth = 0;
+    VkQueryPool uploadQueryPool = VK_NULL_HANDLE;
+    std::atomic<uint32_t> uploadSlot = 0;
+    std::mutex mutex;
+    double uploadMilliseconds = 0.0;
+    uint32_t uploadCount = 0;
+    std::deque<GPUFrameResult> history;
+};
+
+#endif /* _GPU_PROFILER_H_ */
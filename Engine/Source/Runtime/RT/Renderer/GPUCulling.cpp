@@ -0,0 +1,217 @@
+/* ======================================================================== */
+/* GPUCulling.cpp                                                           */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "GPUCulling.h"
+#include "Profiler/GPUProfiler.h"
+
+GPUCulling::GPUCulling(RenderDevice *vRD, uint32_t vMaxMeshCount, uint32_t vMaxObjectCount, HiZBuffer *vHiZBuffer)
+    : rd(vRD), maxMeshCount(vMaxMeshCount), maxObjectCount(vMaxObjectCount), hiZBuffer(vHiZBuffer)
+{
+    compact = rd->IsDrawIndirectCountSupported();
+
+    // the early and late lists are back to back, with a count each.
+    uint32_t listCount = hiZBuffer ? 2 : 1;
+
+    meshBuffer = rd->CreateBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(GPUCullingMesh) * maxMeshCount);
+    objectBuffer = rd->CreateBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(GPUCullingObject) * maxObjectCount);
+    drawBuffer = rd->CreateBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, sizeof(VkDrawIndexedIndirectCommand) * maxObjectCount * listCount, VMA_MEMORY_USAGE_GPU_ONLY);
+    countBuffer = rd->CreateBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(uint32_t) * listCount, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    RenderDevice::SpecializationConstant constant = { 0, VK_SHADER_STAGE_COMPUTE_BIT, compact ? VK_TRUE : VK_FALSE };
+
+    RenderDevice::ComputeShaderInfo shaderInfo = {};
+    shaderInfo.compute = "cull";
+    shaderInfo.specializationConstantCount = 1;
+    shaderInfo.pSpecializationConstants = &constant;
+    cullPipeline = rd->CreateComputePipeline(&shaderInfo);
+
+    rd->AllocateDescriptorSet(rd->GetPipeline(cullPipeline)->descriptorSetLayouts[0], &descriptorSet);
+    rd->UpdateDescriptorSetBuffer(meshBuffer, 0, descriptorSet);
+    rd->UpdateDescriptorSetBuffer(objectBuffer, 1, descriptorSet);
+    rd->UpdateDescriptorSetBuffer(drawBuffer, 2, descriptorSet);
+    rd->UpdateDescriptorSetBuffer(countBuffer, 3, descriptorSet);
+
+    if (!hiZBuffer)
+        return;
+
+    visibilityBuffer = rd->CreateBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(uint32_t) * maxObjectCount, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    shaderInfo.compute = "cull_occlusion";
+    occlusionPipeline = rd->CreateComputePipeline(&shaderInfo);
+
+    rd->AllocateDescriptorSet(rd->GetPipeline(occlusionPipeline)->descriptorSetLayouts[0], &occlusionDescriptorSet);
+    rd->UpdateDescriptorSetBuffer(meshBuffer, 0, occlusionDescriptorSet);
+    rd->UpdateDescriptorSetBuffer(objectBuffer, 1, occlusionDescriptorSet);
+    rd->UpdateDescriptorSetBuffer(drawBuffer, 2, occlusionDescriptorSet);
+    rd->UpdateDescriptorSetBuffer(countBuffer, 3, occlusionDescriptorSet);
+    rd->UpdateDescriptorSetBuffer(visibilityBuffer, 4, occlusionDescriptorSet);
+    RefreshHiZBuffer();
+}
+
+GPUCulling::~GPUCulling()
+{
+    if (hiZBuffer) {
+        rd->FreeDescriptorSet(occlusionDescriptorSet);
+        rd->DestroyPipeline(occlusionPipeline);
+        rd->DestroyBuffer(visibilityBuffer);
+    }
+
+    rd->FreeDescriptorSet(descriptorSet);
+    rd->DestroyPipeline(cullPipeline);
+    rd->DestroyBuffer(countBuffer);
+    rd->DestroyBuffer(drawBuffer);
+    rd->DestroyBuffer(objectBuffer);
+    rd->DestroyBuffer(meshBuffer);
+}
+
+void GPUCulling::SetMeshes(uint32_t count, GPUCullingMesh *pMeshes)
+{
+    assert(count <= maxMeshCount);
+    rd->WriteBuffer(meshBuffer, 0, sizeof(GPUCullingMesh) * count, pMeshes);
+}
+
+void GPUCulling::SetObjects(uint32_t count, GPUCullingObject *pObjects)
+{
+    assert(count <= maxObjectCount);
+    rd->WriteBuffer(objectBuffer, 0, sizeof(GPUCullingObject) * count, pObjects);
+    objectCount = count;
+    resetVisibility = true;
+}
+
+void GPUCulling::RefreshHiZBuffer()
+{
+    rd->UpdateDescriptorSetImage(hiZBuffer->GetPyramidTexture(), 5, occlusionDescriptorSet);
+}
+
+void GPUCulling::CmdCull(VkCommandBuffer cmdBuffer, const mat4 &viewProjection, GPUCullingPhase phase)
+{
+    if (objectCount == 0)
+        return;
+
+    assert(phase == GPU_CULLING_PHASE_ALL || hiZBuffer);
+
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    uint32_t cullScope = profiler ? profiler->CmdBeginScope(cmdBuffer, phase == GPU_CULLING_PHASE_LATE ? "GPUCullingLate" : "GPUCulling") : 0;
+
+    VkDeviceSize countOffset = phase == GPU_CULLING_PHASE_LATE ? sizeof(uint32_t) : 0;
+
+    // the previous frame may still read the commands and the count.
+    RenderDevice::PipelineMemoryBarrier barrier;
+    barrier.buffer.buffer = countBuffer;
+    barrier.buffer.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    barrier.buffer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    rd->CmdFillBuffer(cmdBuffer, countBuffer, countOffset, sizeof(uint32_t), 0);
+
+    barrier.buffer.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.buffer.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    if (phase != GPU_CULLING_PHASE_ALL) {
+        barrier.buffer.buffer = visibilityBuffer;
+
+        /* nothing was visible before these objects */
+        if (phase == GPU_CULLING_PHASE_EARLY && resetVisibility) {
+            barrier.buffer.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.buffer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+            rd->CmdFillBuffer(cmdBuffer, visibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+            resetVisibility = false;
+        }
+
+        // written by the late phase of the previous frame.
+        barrier.buffer.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.buffer.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+    }
+
+    barrier.buffer.buffer = drawBuffer;
+    barrier.buffer.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    barrier.buffer.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    uint32_t groupCount = (objectCount + GPU_CULLING_GROUP_SIZE - 1) / GPU_CULLING_GROUP_SIZE;
+    if (phase == GPU_CULLING_PHASE_ALL) {
+        CullPushConst pushConst;
+        _ExtractFrustumPlanes(viewProjection, pushConst.planes);
+        pushConst.objectCount = objectCount;
+
+        rd->CmdBindPipeline(cmdBuffer, cullPipeline);
+        rd->CmdBindDescriptorSet(cmdBuffer, cullPipeline, descriptorSet);
+        rd->CmdPushConstant(cmdBuffer, cullPipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConst), &pushConst);
+        rd->CmdDispatch(cmdBuffer, groupCount);
+    } else {
+        OcclusionPushConst pushConst;
+        pushConst.viewProjection = viewProjection;
+        pushConst.pyramidSize = vec2((float) hiZBuffer->GetPyramidWidth(), (float) hiZBuffer->GetPyramidHeight());
+        pushConst.objectCount = objectCount;
+        pushConst.phase = phase;
+        pushConst.pyramidMipLevels = hiZBuffer->GetPyramidMipLevels();
+
+        rd->CmdBindPipeline(cmdBuffer, occlusionPipeline);
+        rd->CmdBindDescriptorSet(cmdBuffer, occlusionPipeline, occlusionDescriptorSet);
+        rd->CmdPushConstant(cmdBuffer, occlusionPipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(OcclusionPushConst), &pushConst);
+        rd->CmdDispatch(cmdBuffer, groupCount);
+    }
+
+    barrier.buffer.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.buffer.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    barrier.buffer.buffer = countBuffer;
+    rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    if (profiler)
+        profiler->CmdEndScope(cmdBuffer, cullScope);
+}
+
+void GPUCulling::CmdDrawIndexed(VkCommandBuffer cmdBuffer, GPUCullingPhase phase)
+{
+    if (objectCount == 0)
+        return;
+
+    uint32_t list = phase == GPU_CULLING_PHASE_LATE ? 1 : 0;
+    VkDeviceSize offset = sizeof(VkDrawIndexedIndirectCommand) * objectCount * list;
+
+    // uncompacted commands cover every object, the count buffer is unused.
+    rd->CmdDrawIndexedIndirectCount(cmdBuffer, drawBuffer, offset, countBuffer, sizeof(uint32_t) * list, objectCount);
+}
+void GPUCulling::_ExtractFrustumPlanes(const mat4 &viewProjection, vec4 *pPlanes)
+{
+    // rows of the matrix, glm is column major.
+    vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+
+    /* vulkan clip space, -w <= x, y <= w and 0 <= z <= w */
+    pPlanes[0] = rows[3] + rows[0];
+    pPlanes[1] = rows[3] - rows[0];
+    pPlanes[2] = rows[3] + rows[1];
+    pPlanes[3] = rows[3] - rows[1];
+    pPlanes[4] = rows[2];
+    pPlanes[5] = rows[3] - rows[2];
+
+    for (int i = 0; i < 6; i++)
+        pPlanes[i] /= glm::length(vec3(pPlanes[i]));
+}
@@ -0,0 +1,130 @@
+/* ======================================================================== */
+/* GPUCulling.h                                                             */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _GPU_CULLING_H_
+#define _GPU_CULLING_H_
+
+#include "RT/Drivers/RenderDevice.h"
+#include "HiZBuffer.h"
+#include <Bright/Math.h>
+
+#define GPU_CULLING_GROUP_SIZE 64
+
+// ALL is frustum culling only. With a HiZBuffer every frame run EARLY, draw
+// its list in the depth pass, build the pyramid, then run LATE: objects
+// visible last frame are drawn first, the rest is tested against the depth
+// they produced. Both lists are drawn in the main pass.
+enum GPUCullingPhase {
+    GPU_CULLING_PHASE_ALL,
+    GPU_CULLING_PHASE_EARLY,
+    GPU_CULLING_PHASE_LATE,
+};
+
+// index range of a mesh in the shared vertex/index buffers and its bounding
+// sphere in mesh space (xyz center, w radius). std430, mirrored by cull.comp
+// and cull_occlusion.comp.
+struct GPUCullingMesh {
+    uint32_t indexCount;
+    uint32_t firstIndex;
+    int32_t vertexOffset;
+    uint32_t padding;
+    vec4 boundingSphere;
+};
+
+struct GPUCullingObject {
+    mat4 transform;
+    uint32_t meshIndex;
+    uint32_t padding[3];
+};
+
+// GPU-driven draw list. CmdCull test every object against the frustum in a
+// compute pass and write one VkDrawIndexedIndirectCommand per visible
+// object, CmdDrawIndexed consume them with a single indirect count draw, so
+// the CPU cost doesn't depend on the object count.
+//
+// Commands use firstInstance as the object index, vertex shaders fetch the
+// transform with objects[gl_InstanceIndex] from GetObjectBuffer(), this
+// needs drawIndirectFirstInstance. Without drawIndirectCount the commands
+// are not compacted, culled objects are left with a zero instanceCount.
+//
+// Meshes and objects are shared by every frame in flight, only update them
+// when the GPU is done with the previous content. Setting objects reset the
+// visibility of the previous frame, the next EARLY phase draws nothing.
+class GPUCulling {
+public:
+    GPUCulling(RenderDevice *vRD, uint32_t vMaxMeshCount, uint32_t vMaxObjectCount, HiZBuffer *vHiZBuffer = NULL);
+   ~GPUCulling();
+
+    static bool IsSupported(RenderDevice *pRD) { return pRD->GetDeviceContext()->GetPhysicalDeviceFeatures().drawIndirectFirstInstance; }
+
+    RenderDevice::BufferHandle GetObjectBuffer() { return objectBuffer; }
+    uint32_t GetObjectCount() { return objectCount; }
+
+    void SetMeshes(uint32_t count, GPUCullingMesh *pMeshes);
+    void SetObjects(uint32_t count, GPUCullingObject *pObjects);
+
+    // rewrite the pyramid descriptor after HiZBuffer::Resize, GPU idle.
+    void RefreshHiZBuffer();
+
+    // outside of a render pass, EARLY and LATE need the HiZBuffer.
+    void CmdCull(VkCommandBuffer cmdBuffer, const mat4 &viewProjection, GPUCullingPhase phase = GPU_CULLING_PHASE_ALL);
+    // inside the render pass, with the pipeline, vertex and index buffers
+    // already bound. ALL and EARLY share the same list.
+    void CmdDrawIndexed(VkCommandBuffer cmdBuffer, GPUCullingPhase phase = GPU_CULLING_PHASE_ALL);
+
+private:
+    struct CullPushConst {
+        vec4 planes[6];
+        uint32_t objectCount;
+    };
+
+    struct OcclusionPushConst {
+        mat4 viewProjection;
+        vec2 pyramidSize;
+        uint32_t objectCount;
+        uint32_t phase;
+        uint32_t pyramidMipLevels;
+    };
+
+    static void _ExtractFrustumPlanes(const mat4 &viewProjection, vec4 *pPlanes);
+
+    RenderDevice *rd = VK_NULL_HANDLE;
+    uint32_t maxMeshCount;
+    uint32_t maxObjectCount;
+    uint32_t objectCount = 0;
+    bool compact;
+    RenderDevice::BufferHandle meshBuffer;
+    RenderDevice::BufferHandle objectBuffer;
+    RenderDevice::BufferHandle drawBuffer;
+    RenderDevice::BufferHandle countBuffer;
+    RenderDevice::PipelineHandle cullPipeline;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+
+    /* occlusion, only with a HiZBuffer */
+    HiZBuffer *hiZBuffer = VK_NULL_HANDLE;
+    RenderDevice::BufferHandle visibilityBuffer;
+    RenderDevice::PipelineHandle occlusionPipeline;
+    VkDescriptorSet occlusionDescriptorSet = VK_NULL_HANDLE;
+    bool resetVisibility = true;
+};
+
+#endif /* _GPU_CULLING_H_ */
@@ -0,0 +1,308 @@
+/* ======================================================================== */
+/* HiZBuffer.cpp                                                            */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "HiZBuffer.h"
+#include "Profiler/GPUProfiler.h"
+
+static uint32_t _PreviousPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result * 2 <= value)
+        result *= 2;
+
+    return result;
+}
+
+HiZBuffer::HiZBuffer(RenderDevice *vRD, uint32_t vWidth, uint32_t vHeight)
+    : rd(vRD), width(vWidth), height(vHeight)
+{
+    device = rd->GetDeviceContext()->GetDevice();
+
+    // one pass clearing the depth and one loading it, they are compatible
+    // so the same pipelines draw in both.
+    VkAttachmentDescription attachment = {
+            /* flags */ VK_NONE_FLAGS,
+            /* format */ HI_Z_BUFFER_DEPTH_FORMAT,
+            /* samples */ VK_SAMPLE_COUNT_1_BIT,
+            /* loadOp */ VK_ATTACHMENT_LOAD_OP_CLEAR,
+            /* storeOp */ VK_ATTACHMENT_STORE_OP_STORE,
+            /* stencilLoadOp */ VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            /* stencilStoreOp */ VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            /* initialLayout */ VK_IMAGE_LAYOUT_UNDEFINED,
+            /* finalLayout */ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+
+    VkAttachmentReference reference = {};
+    reference.attachment = 0;
+    reference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &reference;
+
+    /* the pyramid build of the previous pass read the depth */
+    VkSubpassDependency subpass_dependencies[2] = {};
+    subpass_dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpass_dependencies[0].dstSubpass = 0;
+    subpass_dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    subpass_dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    subpass_dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    subpass_dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    subpass_dependencies[1].srcSubpass = 0;
+    subpass_dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    subpass_dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    subpass_dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    subpass_dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    subpass_dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    rd->CreateRenderPass(1, &attachment, 1, &subpass, ARRAY_SIZE(subpass_dependencies), subpass_dependencies, &clearRenderPass);
+
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    rd->CreateRenderPass(1, &attachment, 1, &subpass, ARRAY_SIZE(subpass_dependencies), subpass_dependencies, &loadRenderPass);
+
+    RenderDevice::SamplerCreateInfo sampler_create_info = {};
+    sampler_create_info.u = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.v = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.w = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_create_info.filter = VK_FILTER_NEAREST;
+    sampler_create_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    rd->CreateSampler(&sampler_create_info, &sampler);
+
+    RenderDevice::ComputeShaderInfo shaderInfo = {};
+    shaderInfo.compute = "hiz";
+    downsamplePipeline = rd->CreateComputePipeline(&shaderInfo);
+
+    _CreateTargets();
+}
+
+HiZBuffer::~HiZBuffer()
+{
+    _CleanUpTargets();
+
+    rd->DestroyPipeline(downsamplePipeline);
+    rd->DestroySampler(sampler);
+    rd->DestroyRenderPass(loadRenderPass);
+    rd->DestroyRenderPass(clearRenderPass);
+}
+
+void HiZBuffer::Resize(uint32_t vWidth, uint32_t vHeight)
+{
+    if (vWidth == width && vHeight == height)
+        return;
+
+    _CleanUpTargets();
+
+    width = vWidth;
+    height = vHeight;
+    _CreateTargets();
+}
+
+void HiZBuffer::CmdBeginDepthPass(VkCommandBuffer cmdBuffer, bool clear)
+{
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler)
+        depthPassScope = profiler->CmdBeginScope(cmdBuffer, "DepthPrepass");
+
+    VkClearValue clearDepth = {};
+    clearDepth.depthStencil = { 1.0f, 0 };
+
+    VkRect2D rect = {};
+    rect.extent = { width, height };
+    rd->CmdBeginRenderPass(cmdBuffer, clear ? clearRenderPass : loadRenderPass, 1, &clearDepth, framebuffer, &rect);
+}
+
+void HiZBuffer::CmdEndDepthPass(VkCommandBuffer cmdBuffer)
+{
+    rd->CmdEndRenderPass(cmdBuffer);
+
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler)
+        profiler->CmdEndScope(cmdBuffer, depthPassScope);
+}
+
+void HiZBuffer::CmdBuildPyramid(VkCommandBuffer cmdBuffer)
+{
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    uint32_t pyramidScope = profiler ? profiler->CmdBeginScope(cmdBuffer, "HiZPyramid") : 0;
+
+    // the culling of the previous pass may still sample the pyramid.
+    RenderDevice::PipelineMemoryBarrier barrier;
+    barrier.image.texture = pyramidTexture;
+    barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.image.newImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.image.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.image.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    rd->CmdBindPipeline(cmdBuffer, downsamplePipeline);
+
+    uint32_t sourceWidth = width;
+    uint32_t sourceHeight = height;
+    for (uint32_t i = 0; i < pyramidMipLevels; i++) {
+        uint32_t mipWidth = std::max(pyramidWidth >> i, 1u);
+        uint32_t mipHeight = std::max(pyramidHeight >> i, 1u);
+
+        DownsamplePushConst pushConst = {
+                /* sourceSize */ { (int32_t) sourceWidth, (int32_t) sourceHeight },
+                /* destinationSize */ { (int32_t) mipWidth, (int32_t) mipHeight },
+        };
+
+        rd->CmdBindDescriptorSet(cmdBuffer, downsamplePipeline, descriptorSets[i]);
+        rd->CmdPushConstant(cmdBuffer, downsamplePipeline, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsamplePushConst), &pushConst);
+        rd->CmdDispatch(cmdBuffer, (mipWidth + HI_Z_BUFFER_GROUP_SIZE - 1) / HI_Z_BUFFER_GROUP_SIZE, (mipHeight + HI_Z_BUFFER_GROUP_SIZE - 1) / HI_Z_BUFFER_GROUP_SIZE);
+
+        /* next level read this one, culling read them all */
+        barrier.image.baseMipLevel = i;
+        barrier.image.levelCount = 1;
+        barrier.image.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.image.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+        sourceWidth = mipWidth;
+        sourceHeight = mipHeight;
+    }
+
+    if (profiler)
+        profiler->CmdEndScope(cmdBuffer, pyramidScope);
+}
+
+void HiZBuffer::_CreateTargets()
+{
+    VkResult U_ASSERT_ONLY err;
+
+    pyramidWidth = _PreviousPowerOfTwo(width);
+    pyramidHeight = _PreviousPowerOfTwo(height);
+    pyramidMipLevels = RenderDevice::CalculateMipLevels(pyramidWidth, pyramidHeight);
+
+    RenderDevice::TextureCreateInfo texture_create_info = {};
+    texture_create_info.width = width;
+    texture_create_info.height = height;
+    texture_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    texture_create_info.format = HI_Z_BUFFER_DEPTH_FORMAT;
+    texture_create_info.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    texture_create_info.imageType = VK_IMAGE_TYPE_2D;
+    texture_create_info.imageViewType = VK_IMAGE_VIEW_TYPE_2D;
+    texture_create_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    depthTexture = rd->CreateTexture(&texture_create_info);
+    rd->BindTextureSampler(depthTexture, sampler);
+
+    texture_create_info.width = pyramidWidth;
+    texture_create_info.height = pyramidHeight;
+    texture_create_info.format = VK_FORMAT_R32_SFLOAT;
+    texture_create_info.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    texture_create_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    texture_create_info.mipLevels = pyramidMipLevels;
+    pyramidTexture = rd->CreateTexture(&texture_create_info);
+    rd->BindTextureSampler(pyramidTexture, sampler);
+
+    VkImageView depthImageView = rd->GetTexture(depthTexture)->imageView;
+    rd->CreateFramebuffer(width, height, 1, &depthImageView, clearRenderPass, &framebuffer);
+
+    /* layouts expected outside of the passes */
+    VkCommandBuffer cmdBuffer;
+    rd->CmdBufferOneTimeBegin(&cmdBuffer);
+
+    RenderDevice::PipelineMemoryBarrier barrier;
+    barrier.image.texture = depthTexture;
+    barrier.image.newImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.image.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    barrier.image.texture = pyramidTexture;
+    barrier.image.newImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+
+    rd->CmdBufferOneTimeEnd(cmdBuffer);
+
+    VkImage pyramidImage = rd->GetTexture(pyramidTexture)->image;
+    VkDescriptorSetLayout descriptorSetLayout = rd->GetPipeline(downsamplePipeline)->descriptorSetLayouts[0];
+
+    pyramidViews.resize(pyramidMipLevels);
+    descriptorSets.resize(pyramidMipLevels);
+    for (uint32_t i = 0; i < pyramidMipLevels; i++) {
+        VkImageViewCreateInfo image_view_create_info = {
+                /* sType */ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                /* pNext */ VK_NULL_HANDLE,
+                /* flags */ VK_NONE_FLAGS,
+                /* image */ pyramidImage,
+                /* viewType */ VK_IMAGE_VIEW_TYPE_2D,
+                /* format */ VK_FORMAT_R32_SFLOAT,
+                /* components */ { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY },
+                /* subresourceRange */ { VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 },
+        };
+
+        err = vkCreateImageView(device, &image_view_create_info, VK_NULL_HANDLE, &pyramidViews[i]);
+        assert(!err);
+
+        rd->AllocateDescriptorSet(descriptorSetLayout, &descriptorSets[i]);
+    }
+
+    // every level read the previous one, level 0 read the depth.
+    for (uint32_t i = 0; i < pyramidMipLevels; i++) {
+        VkDescriptorImageInfo sourceInfo = {
+                /* sampler= */ sampler,
+                /* imageView= */ i == 0 ? depthImageView : pyramidViews[i - 1],
+                /* imageLayout= */ i == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL,
+        };
+
+        VkDescriptorImageInfo destinationInfo = {
+                /* sampler= */ VK_NULL_HANDLE,
+                /* imageView= */ pyramidViews[i],
+                /* imageLayout= */ VK_IMAGE_LAYOUT_GENERAL,
+        };
+
+        VkWriteDescriptorSet writeInfos[2] = {};
+        writeInfos[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeInfos[0].dstSet = descriptorSets[i];
+        writeInfos[0].dstBinding = 0;
+        writeInfos[0].descriptorCount = 1;
+        writeInfos[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writeInfos[0].pImageInfo = &sourceInfo;
+
+        writeInfos[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeInfos[1].dstSet = descriptorSets[i];
+        writeInfos[1].dstBinding = 1;
+        writeInfos[1].descriptorCount = 1;
+        writeInfos[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writeInfos[1].pImageInfo = &destinationInfo;
+
+        vkUpdateDescriptorSets(device, ARRAY_SIZE(writeInfos), writeInfos, 0, VK_NULL_HANDLE);
+    }
+}
+
+void HiZBuffer::_CleanUpTargets()
+{
+    for (VkDescriptorSet descriptorSet : descriptorSets)
+        rd->FreeDescriptorSet(descriptorSet);
+
+    for (VkImageView imageView : pyramidViews)
+        vkDestroyImageView(device, imageView, VK_NULL_HANDLE);
+
+    descriptorSets.clear();
+    pyramidViews.clear();
+
+    rd->DestroyFramebuffer(framebuffer);
+    rd->DestroyTexture(pyramidTexture);
+    rd->DestroyTexture(depthTexture);
+}
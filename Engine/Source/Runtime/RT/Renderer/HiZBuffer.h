@@ -0,0 +1,97 @@
+/* ======================================================================== */
+/* HiZBuffer.h                                                              */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _HI_Z_BUFFER_H_
+#define _HI_Z_BUFFER_H_
+
+#include "RT/Drivers/RenderDevice.h"
+#include <vector>
+
+#define HI_Z_BUFFER_DEPTH_FORMAT VK_FORMAT_D32_SFLOAT
+#define HI_Z_BUFFER_GROUP_SIZE 8
+
+// Depth prepass target and the hierarchical depth pyramid built from it.
+// Every pyramid texel hold the farthest depth of the area it covers, mip 0
+// is the largest power of two not above the depth size, so a bounding
+// rectangle can be tested against it with 4 samples of the right level.
+//
+// Pipelines drawn in the depth pass are created against GetRenderPass()
+// with colorAttachmentCount 0. Outside of the passes the depth texture
+// stays in SHADER_READ_ONLY_OPTIMAL and the pyramid in GENERAL.
+//
+// The pyramid mip views are raw Vulkan objects, Resize (GPU idle) after the
+// defragmenter moved the textures.
+class HiZBuffer {
+public:
+    HiZBuffer(RenderDevice *vRD, uint32_t vWidth, uint32_t vHeight);
+   ~HiZBuffer();
+
+    VkRenderPass GetRenderPass() { return clearRenderPass; }
+    RenderDevice::TextureHandle GetDepthTexture() { return depthTexture; }
+    // sampled with a nearest, clamp to edge sampler.
+    RenderDevice::TextureHandle GetPyramidTexture() { return pyramidTexture; }
+    uint32_t GetWidth() { return width; }
+    uint32_t GetHeight() { return height; }
+    uint32_t GetPyramidWidth() { return pyramidWidth; }
+    uint32_t GetPyramidHeight() { return pyramidHeight; }
+    uint32_t GetPyramidMipLevels() { return pyramidMipLevels; }
+
+    // recreate the depth and the pyramid, the GPU must be idle.
+    void Resize(uint32_t vWidth, uint32_t vHeight);
+
+    // clear start from the far plane, otherwise the pass keep the depth
+    // already written this frame.
+    void CmdBeginDepthPass(VkCommandBuffer cmdBuffer, bool clear);
+    void CmdEndDepthPass(VkCommandBuffer cmdBuffer);
+    // outside of a render pass, after the depth pass.
+    void CmdBuildPyramid(VkCommandBuffer cmdBuffer);
+
+private:
+    struct DownsamplePushConst {
+        int32_t sourceSize[2];
+        int32_t destinationSize[2];
+    };
+
+    void _CreateTargets();
+    void _CleanUpTargets();
+
+    RenderDevice *rd = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pyramidWidth;
+    uint32_t pyramidHeight;
+    uint32_t pyramidMipLevels;
+    VkRenderPass clearRenderPass = VK_NULL_HANDLE;
+    VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    RenderDevice::PipelineHandle downsamplePipeline;
+    RenderDevice::TextureHandle depthTexture;
+    RenderDevice::TextureHandle pyramidTexture;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    std::vector<VkImageView> pyramidViews;
+    std::vector<VkDescriptorSet> descriptorSets;
+
+    uint32_t depthPassScope = 0;
+};
+
+#endif /* _HI_Z_BUFFER_H_ */
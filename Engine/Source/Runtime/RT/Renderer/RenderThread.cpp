@@ -0,0 +1,150 @@
+/* ======================================================================== */
+/* RenderThread.cpp                                                         */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "RenderThread.h"
+#include "Profiler/CPUProfiler.h"
+
+RenderThread::RenderThread(RenderingDisplay *vDisplay)
+    : display(vDisplay)
+{
+    frame_arena_create(&commandArena, RENDER_THREAD_FRAME_PACKET_ARENA_SIZE, "frame_packet");
+
+    thread = std::thread(&RenderThread::_ThreadMain, this);
+}
+
+RenderThread::~RenderThread()
+{
+    WaitIdle();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopFlag = true;
+    }
+
+    submitCondition.notify_all();
+    thread.join();
+
+    frame_arena_destroy(&commandArena);
+}
+
+FramePacket *RenderThread::BeginFramePacket()
+{
+    uint64_t frame;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        frame = submittedFrame + 1;
+        renderCondition.wait(lock, [this, frame] { return renderedFrame + RENDER_THREAD_FRAME_PACKET_COUNT >= frame; });
+    }
+
+    FramePacket *packet = &packets[frame % RENDER_THREAD_FRAME_PACKET_COUNT];
+    packet->frame = frame;
+    packet->prePassCommands.clear();
+    packet->commands.clear();
+    frame_arena_begin(&commandArena, frame);
+
+    return packet;
+}
+
+void *RenderThread::PushRenderCommand(FramePacket *pPacket, PFN_RenderCommand fn, size_t size)
+{
+    return _PushCommand(&pPacket->commands, fn, size);
+}
+
+void *RenderThread::PushPrePassCommand(FramePacket *pPacket, PFN_RenderCommand fn, size_t size)
+{
+    return _PushCommand(&pPacket->prePassCommands, fn, size);
+}
+
+void RenderThread::SubmitFramePacket(FramePacket *pPacket)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        assert(pPacket->frame == submittedFrame + 1);
+        submittedFrame = pPacket->frame;
+    }
+
+    submitCondition.notify_one();
+}
+
+void RenderThread::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    renderCondition.wait(lock, [this] { return renderedFrame == submittedFrame; });
+
+    /* submitted isn't finished, the GPU may still run the last frames */
+    display->WaitIdle();
+}
+
+void *RenderThread::_PushCommand(std::vector<RenderCommand> *pCommands, PFN_RenderCommand fn, size_t size)
+{
+    void *data = NULL;
+    if (size > 0) {
+        data = frame_arena_alloc(&commandArena, size);
+        if (!data)
+            return NULL;
+    }
+
+    pCommands->push_back({ fn, data });
+
+    return data;
+}
+
+void RenderThread::_ThreadMain()
+{
+    PROFILE_THREAD("Render");
+
+    while (true) {
+        FramePacket *packet;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            submitCondition.wait(lock, [this] { return stopFlag || submittedFrame > renderedFrame; });
+
+            if (submittedFrame == renderedFrame)
+                return;
+
+            packet = &packets[(renderedFrame + 1) % RENDER_THREAD_FRAME_PACKET_COUNT];
+        }
+
+        {
+            PROFILE_SCOPE("RenderFramePacket");
+
+            VkCommandBuffer cmdBuffer;
+            display->CmdBeginDisplayFrame(&cmdBuffer);
+            for (const RenderCommand &command : packet->prePassCommands)
+                command.fn(cmdBuffer, command.data);
+            display->CmdBeginDisplayPass(cmdBuffer);
+            for (const RenderCommand &command : packet->commands)
+                command.fn(cmdBuffer, command.data);
+            display->CmdEndDisplayPass(cmdBuffer);
+            display->CmdEndDisplayFrame(cmdBuffer);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            renderedFrame = packet->frame;
+        }
+
+        renderCondition.notify_all();
+    }
+}
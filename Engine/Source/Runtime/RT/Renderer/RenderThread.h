@@ -0,0 +1,95 @@
+/* ======================================================================== */
+/* RenderThread.h                                                           */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _RENDER_THREAD_H_
+#define _RENDER_THREAD_H_
+
+#include "RenderingDisplay.h"
+#include <Bright/Memalloc.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define RENDER_THREAD_FRAME_PACKET_COUNT 2
+#define RENDER_THREAD_FRAME_PACKET_ARENA_SIZE (4 * 1024 * 1024)
+
+typedef void (*PFN_RenderCommand) (VkCommandBuffer cmdBuffer, void *pData);
+
+struct RenderCommand {
+    PFN_RenderCommand fn;
+    void *data;
+};
+
+// a frame arena slot must outlive the packet of its frame.
+static_assert(FRAME_ARENA_COUNT >= RENDER_THREAD_FRAME_PACKET_COUNT);
+
+// Everything the render thread need to record one frame, filled by the
+// main thread. Command payloads live in the render thread frame arena and
+// are dropped once the arena slot of the frame is reused.
+struct FramePacket {
+    uint64_t frame = 0;
+    std::vector<RenderCommand> prePassCommands;
+    std::vector<RenderCommand> commands;
+};
+
+// Record, submit and present on a dedicated thread. The main thread fill
+// the packet of frame N+1 while the render thread consume the one of frame
+// N, so event polling and simulation never wait on vkQueuePresentKHR.
+class RenderThread {
+public:
+    RenderThread(RenderingDisplay *vDisplay);
+   ~RenderThread();
+
+    // block until the render thread released the slot of frame N-2.
+    FramePacket *BeginFramePacket();
+    // payload of size bytes is allocated in the packet and passed to fn
+    // inside the display render pass, NULL when the packet arena is full.
+    void *PushRenderCommand(FramePacket *pPacket, PFN_RenderCommand fn, size_t size);
+    // same as PushRenderCommand, recorded before the display render pass
+    // begin (compute dispatches, buffer fills and copies).
+    void *PushPrePassCommand(FramePacket *pPacket, PFN_RenderCommand fn, size_t size);
+    void SubmitFramePacket(FramePacket *pPacket);
+    // every submitted packet recorded and finished on the GPU.
+    void WaitIdle();
+
+    uint64_t GetSubmittedFrame() { return submittedFrame; }
+    uint64_t GetRenderedFrame() { return renderedFrame; }
+
+private:
+    void *_PushCommand(std::vector<RenderCommand> *pCommands, PFN_RenderCommand fn, size_t size);
+    void _ThreadMain();
+
+    RenderingDisplay *display = NULL;
+    FramePacket packets[RENDER_THREAD_FRAME_PACKET_COUNT];
+    /* payloads of the packet being built, only touched by the main thread */
+    frame_arena commandArena;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable submitCondition;
+    std::condition_variable renderCondition;
+    uint64_t submittedFrame = 0;
+    uint64_t renderedFrame = 0;
+    bool stopFlag = false;
+};
+
+#endif /* _RENDER_THREAD_H_ */
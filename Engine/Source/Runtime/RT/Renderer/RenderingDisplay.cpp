@@ -21,6 +21,8 @@
 /*                                                                          */
 /* ======================================================================== */
 #include "RenderingDisplay.h"
+#include "Profiler/CPUProfiler.h"
+#include "Profiler/GPUProfiler.h"
 #include <algorithm>
 
 RenderingDisplay::RenderingDisplay(RenderDevice *vRD, Window *vWindow)
@@ -32,33 +34,82 @@ RenderingDisplay::RenderingDisplay(RenderDevice *vRD, Window *vWindow)
     physicalDevice = rdc->GetPhysicalDevice();
     device = rdc->GetDevice();
     graphQueueFamily = rdc->GetQueueFamily();
-    cmdPool = rdc->GetCommandPool();
     graphQueue = rdc->GetQueue();
+    queueMutex = &rdc->GetQueueMutex();
 
     _Initialize();
 }
 
 RenderingDisplay::~RenderingDisplay()
 {
-    vkDestroySemaphore(device, display->imageAvailableSemaphore, VK_NULL_HANDLE);
-    vkDestroySemaphore(device, display->renderFinishedSemaphore, VK_NULL_HANDLE);
+    /* presents hold semaphores no fence covers */
+    {
+        std::lock_guard<std::mutex> lock(*queueMutex);
+        vkDeviceWaitIdle(device);
+    }
+
+    for (FrameResource &frame : frames) {
+        vkDestroyFence(device, frame.fence, VK_NULL_HANDLE);
+        vkDestroySemaphore(device, frame.imageAvailableSemaphore, VK_NULL_HANDLE);
+        vkFreeCommandBuffers(device, cmdPool, 1, &frame.cmdBuffer);
+    }
+
     vkDestroySwapchainKHR(device, display->swapchain, VK_NULL_HANDLE);
     vkDestroyRenderPass(device, display->renderPass, VK_NULL_HANDLE);
     _CleanUpSwapchain();
+    vkDestroyCommandPool(device, cmdPool, VK_NULL_HANDLE);
     vkDestroySurfaceKHR(instance, display->surface, VK_NULL_HANDLE);
     free(display);
 }
 
+void RenderingDisplay::WaitIdle()
+{
+    for (FrameResource &frame : frames)
+        vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+}
+
 void RenderingDisplay::CmdBeginDisplayRender(VkCommandBuffer *pCmdBuffer)
 {
+    CmdBeginDisplayFrame(pCmdBuffer);
+    CmdBeginDisplayPass(*pCmdBuffer);
+}
+
+void RenderingDisplay::CmdEndDisplayRender(VkCommandBuffer cmdBuffer)
+{
+    CmdEndDisplayPass(cmdBuffer);
+    CmdEndDisplayFrame(cmdBuffer);
+}
+
+void RenderingDisplay::CmdBeginDisplayFrame(VkCommandBuffer *pCmdBuffer)
+{
+    PROFILE_FUNCTION();
+
     _CheckUpdateSwapchain();
-    vkAcquireNextImageKHR(device, display->swapchain, UINT64_MAX, display->imageAvailableSemaphore, nullptr, &acquireNextIndex);
+
+    currentFrame = &frames[frameCounter++ % RENDERING_DISPLAY_FRAME_COUNT];
+    vkWaitForFences(device, 1, &currentFrame->fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device, 1, &currentFrame->fence);
+
+    vkAcquireNextImageKHR(device, display->swapchain, UINT64_MAX, currentFrame->imageAvailableSemaphore, nullptr, &acquireNextIndex);
 
     VkCommandBuffer cmdBuffer;
-    cmdBuffer = display->swapchainResources[acquireNextIndex].cmdBuffer;
+    cmdBuffer = currentFrame->cmdBuffer;
     *pCmdBuffer = cmdBuffer;
     rd->CmdBufferBegin(cmdBuffer, VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
 
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler)
+        profiler->CmdBeginFrame(cmdBuffer);
+}
+
+void RenderingDisplay::CmdBeginDisplayPass(VkCommandBuffer cmdBuffer)
+{
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler) {
+        displayPassScope = profiler->CmdBeginScope(cmdBuffer, "DisplayPass");
+        displayPassStatistics = profiler->CmdBeginStatistics(cmdBuffer, "DisplayPass");
+    }
+
     VkClearValue clearColor = { 0.10f, 0.10f, 0.10f, 1.0f };
 
     VkRect2D rect = {};
@@ -66,14 +117,32 @@ void RenderingDisplay::CmdBeginDisplayRender(VkCommandBuffer *pCmdBuffer)
     rd->CmdBeginRenderPass(cmdBuffer, display->renderPass, 1, &clearColor, display->swapchainResources[acquireNextIndex].framebuffer, &rect);
 }
 
-void RenderingDisplay::CmdEndDisplayRender(VkCommandBuffer cmdBuffer)
+void RenderingDisplay::CmdEndDisplayPass(VkCommandBuffer cmdBuffer)
 {
     rd->CmdEndRenderPass(cmdBuffer);
+
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler) {
+        profiler->CmdEndStatistics(cmdBuffer, displayPassStatistics);
+        profiler->CmdEndScope(cmdBuffer, displayPassScope);
+    }
+}
+
+void RenderingDisplay::CmdEndDisplayFrame(VkCommandBuffer cmdBuffer)
+{
+    PROFILE_FUNCTION();
+
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler)
+        profiler->CmdEndFrame(cmdBuffer);
+
     rd->CmdBufferEnd(cmdBuffer);
 
+    VkSemaphore renderFinishedSemaphore = display->swapchainResources[acquireNextIndex].renderFinishedSemaphore;
+
     VkPipelineStageFlags mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    rd->CmdBufferSubmit(cmdBuffer, 1, &display->imageAvailableSemaphore, 1, &display->renderFinishedSemaphore, &mask, graphQueue, VK_NULL_HANDLE);
-    rd->Present(graphQueue, display->swapchain, acquireNextIndex, display->renderFinishedSemaphore);
+    rd->CmdBufferSubmit(cmdBuffer, 1, &currentFrame->imageAvailableSemaphore, 1, &renderFinishedSemaphore, &mask, graphQueue, currentFrame->fence);
+    rd->Present(graphQueue, display->swapchain, acquireNextIndex, renderFinishedSemaphore);
 }
 
 void RenderingDisplay::_Initialize()
@@ -111,14 +180,43 @@ void RenderingDisplay::_Initialize()
     display->compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     display->presentMode = VK_PRESENT_MODE_FIFO_KHR;
 
+    // own pool, the display may record on the render thread while the main
+    // thread record uploads from the device pool.
+    VkCommandPoolCreateInfo cmd_pool_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            /* pNext */ VK_NULL_HANDLE,
+            /* flags */ VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            /* queueFamilyIndex */ graphQueueFamily
+    };
+
+    err = vkCreateCommandPool(device, &cmd_pool_create_info, VK_NULL_HANDLE, &cmdPool);
+    assert(!err);
+
     VkSemaphoreCreateInfo semaphore_create_info = {};
     semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-    err = vkCreateSemaphore(device, &semaphore_create_info, VK_NULL_HANDLE, &display->imageAvailableSemaphore);
-    assert(!err);
+    VkFenceCreateInfo fence_create_info = {};
+    fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
-    err = vkCreateSemaphore(device, &semaphore_create_info, VK_NULL_HANDLE, &display->renderFinishedSemaphore);
-    assert(!err);
+    for (FrameResource &frame : frames) {
+        VkCommandBufferAllocateInfo cmd_allocate_info = {
+                /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                /* pNext */ VK_NULL_HANDLE,
+                /* commandPool */ cmdPool,
+                /* level */ VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                /* commandBufferCount */ 1
+        };
+
+        err = vkAllocateCommandBuffers(device, &cmd_allocate_info, &frame.cmdBuffer);
+        assert(!err);
+
+        err = vkCreateSemaphore(device, &semaphore_create_info, VK_NULL_HANDLE, &frame.imageAvailableSemaphore);
+        assert(!err);
+
+        err = vkCreateFence(device, &fence_create_info, VK_NULL_HANDLE, &frame.fence);
+        assert(!err);
+    }
 
     _CreateSwapchain();
 }
@@ -220,15 +318,11 @@ void RenderingDisplay::_CreateSwapchain()
     for (uint32_t i = 0; i < display->imageBufferCount; i++) {
         display->swapchainResources[i].image = swap_chain_images[i];
 
-        VkCommandBufferAllocateInfo cmd_allocate_info = {
-                /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-                /* pNext */ VK_NULL_HANDLE,
-                /* commandPool */ cmdPool,
-                /* level */ VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-                /* commandBufferCount */ 1
-        };
+        VkSemaphoreCreateInfo semaphore_create_info = {};
+        semaphore_create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        rd->AllocateCommandBuffer(&(display->swapchainResources[i].cmdBuffer));
+        err = vkCreateSemaphore(device, &semaphore_create_info, VK_NULL_HANDLE, &(display->swapchainResources[i].renderFinishedSemaphore));
+        assert(!err);
 
         VkImageViewCreateInfo image_view_create_info = {
                 /* sType */ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -279,7 +373,7 @@ void RenderingDisplay::_CreateSwapchain()
 void RenderingDisplay::_CleanUpSwapchain()
 {
     for (uint32_t i = 0; i < display->imageBufferCount; i++) {
-        vkFreeCommandBuffers(device, cmdPool, 1, &display->swapchainResources[i].cmdBuffer);
+        vkDestroySemaphore(device, display->swapchainResources[i].renderFinishedSemaphore, VK_NULL_HANDLE);
         vkDestroyFramebuffer(device, display->swapchainResources[i].framebuffer, VK_NULL_HANDLE);
         vkDestroyImageView(device, display->swapchainResources[i].imageView, VK_NULL_HANDLE);
     }
@@ -295,7 +389,10 @@ void RenderingDisplay::_CheckUpdateSwapchain()
 
     /* is update */
     if ((extent.width != display->width || extent.height != display->height) && (extent.width != 0 || extent.height != 0)) {
-        vkDeviceWaitIdle(device);
+        {
+            std::lock_guard<std::mutex> lock(*queueMutex);
+            vkDeviceWaitIdle(device);
+        }
         _CleanUpSwapchain();
         _CreateSwapchain();
     }
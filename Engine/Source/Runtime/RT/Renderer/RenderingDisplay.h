@@ -26,6 +26,10 @@
 #include "RT/Drivers/RenderDevice.h"
 #include "RT/Window/Window.h"
 
+#define RENDERING_DISPLAY_FRAME_COUNT 2
+
+// Up to RENDERING_DISPLAY_FRAME_COUNT frames are in flight, a frame only
+// wait on the fence of the one submitted that many frames before it.
 class RenderingDisplay {
 public:
     RenderingDisplay(RenderDevice *vRD, Window *vWindow);
@@ -35,15 +39,33 @@ public:
     uint32_t GetImageBufferCount() { return display->imageBufferCount; }
     Window *GetNativeWindow() { return currentNativeWindow; }
 
+    // wait every frame in flight.
+    void WaitIdle();
+
     void CmdBeginDisplayRender(VkCommandBuffer *pCmdBuffer);
     void CmdEndDisplayRender(VkCommandBuffer cmdBuffer);
 
+    // same as Begin/EndDisplayRender split around the render pass, work
+    // outside of it (compute, copies) is recorded between BeginDisplayFrame
+    // and BeginDisplayPass.
+    void CmdBeginDisplayFrame(VkCommandBuffer *pCmdBuffer);
+    void CmdBeginDisplayPass(VkCommandBuffer cmdBuffer);
+    void CmdEndDisplayPass(VkCommandBuffer cmdBuffer);
+    void CmdEndDisplayFrame(VkCommandBuffer cmdBuffer);
+
 private:
     struct SwapchainResource {
-        VkCommandBuffer cmdBuffer;
         VkImage image;
         VkImageView imageView;
         VkFramebuffer framebuffer;
+        /* per image, the presentation engine may still wait on it */
+        VkSemaphore renderFinishedSemaphore;
+    };
+
+    struct FrameResource {
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
     };
 
     struct Display {
@@ -56,8 +78,6 @@ private:
         VkRenderPass renderPass = VK_NULL_HANDLE;
         VkSwapchainKHR swapchain = VK_NULL_HANDLE;
         SwapchainResource *swapchainResources;
-        VkSemaphore imageAvailableSemaphore;
-        VkSemaphore renderFinishedSemaphore;
         uint32_t width;
         uint32_t height;
     };
@@ -75,9 +95,15 @@ private:
     VkCommandPool cmdPool = VK_NULL_HANDLE;
     Display *display = VK_NULL_HANDLE;
     VkQueue graphQueue = VK_NULL_HANDLE;
+    std::mutex *queueMutex = NULL;
     Window *currentNativeWindow= VK_NULL_HANDLE;
 
+    FrameResource frames[RENDERING_DISPLAY_FRAME_COUNT];
+    FrameResource *currentFrame = VK_NULL_HANDLE;
+    uint64_t frameCounter = 0;
     uint32_t acquireNextIndex;
+    uint32_t displayPassScope = 0;
+    uint32_t displayPassStatistics = 0;
 };
 
 #endif /* _RENDERING_SCREEN_H_ */
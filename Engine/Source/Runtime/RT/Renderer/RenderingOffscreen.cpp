@@ -0,0 +1,227 @@
+/* ======================================================================== */
+/* RenderingOffscreen.cpp                                                   */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include "RenderingOffscreen.h"
+#include "Profiler/CPUProfiler.h"
+#include "Profiler/GPUProfiler.h"
+
+RenderingOffscreen::RenderingOffscreen(RenderDevice *vRD, uint32_t vWidth, uint32_t vHeight)
+    : rd(vRD), width(vWidth), height(vHeight)
+{
+    VkResult U_ASSERT_ONLY err;
+    RenderDeviceContext *rdc = rd->GetDeviceContext();
+
+    device = rdc->GetDevice();
+    graphQueue = rdc->GetQueue();
+    format = rdc->GetWindowFormat();
+
+    // same layout as the display pass, pipelines built for one work with
+    // the other except for the final layout.
+    VkAttachmentDescription attachment = {
+            /* flags */ VK_NONE_FLAGS,
+            /* format */ format,
+            /* samples */ VK_SAMPLE_COUNT_1_BIT,
+            /* loadOp */ VK_ATTACHMENT_LOAD_OP_CLEAR,
+            /* storeOp */ VK_ATTACHMENT_STORE_OP_STORE,
+            /* stencilLoadOp */ VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            /* stencilStoreOp */ VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            /* initialLayout */ VK_IMAGE_LAYOUT_UNDEFINED,
+            /* finalLayout */ VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    };
+
+    VkAttachmentReference reference = {};
+    reference.attachment = 0;
+    reference.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &reference;
+
+    /* previous frame wrote the same image */
+    VkSubpassDependency subpass_dependency = {};
+    subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpass_dependency.dstSubpass = 0;
+    subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpass_dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    rd->CreateRenderPass(1, &attachment, 1, &subpass, 1, &subpass_dependency, &renderPass);
+
+    VkCommandPoolCreateInfo cmd_pool_create_info = {
+            /* sType */ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            /* pNext */ VK_NULL_HANDLE,
+            /* flags */ VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            /* queueFamilyIndex */ rdc->GetQueueFamily()
+    };
+
+    err = vkCreateCommandPool(device, &cmd_pool_create_info, VK_NULL_HANDLE, &cmdPool);
+    assert(!err);
+
+    for (FrameResource &frame : frames) {
+        VkCommandBufferAllocateInfo cmd_allocate_info = {
+                /* sType */ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                /* pNext */ VK_NULL_HANDLE,
+                /* commandPool */ cmdPool,
+                /* level */ VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                /* commandBufferCount */ 1
+        };
+
+        err = vkAllocateCommandBuffers(device, &cmd_allocate_info, &frame.cmdBuffer);
+        assert(!err);
+
+        VkFenceCreateInfo fence_create_info = {};
+        fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        err = vkCreateFence(device, &fence_create_info, VK_NULL_HANDLE, &frame.fence);
+        assert(!err);
+    }
+
+    _CreateRenderTarget();
+}
+
+RenderingOffscreen::~RenderingOffscreen()
+{
+    WaitIdle();
+    _CleanUpRenderTarget();
+
+    for (FrameResource &frame : frames) {
+        vkDestroyFence(device, frame.fence, VK_NULL_HANDLE);
+        vkFreeCommandBuffers(device, cmdPool, 1, &frame.cmdBuffer);
+    }
+
+    vkDestroyCommandPool(device, cmdPool, VK_NULL_HANDLE);
+    rd->DestroyRenderPass(renderPass);
+}
+
+void RenderingOffscreen::Resize(uint32_t vWidth, uint32_t vHeight)
+{
+    if (vWidth == width && vHeight == height)
+        return;
+
+    WaitIdle();
+    _CleanUpRenderTarget();
+
+    width = vWidth;
+    height = vHeight;
+    _CreateRenderTarget();
+}
+
+void RenderingOffscreen::WaitIdle()
+{
+    for (FrameResource &frame : frames)
+        vkWaitForFences(device, 1, &frame.fence, VK_TRUE, UINT64_MAX);
+}
+
+void RenderingOffscreen::CmdBeginOffscreenRender(VkCommandBuffer *pCmdBuffer)
+{
+    CmdBeginOffscreenFrame(pCmdBuffer);
+    CmdBeginOffscreenPass(*pCmdBuffer);
+}
+
+void RenderingOffscreen::CmdEndOffscreenRender(VkCommandBuffer cmdBuffer)
+{
+    CmdEndOffscreenPass(cmdBuffer);
+    CmdEndOffscreenFrame(cmdBuffer);
+}
+
+void RenderingOffscreen::CmdBeginOffscreenFrame(VkCommandBuffer *pCmdBuffer)
+{
+    PROFILE_FUNCTION();
+
+    FrameResource *frame = &frames[frameCounter++ % RENDERING_OFFSCREEN_FRAME_COUNT];
+    vkWaitForFences(device, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device, 1, &frame->fence);
+
+    VkCommandBuffer cmdBuffer = frame->cmdBuffer;
+    *pCmdBuffer = cmdBuffer;
+    rd->CmdBufferBegin(cmdBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler)
+        profiler->CmdBeginFrame(cmdBuffer);
+}
+
+void RenderingOffscreen::CmdBeginOffscreenPass(VkCommandBuffer cmdBuffer)
+{
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler) {
+        offscreenPassScope = profiler->CmdBeginScope(cmdBuffer, "OffscreenPass");
+        offscreenPassStatistics = profiler->CmdBeginStatistics(cmdBuffer, "OffscreenPass");
+    }
+
+    VkClearValue clearColor = { 0.10f, 0.10f, 0.10f, 1.0f };
+
+    VkRect2D rect = {};
+    rect.extent = { width, height };
+    rd->CmdBeginRenderPass(cmdBuffer, renderPass, 1, &clearColor, framebuffer, &rect);
+}
+
+void RenderingOffscreen::CmdEndOffscreenPass(VkCommandBuffer cmdBuffer)
+{
+    rd->CmdEndRenderPass(cmdBuffer);
+
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler) {
+        profiler->CmdEndStatistics(cmdBuffer, offscreenPassStatistics);
+        profiler->CmdEndScope(cmdBuffer, offscreenPassScope);
+    }
+}
+
+void RenderingOffscreen::CmdEndOffscreenFrame(VkCommandBuffer cmdBuffer)
+{
+    PROFILE_FUNCTION();
+
+    GPUProfiler *profiler = rd->GetGPUProfiler();
+    if (profiler)
+        profiler->CmdEndFrame(cmdBuffer);
+
+    rd->CmdBufferEnd(cmdBuffer);
+
+    FrameResource *frame = &frames[(frameCounter - 1) % RENDERING_OFFSCREEN_FRAME_COUNT];
+    rd->CmdBufferSubmit(cmdBuffer, 0, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, VK_NULL_HANDLE, graphQueue, frame->fence);
+}
+
+void RenderingOffscreen::_CreateRenderTarget()
+{
+    RenderDevice::TextureCreateInfo texture_create_info = {};
+    texture_create_info.width = width;
+    texture_create_info.height = height;
+    texture_create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    texture_create_info.format = format;
+    texture_create_info.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    texture_create_info.imageType = VK_IMAGE_TYPE_2D;
+    texture_create_info.imageViewType = VK_IMAGE_VIEW_TYPE_2D;
+    texture_create_info.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    colorTexture = rd->CreateTexture(&texture_create_info);
+
+    VkImageView imageView = rd->GetTexture(colorTexture)->imageView;
+    rd->CreateFramebuffer(width, height, 1, &imageView, renderPass, &framebuffer);
+}
+
+void RenderingOffscreen::_CleanUpRenderTarget()
+{
+    rd->DestroyFramebuffer(framebuffer);
+    rd->DestroyTexture(colorTexture);
+}
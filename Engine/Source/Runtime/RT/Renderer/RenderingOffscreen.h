@@ -0,0 +1,82 @@
+/* ======================================================================== */
+/* RenderingOffscreen.h                                                     */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#ifndef _RENDERING_OFFSCREEN_H_
+#define _RENDERING_OFFSCREEN_H_
+
+#include "RT/Drivers/RenderDevice.h"
+
+#define RENDERING_OFFSCREEN_FRAME_COUNT 3
+
+// Counterpart of RenderingDisplay rendering into a color texture instead of
+// a swapchain, for headless devices. Up to RENDERING_OFFSCREEN_FRAME_COUNT
+// frames are in flight, beginning a frame waits for the oldest one.
+class RenderingOffscreen {
+public:
+    RenderingOffscreen(RenderDevice *vRD, uint32_t vWidth, uint32_t vHeight);
+   ~RenderingOffscreen();
+
+    VkRenderPass GetRenderPass() { return renderPass; }
+    RenderDevice::TextureHandle GetColorTexture() { return colorTexture; }
+    uint32_t GetWidth() { return width; }
+    uint32_t GetHeight() { return height; }
+
+    // wait every frame in flight and recreate the render target.
+    void Resize(uint32_t vWidth, uint32_t vHeight);
+    void WaitIdle();
+
+    void CmdBeginOffscreenRender(VkCommandBuffer *pCmdBuffer);
+    void CmdEndOffscreenRender(VkCommandBuffer cmdBuffer);
+
+    // split of Begin/EndOffscreenRender, see RenderingDisplay.
+    void CmdBeginOffscreenFrame(VkCommandBuffer *pCmdBuffer);
+    void CmdBeginOffscreenPass(VkCommandBuffer cmdBuffer);
+    void CmdEndOffscreenPass(VkCommandBuffer cmdBuffer);
+    void CmdEndOffscreenFrame(VkCommandBuffer cmdBuffer);
+
+private:
+    struct FrameResource {
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+    };
+
+    void _CreateRenderTarget();
+    void _CleanUpRenderTarget();
+
+    RenderDevice *rd = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueue graphQueue = VK_NULL_HANDLE;
+    VkCommandPool cmdPool = VK_NULL_HANDLE;
+    VkFormat format;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    RenderDevice::TextureHandle colorTexture;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    FrameResource frames[RENDERING_OFFSCREEN_FRAME_COUNT];
+    uint64_t frameCounter = 0;
+    uint32_t width;
+    uint32_t height;
+
+    uint32_t offscreenPassScope = 0;
+    uint32_t offscreenPassStatistics = 0;
+};
+
+#endif /* _RENDERING_OFFSCREEN_H_ */
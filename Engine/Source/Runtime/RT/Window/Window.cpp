@@ -73,6 +73,11 @@ void Window::GetCursorPosition(float* xpos, float* ypos)
 }
 
 
+void Window::SetSize(int w, int h)
+{
+    glfwSetWindowSize(handle, w, h);
+}
+
 void Window::SetVisible(bool isVisible)
 {
     visibleFlag = isVisible;
@@ -83,6 +83,7 @@ public:
     int GetMouseButton(int button);
     void GetCursorPosition(float *xpos, float *ypos);
 
+    void SetSize(int w, int h);
     void SetVisible(bool isVisible);
     void SetCursorPosition(float x, float y);
 
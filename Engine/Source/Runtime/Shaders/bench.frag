@@ -0,0 +1,12 @@
+#version 450
+
+// variant only exists to build distinct pipelines from the same shaders.
+layout(constant_id = 0) const uint variant = 0;
+
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+    float shade = float(variant % 16u) / 15.0f;
+    out_color = vec4(shade, 0.5f, 1.0f - shade, 1.0f);
+}
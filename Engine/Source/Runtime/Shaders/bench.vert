@@ -0,0 +1,24 @@
+#version 450
+
+// small triangle without vertex buffer, placed by push constants so every
+// draw of the benchmark cover a different part of the target. Instances
+// continue on the grid from the pushed offset.
+layout(push_constant) uniform PushConst {
+    vec2 offset;
+    float scale;
+    float cell;
+    uint columns;
+} push_const;
+
+const vec2 positions[3] = vec2[](
+    vec2(0.0f, -1.0f),
+    vec2(1.0f, 1.0f),
+    vec2(-1.0f, 1.0f)
+);
+
+void main()
+{
+    uint instance = uint(gl_InstanceIndex);
+    vec2 grid = vec2(float(instance % push_const.columns), float(instance / push_const.columns)) * push_const.cell;
+    gl_Position = vec4(positions[gl_VertexIndex] * push_const.scale + push_const.offset + grid, 0.0f, 1.0f);
+}
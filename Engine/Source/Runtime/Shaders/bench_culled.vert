@@ -0,0 +1,26 @@
+#version 450
+
+// bench triangle drawn through GPUCulling, the culled indirect commands
+// carry the object index in firstInstance.
+struct Object {
+    mat4 transform;
+    uint meshIndex;
+    uint padding0;
+    uint padding1;
+    uint padding2;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects {
+    Object objects[];
+};
+
+const vec2 positions[3] = vec2[](
+    vec2(0.0f, -1.0f),
+    vec2(1.0f, 1.0f),
+    vec2(-1.0f, 1.0f)
+);
+
+void main()
+{
+    gl_Position = objects[gl_InstanceIndex].transform * vec4(positions[gl_VertexIndex], 0.0f, 1.0f);
+}
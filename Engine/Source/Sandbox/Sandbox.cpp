@@ -21,15 +21,367 @@
 /*                                                                          */
 /* ======================================================================== */
 #include <RT/Win32/RenderDeviceContextWin32.h>
+#include <RT/Drivers/MemoryDefragmenter.h>
 #include <RT/Renderer/RenderingDisplay.h>
+#include <RT/Renderer/RenderThread.h>
+#include <RT/Job/JobSystem.h>
+#include <RT/Loader/TextureStreamer.h>
+#include <RT/Profiler/CPUProfiler.h>
+#include <RT/Profiler/GPUMemoryTracker.h>
+#include <RT/Profiler/GPUProfiler.h>
 #include <NavUI/NavUI.h>
+#include <Bright/SIMDMath.h>
+#include <Bright/VFS.h>
+
+#define CULL_SCENE_OBJECT_COUNT 65536
+#define STREAMED_TEXTURE_SIZE 2048
+/* replace the checker once loaded when the resources provide it */
+#define STREAMED_TEXTURE_PATH "texture/sandbox.ktx2"
+/* frames a replaced view or descriptor may still be used by */
+#define SANDBOX_FRAME_LATENCY (RENDER_THREAD_FRAME_PACKET_COUNT + RENDERING_DISPLAY_FRAME_COUNT)
+
+struct UIRenderCommand {
+    NavUI::FrameDrawData *drawData;
+    GPUProfiler *profiler;
+};
+
+// Boxes scattered around a camera turning in place, culled on the job
+// system every frame.
+struct CullScene {
+    std::vector<simd_aabb> boxes;
+    /* indices of each chunk are written at the chunk begin */
+    std::vector<uint32_t> visible;
+    std::atomic<uint32_t> visibleCount = 0;
+    double milliseconds = 0.0;
+};
+
+static void InitializeCullScene(CullScene *scene)
+{
+    srand(1);
+    for (uint32_t i = 0; i < CULL_SCENE_OBJECT_COUNT; i++) {
+        vec3 center = vec3(rand() % 400 - 200, rand() % 40 - 20, rand() % 400 - 200);
+        scene->boxes.push_back({ { center.x - 1.0f, center.y - 1.0f, center.z - 1.0f, 0.0f }, { center.x + 1.0f, center.y + 1.0f, center.z + 1.0f, 0.0f } });
+    }
+
+    scene->visible.resize(CULL_SCENE_OBJECT_COUNT);
+}
+
+static void CullSceneObjects(JobSystem *jobSystem, CullScene *scene, uint64_t frame, float aspect)
+{
+    PROFILE_SCOPE("CullScene");
+
+    float angle = (float) (frame % 3600) * glm::radians(0.1f);
+    mat4 view = glm::lookAt(vec3(0.0f), vec3(sinf(angle), 0.0f, cosf(angle)), vec3(0.0f, 1.0f, 0.0f));
+    simd_frustum frustum = simd_frustum_from_matrix(glm::perspective(glm::radians(60.0f), aspect, 0.1f, 250.0f) * view);
+
+    uint64_t begin = CPUProfiler::GetTimestamp();
+    scene->visibleCount = 0;
+
+    // one job per chunk, ParallelFor wait on their counter and run chunks
+    // itself meanwhile.
+    jobSystem->ParallelFor(CULL_SCENE_OBJECT_COUNT, 0, [scene, &frustum] (uint32_t first, uint32_t end) {
+        size_t count = simd_frustum_cull_aabb_batch(frustum, std::data(scene->boxes) + first, end - first, std::data(scene->visible) + first);
+        scene->visibleCount.fetch_add((uint32_t) count, std::memory_order_relaxed);
+    });
+
+    scene->milliseconds = CPUProfiler::ToMilliseconds(CPUProfiler::GetTimestamp() - begin);
+}
+
+// Ui descriptor of a streamed texture, rebuilt every time the streamer or
+// the defragmenter replace its view. Replaced descriptors are freed once no
+// frame in flight can use them.
+struct StreamedTextureView {
+    RenderDevice *rd;
+    TextureStreamer *streamer;
+    StreamedTexture *texture = NULL;
+    ImTextureID id = NULL;
+    std::deque<std::pair<ImTextureID, uint64_t>> retired;
+    float size = 256.0f;
+};
+
+// filled on the AsyncIO worker, picked up by the main thread which own the
+// streamer.
+struct StreamedTextureLoad {
+    TextureImage image;
+    Error err = FAIL;
+    std::atomic<bool> doneFlag = false;
+};
+
+static void CreateCheckerImage(TextureImage *pImage, uint32_t size)
+{
+    /* every level has its own tint, the resident mip is visible on screen */
+    static const uint8_t tints[][4] = {
+        { 255, 255, 255, 255 }, { 255, 96, 96, 255 }, { 96, 255, 96, 255 }, { 96, 96, 255, 255 },
+        { 255, 255, 96, 255 }, { 96, 255, 255, 255 }, { 255, 96, 255, 255 },
+    };
+
+    pImage->format = VK_FORMAT_R8G8B8A8_UNORM;
+    pImage->viewType = VK_IMAGE_VIEW_TYPE_2D;
+    pImage->width = size;
+    pImage->height = size;
+    pImage->mipLevels = RenderDevice::CalculateMipLevels(size, size);
+    pImage->arrayLayers = 1;
+
+    for (uint32_t level = 0; level < pImage->mipLevels; level++) {
+        uint32_t levelSize = std::max(size >> level, 1u);
+        uint32_t cellSize = std::max(64u >> level, 1u);
+        const uint8_t *tint = tints[level % std::size(tints)];
+
+        size_t offset = std::size(pImage->data);
+        pImage->data.resize(offset + (size_t) levelSize * levelSize * 4);
+        pImage->regions.push_back({ level, 0, 1, offset });
+
+        uint8_t *dst = std::data(pImage->data) + offset;
+        for (uint32_t y = 0; y < levelSize; y++) {
+            for (uint32_t x = 0; x < levelSize; x++, dst += 4) {
+                uint8_t shade = ((x / cellSize) + (y / cellSize)) % 2 ? 255 : 48;
+                for (uint32_t c = 0; c < 3; c++)
+                    dst[c] = (uint8_t) (shade * tint[c] / 255);
+                dst[3] = 255;
+            }
+        }
+    }
+}
+
+static void RefreshStreamedTextureView(StreamedTextureView *view)
+{
+    RenderDevice::Texture2D *texture = view->rd->GetTexture(view->texture->texture);
+
+    if (view->id)
+        view->retired.push_back({ view->id, view->streamer->GetFrame() });
+
+    view->id = NavUI::AddTexture(texture->sampler, texture->imageView, texture->imageLayout);
+}
+
+static void ReleaseStreamedTextureViews(StreamedTextureView *view, bool all)
+{
+    while (!view->retired.empty() && (all || view->streamer->GetFrame() - view->retired.front().second >= SANDBOX_FRAME_LATENCY)) {
+        NavUI::RemoveTexture(view->retired.front().first);
+        view->retired.pop_front();
+    }
+}
+
+static void ShowTextureStreamingPanel(StreamedTextureView *view)
+{
+    NavUI::Begin("Texture Streaming");
+    NavUI::SliderFloat("Size", &view->size, 16.0f, (float) STREAMED_TEXTURE_SIZE, "%.0f");
+    ImGui::Text("resident mip %u, requested %u", view->texture->residentMip, view->texture->requestedMip);
+    ImGui::Text("%.2f MB resident", (double) view->streamer->GetResidentBytes() / (1024.0 * 1024.0));
+    ImGui::Image(view->id, ImVec2(view->size, view->size));
+    NavUI::End();
+
+    // promoted by the next Update, before the packet using the view is built.
+    view->streamer->RequestScreenSize(view->texture, view->size, view->size);
+}
+
+static void ShowCullScenePanel(JobSystem *jobSystem, CullScene *scene)
+{
+    NavUI::Begin("Scene Culling");
+    ImGui::Text("%u / %u objects visible", scene->visibleCount.load(), CULL_SCENE_OBJECT_COUNT);
+    ImGui::Text("%.3f ms on %u workers, %s", scene->milliseconds, jobSystem->GetWorkerCount(), simd_level_name(simd_get_level()));
+    NavUI::End();
+}
+
+static void ShowGPUProfilerPanel(GPUProfiler *profiler, const std::vector<RenderDevice::PerformanceCounter> &counters)
+{
+    NavUI::Begin("GPU Profiler");
+
+    if (!profiler->IsSupported() && !profiler->IsStatisticsSupported()) {
+        ImGui::TextUnformatted("timestamp and pipeline statistics queries are not supported by this device.");
+        NavUI::End();
+        return;
+    }
+
+    GPUFrameResult frameResult;
+    profiler->GetLatestFrame(&frameResult);
+
+    std::vector<NavUI::StatRow> rows;
+    rows.push_back({ "Frame", 0, frameResult.milliseconds });
+    for (const GPUScopeResult &scope : frameResult.scopes)
+        rows.push_back({ scope.name, scope.depth + 1, scope.milliseconds });
+    rows.push_back({ "Upload", 0, frameResult.uploadMilliseconds });
+    NavUI::StatsTable("GPUScopes", "ms", (uint32_t) rows.size(), std::data(rows));
+
+    std::vector<float> history;
+    profiler->GetFrameTimeHistory(&history);
+
+    char overlay[32];
+    snprintf(overlay, sizeof(overlay), "%.3f ms", frameResult.milliseconds);
+    NavUI::PlotHistory("Frame time", std::data(history), (uint32_t) history.size(), overlay);
+
+    // every statistics scope, then the frame totals.
+    rows.clear();
+    for (const GPUStatisticsResult &statistics : frameResult.statistics) {
+        rows.push_back({ statistics.name, 0, 0.0 });
+        for (uint32_t i = 0; i < GPU_PIPELINE_STATISTIC_COUNT; i++)
+            rows.push_back({ GPUProfiler::GetPipelineStatisticName(i), 1, (double) statistics.values[i] });
+    }
+
+    if (!frameResult.statistics.empty()) {
+        rows.push_back({ "Total", 0, 0.0 });
+        for (uint32_t i = 0; i < GPU_PIPELINE_STATISTIC_COUNT; i++)
+            rows.push_back({ GPUProfiler::GetPipelineStatisticName(i), 1, (double) frameResult.statisticsTotals[i] });
+        NavUI::StatsTable("GPUStatistics", "count", (uint32_t) rows.size(), std::data(rows));
+    }
+
+    if (!counters.empty() && ImGui::CollapsingHeader("Hardware counters")) {
+        for (const RenderDevice::PerformanceCounter &counter : counters)
+            ImGui::BulletText("%s / %s", counter.category.c_str(), counter.name.c_str());
+    }
+
+    if (ImGui::Button("Export CSV"))
+        profiler->ExportCSV("gpu_profile.csv");
+    ImGui::SameLine();
+    if (ImGui::Button("Export JSON"))
+        profiler->ExportJSON("gpu_profile.json");
+
+    NavUI::End();
+}
+
+static void ShowGPUMemoryPanel(GPUMemoryTracker *memoryTracker, MemoryDefragmenter *defragmenter)
+{
+    NavUI::Begin("GPU Memory");
+
+    const GPUMemorySnapshot &snapshot = memoryTracker->GetSnapshot();
+    const double MB = 1024.0 * 1024.0;
+
+    if (!snapshot.budgetSupported)
+        ImGui::TextUnformatted("VK_EXT_memory_budget is missing, budgets are estimated.");
+
+    // heap names must stay alive until the table is drawn.
+    std::vector<std::string> heapNames;
+    for (size_t i = 0; i < snapshot.heaps.size(); i++)
+        heapNames.push_back("Heap " + std::to_string(i) + (snapshot.heaps[i].deviceLocal ? " (device local)" : ""));
+
+    std::vector<NavUI::StatRow> rows;
+    for (size_t i = 0; i < snapshot.heaps.size(); i++) {
+        const GPUMemoryHeap &heap = snapshot.heaps[i];
+        rows.push_back({ heapNames[i].c_str(), 0, heap.size / MB });
+        rows.push_back({ "Usage", 1, heap.usage / MB });
+        rows.push_back({ "Budget", 1, heap.budget / MB });
+        rows.push_back({ "Allocated", 1, heap.allocationBytes / MB });
+        rows.push_back({ "Blocks", 1, heap.blockBytes / MB });
+    }
+
+    rows.push_back({ "Textures", 0, snapshot.textures.bytes / MB });
+    rows.push_back({ "Render targets", 0, snapshot.renderTargets.bytes / MB });
+    rows.push_back({ "Buffers", 0, snapshot.buffers.bytes / MB });
+    NavUI::StatsTable("GPUMemory", "MB", (uint32_t) rows.size(), std::data(rows));
+
+    rows.clear();
+    for (size_t i = 0; i < snapshot.heaps.size(); i++) {
+        const GPUMemoryHeap &heap = snapshot.heaps[i];
+        rows.push_back({ heapNames[i].c_str(), 0, (double) heap.allocationCount });
+        rows.push_back({ "Blocks", 1, (double) heap.blockCount });
+        rows.push_back({ "Free ranges", 1, (double) heap.unusedRangeCount });
+        rows.push_back({ "Fragmentation", 1, (double) heap.fragmentation });
+    }
+
+    rows.push_back({ "Textures", 0, (double) snapshot.textures.count });
+    rows.push_back({ "Render targets", 0, (double) snapshot.renderTargets.count });
+    rows.push_back({ "Buffers", 0, (double) snapshot.buffers.count });
+    NavUI::StatsTable("GPUAllocations", "count", (uint32_t) rows.size(), std::data(rows));
+
+    ImGui::Text("Device local pressure: %.1f%%", memoryTracker->GetDeviceLocalPressure() * 100.0f);
+
+    if (ImGui::Button("Export JSON"))
+        memoryTracker->ExportJSON("gpu_memory.json");
+
+    ImGui::SameLine();
+    if (!defragmenter->IsActive()) {
+        if (ImGui::Button("Defragment"))
+            defragmenter->Begin();
+    } else if (ImGui::Button("Cancel defragmentation")) {
+        defragmenter->Cancel();
+    }
+
+    const MemoryDefragmenterStats &defragmenterStats = defragmenter->GetStats();
+    ImGui::Text("Defragmentation: %u passes, %u buffers and %u textures moved (%.2f MB), %.2f MB and %u blocks freed",
+                defragmenterStats.passCount, defragmenterStats.movedBuffers, defragmenterStats.movedTextures, defragmenterStats.bytesMoved / MB,
+                defragmenterStats.bytesFreed / MB, defragmenterStats.deviceMemoryBlocksFreed);
+
+    NavUI::End();
+}
+
+#ifdef BRIGHT_PROFILER_ENABLED
+static void ShowCPUProfilerPanel()
+{
+    NavUI::Begin("CPU Profiler");
+
+    CPUFrameResult frameResult;
+    CPUProfiler::GetLatestFrame(&frameResult);
+
+    // a row per thread holding its top level scopes, thread names must stay
+    // alive until the table is drawn.
+    std::vector<std::string> threadNames;
+    std::vector<NavUI::StatRow> rows;
+    uint32_t thread = UINT32_MAX;
+    size_t threadRow = 0;
+
+    for (const CPUProfileEvent &event : frameResult.events) {
+        if (event.type != CPU_PROFILE_EVENT_TYPE_SCOPE)
+            continue;
+
+        if (event.thread != thread) {
+            thread = event.thread;
+            threadNames.push_back(CPUProfiler::GetThreadName(thread));
+            threadRow = rows.size();
+            rows.push_back({ NULL, 0, 0.0 });
+        }
+
+        double milliseconds = CPUProfiler::ToMilliseconds(event.end - event.begin);
+        if (event.depth == 0)
+            rows[threadRow].value += milliseconds;
+
+        rows.push_back({ event.name, event.depth + 1u, milliseconds });
+    }
+
+    size_t nameIndex = 0;
+    for (NavUI::StatRow &row : rows) {
+        if (!row.name)
+            row.name = threadNames[nameIndex++].c_str();
+    }
+
+    NavUI::StatsTable("CPUScopes", "ms", (uint32_t) rows.size(), std::data(rows));
+
+    std::vector<float> history;
+    CPUProfiler::GetFrameTimeHistory(&history);
+
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%.3f ms, %llu dropped", CPUProfiler::ToMilliseconds(frameResult.end - frameResult.begin),
+             (unsigned long long) CPUProfiler::GetDroppedEventCount());
+    NavUI::PlotHistory("Frame time", std::data(history), (uint32_t) history.size(), overlay);
+
+    if (!CPUProfiler::IsCapturing()) {
+        if (ImGui::Button("Begin Capture"))
+            CPUProfiler::BeginCapture();
+    } else if (ImGui::Button("End Capture")) {
+        CPUProfiler::EndCapture();
+        CPUProfiler::ExportChromeTrace("cpu_trace.json");
+    }
+
+    NavUI::End();
+}
+#endif
 
 int main()
 {
+    PROFILE_THREAD("Main");
+
+    JobSystem *jobSystem = memnew(JobSystem);
     Window *window = memnew(Window, "BrightEngine", 1680, 1080);
     RenderDeviceContextWin32 *rdc = memnew(RenderDeviceContextWin32, window);
     RenderDevice *rd = rdc->CreateRenderDevice();
     RenderingDisplay* display = memnew(RenderingDisplay, rd, window);
+    GPUProfiler *profiler = memnew(GPUProfiler, rd);
+    rd->SetGPUProfiler(profiler);
+
+    GPUMemoryTracker *memoryTracker = memnew(GPUMemoryTracker, rd);
+    MemoryDefragmenter *defragmenter = memnew(MemoryDefragmenter, rd);
+
+    std::vector<RenderDevice::PerformanceCounter> performanceCounters;
+    rd->EnumeratePerformanceCounters(&performanceCounters);
+    RenderThread *renderThread = memnew(RenderThread, display);
 
     NavUI::InitializeInfo initializeInfo = {};
     initializeInfo.window = (GLFWwindow *) window->GetNativeHandle();
@@ -43,30 +395,157 @@ int main()
     initializeInfo.MinImageCount = display->GetImageBufferCount();
     initializeInfo.ImageCount = display->GetImageBufferCount();
     initializeInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    initializeInfo.QueueMutex = &rdc->GetQueueMutex();
     NavUI::Initialize(&initializeInfo);
 
+    // one ui snapshot per frame packet, the render thread may still record
+    // the previous one while the next frame is built.
+    NavUI::FrameDrawData *uiDrawData[RENDER_THREAD_FRAME_PACKET_COUNT];
+    for (uint32_t i = 0; i < RENDER_THREAD_FRAME_PACKET_COUNT; i++)
+        uiDrawData[i] = NavUI::CreateFrameDrawData();
+
+    CullScene *cullScene = memnew(CullScene);
+    InitializeCullScene(cullScene);
+
+    RenderDevice::SamplerCreateInfo sampler_create_info = {};
+    sampler_create_info.maxLod = VK_LOD_CLAMP_NONE;
+    sampler_create_info.anisotropyEnable = VK_TRUE;
+    VkSampler streamedSampler;
+    rd->CreateSampler(&sampler_create_info, &streamedSampler);
+
+    TextureStreamerSettings streamerSettings;
+    streamerSettings.retireFrames = SANDBOX_FRAME_LATENCY;
+    TextureStreamer *streamer = memnew(TextureStreamer, rd, streamerSettings);
+
+    StreamedTextureView *streamedView = memnew(StreamedTextureView);
+    streamedView->rd = rd;
+    streamedView->streamer = streamer;
+
+    TextureImage checkerImage;
+    CreateCheckerImage(&checkerImage, STREAMED_TEXTURE_SIZE);
+    streamedView->texture = streamer->RegisterTexture(&checkerImage, streamedSampler);
+    streamedView->texture->userdata = streamedView;
+    RefreshStreamedTextureView(streamedView);
+
+    streamer->SetTextureResidencyChangedCallback([] (StreamedTexture *pStreamedTexture, RenderDevice::TextureHandle texture) {
+        /* still registering, the view is created by the caller */
+        if (pStreamedTexture->userdata)
+            RefreshStreamedTextureView((StreamedTextureView *) pStreamedTexture->userdata);
+    });
+
+    AsyncIO *asyncIO = memnew(AsyncIO);
+    StreamedTextureLoad *streamedLoad = NULL;
+    if (vfs_exists(STREAMED_TEXTURE_PATH)) {
+        streamedLoad = memnew(StreamedTextureLoad);
+        LoadTextureImageAsync(asyncIO, STREAMED_TEXTURE_PATH, &streamedLoad->image, [] (Error err, TextureImage *pImage, void *userdata) {
+            StreamedTextureLoad *load = (StreamedTextureLoad *) userdata;
+            load->err = err;
+            load->doneFlag.store(true, std::memory_order_release);
+        }, streamedLoad);
+    }
+
+    // the render thread is idle during a step, the view can be replaced now.
+    defragmenter->SetTextureMovedCallback([] (RenderDevice::TextureHandle texture, void *pUserData) {
+        StreamedTextureView *view = (StreamedTextureView *) pUserData;
+        if (view->texture->texture == texture)
+            RefreshStreamedTextureView(view);
+    }, streamedView);
+
     while (!window->IsClose())
     {
+        // close the previous frame before this one's first scope opens.
+        PROFILE_FRAME();
+        PROFILE_SCOPE("MainFrame");
+
         window->PollEvents();
+        memoryTracker->Update();
 
-        VkCommandBuffer cmdBuffer;
-        display->CmdBeginDisplayRender(&cmdBuffer);
-        {
-            NavUI::BeginNewFrame(cmdBuffer);
-            {
-                static bool showDemoWindowFlag = true;
-                ImGui::ShowDemoWindow(&showDemoWindowFlag);
+        // moves replace Vulkan objects, no frame may use them meanwhile.
+        if (defragmenter->IsActive()) {
+            renderThread->WaitIdle();
+            defragmenter->Step();
+        }
+
+        if (streamedLoad && streamedLoad->doneFlag.load(std::memory_order_acquire)) {
+            StreamedTexture *loaded = streamedLoad->err == OK ? streamer->RegisterTexture(&streamedLoad->image, streamedSampler) : NULL;
+            if (loaded) {
+                streamer->UnregisterTexture(streamedView->texture);
+                streamedView->texture = loaded;
+                loaded->userdata = streamedView;
+                RefreshStreamedTextureView(streamedView);
             }
-            NavUI::EndNewFrame(cmdBuffer);
+
+            memdel(streamedLoad);
+            streamedLoad = NULL;
+        }
+
+        streamer->Update();
+        ReleaseStreamedTextureViews(streamedView, false);
+
+        FramePacket *packet = renderThread->BeginFramePacket();
+        Rect2D windowRect;
+        window->GetSize(&windowRect);
+        CullSceneObjects(jobSystem, cullScene, packet->frame, (float) std::max(windowRect.w, 1) / (float) std::max(windowRect.h, 1));
+        NavUI::FrameDrawData *drawData = uiDrawData[packet->frame % RENDER_THREAD_FRAME_PACKET_COUNT];
+
+        NavUI::BeginFrame();
+        {
+            static bool showDemoWindowFlag = true;
+            ImGui::ShowDemoWindow(&showDemoWindowFlag);
+            ShowGPUProfilerPanel(profiler, performanceCounters);
+            ShowGPUMemoryPanel(memoryTracker, defragmenter);
+            ShowCullScenePanel(jobSystem, cullScene);
+            ShowTextureStreamingPanel(streamedView);
+#ifdef BRIGHT_PROFILER_ENABLED
+            ShowCPUProfilerPanel();
+#endif
+        }
+        NavUI::EndFrame(drawData);
+
+        UIRenderCommand *command = (UIRenderCommand *) renderThread->PushRenderCommand(packet, [] (VkCommandBuffer cmdBuffer, void *pData) {
+            UIRenderCommand *command = (UIRenderCommand *) pData;
+            uint32_t scope = command->profiler->CmdBeginScope(cmdBuffer, "NavUI");
+            NavUI::RenderFrame(command->drawData, cmdBuffer);
+            command->profiler->CmdEndScope(cmdBuffer, scope);
+        }, sizeof(UIRenderCommand));
+
+        /* packet arena full, the ui is dropped this frame */
+        if (command) {
+            command->drawData = drawData;
+            command->profiler = profiler;
         }
-        display->CmdEndDisplayRender(cmdBuffer);
+
+        renderThread->SubmitFramePacket(packet);
     }
 
+    memdel(asyncIO);
+    if (streamedLoad)
+        memdel(streamedLoad);
+    memdel(cullScene);
+    memdel(renderThread);
+    memdel(streamer);
+    ReleaseStreamedTextureViews(streamedView, true);
+    NavUI::RemoveTexture(streamedView->id);
+    memdel(streamedView);
+    rd->DestroySampler(streamedSampler);
+    rd->SetGPUProfiler(VK_NULL_HANDLE);
+    memdel(profiler);
+    memdel(defragmenter);
+    memdel(memoryTracker);
+    for (uint32_t i = 0; i < RENDER_THREAD_FRAME_PACKET_COUNT; i++)
+        NavUI::DestroyFrameDrawData(uiDrawData[i]);
+
     NavUI::Destroy();
     memdel(display);
     memdel(rd);
     memdel(rdc);
     memdel(window);
+    memdel(jobSystem);
+
+#ifdef BRIGHT_MEMORY_TRACKING
+    /* anything still live here leaked */
+    memory_tracker_report(stdout);
+#endif
 
     return 0;
 }
\ No newline at end of file
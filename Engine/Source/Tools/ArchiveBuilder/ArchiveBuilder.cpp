@@ -0,0 +1,165 @@
+/* ======================================================================== */
+/* ArchiveBuilder.cpp                                                       */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include <Bright/Archive.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Pack a directory into a .bpak archive:
+//
+//     ArchiveBuilder <output> <directory> [--lz4] [--align <bytes>]
+//
+// with --lz4 every entry is compressed, entries that don't shrink by at
+// least an eighth are kept raw so they stay usable straight from the map.
+
+struct PendingEntry {
+    std::string path;
+    std::vector<char> data;
+    archive_entry entry;
+};
+
+static void _WritePadding(std::ofstream &file, uint64_t alignment)
+{
+    uint64_t position = file.tellp();
+    uint64_t padding = (alignment - position % alignment) % alignment;
+
+    static const char zeros[64] = {};
+    while (padding > 0) {
+        uint64_t count = std::min<uint64_t>(padding, sizeof(zeros));
+        file.write(zeros, count);
+        padding -= count;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <output> <directory> [--lz4] [--align <bytes>]\n", argv[0]);
+        return 1;
+    }
+
+    const char *output = argv[1];
+    std::filesystem::path root = argv[2];
+    bool compress = false;
+    uint32_t alignment = ARCHIVE_DEFAULT_ALIGNMENT;
+
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--lz4") {
+            compress = true;
+        } else if (arg == "--align" && i + 1 < argc) {
+            alignment = (uint32_t) std::max(1, atoi(argv[++i]));
+        } else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::vector<PendingEntry> entries;
+
+    for (const std::filesystem::directory_entry &file : std::filesystem::recursive_directory_iterator(root)) {
+        if (!file.is_regular_file())
+            continue;
+
+        PendingEntry pending = {};
+        std::string relative = std::filesystem::relative(file.path(), root).generic_string();
+        pending.path = archive_normalize_path(std::data(relative), std::size(relative));
+
+        char *buf = NULL;
+        size_t size = 0;
+        if (io_read_file(file.path().string().c_str(), 0, IO_WHOLE_FILE, &buf, 0, &size) != OK) {
+            fprintf(stderr, "read %s failed\n", pending.path.c_str());
+            return 1;
+        }
+
+        pending.entry.path_hash = archive_hash_path(pending.path.c_str(), pending.path.size());
+        pending.entry.uncompressed_size = size;
+        pending.entry.compression = ARCHIVE_COMPRESSION_NONE;
+        pending.data.assign(buf, buf + size);
+
+        if (compress && size > 0) {
+            std::vector<char> compressed(lz4_compress_bound(size));
+            size_t compressedSize = lz4_compress(buf, size, std::data(compressed), std::size(compressed));
+            if (compressedSize > 0 && compressedSize < size - size / 8) {
+                compressed.resize(compressedSize);
+                pending.data = std::move(compressed);
+                pending.entry.compression = ARCHIVE_COMPRESSION_LZ4;
+            }
+        }
+
+        pending.entry.size = std::size(pending.data);
+        io_free_buf(buf);
+
+        entries.push_back(std::move(pending));
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const PendingEntry &a, const PendingEntry &b) {
+        return a.entry.path_hash < b.entry.path_hash;
+    });
+
+    std::ofstream file(output, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        fprintf(stderr, "open %s failed\n", output);
+        return 1;
+    }
+
+    /* header is rewritten once the offsets are known */
+    archive_header header = {};
+    file.write((const char *) &header, sizeof(header));
+
+    for (PendingEntry &pending : entries) {
+        _WritePadding(file, alignment);
+        pending.entry.offset = file.tellp();
+        file.write(std::data(pending.data), std::size(pending.data));
+    }
+
+    std::string strings;
+    for (PendingEntry &pending : entries) {
+        pending.entry.path_offset = (uint32_t) std::size(strings);
+        pending.entry.path_length = (uint32_t) std::size(pending.path);
+        strings += pending.path;
+    }
+
+    _WritePadding(file, alignof(archive_entry));
+    header.toc_offset = file.tellp();
+    for (PendingEntry &pending : entries)
+        file.write((const char *) &pending.entry, sizeof(archive_entry));
+
+    header.strings_offset = file.tellp();
+    header.strings_size = std::size(strings);
+    file.write(std::data(strings), std::size(strings));
+
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.entry_count = (uint32_t) std::size(entries);
+    header.alignment = alignment;
+
+    file.seekp(0);
+    file.write((const char *) &header, sizeof(header));
+    file.close();
+
+    printf("packed %u entries into %s\n", header.entry_count, output);
+
+    return 0;
+}
@@ -0,0 +1,907 @@
+/* ======================================================================== */
+/* BrightBench.cpp                                                          */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include <RT/Headless/RenderDeviceContextHeadless.h>
+#include <RT/Win32/RenderDeviceContextWin32.h>
+#include <RT/Renderer/RenderingDisplay.h>
+#include <RT/Renderer/RenderingOffscreen.h>
+#include <RT/Renderer/GPUCulling.h>
+#include <RT/Drivers/PipelineCompiler.h>
+#include <RT/Profiler/CPUProfiler.h>
+#include <RT/Profiler/GPUProfiler.h>
+#include <Bright/IOUtils.h>
+#include <Bright/VFS.h>
+#include <algorithm>
+#include <deque>
+#include <math.h>
+#include <string>
+#include <vector>
+
+// Run scripted scenarios for a fixed number of frames and report the CPU
+// and GPU frame times:
+//
+//     BrightBench [--headless] [--scenario <name>] [--frames <count>]
+//                 [--warmup <count>] [--count <n>] [--size <w> <h>]
+//                 [--output <path>]
+//
+// scenarios are empty, draws, instanced, indirect, culled, occluded,
+// textures, pipelines, async_pipelines, resize or all, count is the number
+// of triangles drawn (one draw each, a single instanced draw or a single
+// indirect draw, culled spread them over four times the screen and let
+// GPUCulling drop the ones outside, occluded hide most of them behind a
+// large one for the Hi-Z pass), uploaded textures, created pipelines per
+// frame or pipelines kept compiling through the PipelineCompiler.
+// Results are written as JSON to the output, bench.json by default.
+
+#define BENCH_TEXTURE_SIZE 256
+/* frames a pipeline drawn once may still be used by the GPU */
+#define BENCH_RETIRE_FRAMES std::max(RENDERING_DISPLAY_FRAME_COUNT, RENDERING_OFFSCREEN_FRAME_COUNT)
+
+struct BenchAsyncSlot {
+    AsyncPipeline *asyncPipeline;
+    /* recorded with the compiled pipeline, the slot can move on */
+    bool drawn;
+};
+
+struct BenchRetiredPipeline {
+    AsyncPipeline *asyncPipeline;
+    uint64_t frame;
+};
+
+struct BenchContext {
+    RenderDevice *rd;
+    Window *window;
+    RenderingDisplay *display;
+    RenderingOffscreen *offscreen;
+    VkRenderPass renderPass;
+    uint32_t width;
+    uint32_t height;
+    uint32_t count;
+    uint64_t frame;
+    bool shadersAvailable;
+    RenderDevice::PipelineHandle drawPipeline;
+    RenderDevice::BufferHandle indirectBuffer;
+    RenderDevice::BufferHandle indexBuffer;
+    GPUCulling *culling;
+    HiZBuffer *hiZBuffer;
+    RenderDevice::PipelineHandle depthPipeline;
+    VkDescriptorSet descriptorSet;
+    std::vector<RenderDevice::TextureHandle> textures;
+    std::vector<uint8_t> pixels;
+    PipelineCompiler *compiler;
+    uint32_t asyncVariant;
+    std::vector<BenchAsyncSlot> asyncSlots;
+    std::deque<BenchRetiredPipeline> retiredPipelines;
+    std::vector<double> compileTimes;
+    std::vector<double> latencyTimes;
+    uint32_t fallbackDraws;
+    uint32_t skippedDraws;
+};
+
+struct BenchStats {
+    double min = 0.0;
+    double avg = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+    uint32_t samples = 0;
+};
+
+struct BenchResult {
+    const char *name;
+    const char *skipped = NULL;
+    BenchStats cpu;
+    BenchStats gpu;
+    /* async pipelines only, compile is the time in the worker and latency
+       enqueue to ready */
+    BenchStats compile;
+    BenchStats latency;
+    uint32_t fallbackDraws = 0;
+    uint32_t skippedDraws = 0;
+};
+
+// Check return why the scenario can't run on this device, NULL otherwise.
+// Setup and Teardown run outside the measured frames, Prepare runs before
+// the frame is begun (uploads, pipeline creation, resize), PrePass in the
+// frame before the render pass (compute) and Record inside the render pass.
+struct BenchScenario {
+    const char *name;
+    const char *(*fnCheck) (BenchContext *ctx);
+    void (*fnSetup) (BenchContext *ctx);
+    void (*fnPrepare) (BenchContext *ctx);
+    void (*fnPrePass) (BenchContext *ctx, VkCommandBuffer cmdBuffer);
+    void (*fnRecord) (BenchContext *ctx, VkCommandBuffer cmdBuffer);
+    void (*fnTeardown) (BenchContext *ctx);
+};
+
+struct BenchPushConst {
+    float offset[2];
+    float scale;
+    float cell;
+    uint32_t columns;
+};
+
+static const char *_CheckShaders(BenchContext *ctx)
+{
+    return ctx->shadersAvailable ? NULL : "shader/bench.*.spv not found";
+}
+
+static const char *_CheckIndirect(BenchContext *ctx)
+{
+    // every command pick its grid cell with firstInstance.
+    if (!ctx->rd->GetDeviceContext()->GetPhysicalDeviceFeatures().drawIndirectFirstInstance)
+        return "drawIndirectFirstInstance is not supported";
+
+    return _CheckShaders(ctx);
+}
+
+static const char *_CheckCulled(BenchContext *ctx)
+{
+    if (!GPUCulling::IsSupported(ctx->rd))
+        return "drawIndirectFirstInstance is not supported";
+
+    return _CheckShaders(ctx);
+}
+
+static void _GetBenchPipelineInfo(BenchContext *ctx, const char *vertex, RenderDevice::SpecializationConstant *pConstant,
+                                  RenderDevice::PipelineCreateInfo *pCreateInfo, RenderDevice::ShaderInfo *pShaderInfo)
+{
+    *pCreateInfo = {};
+    pCreateInfo->renderPass = ctx->renderPass;
+    pCreateInfo->polygon = VK_POLYGON_MODE_FILL;
+    pCreateInfo->topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    pCreateInfo->cullMode = VK_CULL_MODE_NONE;
+    pCreateInfo->depthTestEnable = VK_FALSE;
+    pCreateInfo->depthWriteEnable = VK_FALSE;
+
+    *pShaderInfo = {};
+    pShaderInfo->vertex = vertex;
+    pShaderInfo->fragment = "bench";
+    pShaderInfo->specializationConstantCount = 1;
+    pShaderInfo->pSpecializationConstants = pConstant;
+}
+
+static RenderDevice::PipelineHandle _CreateBenchPipeline(BenchContext *ctx, uint32_t variant, const char *vertex = "bench")
+{
+    RenderDevice::SpecializationConstant constant = { 0, VK_SHADER_STAGE_FRAGMENT_BIT, variant };
+
+    RenderDevice::PipelineCreateInfo createInfo;
+    RenderDevice::ShaderInfo shaderInfo;
+    _GetBenchPipelineInfo(ctx, vertex, &constant, &createInfo, &shaderInfo);
+
+    return ctx->rd->CreateGraphicsPipeline(&createInfo, &shaderInfo);
+}
+
+// spread the triangles on a grid so they don't all hit the same pixels,
+// instance i land on cell i.
+static BenchPushConst _GetGridPushConst(uint32_t index, uint32_t columns)
+{
+    BenchPushConst pushConst;
+    pushConst.cell = 2.0f / (float) columns;
+    pushConst.offset[0] = -1.0f + pushConst.cell * ((float) (index % columns) + 0.5f);
+    pushConst.offset[1] = -1.0f + pushConst.cell * ((float) (index / columns) + 0.5f);
+    pushConst.scale = pushConst.cell * 0.5f;
+    pushConst.columns = columns;
+
+    return pushConst;
+}
+
+static uint32_t _GetGridColumns(BenchContext *ctx)
+{
+    return std::max((uint32_t) ceilf(sqrtf((float) ctx->count)), 1u);
+}
+
+static void _SetupDraws(BenchContext *ctx)
+{
+    ctx->drawPipeline = _CreateBenchPipeline(ctx, 0);
+}
+
+static void _RecordDraws(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    RenderDevice *rd = ctx->rd;
+    rd->CmdBindPipeline(cmdBuffer, ctx->drawPipeline);
+    rd->CmdSetViewport(cmdBuffer, ctx->width, ctx->height);
+
+    uint32_t columns = _GetGridColumns(ctx);
+    for (uint32_t i = 0; i < ctx->count; i++) {
+        BenchPushConst pushConst = _GetGridPushConst(i, columns);
+        rd->CmdPushConstant(cmdBuffer, ctx->drawPipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(BenchPushConst), &pushConst);
+        rd->CmdDraw(cmdBuffer, 3);
+    }
+}
+
+static void _RecordInstanced(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    RenderDevice *rd = ctx->rd;
+    rd->CmdBindPipeline(cmdBuffer, ctx->drawPipeline);
+    rd->CmdSetViewport(cmdBuffer, ctx->width, ctx->height);
+
+    BenchPushConst pushConst = _GetGridPushConst(0, _GetGridColumns(ctx));
+    rd->CmdPushConstant(cmdBuffer, ctx->drawPipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(BenchPushConst), &pushConst);
+    rd->CmdDraw(cmdBuffer, 3, ctx->count);
+}
+
+static void _SetupIndirect(BenchContext *ctx)
+{
+    ctx->drawPipeline = _CreateBenchPipeline(ctx, 0);
+
+    std::vector<VkDrawIndirectCommand> commands(ctx->count);
+    for (uint32_t i = 0; i < ctx->count; i++)
+        commands[i] = { 3, 1, 0, i };
+
+    VkDeviceSize size = sizeof(VkDrawIndirectCommand) * ctx->count;
+    ctx->indirectBuffer = ctx->rd->CreateBuffer(VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, size);
+    ctx->rd->WriteBuffer(ctx->indirectBuffer, 0, size, std::data(commands));
+}
+
+static void _RecordIndirect(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    RenderDevice *rd = ctx->rd;
+    rd->CmdBindPipeline(cmdBuffer, ctx->drawPipeline);
+    rd->CmdSetViewport(cmdBuffer, ctx->width, ctx->height);
+
+    BenchPushConst pushConst = _GetGridPushConst(0, _GetGridColumns(ctx));
+    rd->CmdPushConstant(cmdBuffer, ctx->drawPipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(BenchPushConst), &pushConst);
+    rd->CmdDrawIndirect(cmdBuffer, ctx->indirectBuffer, 0, ctx->count);
+}
+
+static void _TeardownIndirect(BenchContext *ctx)
+{
+    ctx->rd->DestroyBuffer(ctx->indirectBuffer);
+    ctx->rd->DestroyPipeline(ctx->drawPipeline);
+}
+
+static void _TeardownDraws(BenchContext *ctx)
+{
+    ctx->rd->DestroyPipeline(ctx->drawPipeline);
+}
+
+// bench triangle as the only mesh, count objects on the grid of the draws
+// scenario scaled by spread. The occluder replace object 0 by a large
+// triangle in front of the grid.
+static void _SetupCullingObjects(BenchContext *ctx, float spread, bool occluder)
+{
+    uint32_t indices[] = { 0, 1, 2 };
+    ctx->indexBuffer = ctx->rd->CreateBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, sizeof(indices));
+    ctx->rd->WriteBuffer(ctx->indexBuffer, 0, sizeof(indices), indices);
+
+    GPUCullingMesh mesh = {};
+    mesh.indexCount = ARRAY_SIZE(indices);
+    mesh.boundingSphere = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    ctx->culling->SetMeshes(1, &mesh);
+
+    uint32_t columns = _GetGridColumns(ctx);
+    std::vector<GPUCullingObject> objects(ctx->count);
+    for (uint32_t i = 0; i < ctx->count; i++) {
+        BenchPushConst pushConst = _GetGridPushConst(i, columns);
+        mat4 transform = glm::translate(mat4(1.0f), vec3(pushConst.offset[0] * spread, pushConst.offset[1] * spread, 0.5f));
+        objects[i].transform = glm::scale(transform, vec3(pushConst.scale * spread));
+        objects[i].meshIndex = 0;
+    }
+
+    if (occluder)
+        objects[0].transform = glm::scale(glm::translate(mat4(1.0f), vec3(0.0f, 0.0f, 0.1f)), vec3(0.9f));
+
+    ctx->culling->SetObjects(ctx->count, std::data(objects));
+
+    ctx->rd->AllocateDescriptorSet(ctx->rd->GetPipeline(ctx->drawPipeline)->descriptorSetLayouts[0], &ctx->descriptorSet);
+    ctx->rd->UpdateDescriptorSetBuffer(ctx->culling->GetObjectBuffer(), 0, ctx->descriptorSet);
+}
+
+static void _SetupCulled(BenchContext *ctx)
+{
+    ctx->drawPipeline = _CreateBenchPipeline(ctx, 0, "bench_culled");
+    ctx->culling = memnew(GPUCulling, ctx->rd, 1, ctx->count);
+
+    // stretched over [-2, 2], three quarters of the objects fall outside
+    // the clip volume.
+    _SetupCullingObjects(ctx, 2.0f, false);
+}
+
+static void _PrePassCulled(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    ctx->culling->CmdCull(cmdBuffer, mat4(1.0f));
+}
+
+static void _RecordCulled(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    RenderDevice *rd = ctx->rd;
+    rd->CmdBindPipeline(cmdBuffer, ctx->drawPipeline);
+    rd->CmdSetViewport(cmdBuffer, ctx->width, ctx->height);
+    rd->CmdBindDescriptorSet(cmdBuffer, ctx->drawPipeline, ctx->descriptorSet);
+    rd->CmdBindIndexBuffer(cmdBuffer, VK_INDEX_TYPE_UINT32, ctx->indexBuffer);
+    ctx->culling->CmdDrawIndexed(cmdBuffer);
+}
+
+static void _TeardownCulled(BenchContext *ctx)
+{
+    ctx->rd->FreeDescriptorSet(ctx->descriptorSet);
+    ctx->rd->DestroyBuffer(ctx->indexBuffer);
+    memdel(ctx->culling);
+    ctx->culling = NULL;
+    ctx->rd->DestroyPipeline(ctx->drawPipeline);
+}
+
+static void _SetupOccluded(BenchContext *ctx)
+{
+    RenderDevice *rd = ctx->rd;
+    ctx->hiZBuffer = memnew(HiZBuffer, rd, ctx->width, ctx->height);
+    ctx->drawPipeline = _CreateBenchPipeline(ctx, 0, "bench_culled");
+
+    RenderDevice::PipelineCreateInfo createInfo = {};
+    createInfo.renderPass = ctx->hiZBuffer->GetRenderPass();
+    createInfo.colorAttachmentCount = 0;
+    createInfo.polygon = VK_POLYGON_MODE_FILL;
+    createInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    createInfo.cullMode = VK_CULL_MODE_NONE;
+
+    RenderDevice::ShaderInfo shaderInfo = {};
+    shaderInfo.vertex = "bench_culled";
+    shaderInfo.fragment = "bench";
+    ctx->depthPipeline = rd->CreateGraphicsPipeline(&createInfo, &shaderInfo);
+
+    // the grid sit behind the occluder, most of it stop being drawn from
+    // the third frame on.
+    ctx->culling = memnew(GPUCulling, rd, 1, ctx->count, ctx->hiZBuffer);
+    _SetupCullingObjects(ctx, 1.0f, true);
+}
+
+static void _PrePassOccluded(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    RenderDevice *rd = ctx->rd;
+    HiZBuffer *hiZBuffer = ctx->hiZBuffer;
+
+    ctx->culling->CmdCull(cmdBuffer, mat4(1.0f), GPU_CULLING_PHASE_EARLY);
+
+    hiZBuffer->CmdBeginDepthPass(cmdBuffer, true);
+    rd->CmdBindPipeline(cmdBuffer, ctx->depthPipeline);
+    rd->CmdSetViewport(cmdBuffer, hiZBuffer->GetWidth(), hiZBuffer->GetHeight());
+    rd->CmdBindDescriptorSet(cmdBuffer, ctx->depthPipeline, ctx->descriptorSet);
+    rd->CmdBindIndexBuffer(cmdBuffer, VK_INDEX_TYPE_UINT32, ctx->indexBuffer);
+    ctx->culling->CmdDrawIndexed(cmdBuffer, GPU_CULLING_PHASE_EARLY);
+    hiZBuffer->CmdEndDepthPass(cmdBuffer);
+
+    hiZBuffer->CmdBuildPyramid(cmdBuffer);
+    ctx->culling->CmdCull(cmdBuffer, mat4(1.0f), GPU_CULLING_PHASE_LATE);
+}
+
+static void _RecordOccluded(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    RenderDevice *rd = ctx->rd;
+    rd->CmdBindPipeline(cmdBuffer, ctx->drawPipeline);
+    rd->CmdSetViewport(cmdBuffer, ctx->width, ctx->height);
+    rd->CmdBindDescriptorSet(cmdBuffer, ctx->drawPipeline, ctx->descriptorSet);
+    rd->CmdBindIndexBuffer(cmdBuffer, VK_INDEX_TYPE_UINT32, ctx->indexBuffer);
+    ctx->culling->CmdDrawIndexed(cmdBuffer, GPU_CULLING_PHASE_EARLY);
+    ctx->culling->CmdDrawIndexed(cmdBuffer, GPU_CULLING_PHASE_LATE);
+}
+
+static void _TeardownOccluded(BenchContext *ctx)
+{
+    _TeardownCulled(ctx);
+    ctx->rd->DestroyPipeline(ctx->depthPipeline);
+    memdel(ctx->hiZBuffer);
+    ctx->hiZBuffer = NULL;
+}
+
+static void _SetupTextures(BenchContext *ctx)
+{
+    RenderDevice::TextureCreateInfo createInfo = {};
+    createInfo.width = BENCH_TEXTURE_SIZE;
+    createInfo.height = BENCH_TEXTURE_SIZE;
+    createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    createInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    createInfo.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    createInfo.imageType = VK_IMAGE_TYPE_2D;
+    createInfo.imageViewType = VK_IMAGE_VIEW_TYPE_2D;
+    createInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    for (uint32_t i = 0; i < ctx->count; i++)
+        ctx->textures.push_back(ctx->rd->CreateTexture(&createInfo));
+
+    ctx->pixels.resize(BENCH_TEXTURE_SIZE * BENCH_TEXTURE_SIZE * 4);
+    for (size_t i = 0; i < ctx->pixels.size(); i++)
+        ctx->pixels[i] = (uint8_t) (i * 31);
+}
+
+static void _PrepareTextures(BenchContext *ctx)
+{
+    for (RenderDevice::TextureHandle texture : ctx->textures)
+        ctx->rd->WriteTexture(texture, ctx->pixels.size(), std::data(ctx->pixels));
+}
+
+static void _TeardownTextures(BenchContext *ctx)
+{
+    for (RenderDevice::TextureHandle texture : ctx->textures)
+        ctx->rd->DestroyTexture(texture);
+
+    ctx->textures.clear();
+    ctx->pixels.clear();
+}
+
+static void _PreparePipelines(BenchContext *ctx)
+{
+    // a new variant every time, neither the registry nor the driver cache
+    // can hand back an existing pipeline.
+    for (uint32_t i = 0; i < ctx->count; i++) {
+        uint32_t variant = (uint32_t) (ctx->frame * ctx->count + i + 1);
+        ctx->rd->DestroyPipeline(_CreateBenchPipeline(ctx, variant));
+    }
+}
+
+static AsyncPipeline *_CompileBenchPipelineAsync(BenchContext *ctx)
+{
+    RenderDevice::SpecializationConstant constant = { 0, VK_SHADER_STAGE_FRAGMENT_BIT, ctx->asyncVariant++ };
+
+    RenderDevice::PipelineCreateInfo createInfo;
+    RenderDevice::ShaderInfo shaderInfo;
+    _GetBenchPipelineInfo(ctx, "bench", &constant, &createInfo, &shaderInfo);
+
+    return ctx->compiler->CompileGraphicsPipelineAsync(&createInfo, &shaderInfo);
+}
+
+static void _CollectAsyncPipeline(BenchContext *ctx, AsyncPipeline *asyncPipeline)
+{
+    ctx->compileTimes.push_back(asyncPipeline->compileMilliseconds);
+    ctx->latencyTimes.push_back(asyncPipeline->latencyMilliseconds);
+}
+
+static void _SetupAsyncPipelines(BenchContext *ctx)
+{
+    ctx->drawPipeline = _CreateBenchPipeline(ctx, 0);
+    ctx->compiler = memnew(PipelineCompiler, ctx->rd);
+
+    // variants the pipelines scenario never create, so the driver cache
+    // can't serve them either.
+    ctx->asyncVariant = 1u << 31;
+    ctx->asyncSlots.assign(ctx->count, BenchAsyncSlot {});
+}
+
+static void _PrepareAsyncPipelines(BenchContext *ctx)
+{
+    while (!ctx->retiredPipelines.empty() && ctx->retiredPipelines.front().frame + BENCH_RETIRE_FRAMES <= ctx->frame) {
+        ctx->compiler->DestroyAsyncPipeline(ctx->retiredPipelines.front().asyncPipeline);
+        ctx->retiredPipelines.pop_front();
+    }
+
+    // count pipelines keep compiling, a slot start a new variant once its
+    // pipeline was drawn or failed to compile.
+    for (BenchAsyncSlot &slot : ctx->asyncSlots) {
+        AsyncPipeline *asyncPipeline = slot.asyncPipeline;
+        if (asyncPipeline) {
+            bool failed = asyncPipeline->ready.load(std::memory_order_acquire) && !asyncPipeline->pipeline;
+            if (!slot.drawn && !failed)
+                continue;
+
+            _CollectAsyncPipeline(ctx, asyncPipeline);
+            ctx->retiredPipelines.push_back({ asyncPipeline, ctx->frame });
+        }
+
+        slot.asyncPipeline = _CompileBenchPipelineAsync(ctx);
+        slot.drawn = false;
+    }
+}
+
+static void _RecordAsyncPipelines(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    RenderDevice *rd = ctx->rd;
+    rd->CmdSetViewport(cmdBuffer, ctx->width, ctx->height);
+
+    // even slots fall back to the variant 0 pipeline, odd ones skip the
+    // draw until their pipeline is ready.
+    uint32_t columns = _GetGridColumns(ctx);
+    for (uint32_t i = 0; i < ctx->count; i++) {
+        BenchAsyncSlot &slot = ctx->asyncSlots[i];
+        RenderDevice::PipelineHandle fallback = i % 2 ? RenderDevice::PipelineHandle() : ctx->drawPipeline;
+        RenderDevice::PipelineHandle pipeline = PipelineCompiler::GetPipelineOrFallback(slot.asyncPipeline, fallback);
+
+        if (!pipeline) {
+            ++ctx->skippedDraws;
+            continue;
+        }
+
+        if (pipeline == fallback)
+            ++ctx->fallbackDraws;
+        else
+            slot.drawn = true;
+
+        BenchPushConst pushConst = _GetGridPushConst(i, columns);
+        rd->CmdBindPipeline(cmdBuffer, pipeline);
+        rd->CmdPushConstant(cmdBuffer, pipeline, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(BenchPushConst), &pushConst);
+        rd->CmdDraw(cmdBuffer, 3);
+    }
+}
+
+static void _TeardownAsyncPipelines(BenchContext *ctx)
+{
+    ctx->compiler->WaitIdle();
+
+    for (BenchAsyncSlot &slot : ctx->asyncSlots) {
+        if (!slot.asyncPipeline)
+            continue;
+
+        _CollectAsyncPipeline(ctx, slot.asyncPipeline);
+        ctx->compiler->DestroyAsyncPipeline(slot.asyncPipeline);
+    }
+
+    for (const BenchRetiredPipeline &retired : ctx->retiredPipelines)
+        ctx->compiler->DestroyAsyncPipeline(retired.asyncPipeline);
+
+    ctx->asyncSlots.clear();
+    ctx->retiredPipelines.clear();
+    memdel(ctx->compiler);
+    ctx->compiler = NULL;
+    ctx->rd->DestroyPipeline(ctx->drawPipeline);
+}
+
+static void _PrepareResize(BenchContext *ctx)
+{
+    // flip between the full and three quarter size, every frame rebuild the
+    // swapchain or the offscreen target.
+    uint32_t width = ctx->width;
+    uint32_t height = ctx->height;
+    if (ctx->frame % 2) {
+        width = width * 3 / 4;
+        height = height * 3 / 4;
+    }
+
+    if (ctx->window) {
+        ctx->window->SetSize((int) width, (int) height);
+        ctx->window->PollEvents();
+    } else {
+        ctx->offscreen->Resize(width, height);
+    }
+}
+
+static const BenchScenario scenarios[] = {
+    { "empty", NULL, NULL, NULL, NULL, NULL, NULL },
+    { "draws", _CheckShaders, _SetupDraws, NULL, NULL, _RecordDraws, _TeardownDraws },
+    { "instanced", _CheckShaders, _SetupDraws, NULL, NULL, _RecordInstanced, _TeardownDraws },
+    { "indirect", _CheckIndirect, _SetupIndirect, NULL, NULL, _RecordIndirect, _TeardownIndirect },
+    { "culled", _CheckCulled, _SetupCulled, NULL, _PrePassCulled, _RecordCulled, _TeardownCulled },
+    { "occluded", _CheckCulled, _SetupOccluded, NULL, _PrePassOccluded, _RecordOccluded, _TeardownOccluded },
+    { "textures", NULL, _SetupTextures, _PrepareTextures, NULL, NULL, _TeardownTextures },
+    { "pipelines", _CheckShaders, NULL, _PreparePipelines, NULL, NULL, NULL },
+    { "async_pipelines", _CheckShaders, _SetupAsyncPipelines, _PrepareAsyncPipelines, NULL, _RecordAsyncPipelines, _TeardownAsyncPipelines },
+    { "resize", NULL, NULL, _PrepareResize, NULL, NULL, NULL },
+};
+
+static void _BeginFrame(BenchContext *ctx, VkCommandBuffer *pCmdBuffer)
+{
+    if (ctx->display)
+        ctx->display->CmdBeginDisplayFrame(pCmdBuffer);
+    else
+        ctx->offscreen->CmdBeginOffscreenFrame(pCmdBuffer);
+}
+
+static void _BeginPass(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    if (ctx->display)
+        ctx->display->CmdBeginDisplayPass(cmdBuffer);
+    else
+        ctx->offscreen->CmdBeginOffscreenPass(cmdBuffer);
+}
+
+static void _EndPass(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    if (ctx->display)
+        ctx->display->CmdEndDisplayPass(cmdBuffer);
+    else
+        ctx->offscreen->CmdEndOffscreenPass(cmdBuffer);
+}
+
+static void _EndFrame(BenchContext *ctx, VkCommandBuffer cmdBuffer)
+{
+    if (ctx->display)
+        ctx->display->CmdEndDisplayFrame(cmdBuffer);
+    else
+        ctx->offscreen->CmdEndOffscreenFrame(cmdBuffer);
+
+    ++ctx->frame;
+}
+
+static void _WaitIdle(BenchContext *ctx)
+{
+    RenderDeviceContext *rdc = ctx->rd->GetDeviceContext();
+    std::lock_guard<std::mutex> lock(rdc->GetQueueMutex());
+    vkDeviceWaitIdle(rdc->GetDevice());
+}
+
+static BenchStats _ComputeStats(std::vector<double> samples)
+{
+    BenchStats stats;
+    if (samples.empty())
+        return stats;
+
+    std::sort(samples.begin(), samples.end());
+
+    double sum = 0.0;
+    for (double sample : samples)
+        sum += sample;
+
+    size_t p99 = (size_t) ceil(0.99 * (double) samples.size());
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.avg = sum / (double) samples.size();
+    stats.p99 = samples[std::max<size_t>(p99, 1) - 1];
+    stats.samples = (uint32_t) samples.size();
+
+    return stats;
+}
+
+static BenchResult _RunScenario(BenchContext *ctx, GPUProfiler *profiler, const BenchScenario *scenario, uint32_t warmup, uint32_t frames)
+{
+    BenchResult result;
+    result.name = scenario->name;
+
+    result.skipped = scenario->fnCheck ? scenario->fnCheck(ctx) : NULL;
+    if (result.skipped)
+        return result;
+
+    if (scenario->fnSetup)
+        scenario->fnSetup(ctx);
+
+    // the profiler is only used by the bench, its frame numbers follow ours.
+    uint64_t firstFrame = ctx->frame + warmup;
+    uint64_t lastFrame = firstFrame + frames;
+    uint64_t collectedFrame = UINT64_MAX;
+
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+
+    // the extra frames at the end only let the profiler read the last
+    // measured ones back.
+    for (uint32_t i = 0; i < warmup + frames + GPU_PROFILER_FRAME_COUNT; i++) {
+        bool measured = i >= warmup && i < warmup + frames;
+
+        if (ctx->window)
+            ctx->window->PollEvents();
+
+        uint64_t begin = CPUProfiler::GetTimestamp();
+
+        if (measured && scenario->fnPrepare)
+            scenario->fnPrepare(ctx);
+
+        VkCommandBuffer cmdBuffer;
+        _BeginFrame(ctx, &cmdBuffer);
+        if (measured && scenario->fnPrePass)
+            scenario->fnPrePass(ctx, cmdBuffer);
+        _BeginPass(ctx, cmdBuffer);
+        if (measured && scenario->fnRecord)
+            scenario->fnRecord(ctx, cmdBuffer);
+        _EndPass(ctx, cmdBuffer);
+        _EndFrame(ctx, cmdBuffer);
+
+        uint64_t end = CPUProfiler::GetTimestamp();
+        if (measured)
+            cpuTimes.push_back(CPUProfiler::ToMilliseconds(end - begin));
+
+        // every CmdBeginFrame resolve at most the frame that used its pools
+        // last, polling once per frame see each of them.
+        GPUFrameResult frameResult;
+        profiler->GetLatestFrame(&frameResult);
+        if (frameResult.frame != collectedFrame && frameResult.frame >= firstFrame && frameResult.frame < lastFrame) {
+            collectedFrame = frameResult.frame;
+            gpuTimes.push_back(frameResult.milliseconds + frameResult.uploadMilliseconds);
+        }
+    }
+
+    _WaitIdle(ctx);
+
+    if (scenario->fnTeardown)
+        scenario->fnTeardown(ctx);
+
+    /* restore the size changed by the resize storm */
+    if (ctx->window) {
+        ctx->window->SetSize((int) ctx->width, (int) ctx->height);
+        ctx->window->PollEvents();
+    } else {
+        ctx->offscreen->Resize(ctx->width, ctx->height);
+    }
+
+    result.cpu = _ComputeStats(cpuTimes);
+    result.gpu = _ComputeStats(gpuTimes);
+    result.compile = _ComputeStats(ctx->compileTimes);
+    result.latency = _ComputeStats(ctx->latencyTimes);
+    result.fallbackDraws = ctx->fallbackDraws;
+    result.skippedDraws = ctx->skippedDraws;
+
+    ctx->compileTimes.clear();
+    ctx->latencyTimes.clear();
+    ctx->fallbackDraws = 0;
+    ctx->skippedDraws = 0;
+
+    return result;
+}
+
+static void _AppendStats(std::string *json, const char *name, const BenchStats &stats)
+{
+    char buf[256];
+    snprintf(buf, sizeof(buf), "\"%s\": { \"min\": %.4f, \"avg\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"samples\": %u }",
+             name, stats.min, stats.avg, stats.p99, stats.max, stats.samples);
+    *json += buf;
+}
+
+static Error _ExportJSON(const char *path, BenchContext *ctx, bool headless, uint32_t warmup, uint32_t frames, const std::vector<BenchResult> &results)
+{
+    const VkPhysicalDeviceProperties &properties = ctx->rd->GetDeviceContext()->GetPhysicalDeviceProperties();
+
+    char buf[512];
+    snprintf(buf, sizeof(buf), "{\n  \"device\": \"%s\",\n  \"apiVersion\": \"%u.%u.%u\",\n  \"headless\": %s,\n"
+                               "  \"width\": %u,\n  \"height\": %u,\n  \"warmup\": %u,\n  \"frames\": %u,\n  \"count\": %u,\n  \"scenarios\": [\n",
+             properties.deviceName, VK_API_VERSION_MAJOR(properties.apiVersion), VK_API_VERSION_MINOR(properties.apiVersion),
+             VK_API_VERSION_PATCH(properties.apiVersion), headless ? "true" : "false", ctx->width, ctx->height, warmup, frames, ctx->count);
+
+    std::string json = buf;
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        json += "    { \"name\": \"";
+        json += result.name;
+        json += "\", ";
+
+        if (result.skipped) {
+            json += "\"skipped\": \"";
+            json += result.skipped;
+            json += "\" }";
+        } else {
+            _AppendStats(&json, "cpu", result.cpu);
+            json += ", ";
+            _AppendStats(&json, "gpu", result.gpu);
+
+            if (result.compile.samples) {
+                json += ", ";
+                _AppendStats(&json, "compile", result.compile);
+                json += ", ";
+                _AppendStats(&json, "latency", result.latency);
+                snprintf(buf, sizeof(buf), ", \"fallbackDraws\": %u, \"skippedDraws\": %u", result.fallbackDraws, result.skippedDraws);
+                json += buf;
+            }
+
+            json += " }";
+        }
+
+        json += i + 1 < results.size() ? ",\n" : "\n";
+    }
+
+    json += "  ]\n}\n";
+
+    return io_write_file(path, std::data(json), std::size(json));
+}
+
+int main(int argc, char **argv)
+{
+    bool headless = false;
+    const char *scenarioName = "all";
+    const char *output = "bench.json";
+    uint32_t frames = 300;
+    uint32_t warmup = 30;
+    uint32_t count = 1000;
+    uint32_t width = 1280;
+    uint32_t height = 720;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless") {
+            headless = true;
+        } else if (arg == "--scenario" && i + 1 < argc) {
+            scenarioName = argv[++i];
+        } else if (arg == "--frames" && i + 1 < argc) {
+            frames = (uint32_t) std::max(1, atoi(argv[++i]));
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmup = (uint32_t) std::max(0, atoi(argv[++i]));
+        } else if (arg == "--count" && i + 1 < argc) {
+            count = (uint32_t) std::max(1, atoi(argv[++i]));
+        } else if (arg == "--size" && i + 2 < argc) {
+            width = (uint32_t) std::max(1, atoi(argv[++i]));
+            height = (uint32_t) std::max(1, atoi(argv[++i]));
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    std::vector<const BenchScenario *> selected;
+    for (const BenchScenario &scenario : scenarios) {
+        if (strcmp(scenarioName, "all") == 0 || strcmp(scenarioName, scenario.name) == 0)
+            selected.push_back(&scenario);
+    }
+
+    if (selected.empty()) {
+        fprintf(stderr, "unknown scenario: %s\n", scenarioName);
+        return 1;
+    }
+
+    // prefer shaders from the resource directory, otherwise the ones
+    // compiled along with the runtime.
+#ifdef BRIGHT_SHADER_DIRECTORY
+    if (!vfs_exists("shader/bench.vert.spv"))
+        vfs_mount_directory("shader", BRIGHT_SHADER_DIRECTORY);
+#endif
+
+    BenchContext ctx = {};
+    ctx.width = width;
+    ctx.height = height;
+    ctx.count = count;
+    ctx.shadersAvailable = vfs_exists("shader/bench.vert.spv") && vfs_exists("shader/bench.frag.spv");
+
+    RenderDeviceContext *rdc;
+    if (headless) {
+        RenderDeviceContextHeadless *rdcHeadless = memnew(RenderDeviceContextHeadless);
+        ctx.rd = rdcHeadless->CreateRenderDevice();
+        rdc = rdcHeadless;
+        ctx.offscreen = memnew(RenderingOffscreen, ctx.rd, width, height);
+        ctx.renderPass = ctx.offscreen->GetRenderPass();
+    } else {
+        ctx.window = memnew(Window, "BrightBench", (int) width, (int) height);
+        RenderDeviceContextWin32 *rdcWin32 = memnew(RenderDeviceContextWin32, ctx.window);
+        ctx.rd = rdcWin32->CreateRenderDevice();
+        rdc = rdcWin32;
+        ctx.display = memnew(RenderingDisplay, ctx.rd, ctx.window);
+        ctx.renderPass = ctx.display->GetRenderPass();
+    }
+
+    GPUProfiler *profiler = memnew(GPUProfiler, ctx.rd);
+    ctx.rd->SetGPUProfiler(profiler);
+
+    printf("%s, %s, %u frames (+%u warmup), count %u\n", rdc->GetDeviceName(), headless ? "headless" : "windowed", frames, warmup, count);
+    if (!profiler->IsSupported())
+        printf("timestamp queries are not supported, GPU times are left empty.\n");
+
+    std::vector<BenchResult> results;
+    for (const BenchScenario *scenario : selected) {
+        BenchResult result = _RunScenario(&ctx, profiler, scenario, warmup, frames);
+        if (result.skipped) {
+            printf("%-10s skipped: %s\n", result.name, result.skipped);
+        } else {
+            printf("%-10s cpu min %8.3f avg %8.3f p99 %8.3f ms | gpu min %8.3f avg %8.3f p99 %8.3f ms\n", result.name,
+                   result.cpu.min, result.cpu.avg, result.cpu.p99, result.gpu.min, result.gpu.avg, result.gpu.p99);
+            if (result.compile.samples) {
+                printf("%-10s %u pipelines, compile avg %8.3f p99 %8.3f ms | latency avg %8.3f p99 %8.3f ms | %u fallback, %u skipped draws\n", "",
+                       result.compile.samples, result.compile.avg, result.compile.p99, result.latency.avg, result.latency.p99,
+                       result.fallbackDraws, result.skippedDraws);
+            }
+        }
+
+        results.push_back(result);
+    }
+
+    Error err = _ExportJSON(output, &ctx, headless, warmup, frames, results);
+    if (err != OK)
+        fprintf(stderr, "write %s failed\n", output);
+
+    ctx.rd->SetGPUProfiler(VK_NULL_HANDLE);
+    memdel(profiler);
+
+    if (headless) {
+        memdel(ctx.offscreen);
+        memdel(ctx.rd);
+        memdel((RenderDeviceContextHeadless *) rdc);
+    } else {
+        memdel(ctx.display);
+        memdel(ctx.rd);
+        memdel((RenderDeviceContextWin32 *) rdc);
+        memdel(ctx.window);
+    }
+
+    return err == OK ? 0 : 1;
+}
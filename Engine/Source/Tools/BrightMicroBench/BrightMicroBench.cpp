@@ -0,0 +1,688 @@
+/* ======================================================================== */
+/* BrightMicroBench.cpp                                                     */
+/* ======================================================================== */
+/*                        This file is part of:                             */
+/*                            BRIGHT ENGINE                                 */
+/* ======================================================================== */
+/*                                                                          */
+/* Copyright (C) 2022 Vcredent All rights reserved.                         */
+/*                                                                          */
+/* Licensed under the Apache License, Version 2.0 (the "License");          */
+/* you may not use this file except in compliance with the License.         */
+/*                                                                          */
+/* You may obtain a copy of the License at                                  */
+/*     http://www.apache.org/licenses/LICENSE-2.0                           */
+/*                                                                          */
+/* Unless required by applicable law or agreed to in writing, software      */
+/* distributed under the License is distributed on an "AS IS" BASIS,        */
+/* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied  */
+/* See the License for the specific language governing permissions and      */
+/* limitations under the License.                                           */
+/*                                                                          */
+/* ======================================================================== */
+#include <RT/Headless/RenderDeviceContextHeadless.h>
+#include <RT/Renderer/RenderingOffscreen.h>
+#include <RT/Profiler/CPUProfiler.h>
+#include <Bright/IOUtils.h>
+#include <Bright/SIMDMath.h>
+#include <Bright/VFS.h>
+#include <algorithm>
+#include <filesystem>
+#include <math.h>
+#include <string>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+// CPU cost of single RenderDevice calls on a headless device:
+//
+//     BrightMicroBench [--filter <substring>] [--min-time <seconds>]
+//                      [--repetitions <count>] [--output <path>]
+//
+// every call has a warm variant, steady state with every pool and cache
+// primed, and a cold one paying the first use cost described next to it.
+// Iteration counts are calibrated until a run lasts min-time, results are
+// written in the Google Benchmark JSON format, microbench.json by default,
+// so its compare tooling can diff two runs.
+//
+// The SIMD math kernels run once per level, an iteration is a batch of
+// MICRO_BENCH_SIMD_BATCH elements, levels the CPU lacks report an error.
+
+#define MICRO_BENCH_BUFFER_SIZE (64 * 1024)
+/* above half the VMA block size, always a dedicated allocation */
+#define MICRO_BENCH_LARGE_BUFFER_SIZE (64 * 1024 * 1024)
+#define MICRO_BENCH_BARRIER_TEXTURES 256
+#define MICRO_BENCH_BARRIERS_PER_RECORD 4096
+#define MICRO_BENCH_SIMD_BATCH 1024
+
+struct MicroBenchContext {
+    RenderDevice *rd;
+    RenderingOffscreen *offscreen;
+    bool shadersAvailable;
+    uint32_t pipelineVariant;
+    VkSampler sampler;
+    VkDescriptorSetLayout descriptorSetLayout;
+    std::vector<RenderDevice::TextureHandle> textures;
+    std::vector<char> data;
+    std::vector<simd_mat4> matrices;
+    std::vector<simd_aabb> boxes;
+    std::vector<simd_quat> quats;
+    std::vector<uint32_t> visible;
+    simd_frustum frustum;
+};
+
+class MicroBenchState {
+public:
+    MicroBenchState(uint64_t vIterations) : iterations(vIterations) {}
+
+    // for (...; state->KeepRunning(); ) runs the body iterations times.
+    bool KeepRunning()
+    {
+        if (count == 0)
+            ResumeTiming();
+
+        if (count++ < iterations)
+            return true;
+
+        PauseTiming();
+        return false;
+    }
+
+    // exclude setup and cleanup that must happen between two calls.
+    void PauseTiming() { elapsed += CPUProfiler::GetTimestamp() - begin; }
+    void ResumeTiming() { begin = CPUProfiler::GetTimestamp(); }
+    void SkipWithError(const char *vMessage) { message = vMessage; count = iterations + 1; }
+
+    uint64_t GetIterations() { return iterations; }
+    uint64_t GetElapsed() { return elapsed; }
+    const char *GetErrorMessage() { return message; }
+
+private:
+    uint64_t iterations;
+    uint64_t count = 0;
+    uint64_t begin = 0;
+    uint64_t elapsed = 0;
+    const char *message = NULL;
+};
+
+typedef void (*PFN_MicroBench) (MicroBenchContext *ctx, MicroBenchState *state);
+
+struct MicroBench {
+    const char *name;
+    PFN_MicroBench fn;
+    uint64_t maxIterations;
+};
+
+struct MicroBenchRun {
+    std::string name;
+    std::string runName;
+    const char *aggregateName;
+    uint32_t repetitionIndex;
+    uint64_t iterations;
+    double nanoseconds;
+    const char *error;
+};
+
+static RenderDevice::PipelineHandle _CreateBenchPipeline(MicroBenchContext *ctx, uint32_t variant)
+{
+    RenderDevice::PipelineCreateInfo createInfo = {};
+    createInfo.renderPass = ctx->offscreen->GetRenderPass();
+    createInfo.polygon = VK_POLYGON_MODE_FILL;
+    createInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    createInfo.cullMode = VK_CULL_MODE_NONE;
+    createInfo.depthTestEnable = VK_FALSE;
+    createInfo.depthWriteEnable = VK_FALSE;
+
+    RenderDevice::SpecializationConstant constant = { 0, VK_SHADER_STAGE_FRAGMENT_BIT, variant };
+
+    RenderDevice::ShaderInfo shaderInfo = {};
+    shaderInfo.vertex = "bench";
+    shaderInfo.fragment = "bench";
+    shaderInfo.specializationConstantCount = 1;
+    shaderInfo.pSpecializationConstants = &constant;
+
+    return ctx->rd->CreateGraphicsPipeline(&createInfo, &shaderInfo);
+}
+
+/* warm: VMA suballocate from a block kept alive by the previous buffers */
+static void _CreateBufferWarm(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    while (state->KeepRunning()) {
+        RenderDevice::BufferHandle buffer = ctx->rd->CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MICRO_BENCH_BUFFER_SIZE);
+        state->PauseTiming();
+        ctx->rd->DestroyBuffer(buffer);
+        state->ResumeTiming();
+    }
+}
+
+/* cold: a dedicated vkAllocateMemory on every call */
+static void _CreateBufferCold(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    while (state->KeepRunning()) {
+        RenderDevice::BufferHandle buffer = ctx->rd->CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MICRO_BENCH_LARGE_BUFFER_SIZE);
+        state->PauseTiming();
+        ctx->rd->DestroyBuffer(buffer);
+        state->ResumeTiming();
+    }
+}
+
+/* warm: the same buffer, its memory already touched */
+static void _WriteBufferWarm(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    RenderDevice::BufferHandle buffer = ctx->rd->CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MICRO_BENCH_BUFFER_SIZE);
+
+    while (state->KeepRunning())
+        ctx->rd->WriteBuffer(buffer, 0, MICRO_BENCH_BUFFER_SIZE, std::data(ctx->data));
+
+    ctx->rd->DestroyBuffer(buffer);
+}
+
+/* cold: first write into a new buffer, mapping and page faults included */
+static void _WriteBufferCold(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    while (state->KeepRunning()) {
+        state->PauseTiming();
+        RenderDevice::BufferHandle buffer = ctx->rd->CreateBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, MICRO_BENCH_BUFFER_SIZE);
+        state->ResumeTiming();
+
+        ctx->rd->WriteBuffer(buffer, 0, MICRO_BENCH_BUFFER_SIZE, std::data(ctx->data));
+
+        state->PauseTiming();
+        ctx->rd->DestroyBuffer(buffer);
+        state->ResumeTiming();
+    }
+}
+
+/* warm: the pool slot freed by the previous iteration is reused */
+static void _AllocateDescriptorSetWarm(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    while (state->KeepRunning()) {
+        VkDescriptorSet descriptorSet;
+        ctx->rd->AllocateDescriptorSet(ctx->descriptorSetLayout, &descriptorSet);
+        state->PauseTiming();
+        ctx->rd->FreeDescriptorSet(descriptorSet);
+        state->ResumeTiming();
+    }
+}
+
+/* cold: first allocation with a layout the driver never saw */
+static void _AllocateDescriptorSetCold(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    while (state->KeepRunning()) {
+        state->PauseTiming();
+        VkDescriptorSetLayout descriptorSetLayout;
+        ctx->rd->CreateDescriptorSetLayout(1, &binding, &descriptorSetLayout);
+        state->ResumeTiming();
+
+        VkDescriptorSet descriptorSet;
+        ctx->rd->AllocateDescriptorSet(descriptorSetLayout, &descriptorSet);
+
+        state->PauseTiming();
+        ctx->rd->FreeDescriptorSet(descriptorSet);
+        ctx->rd->DestroyDescriptorSetLayout(descriptorSetLayout);
+        state->ResumeTiming();
+    }
+}
+
+/* warm: rewrite the same binding, its reference entry already exists */
+static void _UpdateDescriptorSetImageWarm(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    VkDescriptorSet descriptorSet;
+    ctx->rd->AllocateDescriptorSet(ctx->descriptorSetLayout, &descriptorSet);
+
+    while (state->KeepRunning())
+        ctx->rd->UpdateDescriptorSetImage(ctx->textures[0], 0, descriptorSet);
+
+    ctx->rd->FreeDescriptorSet(descriptorSet);
+}
+
+/* cold: first write of a new set, the reference registry grows */
+static void _UpdateDescriptorSetImageCold(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    while (state->KeepRunning()) {
+        state->PauseTiming();
+        VkDescriptorSet descriptorSet;
+        ctx->rd->AllocateDescriptorSet(ctx->descriptorSetLayout, &descriptorSet);
+        state->ResumeTiming();
+
+        ctx->rd->UpdateDescriptorSetImage(ctx->textures[0], 0, descriptorSet);
+
+        state->PauseTiming();
+        ctx->rd->FreeDescriptorSet(descriptorSet);
+        state->ResumeTiming();
+    }
+}
+
+/* warm: served by the pipeline registry, shaders are still hashed */
+static void _CreateGraphicsPipelineWarm(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    if (!ctx->shadersAvailable) {
+        state->SkipWithError("shader/bench.*.spv not found");
+        return;
+    }
+
+    RenderDevice::PipelineHandle pipeline = _CreateBenchPipeline(ctx, 0);
+
+    while (state->KeepRunning()) {
+        RenderDevice::PipelineHandle shared = _CreateBenchPipeline(ctx, 0);
+        state->PauseTiming();
+        ctx->rd->DestroyPipeline(shared);
+        state->ResumeTiming();
+    }
+
+    ctx->rd->DestroyPipeline(pipeline);
+}
+
+/* cold: a new specialization every call, nothing cached can match */
+static void _CreateGraphicsPipelineCold(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    if (!ctx->shadersAvailable) {
+        state->SkipWithError("shader/bench.*.spv not found");
+        return;
+    }
+
+    while (state->KeepRunning()) {
+        RenderDevice::PipelineHandle pipeline = _CreateBenchPipeline(ctx, ++ctx->pipelineVariant);
+        state->PauseTiming();
+        ctx->rd->DestroyPipeline(pipeline);
+        state->ResumeTiming();
+    }
+}
+
+static void _CmdPipelineBarrier(MicroBenchContext *ctx, MicroBenchState *state, uint32_t textureCount)
+{
+    VkCommandBuffer cmdBuffer;
+    ctx->rd->AllocateCommandBuffer(&cmdBuffer);
+    ctx->rd->CmdBufferBegin(cmdBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+    RenderDevice::PipelineMemoryBarrier barrier;
+    barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.image.newImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.image.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.image.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    // never submitted, restart the recording before it grows too large.
+    uint64_t recorded = 0;
+    while (state->KeepRunning()) {
+        if (++recorded % MICRO_BENCH_BARRIERS_PER_RECORD == 0) {
+            state->PauseTiming();
+            ctx->rd->CmdBufferEnd(cmdBuffer);
+            vkResetCommandBuffer(cmdBuffer, 0);
+            ctx->rd->CmdBufferBegin(cmdBuffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            state->ResumeTiming();
+        }
+
+        barrier.image.texture = ctx->textures[recorded % textureCount];
+        ctx->rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+    }
+
+    ctx->rd->CmdBufferEnd(cmdBuffer);
+    ctx->rd->FreeCommandBuffer(cmdBuffer);
+}
+
+/* warm: the same texture every time, its state stay in cache */
+static void _CmdPipelineBarrierWarm(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    _CmdPipelineBarrier(ctx, state, 1);
+}
+
+/* cold: walk many textures, handle lookups miss the CPU caches */
+static void _CmdPipelineBarrierCold(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    _CmdPipelineBarrier(ctx, state, MICRO_BENCH_BARRIER_TEXTURES);
+}
+
+// the level is process wide, callers restore the previous one once done.
+static bool _SetSIMDLevel(MicroBenchState *state, simd_level level)
+{
+    simd_set_level(level);
+    if (simd_get_level() == level)
+        return true;
+
+    state->SkipWithError("SIMD level not supported by this CPU");
+    return false;
+}
+
+/* parent * local, the hierarchy flattening loop */
+template<simd_level level>
+static void _SIMDMat4MulBatch(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    simd_level previous = simd_get_level();
+
+    if (_SetSIMDLevel(state, level)) {
+        simd_mat4 *locals = std::data(ctx->matrices);
+        while (state->KeepRunning())
+            simd_mat4_mul_batch(locals, locals + MICRO_BENCH_SIMD_BATCH, locals + MICRO_BENCH_SIMD_BATCH * 2, MICRO_BENCH_SIMD_BATCH);
+    }
+
+    simd_set_level(previous);
+}
+
+/* boxes all around the camera, visibility follow no pattern */
+template<simd_level level>
+static void _SIMDFrustumCullAABBBatch(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    simd_level previous = simd_get_level();
+
+    if (_SetSIMDLevel(state, level)) {
+        while (state->KeepRunning())
+            simd_frustum_cull_aabb_batch(ctx->frustum, std::data(ctx->boxes), MICRO_BENCH_SIMD_BATCH, std::data(ctx->visible));
+    }
+
+    simd_set_level(previous);
+}
+
+template<simd_level level>
+static void _SIMDQuatSlerpBatch(MicroBenchContext *ctx, MicroBenchState *state)
+{
+    simd_level previous = simd_get_level();
+
+    if (_SetSIMDLevel(state, level)) {
+        simd_quat *quats = std::data(ctx->quats);
+        while (state->KeepRunning())
+            simd_quat_slerp_batch(quats, quats + MICRO_BENCH_SIMD_BATCH, 0.25f, quats + MICRO_BENCH_SIMD_BATCH * 2, MICRO_BENCH_SIMD_BATCH);
+    }
+
+    simd_set_level(previous);
+}
+
+static const MicroBench benchmarks[] = {
+    { "CreateBuffer/warm", _CreateBufferWarm, 1000000 },
+    { "CreateBuffer/cold", _CreateBufferCold, 10000 },
+    { "WriteBuffer/warm", _WriteBufferWarm, 1000000 },
+    { "WriteBuffer/cold", _WriteBufferCold, 100000 },
+    { "AllocateDescriptorSet/warm", _AllocateDescriptorSetWarm, 1000000 },
+    { "AllocateDescriptorSet/cold", _AllocateDescriptorSetCold, 100000 },
+    { "UpdateDescriptorSetImage/warm", _UpdateDescriptorSetImageWarm, 10000000 },
+    { "UpdateDescriptorSetImage/cold", _UpdateDescriptorSetImageCold, 1000000 },
+    { "CreateGraphicsPipeline/warm", _CreateGraphicsPipelineWarm, 1000000 },
+    { "CreateGraphicsPipeline/cold", _CreateGraphicsPipelineCold, 1000 },
+    { "CmdPipelineBarrier/warm", _CmdPipelineBarrierWarm, 10000000 },
+    { "CmdPipelineBarrier/cold", _CmdPipelineBarrierCold, 10000000 },
+    { "SIMDMat4MulBatch/scalar", _SIMDMat4MulBatch<SIMD_LEVEL_SCALAR>, 10000000 },
+    { "SIMDMat4MulBatch/sse2", _SIMDMat4MulBatch<SIMD_LEVEL_SSE2>, 10000000 },
+    { "SIMDMat4MulBatch/avx2", _SIMDMat4MulBatch<SIMD_LEVEL_AVX2>, 10000000 },
+    { "SIMDMat4MulBatch/neon", _SIMDMat4MulBatch<SIMD_LEVEL_NEON>, 10000000 },
+    { "SIMDFrustumCullAABBBatch/scalar", _SIMDFrustumCullAABBBatch<SIMD_LEVEL_SCALAR>, 10000000 },
+    { "SIMDFrustumCullAABBBatch/sse2", _SIMDFrustumCullAABBBatch<SIMD_LEVEL_SSE2>, 10000000 },
+    { "SIMDFrustumCullAABBBatch/avx2", _SIMDFrustumCullAABBBatch<SIMD_LEVEL_AVX2>, 10000000 },
+    { "SIMDFrustumCullAABBBatch/neon", _SIMDFrustumCullAABBBatch<SIMD_LEVEL_NEON>, 10000000 },
+    { "SIMDQuatSlerpBatch/scalar", _SIMDQuatSlerpBatch<SIMD_LEVEL_SCALAR>, 10000000 },
+    { "SIMDQuatSlerpBatch/sse2", _SIMDQuatSlerpBatch<SIMD_LEVEL_SSE2>, 10000000 },
+    { "SIMDQuatSlerpBatch/avx2", _SIMDQuatSlerpBatch<SIMD_LEVEL_AVX2>, 10000000 },
+    { "SIMDQuatSlerpBatch/neon", _SIMDQuatSlerpBatch<SIMD_LEVEL_NEON>, 10000000 },
+};
+
+static MicroBenchRun _Run(MicroBenchContext *ctx, const MicroBench *bench, uint64_t iterations)
+{
+    MicroBenchState state(iterations);
+    bench->fn(ctx, &state);
+
+    MicroBenchRun run = {};
+    run.name = bench->name;
+    run.runName = bench->name;
+    run.iterations = iterations;
+    run.nanoseconds = (double) state.GetElapsed() / (double) iterations;
+    run.error = state.GetErrorMessage();
+
+    return run;
+}
+
+// grow the iteration count until a run last minTime, at most ten times
+// more per step.
+static uint64_t _CalibrateIterations(MicroBenchContext *ctx, const MicroBench *bench, double minTime)
+{
+    uint64_t iterations = 1;
+    double minNanoseconds = minTime * 1000000000.0;
+
+    while (iterations < bench->maxIterations) {
+        MicroBenchState state(iterations);
+        bench->fn(ctx, &state);
+
+        double elapsed = (double) state.GetElapsed();
+        if (state.GetErrorMessage() || elapsed >= minNanoseconds)
+            break;
+
+        double multiplier = elapsed > 0.0 ? minNanoseconds * 1.4 / elapsed : 10.0;
+        multiplier = std::clamp(multiplier, 2.0, 10.0);
+        iterations = std::min(bench->maxIterations, (uint64_t) ((double) iterations * multiplier));
+    }
+
+    return iterations;
+}
+
+static void _AppendAggregates(std::vector<MicroBenchRun> *pRuns, size_t first)
+{
+    std::vector<double> samples;
+    for (size_t i = first; i < pRuns->size(); i++)
+        samples.push_back((*pRuns)[i].nanoseconds);
+
+    std::sort(samples.begin(), samples.end());
+
+    double mean = 0.0;
+    for (double sample : samples)
+        mean += sample;
+    mean /= (double) samples.size();
+
+    double variance = 0.0;
+    for (double sample : samples)
+        variance += (sample - mean) * (sample - mean);
+    double stddev = samples.size() > 1 ? sqrt(variance / (double) (samples.size() - 1)) : 0.0;
+
+    size_t middle = samples.size() / 2;
+    double median = samples.size() % 2 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2.0;
+
+    MicroBenchRun aggregate = (*pRuns)[first];
+    aggregate.repetitionIndex = 0;
+
+    const char *names[] = { "mean", "median", "stddev" };
+    double values[] = { mean, median, stddev };
+    for (uint32_t i = 0; i < ARRAY_SIZE(names); i++) {
+        aggregate.name = aggregate.runName + "_" + names[i];
+        aggregate.aggregateName = names[i];
+        aggregate.nanoseconds = values[i];
+        pRuns->push_back(aggregate);
+    }
+}
+
+static Error _ExportJSON(const char *path, const char *executable, MicroBenchContext *ctx, uint32_t repetitions, const std::vector<MicroBenchRun> &runs)
+{
+    const VkPhysicalDeviceProperties &properties = ctx->rd->GetDeviceContext()->GetPhysicalDeviceProperties();
+
+    char date[64];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+#ifdef NDEBUG
+    const char *buildType = "release";
+#else
+    const char *buildType = "debug";
+#endif
+
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"executable\": \"%s\",\n    \"num_cpus\": %u,\n"
+                               "    \"library_build_type\": \"%s\",\n    \"device\": \"%s\",\n    \"api_version\": \"%u.%u.%u\",\n"
+                               "    \"driver_version\": %u\n  },\n  \"benchmarks\": [\n",
+             date, executable, std::thread::hardware_concurrency(), buildType, properties.deviceName,
+             VK_API_VERSION_MAJOR(properties.apiVersion), VK_API_VERSION_MINOR(properties.apiVersion), VK_API_VERSION_PATCH(properties.apiVersion),
+             properties.driverVersion);
+
+    std::string json = buf;
+    for (size_t i = 0; i < runs.size(); i++) {
+        const MicroBenchRun &run = runs[i];
+
+        // wall time only, cpu_time repeat it, the driver may do the work
+        // on its own threads.
+        if (run.error) {
+            snprintf(buf, sizeof(buf), "    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"iteration\",\n"
+                                       "      \"error_occurred\": true,\n      \"error_message\": \"%s\"\n    }",
+                     run.name.c_str(), run.runName.c_str(), run.error);
+        } else if (run.aggregateName) {
+            snprintf(buf, sizeof(buf), "    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"aggregate\",\n"
+                                       "      \"repetitions\": %u,\n      \"aggregate_name\": \"%s\",\n      \"iterations\": %u,\n"
+                                       "      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n      \"time_unit\": \"ns\"\n    }",
+                     run.name.c_str(), run.runName.c_str(), repetitions, run.aggregateName, repetitions, run.nanoseconds, run.nanoseconds);
+        } else {
+            snprintf(buf, sizeof(buf), "    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"iteration\",\n"
+                                       "      \"repetitions\": %u,\n      \"repetition_index\": %u,\n      \"iterations\": %llu,\n"
+                                       "      \"real_time\": %.3f,\n      \"cpu_time\": %.3f,\n      \"time_unit\": \"ns\"\n    }",
+                     run.name.c_str(), run.runName.c_str(), repetitions, run.repetitionIndex, (unsigned long long) run.iterations,
+                     run.nanoseconds, run.nanoseconds);
+        }
+
+        json += buf;
+        json += i + 1 < runs.size() ? ",\n" : "\n";
+    }
+
+    json += "  ]\n}\n";
+
+    return io_write_file(path, std::data(json), std::size(json));
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+    const char *output = "microbench.json";
+    double minTime = 0.5;
+    uint32_t repetitions = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            minTime = std::max(0.001, atof(argv[++i]));
+        } else if (arg == "--repetitions" && i + 1 < argc) {
+            repetitions = (uint32_t) std::max(1, atoi(argv[++i]));
+        } else if (arg == "--output" && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            fprintf(stderr, "unknown argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+#ifdef BRIGHT_SHADER_DIRECTORY
+    if (!vfs_exists("shader/bench.vert.spv"))
+        vfs_mount_directory("shader", BRIGHT_SHADER_DIRECTORY);
+#endif
+
+    RenderDeviceContextHeadless *rdc = memnew(RenderDeviceContextHeadless);
+
+    MicroBenchContext ctx = {};
+    ctx.rd = rdc->CreateRenderDevice();
+    ctx.offscreen = memnew(RenderingOffscreen, ctx.rd, 64, 64);
+    ctx.shadersAvailable = vfs_exists("shader/bench.vert.spv") && vfs_exists("shader/bench.frag.spv");
+    ctx.data.resize(MICRO_BENCH_BUFFER_SIZE, 0x5A);
+
+    /* deterministic inputs, sources then destination of every batch */
+    srand(1);
+    for (uint32_t i = 0; i < MICRO_BENCH_SIMD_BATCH * 3; i++) {
+        mat4 transform = glm::translate(mat4(1.0f), vec3(rand() % 64, rand() % 64, rand() % 64));
+        ctx.matrices.push_back(simd_load(glm::rotate(transform, (float) (rand() % 360), vec3(0.0f, 1.0f, 0.0f))));
+        ctx.quats.push_back(simd_load(glm::normalize(quat((float) (rand() % 100), (float) (rand() % 100), (float) (rand() % 100), (float) (rand() % 100) + 1.0f))));
+    }
+
+    for (uint32_t i = 0; i < MICRO_BENCH_SIMD_BATCH; i++) {
+        vec3 center = vec3(rand() % 200 - 100, rand() % 200 - 100, rand() % 200 - 100);
+        ctx.boxes.push_back({ { center.x - 1.0f, center.y - 1.0f, center.z - 1.0f, 0.0f }, { center.x + 1.0f, center.y + 1.0f, center.z + 1.0f, 0.0f } });
+    }
+
+    ctx.visible.resize(MICRO_BENCH_SIMD_BATCH);
+    ctx.frustum = simd_frustum_from_matrix(glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f) *
+                                           glm::lookAt(vec3(0.0f), vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 1.0f, 0.0f)));
+
+    RenderDevice::SamplerCreateInfo samplerCreateInfo = {};
+    ctx.rd->CreateSampler(&samplerCreateInfo, &ctx.sampler);
+
+    RenderDevice::TextureCreateInfo textureCreateInfo = {};
+    textureCreateInfo.width = 4;
+    textureCreateInfo.height = 4;
+    textureCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    textureCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    textureCreateInfo.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    textureCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    textureCreateInfo.imageViewType = VK_IMAGE_VIEW_TYPE_2D;
+    textureCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    for (uint32_t i = 0; i < MICRO_BENCH_BARRIER_TEXTURES; i++) {
+        RenderDevice::TextureHandle texture = ctx.rd->CreateTexture(&textureCreateInfo);
+        ctx.rd->BindTextureSampler(texture, ctx.sampler);
+        ctx.textures.push_back(texture);
+    }
+
+    // the barrier benches record GENERAL to GENERAL, leave UNDEFINED once
+    // here so the recorded old layout is the real one.
+    VkCommandBuffer cmdBuffer;
+    ctx.rd->CmdBufferOneTimeBegin(&cmdBuffer);
+    for (RenderDevice::TextureHandle texture : ctx.textures) {
+        RenderDevice::PipelineMemoryBarrier barrier;
+        barrier.image.texture = texture;
+        barrier.image.oldImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.image.newImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.image.srcAccessMask = 0;
+        barrier.image.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        ctx.rd->CmdPipelineBarrier(cmdBuffer, &barrier);
+    }
+    ctx.rd->CmdBufferOneTimeEnd(cmdBuffer);
+
+    VkDescriptorSetLayoutBinding binding = {};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    ctx.descriptorSetLayout = ctx.rd->AcquireDescriptorSetLayout(1, &binding);
+
+    printf("%s\n", rdc->GetDeviceName());
+    printf("%-36s %14s %14s\n", "Benchmark", "Time", "Iterations");
+
+    std::vector<MicroBenchRun> runs;
+    for (const MicroBench &bench : benchmarks) {
+        if (filter && !strstr(bench.name, filter))
+            continue;
+
+        uint64_t iterations = _CalibrateIterations(&ctx, &bench, minTime);
+        size_t first = runs.size();
+
+        for (uint32_t i = 0; i < repetitions; i++) {
+            MicroBenchRun run = _Run(&ctx, &bench, iterations);
+            run.repetitionIndex = i;
+            runs.push_back(run);
+
+            if (run.error) {
+                printf("%-36s ERROR: %s\n", bench.name, run.error);
+                break;
+            }
+
+            printf("%-36s %11.1f ns %14llu\n", bench.name, run.nanoseconds, (unsigned long long) iterations);
+        }
+
+        if (repetitions > 1 && !runs.back().error) {
+            _AppendAggregates(&runs, first);
+            for (size_t i = runs.size() - 3; i < runs.size(); i++)
+                printf("%-36s %11.1f ns\n", runs[i].name.c_str(), runs[i].nanoseconds);
+        }
+    }
+
+    /* only the file name, a Windows path would need escaping */
+    std::string executable = std::filesystem::path(argv[0]).filename().string();
+    Error err = _ExportJSON(output, executable.c_str(), &ctx, repetitions, runs);
+    if (err != OK)
+        fprintf(stderr, "write %s failed\n", output);
+
+    for (RenderDevice::TextureHandle texture : ctx.textures)
+        ctx.rd->DestroyTexture(texture);
+    ctx.rd->DestroySampler(ctx.sampler);
+
+    memdel(ctx.offscreen);
+    memdel(ctx.rd);
+    memdel(rdc);
+
+    return err == OK ? 0 : 1;
+}